@@ -31,6 +31,7 @@ using namespace regexx;
 #include "BmFilterChain.h"
 #include "BmGuiRoster.h"
 #include "BmIdentity.h"
+#include "BmImap.h"
 #include "BmImapAccount.h"
 #include "BmJobStatusWin.h"
 #include "BmLogHandler.h"
@@ -915,6 +916,7 @@ bool BeamApplication::QuitRequested() {
 			TheMailMonitor->UnlockLooper();
 			mIsQuitting = false;
 		} else {
+			ThePrefs->LogReadStatistics();
 			TheStoredActionFlusher->Quit();
 			TheMailMonitor->Quit();
 			for( int32 i=count-1; i>=0; --i) {
@@ -1056,6 +1058,31 @@ void BeamApplication::MessageReceived( BMessage* msg) {
 				}
 				break;
 			}
+			case BM_IMAP_IDLE: {
+				// N.B.: the IDLE-session is not subject to the limits of the
+				// network-job queue (see BmNetJobQueue):
+				while( TheRecvAccountList->IsJobRunning())
+					snooze( 200*1000);
+				const char* key = NULL;
+				msg->FindString( BmRecvAccountList::MSG_ITEMKEY, &key);
+				if (!key)
+					break;
+				BmRef<BmListModelItem> item 
+					= TheRecvAccountList->FindItemByKey( key);
+				BmImapAccount* imapAcc 
+					= dynamic_cast< BmImapAccount*>( item.Get());
+				if (!imapAcc || !imapAcc->WantsIdleSession())
+					break;
+				BmRef<BmImap> imap( new BmImap( BmString(key) << "_idle", 
+														  imapAcc));
+				if (imapAcc->AdoptIdleJob( imap.Get())) {
+					BM_LOG( BM_LogApp, 
+							  BmString("RecvAccount ") << key 
+							  	<< ": starting IDLE-session");
+					imap->StartJobInNewThread( BmImap::BM_IDLE_JOB);
+				}
+				break;
+			}
 			case BMM_CHECK_ALL: {
 				BM_LOG( BM_LogApp, "Request to check mail for all accounts");
 				while( TheRecvAccountList->IsJobRunning())
@@ -807,6 +807,129 @@ void BmSmtpView::UpdateModelView( BMessage* msg) {
 
 
 
+/********************************************************************************\
+	BmNetJobQueue
+\********************************************************************************/
+
+/*------------------------------------------------------------------------------*\
+	BmNetJobQueue()
+		-	c'tor
+\*------------------------------------------------------------------------------*/
+BmNetJobQueue::BmNetJobQueue()
+	:	mMaxJobs( 0)
+	,	mMaxJobsPerServer( 0)
+{
+}
+
+/*------------------------------------------------------------------------------*\
+	~BmNetJobQueue()
+		-	d'tor, deletes all messages that are still waiting
+\*------------------------------------------------------------------------------*/
+BmNetJobQueue::~BmNetJobQueue() {
+	for( EntryQueue::iterator iter = mQueue.begin(); iter != mQueue.end(); 
+	++iter)
+		delete iter->msg;
+}
+
+/*------------------------------------------------------------------------------*\
+	Add( msg, server)
+		-	adds the given job-message to the queue
+		-	a job that is already waiting is not queued twice, but a waiting 
+			automatic check is replaced by a user-requested one (such that it
+			moves up front)
+		-	returns true if the queue has taken ownership of msg
+\*------------------------------------------------------------------------------*/
+bool BmNetJobQueue::Add( BMessage* msg, const BmString& server) {
+	Entry entry;
+	entry.msg = msg;
+	entry.name = FindMsgString( msg, BmJobModel::MSG_JOB_NAME);
+	entry.server = server;
+	entry.isAutoCheck = msg->FindBool( BmRecvAccountList::MSG_AUTOCHECK);
+
+	EntryQueue::iterator iter;
+	for( iter = mQueue.begin(); iter != mQueue.end(); ++iter) {
+		if (iter->name == entry.name) {
+			if (entry.isAutoCheck || !iter->isAutoCheck)
+				return false;
+			delete iter->msg;
+			mQueue.erase( iter);
+			break;
+		}
+	}
+	if (entry.isAutoCheck)
+		mQueue.push_back( entry);
+	else {
+		for( iter = mQueue.begin(); iter != mQueue.end(); ++iter) {
+			if (iter->isAutoCheck)
+				break;
+		}
+		mQueue.insert( iter, entry);
+	}
+	return true;
+}
+
+/*------------------------------------------------------------------------------*\
+	TakeNextStartable()
+		-	removes the first job that may be started with respect to the 
+			limits from the queue and returns its message (which is then 
+			owned by the caller)
+		-	returns NULL if no job may be started right now
+\*------------------------------------------------------------------------------*/
+BMessage* BmNetJobQueue::TakeNextStartable() {
+	for( EntryQueue::iterator iter = mQueue.begin(); iter != mQueue.end(); 
+	++iter) {
+		if (MayStart( *iter)) {
+			BMessage* msg = iter->msg;
+			mRunning[iter->name] = iter->server;
+			mQueue.erase( iter);
+			return msg;
+		}
+	}
+	return NULL;
+}
+
+/*------------------------------------------------------------------------------*\
+	JobHasEnded( name)
+		-	frees the slot of the job with the given name
+\*------------------------------------------------------------------------------*/
+void BmNetJobQueue::JobHasEnded( const BmString& name) {
+	mRunning.erase( name);
+}
+
+/*------------------------------------------------------------------------------*\
+	SetLimits( maxJobs, maxJobsPerServer)
+		-	sets the maximum number of jobs running in total and per server
+\*------------------------------------------------------------------------------*/
+void BmNetJobQueue::SetLimits( uint32 maxJobs, uint32 maxJobsPerServer) {
+	mMaxJobs = maxJobs;
+	mMaxJobsPerServer = maxJobsPerServer;
+}
+
+/*------------------------------------------------------------------------------*\
+	MayStart( entry)
+		-	determines whether the given job may be started without exceeding
+			any of the limits
+\*------------------------------------------------------------------------------*/
+bool BmNetJobQueue::MayStart( const Entry& entry) const {
+	if (IsRunning( entry.name))
+		return false;
+	if (mMaxJobs && mRunning.size() >= mMaxJobs)
+		return false;
+	if (mMaxJobsPerServer) {
+		uint32 count = 0;
+		for( ServerMap::const_iterator iter = mRunning.begin(); 
+		iter != mRunning.end(); ++iter) {
+			if (iter->second == entry.server)
+				count++;
+		}
+		if (count >= mMaxJobsPerServer)
+			return false;
+	}
+	return true;
+}
+
+
+
 /********************************************************************************\
 	BmJobStatusWin
 \********************************************************************************/
@@ -915,11 +1038,8 @@ void BmJobStatusWin::MessageReceived(BMessage* msg) {
 			case BM_JOBWIN_SMTP:
 			case BM_JOBWIN_POP:
 			case BM_JOBWIN_IMAP: {
-				if (mActiveJobs.empty()
-				|| !ThePrefs->GetBool("QueueNetworkJobs", true))
-					AddJob( msg);
-				else
-					QueueJob( msg);
+				QueueNetJob( msg);
+				StartQueuedNetJobs();
 				break;
 			}
 			case BM_JOBWIN_FILTER:
@@ -942,12 +1062,8 @@ void BmJobStatusWin::MessageReceived(BMessage* msg) {
 					mDoneJobs[name] = pos->second;
 					mActiveJobs.erase(pos);
 				}
-				if (mActiveJobs.empty() && !mQueuedJobs.empty()) {
-					BMessage* msg = mQueuedJobs[0];
-					mQueuedJobs.pop_front();
-					AddJob( msg);
-					delete msg;
-				}
+				mNetJobQueue.JobHasEnded( name);
+				StartQueuedNetJobs();
 				break;
 			}
 			default:
@@ -961,10 +1077,11 @@ void BmJobStatusWin::MessageReceived(BMessage* msg) {
 }
 
 /*------------------------------------------------------------------------------*\
-	QueueJob( msg)
-		-	queues a new job-interface for later execution
+	QueueNetJob( msg)
+		-	queues a new network-job for later execution
+		-	if the job is already active (or waiting), it is left alone
 \*------------------------------------------------------------------------------*/
-void BmJobStatusWin::QueueJob( BMessage* msg) {
+void BmJobStatusWin::QueueNetJob( BMessage* msg) {
 	BM_ASSERT( msg);
 
 	BmString name = FindMsgString( msg, BmJobModel::MSG_JOB_NAME);
@@ -973,9 +1090,69 @@ void BmJobStatusWin::QueueJob( BMessage* msg) {
 
 	BmAutolockCheckGlobal lock( this);
 	if (!lock.IsLocked())
-		BM_THROW_RUNTIME( "AddJob(): could not lock window");
-	DetachCurrentMessage();
-	mQueuedJobs.push_back(msg);
+		BM_THROW_RUNTIME( "QueueNetJob(): could not lock window");
+	if (mActiveJobs.find( name) != mActiveJobs.end())
+		return;
+	if (mNetJobQueue.Add( msg, ServerOfJob( msg)))
+		DetachCurrentMessage();
+}
+
+/*------------------------------------------------------------------------------*\
+	StartQueuedNetJobs()
+		-	starts as many of the waiting network-jobs as the limits allow
+		-	if "QueueNetworkJobs" is switched off, all jobs are started
+			right away
+\*------------------------------------------------------------------------------*/
+void BmJobStatusWin::StartQueuedNetJobs() {
+	BmAutolockCheckGlobal lock( this);
+	if (!lock.IsLocked())
+		BM_THROW_RUNTIME( "StartQueuedNetJobs(): could not lock window");
+	if (ThePrefs->GetBool( "QueueNetworkJobs", true))
+		mNetJobQueue.SetLimits(
+			std::max( ThePrefs->GetInt( "MaxNetworkJobs", 3), (int32)1),
+			std::max( ThePrefs->GetInt( "MaxNetworkJobsPerServer", 2), (int32)1)
+		);
+	else
+		mNetJobQueue.SetLimits( 0, 0);
+	BMessage* msg;
+	while( (msg = mNetJobQueue.TakeNextStartable()) != NULL) {
+		BmString name = FindMsgString( msg, BmJobModel::MSG_JOB_NAME);
+		try {
+			AddJob( msg);
+		} catch(...) {
+			// the job has been counted as running already, so we must
+			// free its slot, otherwise it would be blocked forever:
+			mNetJobQueue.JobHasEnded( name);
+			delete msg;
+			throw;
+		}
+		delete msg;
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	ServerOfJob( msg)
+		-	returns the (lowercase) name of the server the given network-job
+			is going to talk to
+\*------------------------------------------------------------------------------*/
+BmString BmJobStatusWin::ServerOfJob( BMessage* msg) const {
+	BmString name = FindMsgString( msg, BmJobModel::MSG_JOB_NAME);
+	BmString server;
+	if (msg->what == BM_JOBWIN_SMTP) {
+		BmRef<BmListModelItem> item = TheSmtpAccountList->FindItemByKey( name);
+		BmSmtpAccount* smtpAcc = dynamic_cast< BmSmtpAccount*>( item.Get());
+		if (smtpAcc)
+			server = smtpAcc->SMTPServer();
+	} else {
+		BmRef<BmListModelItem> item = TheRecvAccountList->FindItemByKey( name);
+		BmRecvAccount* recvAcc = dynamic_cast< BmRecvAccount*>( item.Get());
+		if (recvAcc)
+			server = recvAcc->Server();
+	}
+	if (!server.Length())
+		// unknown account, we treat it as if it had a server of its own:
+		server = name;
+	return server.ToLower();
 }
 
 /*------------------------------------------------------------------------------*\
@@ -1081,18 +1258,10 @@ void BmJobStatusWin::RemoveJob( const char* name) {
 		RecalcSize();
 		mDoneJobs.erase( controller->ControllerName());
 
-		if (mActiveJobs.empty()) {
-			if (!mQueuedJobs.empty()) {
-				BMessage* msg = mQueuedJobs[0];
-				mQueuedJobs.pop_front();
-				AddJob( msg);
-				delete msg;
-			} else {
-				if (mDoneJobs.empty()) {
-					while( !IsHidden())
-						Hide();
-				}
-			}
+		StartQueuedNetJobs();
+		if (mActiveJobs.empty() && mDoneJobs.empty()) {
+			while( !IsHidden())
+				Hide();
 		}
 	}
 }
@@ -23,6 +23,7 @@
 #include <VGroup.h>
 
 #include "BmController.h"
+#include "BmString.h"
 #include "BmWindow.h"
 
 using std::deque;
@@ -243,6 +244,65 @@ private:
 	BmSmtpView operator=( const BmSmtpView&);
 };
 
+/*------------------------------------------------------------------------------*\
+	BmNetJobQueue
+		-	decides which of the waiting network-jobs may be started next: 
+			at most maxJobs jobs run at the same time, at most 
+			maxJobsPerServer of these talk to the same server
+		-	jobs requested by the user are started before automatic checks
+		-	a limit of 0 means that there is no limit
+		-	N.B.: IMAP IDLE-sessions are not counted against these limits,
+			as they are not started via this queue. Each account has at 
+			most one of them and it lives for as long as Beam runs, so 
+			counting it would permanently take up a slot per server (and,
+			with a per-server limit of 1, block the very checks the session
+			triggers)
+\*------------------------------------------------------------------------------*/
+class BmNetJobQueue {
+
+	struct Entry {
+		BMessage* msg;
+		BmString name;
+		BmString server;
+		bool isAutoCheck;
+	};
+	typedef deque<Entry> EntryQueue;
+	typedef map<BmString, BmString> ServerMap;
+
+public:
+	BmNetJobQueue();
+	~BmNetJobQueue();
+
+	// native methods:
+	bool Add( BMessage* msg, const BmString& server);
+	BMessage* TakeNextStartable();
+	void JobHasEnded( const BmString& name);
+
+	// getters:
+	inline bool IsEmpty() const			{ return mQueue.empty(); }
+	inline uint32 RunningCount() const	{ return mRunning.size(); }
+	inline bool IsRunning( const BmString& name) const
+													{ return mRunning.find( name) 
+																!= mRunning.end(); }
+
+	// setters:
+	void SetLimits( uint32 maxJobs, uint32 maxJobsPerServer);
+
+private:
+	bool MayStart( const Entry& entry) const;
+
+	EntryQueue mQueue;
+							// jobs waiting to run (user-requested ones first)
+	ServerMap mRunning;
+							// running jobs (name -> server)
+	uint32 mMaxJobs;
+	uint32 mMaxJobsPerServer;
+
+	// Hide copy-constructor and assignment:
+	BmNetJobQueue( const BmNetJobQueue&);
+	BmNetJobQueue operator=( const BmNetJobQueue&);
+};
+
 /*------------------------------------------------------------------------------*\
 	BmJobStatusWin
 		-	implements the connection-window, where the states of all 
@@ -269,7 +329,6 @@ class BmJobStatusWin : public BmWindow {
 	friend class BmJobStatusView;
 
 	typedef map<BmString, BmJobStatusView*> JobMap;
-	typedef deque<BMessage*> JobQueue;
 
 public:
 	// creator-func, c'tors and d'tor:
@@ -297,14 +356,16 @@ private:
 	// native methods:
 	void AddJob( BMessage* msg);
 	void RemoveJob( const char* name);
-	void QueueJob( BMessage* msg);
+	void QueueNetJob( BMessage* msg);
+	void StartQueuedNetJobs();
+	BmString ServerOfJob( BMessage* msg) const;
 
 	JobMap mActiveJobs;
 							// running jobs
 	JobMap mDoneJobs;
 							// jobs that are done, waiting to be removed
-	JobQueue mQueuedJobs;
-							// jobs waiting to run
+	BmNetJobQueue mNetJobQueue;
+							// network-jobs waiting to run
 	VGroup* mOuterGroup;
 							// the outmost view that the connection-interfaces live in
 	BLooper* mInvokingLooper;
@@ -318,6 +318,10 @@ const char* const BmListViewController::MSG_HIGHITEM = 	"hitem";
 const char* const BmListViewController::MSG_EXPAND = 		"expnd";
 const char* const BmListViewController::MSG_SCROLL_STEP= "step";
 
+// if a batch adds at least this many items, they are not inserted at their
+// sorted positions, but the whole list is sorted once they have been added:
+static const uint32 nMinAddedCountForSortOnce = 50;
+
 /*------------------------------------------------------------------------------*\
 	BmListViewController()
 		-	standard contructor
@@ -337,6 +341,7 @@ BmListViewController::BmListViewController( BRect rect,
 	,	mPulsedScrollRunner( NULL)
 	,	mPulsedScrollStep( 0)
 	,	mDragBetweenItems( false)
+	,	mInModelBatch( false)
 {
 	BmString family = ThePrefs->GetString( "ListviewFont", "");
 	int size = ThePrefs->GetInt( "ListviewFontSize", 0);
@@ -648,41 +653,18 @@ void BmListViewController::MessageReceived( BMessage* msg) {
 	try {
 		BmRef<BmDataModel> dataModel( DataModel());
 		switch( msg->what) {
-			case BM_LISTMODEL_ADD: {
-				BmListModelItem* item=NULL;
-				msg->FindPointer( BmListModel::MSG_MODELITEM, (void**)&item);
-				if (!item) break;
-				if (IsMsgFromCurrentModel( msg)) {
-					AddModelItem( item);
-					UpdateCaption();
-				}
-				item->RemoveRef();
-							// the msg is no longer referencing the item
-				break;
-			}
-			case BM_LISTMODEL_REMOVE: {
-				BmListModelItem* item=NULL;
-				msg->FindPointer( BmListModel::MSG_MODELITEM, (void**)&item);
-				if (!item) break;
+			case BM_LISTMODEL_BATCH: {
+				BmListModelBatch* batch=NULL;
+				msg->FindPointer( BmListModel::MSG_BATCH, (void**)&batch);
+				if (!batch) break;
+				batch->Close();
+							// the model must not add any more changes now
 				if (IsMsgFromCurrentModel( msg)) {
-					RemoveModelItem( item);
+					ApplyModelBatch( batch);
 					UpdateCaption();
 				}
-				item->RemoveRef();
-							// the msg is no longer referencing the item
-				break;
-			}
-			case BM_LISTMODEL_UPDATE: {
-				BmListModelItem* item=NULL;
-				msg->FindPointer( BmListModel::MSG_MODELITEM, (void**)&item);
-				if (!item) break;
-				if (IsMsgFromCurrentModel( msg)) {
-					BmUpdFlags flags = UPD_ALL;
-					msg->FindInt32( BmListModel::MSG_UPD_FLAGS, (int32*)&flags);
-					UpdateModelItem( item, flags);
-				}
-				item->RemoveRef();
-							// the msg is no longer referencing the item
+				batch->RemoveRef();
+							// the msg is no longer referencing the batch
 				break;
 			}
 			case BM_LISTVIEW_SHOW_COLUMN:
@@ -862,6 +844,67 @@ void BmListViewController::AddAllModelItems() {
 					<< ": finished with sorting added items");
 }
 
+/*------------------------------------------------------------------------------*\
+	ApplyModelBatch( batch)
+		-	applies all changes contained in the given batch (in order)
+		-	if the batch adds many items, these are appended unsorted and the 
+			whole list is sorted once afterwards (instead of inserting each item 
+			at its sorted position)
+\*------------------------------------------------------------------------------*/
+void BmListViewController::ApplyModelBatch( BmListModelBatch* batch) {
+	BmListModel *model = dynamic_cast<BmListModel*>(DataModel().Get());
+	BM_ASSERT( model);
+	BmAutolockCheckGlobal lock( model->ModelLocker());
+	if (!lock.IsLocked())
+		BM_THROW_RUNTIME( 
+			model->ModelNameNC() << ": Unable to get lock"
+		);
+	const BmListModelBatch::BmChangeVect& changes = batch->Changes();
+	BM_LOG2( BM_LogModelController, 
+				BmString(ControllerName()) << ": applying batch of " 
+					<< changes.size() << " changes");
+	bool sortOnce = batch->AddedCount() >= nMinAddedCountForSortOnce;
+	if (sortOnce) {
+		SetDisconnectScrollView( true);
+		SetInsertAtSortedPos( false);
+	}
+	mInModelBatch = true;
+	try {
+		BmListModelBatch::BmChangeVect::const_iterator iter;
+		for( iter = changes.begin(); iter != changes.end(); ++iter) {
+			switch( iter->type) {
+				case BmListModelBatch::ITEM_ADDED:
+					AddModelItem( iter->item.Get());
+					break;
+				case BmListModelBatch::ITEM_REMOVED:
+					RemoveModelItem( iter->item.Get());
+					break;
+				case BmListModelBatch::ITEM_UPDATED:
+					UpdateModelItem( iter->item.Get(), iter->flags);
+					break;
+			}
+		}
+	} catch( BM_error&) {
+		mInModelBatch = false;
+		if (sortOnce) {
+			SetInsertAtSortedPos( true);
+			SetDisconnectScrollView( false);
+		}
+		throw;
+	}
+	mInModelBatch = false;
+	if (sortOnce) {
+		SortItems();
+		SetInsertAtSortedPos( true);
+		SetDisconnectScrollView( false);
+		UpdateDataRect( true);
+	}
+	if (batch->AddedCount() || batch->RemovedCount()) {
+		BMessage msg( BM_NTFY_LISTCONTROLLER_MODIFIED);
+		SendNotices( BM_NTFY_LISTCONTROLLER_MODIFIED, &msg);
+	}
+}
+
 /*------------------------------------------------------------------------------*\
 	AddModelItem( item)
 		-	Hook function that is called whenever a new item has been added to the 
@@ -886,8 +929,10 @@ BmListViewItem* BmListViewController::AddModelItem( BmListModelItem* item) {
 			BmListViewItem* parentItem = FindViewItemFor( parent.Get());
 			newItem = doAddModelItem( parentItem, item, true);
 		}
-		BMessage msg( BM_NTFY_LISTCONTROLLER_MODIFIED);
-		SendNotices( BM_NTFY_LISTCONTROLLER_MODIFIED, &msg);
+		if (!mInModelBatch) {
+			BMessage msg( BM_NTFY_LISTCONTROLLER_MODIFIED);
+			SendNotices( BM_NTFY_LISTCONTROLLER_MODIFIED, &msg);
+		}
 	}
 	return newItem;
 }
@@ -946,9 +991,11 @@ void BmListViewController::RemoveModelItem( BmListModelItem* item) {
 				model->ModelNameNC() << ": Unable to get lock"
 			);
 		doRemoveModelItem( item);
-		UpdateCaption();
-		BMessage msg( BM_NTFY_LISTCONTROLLER_MODIFIED);
-		SendNotices( BM_NTFY_LISTCONTROLLER_MODIFIED, &msg);
+		if (!mInModelBatch) {
+			UpdateCaption();
+			BMessage msg( BM_NTFY_LISTCONTROLLER_MODIFIED);
+			SendNotices( BM_NTFY_LISTCONTROLLER_MODIFIED, &msg);
+		}
 	}
 }
 
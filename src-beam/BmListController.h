@@ -206,6 +206,7 @@ public:
 protected:
 	// native methods:
 	virtual void AddAllModelItems();
+	virtual void ApplyModelBatch( BmListModelBatch* batch);
 	virtual BmListViewItem* AddModelItem( BmListModelItem* item);
 	virtual void RemoveModelItem( BmListModelItem* item);
 	virtual BmListViewItem* UpdateModelItem( BmListModelItem* item, BmUpdFlags updFlags);
@@ -245,6 +246,7 @@ protected:
 	BMessageRunner* mPulsedScrollRunner;
 	int32 mPulsedScrollStep;
 	bool mDragBetweenItems;
+	bool mInModelBatch;
 
 	static const char* const MSG_HIGHITEM;
 	static const char* const MSG_EXPAND;
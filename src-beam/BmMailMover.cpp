@@ -6,24 +6,47 @@
  *		Oliver Tappe <beam@hirschkaefer.de>
  */
 
+#include <map>
 #include <memory.h>
 #include <memory>
 #include <stdio.h>
+#include <vector>
 
 #include <Directory.h>
 
 #include "BmBasics.h"
 #include "BmLogHandler.h"
 #include "BmMailFolder.h"
+#include "BmMailFolderList.h"
+#include "BmMailMonitor.h"
 #include "BmMailMover.h"
+#include "BmStorageUtil.h"
 #include "BmUtil.h"
 
 // standard logfile-name for this class:
 #undef BM_LOGNAME
 #define BM_LOGNAME Name()
 
+using std::map;
+using std::vector;
+
 static const float GRAIN = 1.0f;
 
+/*------------------------------------------------------------------------------*\
+	PendingMove
+		-	a mail that is about to be moved, together with the info that is
+			required to update the ref-lists once it has been moved
+\*------------------------------------------------------------------------------*/
+struct PendingMove {
+	PendingMove() : ref( NULL), announced( false) {}
+	entry_ref* ref;
+	node_ref nref;
+	BmRef<BmMailFolder> srcFolder;
+	bool announced;
+};
+typedef vector< PendingMove> PendingMoveVect;
+typedef map< BmMailFolder*, vector<node_ref> > RemovedRefMap;
+
 const char* const BmMailMover::MSG_MOVER = 		"bm:mover";
 const char* const BmMailMover::MSG_DELTA = 		"bm:delta";
 const char* const BmMailMover::MSG_TRAILING = 	"bm:trailing";
@@ -55,6 +78,9 @@ BmMailMover::~BmMailMover() {
 /*------------------------------------------------------------------------------*\
 	StartJob()
 		-	the mainloop, moves all mails to new home
+		-	the moves are announced to the mail-monitor beforehand, which will
+			then ignore the corresponding move-events. Instead, the affected
+			ref-lists are updated by us, once per folder for the whole batch.
 \*------------------------------------------------------------------------------*/
 bool BmMailMover::StartJob() {
 
@@ -69,15 +95,42 @@ bool BmMailMover::StartJob() {
 	BEntry entry;
 	node_ref destNodeRef;
 	destDir.GetNodeRef( &destNodeRef);
-	// move each mailref into the destination folder:
-	try {
-		int32 i;
-		for( i=0; ShouldContinue() && i < mRefCount; ++i) {
-			ref = &mRefs[i];
-			if (ref->directory == destNodeRef.node 
-			&& ref->device == destNodeRef.device)
-				continue;						
+	// find out which mails need to be moved (and where they live):
+	PendingMoveVect moves;
+	BmExpectedMoveMap expectedMoves;
+	for( int32 i=0; i < mRefCount; ++i) {
+		ref = &mRefs[i];
+		if (ref->directory == destNodeRef.node 
+		&& ref->device == destNodeRef.device)
+			continue;						
 							// no move neccessary, already at 'new' home
+		PendingMove move;
+		move.ref = ref;
+		if (entry.SetTo( ref) == B_OK && entry.GetNodeRef( &move.nref) == B_OK) {
+			node_ref pnref;
+			pnref.device = ref->device;
+			pnref.node = ref->directory;
+			move.srcFolder = dynamic_cast<BmMailFolder*>( 
+				TheMailFolderList->FindItemByKey( BM_REFKEY( pnref)).Get()
+			);
+			// we get a move-event from the destination folder and another one
+			// from the source folder (if that is being watched, too):
+			expectedMoves[BM_REFKEY( move.nref)] = move.srcFolder ? 2 : 1;
+			move.announced = true;
+		}
+		moves.push_back( move);
+	}
+	TheMailMonitor->ExpectMoves( expectedMoves);
+
+	// move each mail into the destination folder:
+	BmMailRefSpecVect addedSpecs;
+	RemovedRefMap removedRefs;
+	BmExpectedMoveMap cancelledMoves;
+	BmString errstr;
+	uint32 m;
+	try {
+		for( m=0; ShouldContinue() && m < moves.size(); ++m) {
+			ref = moves[m].ref;
 			if ((err = entry.SetTo( ref)) != B_OK)
 				BM_THROW_RUNTIME( BmString("couldn't create entry for <")
 											<< ref->name << "> \n\nError:" 
@@ -97,22 +150,56 @@ bool BmMailMover::StartJob() {
 					BmString("couldn't move <") << ref->name << "> \n\nError:" 
 						<< strerror(err)
 				);
-			if ((i+1)%(int)GRAIN == 0) {
+			BmMailRefSpec spec;
+			if (moves[m].announced && entry.GetRef( &spec.eref) == B_OK
+			&& entry.GetStat( &spec.st) == B_OK) {
+				addedSpecs.push_back( spec);
+				if (moves[m].srcFolder)
+					removedRefs[moves[m].srcFolder.Get()].push_back( 
+						moves[m].nref
+					);
+			} else if (moves[m].announced) {
+				// we can't handle this one, so we leave it to the mail-monitor:
+				cancelledMoves[BM_REFKEY( moves[m].nref)] 
+					= expectedMoves[BM_REFKEY( moves[m].nref)];
+			}
+			if ((m+1)%(int)GRAIN == 0) {
 				entry.GetName( filename);
-				BmString currentCount = BmString()<<i<<" of "<<mRefCount;
+				BmString currentCount = BmString()<<m<<" of "<<moves.size();
 				UpdateStatus( delta, filename, currentCount.String());
 			}
-			snooze( 20*1000);
-							// give node-monitor a chance to keep up... 
-							// (it will drop messages if we go too fast)
 		}
 		entry.GetName( filename);
-		BmString currentCount = BmString()<<i<<" of "<<mRefCount;
+		BmString currentCount = BmString()<<m<<" of "<<moves.size();
 		UpdateStatus( delta, filename, currentCount.String());
 	}
 	catch( BM_runtime_error &err) {
+		errstr = err.what();
+	}
+
+	// withdraw the announcements of all moves that didn't happen...
+	for( ; m < moves.size(); ++m) {
+		if (moves[m].announced)
+			cancelledMoves[BM_REFKEY( moves[m].nref)] 
+				= expectedMoves[BM_REFKEY( moves[m].nref)];
+	}
+	if (!cancelledMoves.empty())
+		TheMailMonitor->CancelExpectedMoves( cancelledMoves);
+	// ...and update the ref-lists for the ones that did:
+	try {
+		RemovedRefMap::iterator iter;
+		for( iter = removedRefs.begin(); iter != removedRefs.end(); ++iter)
+			iter->first->RemoveMailRefs( iter->second);
+		if (!addedSpecs.empty())
+			mDestFolder->AddMailRefs( addedSpecs);
+	}
+	catch( BM_runtime_error &err) {
+		if (!errstr.Length())
+			errstr = err.what();
+	}
+
+	if (errstr.Length()) {
 		// a problem occurred, we tell the user:
-		BmString errstr = err.what();
 		BmString text = Name() << "\n\n" << errstr;
 		BM_SHOWERR( BmString("BmMailMover: ") << text);
 		return false;
@@ -57,6 +57,7 @@ void WordWrap( const BmString& in, BmString& out, int32 maxLineLen,
 	}
 	Regexx rx;
 	Regexx rxUrl;
+	const BmString quotingLevelRX = ThePrefs->GetString( "QuotingLevelRX");
 	int32 lastPos = 0;
 	const char *s = in.String();
 	bool needBreak = false;
@@ -87,8 +88,7 @@ void WordWrap( const BmString& in, BmString& out, int32 maxLineLen,
 				// and the word:
 				BmString lineBeforeSpace;
 				in.CopyInto( lineBeforeSpace, lastPos, 1+lastSpcPos-lastPos);
-				if (rx.exec( lineBeforeSpace, 
-								 ThePrefs->GetString( "QuotingLevelRX"))) {
+				if (rx.exec( lineBeforeSpace, quotingLevelRX)) {
 					BmString text=rx.match[0].atom[1];
 					if (!text.Length()) {
 						// the subpart before last space consists only of the quote,
@@ -873,7 +873,7 @@ void BmMailView::JobIsDone( bool completed) {
 		ContainerView()->SetErrorText(mParsingErrors);
 		BmString displayText;
 		BmStringOBuf displayBuf( mShowRaw 
-											? mCurrMail->RawText().Length()
+											? mCurrMail->RawTextLength()
 											: 65536);
 		mTextRunMap.clear();
 		mTextRunMap[0] = BmTextRunInfo( ui_color(B_DOCUMENT_TEXT_COLOR));
@@ -6,6 +6,8 @@
  *		Oliver Tappe <beam@hirschkaefer.de>
  */
 
+#include <ctype.h>
+
 #include "BmFilterAddon.h"
 
 /********************************************************************************\
@@ -33,6 +35,74 @@ BmFilterAddon::~BmFilterAddon()
 
 
 
+/********************************************************************************\
+	BmHeaderInfoSet
+\********************************************************************************/
+
+/*------------------------------------------------------------------------------*\
+	BmHeaderInfoSet( count)
+		-	c'tor, the set starts with one reference (owned by the creator)
+\*------------------------------------------------------------------------------*/
+BmHeaderInfoSet::BmHeaderInfoSet( int32 count)
+	:	mInfos( new BmHeaderInfo [count])
+	,	mCount( count)
+	,	mValues( count)
+	,	mRefCount( 1)
+{
+	for( int32 i=0; i<count; ++i)
+		mInfos[i].values = NULL;
+}
+
+/*------------------------------------------------------------------------------*\
+	~BmHeaderInfoSet()
+		-	d'tor
+\*------------------------------------------------------------------------------*/
+BmHeaderInfoSet::~BmHeaderInfoSet()
+{
+	for( int32 i=0; i<mCount; ++i)
+		delete [] mInfos[i].values;
+	delete [] mInfos;
+}
+
+/*------------------------------------------------------------------------------*\
+	AddRef()
+		-	
+\*------------------------------------------------------------------------------*/
+void BmHeaderInfoSet::AddRef()
+{
+	atomic_add( &mRefCount, 1);
+}
+
+/*------------------------------------------------------------------------------*\
+	RemoveRef()
+		-	deletes the set when the last reference is gone
+\*------------------------------------------------------------------------------*/
+void BmHeaderInfoSet::RemoveRef()
+{
+	if (atomic_add( &mRefCount, -1) == 1)
+		delete this;
+}
+
+/*------------------------------------------------------------------------------*\
+	SetInfo( idx, fieldName, values)
+		-	sets the info at the given index to (copies of) the given field
+\*------------------------------------------------------------------------------*/
+void BmHeaderInfoSet::SetInfo( int32 idx, const BmString& fieldName, 
+										 const vector<BmString>& values)
+{
+	vector<BmString>& store = mValues[idx];
+	store = values;
+	const char** valuePtrs = new const char* [store.size()+1];
+	for( uint32 v=0; v<store.size(); ++v)
+		valuePtrs[v] = store[v].String();
+	valuePtrs[store.size()] = NULL;
+	delete [] mInfos[idx].values;
+	mInfos[idx].values = valuePtrs;
+	mInfos[idx].fieldName = fieldName;
+}
+
+
+
 /********************************************************************************\
 	BmMsgContext
 \********************************************************************************/
@@ -43,7 +113,11 @@ BmFilterAddon::~BmFilterAddon()
 \*------------------------------------------------------------------------------*/
 BmMsgContext::BmMsgContext()
 	:	mail( NULL)
+	,	headerInfoCount( 0)
 	,	headerInfos( NULL)
+	,	mHeaderIndex( NULL)
+	,	mHeaderIndexSize( 0)
+	,	mSharedHeaderInfos( NULL)
 {
 }
 
@@ -52,11 +126,103 @@ BmMsgContext::BmMsgContext()
 		-	standard d'tor
 \*------------------------------------------------------------------------------*/
 BmMsgContext::~BmMsgContext() {
-	if (headerInfos) {
+	FreeHeaderInfos();
+	delete [] mHeaderIndex;
+}
+
+/*------------------------------------------------------------------------------*\
+	FreeHeaderInfos()
+		-	frees the header-infos or, if they are shared, drops the reference
+			to them
+\*------------------------------------------------------------------------------*/
+void BmMsgContext::FreeHeaderInfos()
+{
+	if (mSharedHeaderInfos) {
+		mSharedHeaderInfos->RemoveRef();
+		mSharedHeaderInfos = NULL;
+	} else if (headerInfos) {
 		for( int i=0; i<headerInfoCount; ++i)
 			delete [] headerInfos[i].values;
 		delete [] headerInfos;
 	}
+	headerInfos = NULL;
+	headerInfoCount = 0;
+}
+
+/*------------------------------------------------------------------------------*\
+	HashFieldName()
+		-	case-insensitive hash for header-field names
+\*------------------------------------------------------------------------------*/
+static inline uint32 HashFieldName( const char* name)
+{
+	uint32 hash = 5381;
+	for( const unsigned char* p = (const unsigned char*)name; *p; ++p)
+		hash = (hash << 5) + hash + tolower( *p);
+	return hash;
+}
+
+/*------------------------------------------------------------------------------*\
+	BuildHeaderIndex()
+		-	builds a hash-index for all header-infos
+\*------------------------------------------------------------------------------*/
+void BmMsgContext::BuildHeaderIndex()
+{
+	mHeaderIndexSize = 16;
+	while( mHeaderIndexSize < 2 * (uint32)headerInfoCount)
+		mHeaderIndexSize *= 2;
+	mHeaderIndex = new int32 [mHeaderIndexSize];
+	for( uint32 s=0; s<mHeaderIndexSize; ++s)
+		mHeaderIndex[s] = -1;
+	for( int32 i=0; i<headerInfoCount; ++i) {
+		uint32 s 
+			= HashFieldName( headerInfos[i].fieldName.String()) 
+				& (mHeaderIndexSize-1);
+		while( mHeaderIndex[s] >= 0)
+			s = (s+1) & (mHeaderIndexSize-1);
+		mHeaderIndex[s] = i;
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	FindHeaderInfo( fieldName)
+		-	returns the header-info for the given field (case-insensitive) or
+			NULL if the mail has no such field
+		-	the hash-index is built on first use, so multiple filters (and
+			multiple lookups of a single filter) on the same mail share it
+\*------------------------------------------------------------------------------*/
+const BmHeaderInfo* BmMsgContext::FindHeaderInfo( const char* fieldName)
+{
+	if (!headerInfos || !fieldName)
+		return NULL;
+	if (!mHeaderIndex)
+		BuildHeaderIndex();
+	uint32 s = HashFieldName( fieldName) & (mHeaderIndexSize-1);
+	for( int32 i; (i = mHeaderIndex[s]) >= 0; s = (s+1) & (mHeaderIndexSize-1)) {
+		if (!headerInfos[i].fieldName.ICompare( fieldName))
+			return &headerInfos[i];
+	}
+	return NULL;
+}
+
+/*------------------------------------------------------------------------------*\
+	ShareHeaderInfos( infoSet)
+		-	sets the header-infos of this context to the ones of the given set,
+			which is shared with someone else (the mail-header)
+		-	the context keeps a reference to the set, so the infos stay valid 
+			for as long as this context lives, even if the header changes
+\*------------------------------------------------------------------------------*/
+void BmMsgContext::ShareHeaderInfos( BmHeaderInfoSet* infoSet)
+{
+	if (infoSet)
+		infoSet->AddRef();
+	FreeHeaderInfos();
+	delete [] mHeaderIndex;
+	mHeaderIndex = NULL;
+	if (infoSet) {
+		mSharedHeaderInfos = infoSet;
+		headerInfos = infoSet->Infos();
+		headerInfoCount = infoSet->Count();
+	}
 }
 
 /*------------------------------------------------------------------------------*\
@@ -188,3 +354,26 @@ double BmMsgContext::GetDouble(const char* fieldName) const
 	return mDataMsg.FindDouble(fieldName);
 }
 
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	
+\*------------------------------------------------------------------------------*/
+void BmMsgContext::SetData(const char* fieldName, const void* data, 
+									ssize_t size)
+{
+	mDataMsg.RemoveName(fieldName);
+	mDataMsg.AddData(fieldName, B_RAW_TYPE, data, size);
+	NoteChange(fieldName);
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	the returned data belongs to the msg-context and stays valid until
+			the field is set again
+\*------------------------------------------------------------------------------*/
+bool BmMsgContext::GetData(const char* fieldName, const void** data, 
+									ssize_t* size) const
+{
+	return mDataMsg.FindData(fieldName, B_RAW_TYPE, data, size) == B_OK;
+}
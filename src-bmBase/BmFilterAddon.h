@@ -11,6 +11,8 @@
 
 #include <Message.h>
 
+#include <vector>
+
 #include "BmBase.h"
 #include "BmString.h"
 
@@ -19,6 +21,42 @@ struct IMPEXPBMBASE BmHeaderInfo {
 	BmString fieldName;
 	const char** values;
 };
+
+/*------------------------------------------------------------------------------*\
+	BmHeaderInfoSet
+		-	a reference-counted array of header-infos (holding copies of all
+			the values), which a mail-header shares with its message-contexts
+		-	the set is deleted when the last reference is removed, so a
+			context can keep using it even after the header has changed
+\*------------------------------------------------------------------------------*/
+class IMPEXPBMBASE BmHeaderInfoSet {
+public:
+	BmHeaderInfoSet( int32 count);
+
+	void AddRef();
+	void RemoveRef();
+
+	void SetInfo( int32 idx, const BmString& fieldName, 
+					  const vector<BmString>& values);
+
+	// getters:
+	inline BmHeaderInfo* Infos() const	{ return mInfos; }
+	inline int32 Count() const				{ return mCount; }
+
+private:
+	~BmHeaderInfoSet();
+
+	BmHeaderInfo* mInfos;
+	int32 mCount;
+	vector< vector<BmString> > mValues;
+							// the values the infos point into
+	int32 mRefCount;
+
+	// Hide copy-constructor and assignment:
+	BmHeaderInfoSet( const BmHeaderInfoSet&);
+	BmHeaderInfoSet operator=( const BmHeaderInfoSet&);
+};
+
 /*------------------------------------------------------------------------------*\
 	BmMsgContext
 		-	
@@ -32,6 +70,11 @@ struct IMPEXPBMBASE BmMsgContext {
 	int32 headerInfoCount;
 	BmHeaderInfo *headerInfos;
 	
+	const BmHeaderInfo* FindHeaderInfo( const char* fieldName);
+	void ShareHeaderInfos( BmHeaderInfoSet* infoSet);
+							// sets header-infos that are shared with someone 
+							// else (the mail-header), keeping a reference
+
 	void ResetChanges();
 	bool FieldHasChanged(const char* fieldName) const;
 
@@ -50,8 +93,19 @@ struct IMPEXPBMBASE BmMsgContext {
 	void SetDouble(const char* fieldName, double value);
 	double GetDouble(const char* fieldName) const;
 
+	void SetData(const char* fieldName, const void* data, ssize_t size);
+	bool GetData(const char* fieldName, const void** data, ssize_t* size) const;
+
 private:
 	void NoteChange(const char* fieldName);
+	void BuildHeaderIndex();
+	void FreeHeaderInfos();
+
+	// hash-index into headerInfos (case-insensitive, open addressing):
+	int32* mHeaderIndex;
+	uint32 mHeaderIndexSize;
+	BmHeaderInfoSet* mSharedHeaderInfos;
+							// the set headerInfos belongs to, if shared
 
 	// data message that contains input & output data:
 	BMessage mDataMsg;
@@ -67,6 +121,14 @@ private:
 /*------------------------------------------------------------------------------*\
 	BmFilterAddon 
 		-	base class for all filter-addons, this is used as filter-addon-API
+		-	Execute() is called for several mails at the same time (by the 
+			worker threads of a BmMailFilter and by concurrently running 
+			inbound jobs), so it must be reentrant: anything that belongs to
+			one call lives in the msg-context, the job-specs or on the stack,
+			never in members or statics. State shared between calls (compiled
+			scripts, feature-tables, ...) must be guarded by the addon itself.
+		-	ErrorString() may be called while other threads are executing,
+			it returns a copy of the last error (of whichever call).
 \*------------------------------------------------------------------------------*/
 class IMPEXPBMBASE BmFilterAddon {
 
@@ -5,6 +5,7 @@
  * Authors:
  *		Oliver Tappe <beam@hirschkaefer.de>
  */
+#include <algorithm>
 #include <cstring>
 
 #include <Autolock.h>
@@ -12,7 +13,6 @@
 #include <Entry.h>
 #include <File.h>
 #include <FindDirectory.h>
-#include <MessageQueue.h>
 #include <Messenger.h>
 #include <Path.h>
 
@@ -76,11 +76,31 @@ const uint32 BM_LogAll  				= 0xffffffff;
 
 BmLogHandler* TheLogHandler = NULL;
 
+volatile uint32 BmLogHandler::nLogLevels = 0;
+
 /*------------------------------------------------------------------------------*\
 	static logging-function
 		-	logs only if a loghandler is actually present
 \*------------------------------------------------------------------------------*/
-void BmLogHandler::Log( const BmString logname, const BmString& msg) { 
+void BmLogHandler::Log( const BmString& logname, const BmString& msg) { 
+	if (TheLogHandler)
+		TheLogHandler->LogToFile( logname.String(), msg.String());
+}
+
+/*------------------------------------------------------------------------------*\
+	static logging-function
+		-	logs only if a loghandler is actually present
+\*------------------------------------------------------------------------------*/
+void BmLogHandler::Log( const BmString& logname, const char* msg) { 
+	if (TheLogHandler)
+		TheLogHandler->LogToFile( logname.String(), msg);
+}
+
+/*------------------------------------------------------------------------------*\
+	static logging-function
+		-	logs only if a loghandler is actually present
+\*------------------------------------------------------------------------------*/
+void BmLogHandler::Log( const char* const logname, const BmString& msg) { 
 	if (TheLogHandler)
 		TheLogHandler->LogToFile( logname, msg.String());
 }
@@ -90,9 +110,8 @@ void BmLogHandler::Log( const BmString logname, const BmString& msg) {
 		-	logs only if a loghandler is actually present
 \*------------------------------------------------------------------------------*/
 void BmLogHandler::Log( const char* const logname, const char* msg) { 
-	BmString theLogname(logname);
 	if (TheLogHandler)
-		TheLogHandler->LogToFile( theLogname, msg);
+		TheLogHandler->LogToFile( logname, msg);
 }
 
 /*------------------------------------------------------------------------------*\
@@ -127,8 +146,11 @@ void BmLogHandler::StartWatchingLogfile( BHandler* handler,
 	} else if (!info->watchingHandlers.HasItem( handler))
 		info->watchingHandlers.AddItem( handler);
 	BmLogfile* log = LogfileFor( logfileName);
-	if (log && !log->mWatchingHandlers.HasItem( handler))
-		log->mWatchingHandlers.AddItem( handler);
+	if (log) {
+		BAutolock watcherLock( log->mWatcherLocker);
+		if (!log->mWatchingHandlers.HasItem( handler))
+			log->mWatchingHandlers.AddItem( handler);
+	}
 	mLocker.Unlock();
 }
 
@@ -146,8 +168,10 @@ void BmLogHandler::StopWatchingLogfile( BHandler* handler,
 	} else
 		info->watchingHandlers.RemoveItem( handler);
 	BmLogfile* log = LogfileFor( logfileName);
-	if (log)
+	if (log) {
+		BAutolock watcherLock( log->mWatcherLocker);
 		log->mWatchingHandlers.RemoveItem( handler);
+	}
 	mLocker.Unlock();
 }
 
@@ -170,8 +194,12 @@ BmLogHandler* BmLogHandler::CreateInstance( uint32 logLevels,
 BmLogHandler::BmLogHandler( uint32 logLevels, node_ref* appFolderNodeRef)
 	:	StopWatch( "Beam_watch", true)
 	,	mLocker( "beam_loghandler")
-	,	mLoglevels( logLevels)
+	,	mPublishedCount( 0)
+	,	mLookupCount( 0)
 {
+	for( int32 i=0; i<nMaxPublishedLogs; ++i)
+		mPublishedLogs[i] = NULL;
+	nLogLevels = logLevels;
 	BPath logPath;
 	if (find_directory( B_SYSTEM_LOG_DIRECTORY, &logPath, true) == B_OK) {
 		mLogFolder.SetTo(logPath.Path());
@@ -194,13 +222,8 @@ BmLogHandler::BmLogHandler( uint32 logLevels, node_ref* appFolderNodeRef)
 		-	frees each and every log-file
 \*------------------------------------------------------------------------------*/
 BmLogHandler::~BmLogHandler() {
-	int32 count = mActiveLogs.CountItems();
-	for( int i=0; i<count; ++i) {
-		BLooper* looper = static_cast< BLooper*>( mActiveLogs.ItemAt(i));
-		looper->LockLooper();
-		looper->Quit();
-	}
-	mActiveLogs.MakeEmpty();
+	CloseAllLogs();
+	nLogLevels = 0;
 	TheLogHandler = NULL;
 }
 
@@ -210,7 +233,7 @@ BmLogHandler::~BmLogHandler() {
 \*------------------------------------------------------------------------------*/
 void BmLogHandler::LogLevels( uint32 loglevels, int32 minFileSize, 
 										int32 maxFileSize) {
-	mLoglevels = loglevels;
+	nLogLevels = loglevels;
 	mMinFileSize = minFileSize;
 	mMaxFileSize = maxFileSize;
 }
@@ -219,7 +242,7 @@ void BmLogHandler::LogLevels( uint32 loglevels, int32 minFileSize,
 	LogfileFor( logname)
 		-	tries to find the logfile of the given name in the logfile-list
 \*------------------------------------------------------------------------------*/
-BmLogHandler::BmLogfile* BmLogHandler::LogfileFor( const BmString &logname) {
+BmLogHandler::BmLogfile* BmLogHandler::LogfileFor( const char* logname) {
 	BmLogfile* log = NULL;
 	int32 count = mActiveLogs.CountItems();
 	for( int i=0; i<count; ++i) {
@@ -230,6 +253,69 @@ BmLogHandler::BmLogfile* BmLogHandler::LogfileFor( const BmString &logname) {
 	return NULL;
 }
 
+/*------------------------------------------------------------------------------*\
+	LookupPublishedLogfile( logname)
+		-	tries to find the logfile of the given name among the published 
+			ones, without locking
+		-	a found logfile is returned with its producer-count incremented
+		-	while scanning, we are counted in mLookupCount, such that 
+			UnpublishLogfile() can wait for us before the logfile is deleted
+\*------------------------------------------------------------------------------*/
+BmLogHandler::BmLogfile* 
+BmLogHandler::LookupPublishedLogfile( const char* logname) {
+	atomic_add( &mLookupCount, 1);
+	BmLogfile* found = NULL;
+	int32 count = atomic_get( &mPublishedCount);
+	for( int32 i=0; i<count; ++i) {
+		BmLogfile* log = mPublishedLogs[i];
+		if (log && log->logname == logname) {
+			atomic_add( &log->mActiveProducers, 1);
+			found = log;
+			break;
+		}
+	}
+	atomic_add( &mLookupCount, -1);
+	return found;
+}
+
+/*------------------------------------------------------------------------------*\
+	PublishLogfile( log)
+		-	makes the given (completely set up) logfile available to
+			LookupPublishedLogfile()
+		-	if all slots are taken, the logfile is only found with the lock 
+			held, which is slower, but works just as well
+		-	the caller is expected to hold mLocker
+\*------------------------------------------------------------------------------*/
+void BmLogHandler::PublishLogfile( BmLogfile* log) {
+	for( int32 i=0; i<mPublishedCount; ++i) {
+		if (!mPublishedLogs[i]) {
+			mPublishedLogs[i] = log;
+			return;
+		}
+	}
+	if (mPublishedCount < nMaxPublishedLogs) {
+		mPublishedLogs[mPublishedCount] = log;
+		atomic_add( &mPublishedCount, 1);
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	UnpublishLogfile( log)
+		-	removes the given logfile from the published ones
+		-	a lookup that is still scanning may have fetched the logfile 
+			before we removed it, so we wait until all current lookups are 
+			done (by then they have registered as producers of the logfile)
+		-	the caller is expected to hold mLocker
+\*------------------------------------------------------------------------------*/
+void BmLogHandler::UnpublishLogfile( BmLogfile* log) {
+	for( int32 i=0; i<mPublishedCount; ++i) {
+		if (mPublishedLogs[i] == log)
+			mPublishedLogs[i] = NULL;
+	}
+	while( atomic_get( &mLookupCount) > 0)
+		snooze( 1000);
+}
+
 /*------------------------------------------------------------------------------*\
 	WatcherInfoFor( logname)
 		-	tries to find the watcher-info of the given name in the list
@@ -250,20 +336,28 @@ BmLogHandler::WatcherInfoFor( const BmString &logname) {
 	FindLogfile( logname)
 		-	tries to find the logfile of the given name in the logfile-map
 		-	if logfile does not exist yet, it is created and added to map
+		-	the logfile is returned with its producer-count incremented, so 
+			the caller must decrement it when done with the logfile
+		-	this is called for every log-entry, so existing logfiles are
+			looked up without locking, the lock is only taken when a logfile
+			needs to be created
 \*------------------------------------------------------------------------------*/
-BmLogHandler::BmLogfile* BmLogHandler::FindLogfile( const BmString &ln) {
-	BmString logFolderName 
-		= BeamInTestMode
-			? "beam_test"					// use another log-folder in testmode
-			: "beam";
+BmLogHandler::BmLogfile* BmLogHandler::FindLogfile( const char* ln) {
+	const char* logname = (ln && *ln) ? ln : "Beam";
+	BmLogfile* log = LookupPublishedLogfile( logname);
+	if (log)
+		return log;
 	BAutolock lock( mLocker);
 	if (!lock.IsLocked())
 		throw BM_runtime_error("LogToFile(): Unable to get lock on loghandler");
-	BmString logname = ln.Length() ? ln : BmString("Beam");
-	BmString name = logFolderName + "/" + logname + ".log";
-	BmLogfile* log = LogfileFor( logname);
+	log = LogfileFor( logname);
 	if (!log) {
 		// logfile doesn't exists, so we create it:
+		BmString logFolderName 
+			= BeamInTestMode
+				? "beam_test"					// use another log-folder in testmode
+				: "beam";
+		BmString name = logFolderName + "/" + logname + ".log";
 		mLogFolder.CreateDirectory( logFolderName.String(), NULL);
 						// ensure that the logs-folder exists
 		BFile* logfile = new BFile( &mLogFolder, name.String(),
@@ -286,46 +380,36 @@ BmLogHandler::BmLogfile* BmLogHandler::FindLogfile( const BmString &ln) {
 			logfile->WriteAt( 0, buf+offs, size_t(newSize-offs));
 			delete [] buf;
 		}
-		log = new BmLogfile( logfile, name.String(), logname.String());
+		log = new BmLogfile( logfile, name.String(), logname);
 		// now add known watchers to this logfile:
 		BmWatcherInfo* info = WatcherInfoFor( logname);
 		if (info)
 			log->mWatchingHandlers = info->watchingHandlers;
 		// finally add logfile to list of active logfiles:
 		mActiveLogs.AddItem( log);
+		PublishLogfile( log);
 	}
+	atomic_add( &log->mActiveProducers, 1);
 	return log;
 }
 
-/*------------------------------------------------------------------------------*\
-	CheckLogLevel( terrain)
-		-	returns whether or not the loglevel for the given terrain is at least 
-		   minlevel
-\*------------------------------------------------------------------------------*/
-bool BmLogHandler::CheckLogLevel( uint32 terrain, int8 minlevel) const {
-	int8 loglevel = int8(BM_LOGLVL_FOR(mLoglevels, terrain));
-	return loglevel >= minlevel;
-}
-
 /*------------------------------------------------------------------------------*\
 	LogToFile( logname, msg)
 		-	dispatches msg to corrsponding logfile
 \*------------------------------------------------------------------------------*/
 void BmLogHandler::LogToFile( const BmString& logname, const BmString& msg) {
-	LogToFile( logname, msg.String());
+	LogToFile( logname.String(), msg.String());
 }
 
 /*------------------------------------------------------------------------------*\
 	LogToFile( logname, msg)
 		-	dispatches msg to corrsponding logfile
 \*------------------------------------------------------------------------------*/
-void BmLogHandler::LogToFile( const BmString& logname, const char* msg) { 
+void BmLogHandler::LogToFile( const char* logname, const char* msg) { 
 	BmLogfile* log = FindLogfile( logname);
 	if (log) {
-		BMessage mess( BM_LOG_MSG);
-		mess.AddString( MSG_MESSAGE, msg);
-		mess.AddInt32( MSG_THREAD_ID, find_thread(NULL));
-		log->PostMessage( &mess);
+		log->Add( msg, find_thread(NULL));
+		atomic_add( &log->mActiveProducers, -1);
 	}
 }
 
@@ -351,22 +435,16 @@ void BmLogHandler::CloseAllLogs() {
 void BmLogHandler::CloseLog( const BmString &logname) {
 	BAutolock lock( mLocker);
 	if (lock.IsLocked()) {
-		BmLogfile* log = LogfileFor( logname);
+		BmLogfile* log = LogfileFor( logname.String());
 		if (log) {
 			mActiveLogs.RemoveItem( log);
-			// wait until the logfile has no more entries to process...
-			BMessageQueue* msgQueue = log->MessageQueue();
-			bool done = false;
-			while( msgQueue && !done) {
-				msgQueue->Lock();
-				done = msgQueue->IsEmpty();
-				msgQueue->Unlock();
-				if (!done)
-					snooze( 100*1000);
-			}
-			// ...ok, we can quit the logfile:
-			log->Lock();
-			log->Quit();
+			UnpublishLogfile( log);
+			// wait until no thread is adding entries anymore...
+			while( atomic_add( &log->mActiveProducers, 0) > 0)
+				snooze( 1000);
+			// ...ok, we can close the logfile (which writes all pending
+			// entries):
+			delete log;
 		}
 	}
 }
@@ -374,76 +452,250 @@ void BmLogHandler::CloseLog( const BmString &logname) {
 const char* const BmLogHandler::MSG_MESSAGE = 	"bm:msg";
 const char* const BmLogHandler::MSG_THREAD_ID =	"bm:tid";
 
+/*------------------------------------------------------------------------------*\
+	the size of the ring-buffer of each logfile (must be a power of two),
+	the maximum time a thread waits for room in a full ring-buffer (before 
+	dropping its entry) and the minimum interval between two notifications
+	of the watchers of a logfile
+\*------------------------------------------------------------------------------*/
+const int32 BmLogHandler::BmLogfile::nQueueSize = 4096;
+const bigtime_t BmLogHandler::BmLogfile::nMaxBlockTime = 200*1000;
+const bigtime_t BmLogHandler::BmLogfile::nNotificationInterval = 250*1000;
+
 /*------------------------------------------------------------------------------*\
 	BmLogfile()
 		-	c'tor
-		-	starts Looper's message-loop
+		-	starts the flusher-thread
 \*------------------------------------------------------------------------------*/
 BmLogHandler::BmLogfile::BmLogfile( BFile* file, const char* fn, const char* ln)
-	:	BLooper( (BmString("log_")<<ln).String(), B_DISPLAY_PRIORITY, 500)
+	:	mWatcherLocker( "beam_logwatchers")
 	,	logname( ln)
 	,	mLogFile( file)
 	,	filename( fn)
+	,	mEntries( new BmLogEntry [nQueueSize])
+	,	mTail( 0)
+	,	mHead( 0)
+	,	mActiveProducers( 0)
+	,	mMayDrop( logname != "Errors")
+							// errors are never dropped
+	,	mDroppedCount( 0)
+	,	mBlockedCount( 0)
+	,	mReportedDropCount( 0)
+	,	mWakeupPending( 0)
+	,	mShouldRun( true)
+	,	mLastNotificationTime( 0)
+	,	mLastSecond( 0)
 {
-	Run();
+	for( int32 i=0; i<nQueueSize; ++i)
+		mEntries[i].sequence = i;
+	mWakeSem = create_sem( 0, (BmString("log_")<<ln).String());
+	mThreadId = spawn_thread( &BmLogfile::_ThreadEntry, 
+									  (BmString("log_")<<ln).String(), 
+									  B_DISPLAY_PRIORITY, this);
+	if (mWakeSem < 0 || mThreadId < 0)
+		throw BM_runtime_error( BmString("Unable to start flusher for logfile ") 
+											<< filename);
+	resume_thread( mThreadId);
 }
 
 /*------------------------------------------------------------------------------*\
 	~BmLogfile()
 		-	standard d'tor
+		-	stops the flusher-thread after it has written all pending entries
 \*------------------------------------------------------------------------------*/
 BmLogHandler::BmLogfile::~BmLogfile() {
+	mShouldRun = false;
+	release_sem( mWakeSem);
+	status_t exitVal;
+	wait_for_thread( mThreadId, &exitVal);
+	delete_sem( mWakeSem);
+	delete [] mEntries;
 	delete mLogFile;
 }
 
 /*------------------------------------------------------------------------------*\
-	MessageReceived( msg)
-		-	handles log-requests to this logfile
+	Add( msg, threadId)
+		-	puts the given msg into the ring-buffer (from where the flusher will
+			pick it up)
+		-	if the ring-buffer is full, we wait for the flusher to make room,
+			but (unless this is the error-log) only for nMaxBlockTime, after
+			which the msg is dropped
+		-	returns whether or not the msg has been added
+\*------------------------------------------------------------------------------*/
+bool BmLogHandler::BmLogfile::Add( const char* const msg, const int32 threadId) {
+	bigtime_t blockStart = 0;
+	int32 pos;
+	BmLogEntry* entry;
+	for( ;; ) {
+		pos = atomic_add( &mTail, 0);
+		entry = &mEntries[pos & (nQueueSize-1)];
+		int32 diff = int32( uint32( atomic_add( &entry->sequence, 0)) 
+								  - uint32( pos));
+		if (diff == 0) {
+			// entry is free, try to claim it:
+			if (atomic_test_and_set( &mTail, int32( uint32( pos)+1), pos) == pos)
+				break;
+		} else if (diff < 0) {
+			// ring-buffer is full:
+			if (!blockStart) {
+				blockStart = system_time();
+				atomic_add( &mBlockedCount, 1);
+				if (atomic_add( &mWakeupPending, 1) == 0)
+					release_sem( mWakeSem);
+			} else if (mMayDrop && system_time()-blockStart > nMaxBlockTime) {
+				atomic_add( &mDroppedCount, 1);
+				return false;
+			}
+			snooze( 1000);
+		}
+		// else: another thread has claimed the entry, so we try again
+	}
+	entry->threadId = threadId;
+	entry->time = real_time_clock_usecs();
+	entry->text.SetTo( msg);
+	// publish the entry to the flusher:
+	atomic_add( &entry->sequence, 1);
+	if (atomic_add( &mWakeupPending, 1) == 0)
+		release_sem( mWakeSem);
+	return true;
+}
+
+/*------------------------------------------------------------------------------*\
+	_ThreadEntry()
+		-	
+\*------------------------------------------------------------------------------*/
+int32 BmLogHandler::BmLogfile::_ThreadEntry( void* data) {
+	BmLogfile* log = static_cast< BmLogfile*>( data);
+	if (log)
+		log->_Loop();
+	return B_OK;
+}
+
+/*------------------------------------------------------------------------------*\
+	_Loop()
+		-	waits for new entries and writes them, until asked to quit
 \*------------------------------------------------------------------------------*/
-void BmLogHandler::BmLogfile::MessageReceived( BMessage* msg) {
-	switch( msg->what) {
-		case BM_LOG_MSG: {
-			Write( msg->FindString( MSG_MESSAGE), msg->FindInt32( MSG_THREAD_ID));
+void BmLogHandler::BmLogfile::_Loop() {
+	for( ;; ) {
+		bigtime_t timeout = B_INFINITE_TIMEOUT;
+		if (mPendingNotification.Length()) {
+			// wake up in time to notify the watchers:
+			timeout = std::max( (bigtime_t)0, 
+									  mLastNotificationTime + nNotificationInterval 
+										- system_time());
+		}
+		acquire_sem_etc( mWakeSem, 1, B_RELATIVE_TIMEOUT, timeout);
+		// reset the wakeup-flag *before* flushing, such that every entry 
+		// that is added after the flush will wake us again:
+		atomic_and( &mWakeupPending, 0);
+		_Flush();
+		if (!mShouldRun) {
+			_Flush();
+			_NotifyWatchers();
 			break;
 		}
-		default:
-			inherited::MessageReceived( msg);
+		if (mPendingNotification.Length()
+		&& system_time() >= mLastNotificationTime + nNotificationInterval)
+			_NotifyWatchers();
 	}
 }
 
 /*------------------------------------------------------------------------------*\
-	Write( msg)
-		-	writes given msg into log, including current timestamp
-		-	log is flushed after each write
+	_Flush()
+		-	writes all entries that are currently in the ring-buffer to disk
 \*------------------------------------------------------------------------------*/
-void BmLogHandler::BmLogfile::Write( const char* const msg, int32 threadId) {
-	BmString s(msg);
-	s.ReplaceAll( "\r", "<CR>");
-	s.ReplaceAll( "\n\n", "\n");
-	s.ReplaceAll( "\n", "\n                                  ");
-	s << "\n";
-	bigtime_t rtNow = real_time_clock_usecs();
-	time_t now = time_t(rtNow/1000000);
-	int32 nowMSecs = int32((rtNow/1000)%1000);
+void BmLogHandler::BmLogfile::_Flush() {
+	const int32 maxBatchSize = 65536;
+	BmString batch;
+	int32 dropCount = atomic_add( &mDroppedCount, 0);
+	if (dropCount != mReportedDropCount) {
+		// make the gap visible in the log:
+		BmString note = BmString("") << dropCount-mReportedDropCount 
+								<< " log-entries have been dropped, since the " 
+									"logfile could not keep up";
+		_Format( find_thread(NULL), real_time_clock_usecs(), note.String(), 
+					batch);
+		mReportedDropCount = dropCount;
+	}
+	for( ;; ) {
+		BmLogEntry* entry = &mEntries[mHead & (nQueueSize-1)];
+		bool haveEntry 
+			= int32( uint32( atomic_add( &entry->sequence, 0)) 
+						- uint32( mHead+1)) >= 0;
+		if (haveEntry) {
+			_Format( entry->threadId, entry->time, entry->text.String(), batch);
+			entry->text.Truncate( 0, false);
+			// hand the entry back to the producers:
+			atomic_add( &entry->sequence, nQueueSize-1);
+			mHead = int32( uint32( mHead)+1);
+		}
+		if (batch.Length() && (!haveEntry || batch.Length() >= maxBatchSize)) {
+			if (mLogFile->Write( batch.String(), batch.Length()) < 0) {
+				// there's nobody we could tell, so we just go on
+			}
+			BAutolock watcherLock( mWatcherLocker);
+			if (mWatchingHandlers.CountItems() > 0)
+				mPendingNotification << batch;
+			batch.Truncate( 0, true);
+		}
+		if (!haveEntry)
+			break;
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	_Format( threadId, time, msg, out)
+		-	appends the given msg to out, prefixed by thread-id and timestamp
+		-	carriage-returns are made visible, empty lines are removed and 
+			continuation lines are indented
+\*------------------------------------------------------------------------------*/
+void BmLogHandler::BmLogfile::_Format( int32 threadId, bigtime_t time, 
+													const char* msg, BmString& out) {
+	time_t second = time_t( time/1000000);
+	if (second != mLastSecond || !mLastSecondStr.Length()) {
+		mLastSecondStr = TimeToString( second, "%Y-%m-%d|%H:%M:%S");
+		mLastSecond = second;
+	}
 	char buf[40];
 	sprintf( buf, "<%6ld|%s.%03ld>: ", 
-					  threadId, 
-					  TimeToString( now, "%Y-%m-%d|%H:%M:%S").String(),
-					  nowMSecs);
-	s.Prepend( buf);
-	ssize_t result;
-	if ((result = mLogFile->Write( s.String(), s.Length())) < 0)
-		throw BM_runtime_error( BmString("Unable to write to logfile ") 
-											<< filename);
-	int32 watcherCount = mWatchingHandlers.CountItems();
-	if (watcherCount>0) {
+				threadId, mLastSecondStr.String(), int32( (time/1000)%1000));
+	out << buf;
+	const char* start = msg;
+	const char* pos;
+	for( pos = msg; *pos; ++pos) {
+		if (*pos == '\r') {
+			out.Append( start, pos-start);
+			out << "<CR>";
+			start = pos+1;
+		} else if (*pos == '\n') {
+			out.Append( start, pos-start);
+			out << "\n                                  ";
+			if (pos[1] == '\n')
+				++pos;
+			start = pos+1;
+		}
+	}
+	out.Append( start, pos-start);
+	out << "\n";
+}
+
+/*------------------------------------------------------------------------------*\
+	_NotifyWatchers()
+		-	sends all entries written since the last notification to the 
+			watchers of this logfile (in one message)
+\*------------------------------------------------------------------------------*/
+void BmLogHandler::BmLogfile::_NotifyWatchers() {
+	if (mPendingNotification.Length()) {
 		BMessage msg( BM_LOG_MSG);
-		msg.AddString( MSG_MESSAGE, s.String());
+		msg.AddString( MSG_MESSAGE, mPendingNotification.String());
+		BAutolock watcherLock( mWatcherLocker);
+		int32 watcherCount = mWatchingHandlers.CountItems();
 		for( int32 i=0; i<watcherCount; ++i) {
 			BMessenger watcher( 
 							static_cast< BHandler*>( mWatchingHandlers.ItemAt(i)));
 			watcher.SendMessage( &msg);
 		}
 	}
-//	mLogFile->Sync();
+	mPendingNotification.Truncate( 0, false);
+	mLastNotificationTime = system_time();
 }
@@ -16,6 +16,7 @@
 #include <List.h>
 #include <Locker.h>
 #include <Looper.h>
+#include <OS.h>
 #include <StopWatch.h>
 
 #include "BmBase.h"
@@ -49,8 +50,11 @@ class IMPEXPBMBASE BmLogHandler {
 
 public:
 	// static functions
-	static void Log( const BmString logname, const BmString& msg);
+	static void Log( const BmString& logname, const BmString& msg);
+	static void Log( const BmString& logname, const char* msg);
+	static void Log( const char* const logname, const BmString& msg);
 	static void Log( const char* const logname, const char* msg);
+	static bool IsLogLevelActive( uint32 terrain, int8 minlevel);
 	static void Shutdown( bool sync=true);
 	static void FinishLog( const BmString& logname);
 
@@ -60,19 +64,24 @@ public:
 	~BmLogHandler();
 
 	// native methods:
-	BmLogfile* FindLogfile( const BmString &logname);
+	BmLogfile* FindLogfile( const char* logname);
 	void CloseAllLogs();
 	void CloseLog( const BmString &logname);
 	void LogToFile( const BmString& logname, const BmString &msg);
-	void LogToFile( const BmString& logname, const char* msg);
+	void LogToFile( const char* logname, const char* msg);
 	//
-	bool CheckLogLevel( uint32 terrain, int8 minlevel) const;
+	bool CheckLogLevel( uint32 terrain, int8 minlevel) const
+													{ return IsLogLevelActive( terrain, 
+																						minlevel); }
 
 	void StartWatchingLogfile( BHandler* looper, const char* logfileName);
 	void StopWatchingLogfile( BHandler* looper, const char* logfileName);
 
 	// getters:
 	bool ShowErrorsOnScreen()				{ return mShowErrorsOnScreen; }
+	uint32 LogLevels() const				{ return nLogLevels; }
+	int32 MinFileSize() const				{ return mMinFileSize; }
+	int32 MaxFileSize() const				{ return mMaxFileSize; }
 
 	// setters:
 	void LogLevels( uint32 loglevels, int32 minFileSize, int32 maxFileSize);
@@ -86,8 +95,15 @@ public:
 	static const char* const MSG_MESSAGE;
 	static const char* const MSG_THREAD_ID;
 
+	static volatile uint32 nLogLevels;
+							// the current loglevels (0 if there is no loghandler),
+							// read without locking by the logging-macros
+
 private:
-	BmLogfile* LogfileFor( const BmString &logname);
+	BmLogfile* LogfileFor( const char* logname);
+	BmLogfile* LookupPublishedLogfile( const char* logname);
+	void PublishLogfile( BmLogfile* log);
+	void UnpublishLogfile( BmLogfile* log);
 	BmWatcherInfo* WatcherInfoFor( const BmString &logname);
 
 	// Hide copy-constructor and assignment:
@@ -97,24 +113,75 @@ private:
 	/*---------------------------------------------------------------------------*\
 		BmLogfile
 			-	implements a single logfile
-			-	the actual logging takes place in here
+			-	log-entries are put into a ring-buffer (by any number of threads,
+				without locking), from where they are picked up by a flusher-
+				thread, which writes them to disk in batches
+			-	watchers of the logfile are notified about new entries at most 
+				every nNotificationInterval microseconds
 	\*---------------------------------------------------------------------------*/
-	class IMPEXPBMBASE BmLogfile : public BLooper{
-		typedef BLooper inherited;
+	class IMPEXPBMBASE BmLogfile {
 		friend class BmLogHandler;
+
+		struct BmLogEntry {
+			volatile int32 sequence;
+							// tells whether this entry is free or filled
+			int32 threadId;
+			bigtime_t time;
+			BmString text;
+		};
+
 	public:
 		BmLogfile( BFile* file, const char* fn, const char* ln);
 		~BmLogfile();
-		void Write( const char* const msg, const int32 threadId);
-		void MessageReceived( BMessage* msg);
+		bool Add( const char* const msg, const int32 threadId);
+
+		// getters:
+		int32 DroppedCount()					{ return atomic_add( &mDroppedCount, 0); }
+		int32 BlockedCount()					{ return atomic_add( &mBlockedCount, 0); }
 
 		BList mWatchingHandlers;
+		BLocker mWatcherLocker;
 		BmString logname;
 
+		static const int32 nQueueSize;
+		static const bigtime_t nMaxBlockTime;
+		static const bigtime_t nNotificationInterval;
+
 	private:
+		static int32 _ThreadEntry( void* data);
+		void _Loop();
+		void _Flush();
+		void _Format( int32 threadId, bigtime_t time, const char* msg,
+						  BmString& out);
+		void _NotifyWatchers();
+
 		BFile* mLogFile;
 		BmString filename;
 
+		BmLogEntry* mEntries;
+		volatile int32 mTail;
+							// position where the next entry will be added
+		int32 mHead;
+							// position of the next entry to be written (only
+							// ever touched by the flusher)
+		volatile int32 mActiveProducers;
+		bool mMayDrop;
+							// whether entries may be dropped when the ring-
+							// buffer is full (otherwise producers wait)
+		volatile int32 mDroppedCount;
+		volatile int32 mBlockedCount;
+		int32 mReportedDropCount;
+
+		sem_id mWakeSem;
+		volatile int32 mWakeupPending;
+		volatile bool mShouldRun;
+		thread_id mThreadId;
+
+		BmString mPendingNotification;
+		bigtime_t mLastNotificationTime;
+		time_t mLastSecond;
+		BmString mLastSecondStr;
+
 		// Hide copy-constructor and assignment:
 		BmLogfile( const BmLogfile&);
 		BmLogfile operator=( const BmLogfile&);
@@ -125,9 +192,17 @@ private:
 
 	BList mActiveLogs;
 							// list of logfiles
+	static const int32 nMaxPublishedLogs = 32;
+	BmLogfile* volatile mPublishedLogs[nMaxPublishedLogs];
+							// the active logfiles again, for lookup without
+							// locking (only written with mLocker held)
+	volatile int32 mPublishedCount;
+							// number of used slots in mPublishedLogs
+	volatile int32 mLookupCount;
+							// number of threads currently scanning 
+							// mPublishedLogs
 	BList mWatcherInfo;
 
-	uint32 mLoglevels;
 	BDirectory mLogFolder;
 	int32 mMinFileSize;
 	int32 mMaxFileSize;
@@ -169,6 +244,25 @@ extern IMPEXPBMBASE const uint32 BM_LogAll;
 #define BM_LOGLVL_VAL(loglevel,terrain) \
 (((loglevel & 1) ? terrain : 0) + ((loglevel & 2) ? terrain<<16 : 0))
 
+/*------------------------------------------------------------------------------*\
+	IsLogLevelActive( terrain, minlevel)
+		-	returns whether or not the loglevel for the given terrain is at least
+			minlevel
+		-	this is just one (unlocked) load of the loglevels and a bit-test,
+			since minlevel is a constant in all logging-macros
+\*------------------------------------------------------------------------------*/
+inline bool BmLogHandler::IsLogLevelActive( uint32 terrain, int8 minlevel) {
+	uint32 loglevels = nLogLevels;
+	if (minlevel <= 0)
+		return true;
+	if (minlevel == 2)
+		return (loglevels & terrain<<16) != 0;
+	uint32 mask = terrain | terrain<<16;
+	return minlevel == 1 
+		? (loglevels & mask) != 0
+		: (loglevels & mask) == mask;
+}
+
 /*------------------------------------------------------------------------------*\
 	time-related utility functions
 \*------------------------------------------------------------------------------*/
@@ -187,20 +281,30 @@ IMPEXPBMBASE void ShowAlert( const BmString &text);
 \*------------------------------------------------------------------------------*/
 IMPEXPBMBASE void ShowAlertWithType( const BmString &text, alert_type type);
 
-// the macros used for logging:
+// the highest loglevel that is compiled in, log-statements above it are 
+// removed by the compiler (release-builds may set this to 1 or even 0):
+#ifndef BM_LOGLEVEL_CEILING
+#define BM_LOGLEVEL_CEILING 3
+#endif
+
+// the macros used for logging (the msg is only built if it is going to be 
+// logged):
+#define BM_LOG_ACTIVE(terrain,level) \
+	((level) <= BM_LOGLEVEL_CEILING \
+		&& BmLogHandler::IsLogLevelActive( terrain, level))
 #define BM_LOG(terrain,msg) \
 	do {	\
-		if (TheLogHandler && TheLogHandler->CheckLogLevel( terrain, 1)) \
+		if (BM_LOG_ACTIVE( terrain, 1)) \
 			BmLogHandler::Log( BM_LOGNAME, msg); \
 	} while(0)
 #define BM_LOG2(terrain,msg) \
 	do {	\
-		if (TheLogHandler && TheLogHandler->CheckLogLevel( terrain, 2)) \
+		if (BM_LOG_ACTIVE( terrain, 2)) \
 			BmLogHandler::Log( BM_LOGNAME, msg); \
 	} while(0)
 #define BM_LOG3(terrain,msg) \
 	do {	\
-		if (TheLogHandler && TheLogHandler->CheckLogLevel( terrain, 3)) \
+		if (BM_LOG_ACTIVE( terrain, 3)) \
 			BmLogHandler::Log( BM_LOGNAME, msg); \
 	} while(0)
 #define BM_LOGERR(msg) \
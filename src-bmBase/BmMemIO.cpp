@@ -122,6 +122,39 @@ uint32 BmMemFilter::Read( char* data, uint32 reqLen) {
 	return readLen;
 }
 
+/*------------------------------------------------------------------------------*\
+	TakeBufferedInput()
+		-	hands out the input that has been read but not yet been filtered
+			and empties the buffer
+\*------------------------------------------------------------------------------*/
+void BmMemFilter::TakeBufferedInput( BmString& data) {
+	data.SetTo( mBuf+mCurrPos, mCurrSize-mCurrPos);
+	mCurrPos = mCurrSize = 0;
+}
+
+/*------------------------------------------------------------------------------*\
+	PushBackInput()
+		-	puts the given data in front of the buffered input, such that it
+			is filtered before anything else is read from the input
+\*------------------------------------------------------------------------------*/
+void BmMemFilter::PushBackInput( const char* data, uint32 len) {
+	if (!len)
+		return;
+	uint32 bufferedLen = mCurrSize-mCurrPos;
+	if (bufferedLen+len > mBlockSize) {
+		// the buffer is too small, we grow it:
+		char* newBuf = new char [bufferedLen+len];
+		memcpy( newBuf+len, mBuf+mCurrPos, bufferedLen);
+		delete [] mBuf;
+		mBuf = newBuf;
+		mBlockSize = bufferedLen+len;
+	} else
+		memmove( mBuf+len, mBuf+mCurrPos, bufferedLen);
+	memcpy( mBuf, data, len);
+	mCurrPos = 0;
+	mCurrSize = bufferedLen+len;
+}
+
 /*------------------------------------------------------------------------------*\
 	AddStatusText()
 		-	
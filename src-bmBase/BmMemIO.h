@@ -46,6 +46,8 @@ public:
 	virtual void Reset( BmMemIBuf* input=NULL);
 	void AddStatusText( const BmString& text);
 	virtual void Stop();
+	void TakeBufferedInput( BmString& data);
+	void PushBackInput( const char* data, uint32 len);
 
 	// overrides of BmMemIBuf:
 	uint32 Read( char* data, uint32 reqLen);
@@ -56,6 +58,7 @@ public:
 	uint32 SrcCount() const					{ return mSrcCount; }
 	uint32 DestCount() const				{ return mDestCount; }
 	bool HaveStatusText() const			{ return mStatusText.Length() > 0; }
+	uint32 BufferedInputSize() const		{ return mCurrSize-mCurrPos; }
 	const BmString& StatusText() const	{ return mStatusText; }
 
 	static IMPEXPBMBASE const uint32 nBlockSize;
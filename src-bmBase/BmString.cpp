@@ -12,6 +12,8 @@ char* strcasestr(const char *s, const char *find);
 
 BmString BM_DEFAULT_STRING;
 
+static BmString::HeapAllocHook nHeapAllocHook = NULL;
+
 // -----------------------------------------------------------------------
 // start of OpenBeOS implemenation of BmString
 // -----------------------------------------------------------------------
@@ -207,6 +209,19 @@ BmString::BmString(const char *str, int32 maxLength)
 }
 
 
+#if __cplusplus >= 201103L
+// move constructor
+/*! \brief Creates a BmString by taking over the data of the supplied one.
+	\param string the BmString object whose data is taken, it is left empty.
+*/
+BmString::BmString(BmString &&string)
+	:_privateData(NULL)
+{
+	_Steal(string);
+}
+#endif
+
+
 // destructor
 /*! \brief Frees all resources associated with the object.
 	
@@ -214,8 +229,7 @@ BmString::BmString(const char *str, int32 maxLength)
 */
 BmString::~BmString()
 {
-	if (_privateData)
-		free(_privateData - sizeof(int32));
+	_FreePrivateData();
 }
 
 
@@ -349,6 +363,21 @@ BmString::operator=(char c)
 }
 
 
+#if __cplusplus >= 201103L
+// move operator
+/*! \brief Takes over the data of the given BmString object, leaving it empty.
+	\param string The string object whose data is taken.
+	\return
+		The function always returns \c *this .
+*/
+BmString&
+BmString::operator=(BmString &&string)
+{
+	return Adopt(string);
+}
+#endif
+
+
 // SetTo
 /*! \brief Re-initializes the object to the given string.
 	\param str Pointer to a string.
@@ -397,12 +426,10 @@ BmString::Adopt(BmString &from)
 	if (&from == this) // Avoid auto-adoption
 		return *this;
 		
-	if (_privateData)
-		free(_privateData - sizeof(int32));
+	_FreePrivateData();
 
 	/* "steal" the data from the given BmString */
-	_privateData = from._privateData;
-	from._privateData = NULL;
+	_Steal(from);
 
 	return *this;
 }
@@ -439,12 +466,10 @@ BmString::Adopt(BmString &from, int32 length)
 
 	int32 len = min_clamp0(length, from.Length());
 
-	if (_privateData)
-		free(_privateData - sizeof(int32));
+	_FreePrivateData();
 
 	/* "steal" the data from the given BmString */
-	_privateData = from._privateData;
-	from._privateData = NULL;
+	_Steal(from);
 	
 	if (len < Length())
 		_GrowBy(len - Length()); // Negative, we truncate
@@ -1869,6 +1894,8 @@ BmString::CharacterEscape(const char *setOfCharsToEscape, char escapeWith)
 	char* oldAdr = _privateData;
 	char* newData = (char*)malloc(newLength + sizeof(int32) + 1);
 	if (newData) {
+		if (nHeapAllocHook)
+			nHeapAllocHook();
 		newData += sizeof(int32);
 		char* newAdr = newData;
 		for (uint32 i = 0; i < count; ++i) {
@@ -1887,7 +1914,7 @@ BmString::CharacterEscape(const char *setOfCharsToEscape, char escapeWith)
 		if (len > 0)
 			memcpy(newAdr, oldAdr, len);
 
-		free(_privateData - sizeof(int32));
+		_FreePrivateData();
 		_privateData = newData;
 		_privateData[newLength] = 0;
 		_SetLength( newLength);
@@ -2028,29 +2055,69 @@ BmString::operator<<(double d)
 char*
 BmString::_Alloc(int32 dataLen, bool allocateEmptyString)
 {
-	char *dataPtr = _privateData ? _privateData - sizeof(int32) : NULL;
 	if (dataLen <= 0) {
 		if (!allocateEmptyString) {
 			// Release buffer if requested size is 0 and we're not told to
 			// allocate an empty string.
-			free(dataPtr);
-			_privateData = NULL;
+			_FreePrivateData();
 			return NULL;
 		} else
 			dataLen = 0;
 	}
-	int32 allocLen = dataLen + sizeof(int32) + 1;
-	dataPtr = (char *)realloc(dataPtr, allocLen);
-	if (dataPtr) {
+	char *dataPtr;
+	if (dataLen <= kShortCapacity) {
+		// short strings live inline, so we move data over from the heap
+		// (if it has been there):
+		dataPtr = _shortData + sizeof(int32);
+		if (_privateData && !_IsShort()) {
+			memcpy(dataPtr, _privateData, min_clamp0(dataLen, Length()));
+			_FreePrivateData();
+		}
+	} else {
+		int32 allocLen = dataLen + sizeof(int32) + 1;
+		if (_privateData && !_IsShort())
+			dataPtr = (char *)realloc(_privateData - sizeof(int32), allocLen);
+		else {
+			// move data over from the inline storage (if it has been used):
+			dataPtr = (char *)malloc(allocLen);
+			if (dataPtr && _privateData)
+				memcpy(dataPtr + sizeof(int32), _privateData, Length());
+		}
+		if (!dataPtr)
+			return NULL;
+		if (nHeapAllocHook)
+			nHeapAllocHook();
 		dataPtr += sizeof(int32);
-		_privateData = dataPtr;
-		int32 newLen = allocLen - sizeof(int32) - 1;
-		_SetLength(newLen);
-		_privateData[newLen] = '\0';
 	}
+	_privateData = dataPtr;
+	_SetLength(dataLen);
+	_privateData[dataLen] = '\0';
 	return dataPtr;
 }	
 
+
+void
+BmString::_FreePrivateData()
+{
+	if (_privateData && !_IsShort())
+		free(_privateData - sizeof(int32));
+	_privateData = NULL;
+}
+
+
+void
+BmString::_Steal(BmString &from)
+{
+	if (from._IsShort()) {
+		// inline data can't be stolen, but copying it is cheap:
+		memcpy(_shortData, from._shortData, 
+				 sizeof(int32) + from.Length() + 1);
+		_privateData = _shortData + sizeof(int32);
+	} else
+		_privateData = from._privateData;
+	from._privateData = NULL;
+}
+
 void
 BmString::_Init(const char *str, int32 len)
 {
@@ -2248,6 +2315,8 @@ BmString::_ReplaceAtPositions(const PosVect* positions,
 	char *oldAdr = _privateData;
 	char *newData = (char *)malloc(newLength + sizeof(int32) + 1);
 	if (newData) {
+		if (nHeapAllocHook)
+			nHeapAllocHook();
 		newData += sizeof(int32);
 		char *newAdr = newData;
 		for(uint32 i = 0; i < count; ++i) {
@@ -2267,7 +2336,7 @@ BmString::_ReplaceAtPositions(const PosVect* positions,
 		if (len > 0)
 			memcpy(newAdr, oldAdr, len);
 
-		free(_privateData - sizeof(int32));
+		_FreePrivateData();
 		_privateData = newData;
 		_privateData[newLength] = 0;
 		_SetLength( newLength);
@@ -2547,3 +2616,13 @@ BmString::Trim( bool left, bool right) {
 	}
 	return *this;
 }
+
+/*------------------------------------------------------------------------------*\
+	SetHeapAllocHook( hook)
+		-	sets the function to be called for every heap-buffer that is 
+			(re-)allocated for string-data (NULL removes it)
+\*------------------------------------------------------------------------------*/
+void
+BmString::SetHeapAllocHook( HeapAllocHook hook) {
+	nHeapAllocHook = hook;
+}
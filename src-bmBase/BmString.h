@@ -21,6 +21,9 @@ public:
 						BmString(const char *);
 						BmString(const BmString &);
 						BmString(const char *, int32 maxLength);
+#if __cplusplus >= 201103L
+						BmString(BmString &&);
+#endif
 					
 						~BmString();
 			
@@ -40,6 +43,10 @@ public:
 	BmString 			&operator=(const BmString &);
 	BmString 			&operator=(const char *);
 	BmString 			&operator=(char);
+#if __cplusplus >= 201103L
+	BmString 			&operator=(BmString &&);
+						/* leaves the source empty, avoiding a copy */
+#endif
 	
 	BmString				&SetTo(const char *);
 	BmString 			&SetTo(const char *, int32 length);
@@ -309,6 +316,9 @@ private:
 #endif
 
 	char			*_Alloc( int32 dataLen, bool allocateEmptyString = false);
+	bool			_IsShort() const;
+	void			_FreePrivateData();
+	void			_Steal(BmString &from);
 
 	struct PosVect;
 	void 			_ReplaceAtPositions( const PosVect* positions,
@@ -319,6 +329,19 @@ private:
 protected:
 	char *_privateData;
 
+private:
+	enum { kShortCapacity = 19 };
+		/* strings up to this length are stored inline (in _shortData),
+		 * longer ones live on the heap
+		 */
+	union {
+		int32 _shortAlign;
+		char _shortData[sizeof(int32) + kShortCapacity + 1];
+			/* length-field, data and terminating null, just like the 
+			 * layout of the heap-buffer
+			 */
+	};
+
 
 	// ----------------------------------------------------------
 	// Beam extensions start here!	
@@ -331,6 +354,12 @@ public:
 	BmString& DeUrlify();
 	BmString& Trim( bool left=true, bool right=true);
 
+	typedef void (*HeapAllocHook)();
+	static void SetHeapAllocHook( HeapAllocHook hook);
+		/* installs a function that is called whenever a heap-buffer is
+		 * (re-)allocated for string-data (short strings are kept inline 
+		 * and never get there). Meant for tests, by default there is none.
+		 */
 };
 
 /*----- Comutative compare operators --------------------------------------*/
@@ -348,6 +377,54 @@ int 				Compare(const BmString *, const BmString *);
 int 				ICompare(const BmString *, const BmString *);
 
 
+/*------------------------------------------------------------------------------*\
+	BmStringView
+		-	a non-owning view onto (a part of) some string data, used for
+			parsing without copying. The viewed data must outlive the view
+			and is not necessarily null-terminated.
+\*------------------------------------------------------------------------------*/
+class BmStringView {
+public:
+	BmStringView()
+		:	mData( ""), mLength( 0)				{}
+	BmStringView( const char* data, int32 length)
+		:	mData( data), mLength( length)		{}
+	BmStringView( const char* str)
+		:	mData( str), mLength( strlen( str))	{}
+	BmStringView( const BmString& str)
+		:	mData( str.String()), mLength( str.Length())
+														{}
+
+	inline const char* Data() const		{ return mData; }
+	inline int32 Length() const			{ return mLength; }
+	inline char operator[]( int32 index) const
+													{ return index < mLength 
+																? mData[index] : 0; }
+
+	inline BmStringView Substr( int32 from, int32 length=-1) const {
+		if (from > mLength)
+			from = mLength;
+		if (length < 0 || from + length > mLength)
+			length = mLength - from;
+		return BmStringView( mData + from, length);
+	}
+	int32 FindFirst( const char* str, int32 fromOffset=0) const {
+		int32 len = strlen( str);
+		for( int32 pos = fromOffset; pos + len <= mLength; ++pos) {
+			if (mData[pos] == str[0] && !memcmp( mData+pos, str, len))
+				return pos;
+		}
+		return B_ERROR;
+	}
+	inline BmString& CopyInto( BmString& into) const
+													{ return into.SetTo( mData, mLength); }
+
+private:
+	const char* mData;
+	int32 mLength;
+};
+
+
 
 
 /*-------------------------------------------------------------------------*/
@@ -370,6 +447,12 @@ BmString::String() const
 	return _privateData;
 }
 
+inline bool
+BmString::_IsShort() const
+{
+	return _privateData == _shortData + sizeof(int32);
+}
+
 inline BmString &
 BmString::SetTo(const char *str)
 {
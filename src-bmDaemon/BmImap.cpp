@@ -9,6 +9,7 @@
 #include <memory.h>
 #include <memory>
 #include <stdio.h>
+#include <stdlib.h>
 
 #ifdef BEAM_FOR_BONE
 # include <netinet/in.h>
@@ -29,6 +30,7 @@ using namespace regexx;
 #include "BmNetEndpointRoster.h"
 #include "BmImapAccount.h"
 #include "BmImap.h"
+#include "BmInboundStage.h"
 #include "BmPrefs.h"
 #include "BmRosterBase.h"
 #include "BmUtil.h"
@@ -77,8 +79,11 @@ void BmImapStatusFilter::Filter( const char* srcBuf, uint32& srcLen,
 
 	if (!mLiteralCharCount) {
 		BmString tagStr;
-		if (mInfoMsg)
+		bool singleLine = false;
+		if (mInfoMsg) {
 			tagStr = mInfoMsg->FindString(BmImap::IMSG_NEEDED_TAG);
+			singleLine = mInfoMsg->FindBool(BmImap::IMSG_SINGLE_LINE);
+		}
 
 		// setup a regex-string that can decide whether or not a given line
 		// is a status line.
@@ -111,8 +116,9 @@ void BmImapStatusFilter::Filter( const char* srcBuf, uint32& srcLen,
 					srcLen = src-srcBuf;
 					destLen = 0;
 					// we have reached the end if no tag is expected (the answer
-					// will be one line only) or if this is the tagged line:
-					if (!tagStr.Length()
+					// will be one line only), if only a single line has been
+					// asked for (IDLE) or if this is the tagged line:
+					if (!tagStr.Length() || singleLine
 					|| mLastStatusLine.ICompare(tagStr, tagStr.Length()) == 0)
 						mEndReached = true;
 					// check for a literal:
@@ -183,8 +189,11 @@ const char* const BmImap::MSG_PWD = 	"bm:pwd";
 // alternate job-specifiers:
 const int32 BmImap::BM_CHECK_CAPABILITIES_JOB = 1;
 					// to find out about supported capabilities
+const int32 BmImap::BM_IDLE_JOB = 2;
+					// to keep an IDLE-session on the inbox
 
 const char* const BmImap::IMSG_NEEDED_TAG = "neededTag";
+const char* const BmImap::IMSG_SINGLE_LINE = "singleLine";
 
 int32 BmImap::mId = 0;
 
@@ -218,6 +227,10 @@ BmImap::BmImap( const BmString& name, BmImapAccount* account)
 	,	mNewMsgCount( 0)
 	,	mNewMsgTotalSize( 1)
 	,	mServerSupportsTLS(false)
+	,	mServerSupportsQResync( false)
+	,	mQResyncEnabled( false)
+	,	mServerSupportsIdle( false)
+	,	mSyncComplete( false)
 	,	mExpungeCount( 0)
 	,	mState( 0)
 	,	mTaggedMode( false)
@@ -240,11 +253,17 @@ BmImap::~BmImap()
 		-	in addition to the inherited behaviour, the Imapper should continue
 			when it executes special jobs (not BM_DEFAULT_JOB), since in that
 			case there are no controllers present.
+		-	an IDLE-session is stopped as soon as the account no longer wants
+			one (or has been removed) and when Beam quits
 \*------------------------------------------------------------------------------*/
 bool BmImap::ShouldContinue()
 {
 	if (mConnection && mConnection->IsStopRequested())
 		return false;
+	if (CurrentJobSpecifier() == BM_IDLE_JOB
+	&& (BeamRoster->IsQuitting() || !mImapAccount->ListModel()
+		|| !mImapAccount->WantsIdleSession()))
+		StopJob();
 	return CurrentJobSpecifier() == BM_CHECK_CAPABILITIES_JOB
 			 || inherited::ShouldContinue();
 }
@@ -271,6 +290,9 @@ void BmImap::SetupAdditionalInfo( BMessage* additionalInfo)
 \*------------------------------------------------------------------------------*/
 bool BmImap::StartJob()
 {
+	if (CurrentJobSpecifier() == BM_IDLE_JOB)
+		return StartIdleJob();
+
 	for( int32 state = IMAP_CONNECT; state<IMAP_DONE; ++state)
 		ImapStates[state].skip = false;
 
@@ -332,6 +354,50 @@ bool BmImap::StartJob()
 	return true;
 }
 
+/*------------------------------------------------------------------------------*\
+	StartIdleJob()
+		-	the mainloop of an IDLE-session: connects to the server, logs in
+			and then waits for the server to announce new mails (refer 
+			StateIdle())
+		-	whenever the connection breaks, we reconnect (with growing delays
+			between the attempts)
+		-	the session ends when the account no longer wants it, after which
+			the account falls back to being checked at regular intervals
+\*------------------------------------------------------------------------------*/
+bool BmImap::StartIdleJob()
+{
+	// nobody is watching the IDLE-session:
+	NeedControllersToContinue( false);
+
+	bigtime_t reconnectDelay = 0;
+	while( ShouldContinue()) {
+		try {
+			SetTaggedMode( false);
+			for( mState=IMAP_CONNECT; ShouldContinue() && mState<=IMAP_AUTH; 
+				  ++mState) {
+				TStateMethod stateFunc = ImapStates[mState].func;
+				(this->*stateFunc)();
+			}
+			if (ShouldContinue()) {
+				reconnectDelay = 0;
+				StateIdle();
+			}
+		}
+		catch( BM_runtime_error &err) {
+			BM_LOG( BM_LogRecv, 
+					  BmString("IDLE-session has been interrupted: ") << err.what());
+		}
+		Disconnect();
+		reconnectDelay = NextReconnectDelay( reconnectDelay);
+		for( bigtime_t waited=0; 
+			  waited<reconnectDelay && ShouldContinue(); waited+=200*1000)
+			snooze( 200*1000);
+	}
+	Disconnect();
+	mImapAccount->IdleJobHasEnded( this);
+	return true;
+}
+
 /*------------------------------------------------------------------------------*\
 	UpdateIMAPStatus( delta, detailText, failed)
 		-	informs the interested party about a change in the current IMAP3-state
@@ -473,10 +539,27 @@ void BmImap::StateCapa()
 			mServerSupportsTLS = true;
 		else
 			mServerSupportsTLS = false;
+		ParseCapabilities( StatusText());
 	} catch(...) {
 	}
 }
 
+/*------------------------------------------------------------------------------*\
+	ParseCapabilities( capabilities)
+		-	determines whether or not the server supports QRESYNC (which
+			implies CONDSTORE) and IDLE
+\*------------------------------------------------------------------------------*/
+void BmImap::ParseCapabilities( const BmString& capabilities)
+{
+	Regexx rx;
+	mServerSupportsQResync 
+		= rx.exec( capabilities, "\\bQRESYNC\\b", 
+					  Regexx::newline | Regexx::nocase) > 0;
+	mServerSupportsIdle
+		= rx.exec( capabilities, "\\bIDLE\\b", 
+					  Regexx::newline | Regexx::nocase) > 0;
+}
+
 /*------------------------------------------------------------------------------*\
 	StateStartTLS()
 		-
@@ -582,9 +665,12 @@ void BmImap::StateAuth()
 										   << authMethod << "' found!?! Skipping!");
 		}
 		try {
-			if (CheckForPositiveAnswer())
+			if (CheckForPositiveAnswer()) {
 				pwdOK = true;
-			else {
+				// many servers announce their extensions only after login:
+				if (StatusText().IFindFirst( "[CAPABILITY") >= 0)
+					ParseCapabilities( StatusText());
+			} else {
 				Disconnect();
 				StopJob();
 				return;
@@ -608,152 +694,463 @@ void BmImap::StateAuth()
 	}
 }
 
+/*------------------------------------------------------------------------------*\
+	EnableQResync()
+		-	asks the server to enable QRESYNC (if it supports it), such that 
+			it will tell us about the mails that vanished since our last check
+\*------------------------------------------------------------------------------*/
+void BmImap::EnableQResync()
+{
+	mQResyncEnabled = false;
+	if (!mServerSupportsQResync 
+	|| !ThePrefs->GetBool( "ImapIncrementalSync", true))
+		return;
+	SendCommand( "ENABLE QRESYNC");
+	try {
+		if (!CheckForPositiveAnswer())
+			return;
+		Regexx rx;
+		mQResyncEnabled 
+			= rx.exec( StatusText(), "^\\*\\s+enabled\\b.*\\bqresync\\b",
+						  Regexx::newline | Regexx::nocase) > 0;
+	} catch( BM_network_error&) {
+		// the server doesn't like it, so we do without QRESYNC
+	}
+}
+
 /*------------------------------------------------------------------------------*\
 	StateCheck()
 		-	looks for new mail (only in inbox)
+		-	if the inbox still has the same uidvalidity as during the last 
+			complete check, only the changes since then are requested from
+			the server, otherwise the info about all mails is fetched
 \*------------------------------------------------------------------------------*/
 void BmImap::StateCheck()
 {
-	// select inbox and fetch number of existing messages...
+	EnableQResync();
+
+	// select inbox and fetch number of existing messages, uidvalidity 
+	// (domain of UIDs) and the values needed for an incremental check:
 	BmString cmd("SELECT inbox");
 	SendCommand( cmd);
 	if (!CheckForPositiveAnswer())
 		return;
-	Regexx rx;
-	if (!rx.exec( StatusText(), "\\*\\s+(\\d+)\\s+exists",
-					  Regexx::newline | Regexx::nocase))
+	MailboxStatus status;
+	if (!ParseMailboxStatus( StatusText(), status))
 		throw BM_network_error( BmString("answer to '") << cmd
 											<< "' has unknown format");
-	BmString msgCountStr = rx.match[0].atom[0];
-	mMsgCount = atoi(msgCountStr.String());
-	if (mMsgCount < 0)
-		mMsgCount = 0;
-	// ...and uidvalidity (domain of UIDs)
-	BmString uidValidity;
-	if (rx.exec( StatusText(), "\\buidvalidity\\s+(\\d+)",
-					 Regexx::newline | Regexx::nocase))
-		uidValidity = rx.match[0].atom[0];
+	mMsgCount = status.exists;
+	// we compose our uids as "uidvalidity:uid", such that we never
+	// confuse UIDs, should the server decide to renumber the messages:
+	BmString uidPrefix;
+	if (status.uidValidity)
+		uidPrefix << status.uidValidity;
+	uidPrefix << ":";
 
 	mNewMsgTotalSize = 0;
 	mNewMsgCount = 0;
+	mNewMsgSizes.clear();
+	mMsgUIDs.clear();
+	mMsgSeqNrs.clear();
+	mMsgFlags.clear();
 	mCleanupMsgUIDs.clear();
+	mSyncComplete = false;
+	mSyncState.uidValidity = status.uidValidity;
+	mSyncState.uidNext = status.uidNext;
+	mSyncState.msgCount = status.exists;
+	mSyncState.highestModSeq = status.highestModSeq;
+
+	if (!CheckNewMsgs( status, uidPrefix))
+		CheckAllMsgs( uidPrefix);
+
+	if (mNewMsgCount == 0)
+		UpdateMailStatus( 0, NULL, 0);
+}
+
+/*------------------------------------------------------------------------------*\
+	CheckAllMsgs( uidPrefix)
+		-	fetches uid, size and flags of every message in the inbox and
+			determines which of these are new and which should be removed
+\*------------------------------------------------------------------------------*/
+void BmImap::CheckAllMsgs( const BmString& uidPrefix)
+{
+	vector<BmString> serverUids;
 	if (mMsgCount) {
-		// fetch list with uid and size of every message:
-		// add "flags" here to the list of data to fetch.
-		cmd = BmString("FETCH 1:") << mMsgCount << " (uid rfc822.size flags)";
+		// fetch list with uid, size and flags of every message:
+		BmString cmd = BmString("FETCH 1:") << mMsgCount 
+								<< " (uid rfc822.size flags)";
 		SendCommand( cmd);
 		if (!CheckForPositiveAnswer())
 			return;
-		const BmString& status = StatusText();
-		uint32 fetchedCount = rx.exec(
-			status, "^\\*\\s+(\\d+)\\s+fetch\\s+(\\([^\\r\\n]*\\))",
-			Regexx::newline | Regexx::nocase | Regexx::global
-		);
-		if (!fetchedCount)
+		MsgInfoVect infos;
+		if (!ParseMsgInfos( StatusText(), infos) || infos.empty())
 			throw BM_network_error( BmString("answer to '") << cmd
 												<< "' has unknown format");
-		if (fetchedCount != mMsgCount) {
+		if (infos.size() != mMsgCount) {
 			BM_LOG( BM_LogRecv,
 					  BmString("Strange: server indicated ")<< mMsgCount
-							<< " mails, but FETCH received " << fetchedCount
+							<< " mails, but FETCH received " << infos.size()
 							<< " lines!");
-			if (fetchedCount > mMsgCount)
-				fetchedCount = mMsgCount;
+			if (infos.size() < mMsgCount)
+				throw BM_network_error( BmString("answer to '") << cmd
+													<< "' does not have enough UIDs");
 		}
-		// grab individual UID, flags and message size from result:
-		vector<uint32> msgSizes;
-		mMsgFlags.clear();
-		mMsgUIDs.clear();
-		BmImapNestedStringList nestedList;
-		for(uint32 i=0; i<fetchedCount; ++i) {
-			BmString nrStr = rx.match[i].atom[0];
-			uint32 nr = atoi(nrStr.String());
-			if (nr != i+1)
+		for(uint32 i=0; i<mMsgCount; ++i) {
+			if (infos[i].seqNr != i+1)
 				throw BM_network_error( BmString("answer to '") << cmd
 													<< "' has unexpected msg-nr. in line "
 													<< i+1);
-			const char* posInText = status.String() + rx.match[i].atom[1].start();
-			if (!nestedList.Parse(posInText))
-				throw BM_network_error( BmString("answer to '") << cmd
-													<< "' has unparsable string list in line "
-													<< i+1);
-			uint32 listSize = nestedList.Size();
-			if (listSize % 2 != 0)
-				throw BM_network_error( BmString("answer to '") << cmd
-													<< "' has uneven number of items "
-													<< "in string list in line "
-													<< i+1);
-			for(uint32 l = 0; l < listSize; l += 2) {
-				const BmString& key = nestedList[l].Text();
-				if (key.ICompare("UID") == 0) {
-					// compose our uid as "uidvalidity:uid", such that we never
-					// confuse UIDs, should the server decide to renumber the messages:
-					BmString uid = uidValidity + ":" + nestedList[l+1].Text();
-					mMsgUIDs.push_back(uid);
-				} else if (key.ICompare("FLAGS") == 0) {
-					unsigned flags = StringToFlags(nestedList[l+1]);
-					mMsgFlags.push_back(flags);
-				} else if (key.ICompare("RFC822.SIZE") == 0) {
-					const BmString& sizeStr = nestedList[l+1].Text();
-					msgSizes.push_back(atoi(sizeStr.String()));
-				} else
-					throw BM_network_error( BmString("answer to '") << cmd
-														<< "' contains unrequested key '" << key
-														<< "' in string list in line "
-														<< i+1);
-			}
-			if (mMsgUIDs.size() != i + 1)
-				throw BM_network_error( BmString("answer to '") << cmd
-													<< "' is missing UID in line "
-													<< i+1);
-			if (mMsgFlags.size() != i + 1)
-				throw BM_network_error( BmString("answer to '") << cmd
-													<< "' is missing FLAGS in line "
-													<< i+1);
-			if (msgSizes.size() != i + 1)
-				throw BM_network_error( BmString("answer to '") << cmd
-													<< "' is missing RFC822.SIZE in line "
-													<< i+1);
-		}
-
-		if (mMsgUIDs.size() != mMsgCount)
-			throw BM_network_error( BmString("answer to '") << cmd
-												<< "' does not have enough UIDs");
-		if (mMsgFlags.size() != mMsgCount)
-			throw BM_network_error( BmString("answer to '") << cmd
-												<< "' does not have enough FLAGS");
-		if (msgSizes.size() != mMsgCount)
-			throw BM_network_error( BmString("answer to '") << cmd
-												<< "' does not have enough RFC822.SIZEs");
-
-		// compute total size of messages that are new to us:
-		for(uint32 i=0; i<mMsgCount; i++) {
-			if (!mImapAccount->IsUIDDownloaded( mMsgUIDs[i])) {
-				// msg is new (according to unknown UID)
-				// add msg-size to total:
-				mNewMsgTotalSize += msgSizes[i];
-				mNewMsgSizes.push_back( msgSizes[i]);
-				mNewMsgCount++;
+			BmString uid = uidPrefix + (BmString() << infos[i].uid);
+			serverUids.push_back( uid);
+			if (!mImapAccount->IsUIDDownloaded( uid)) {
+				// msg is new (according to unknown UID):
+				AddNewMsg( infos[i], uidPrefix);
 			} else {
 				// msg is old (according to known UID), we may have to remove it now:
 				BmString log;
 				bool shouldBeRemoved
-					= mImapAccount->ShouldUIDBeDeletedFromServer(mMsgUIDs[i], log);
+					= mImapAccount->ShouldUIDBeDeletedFromServer( uid, log);
 				BM_LOG2( BM_LogRecv, log);
 				if (shouldBeRemoved) {
 					// store msg-UID for cleanup state
-					mCleanupMsgUIDs.push_back(mMsgUIDs[i]);
+					mCleanupMsgUIDs.push_back( uid);
 				}
 			}
 		}
 	}
 
 	// remove local UIDs that are not listed on the server anymore:
-	BmString removedUids = mImapAccount->AdjustToCurrentServerUids( mMsgUIDs);
+	BmString removedUids = mImapAccount->AdjustToCurrentServerUids( serverUids);
 	BM_LOG( BM_LogRecv, removedUids);
+}
 
-	if (mNewMsgCount == 0)
-		UpdateMailStatus( 0, NULL, 0);
+/*------------------------------------------------------------------------------*\
+	CheckNewMsgs( status, uidPrefix)
+		-	compares the given status of the inbox with the one found during 
+			the last complete check and asks the server only about the mails
+			that have been added (all with a UID >= the old uidnext) or have 
+			vanished (QRESYNC only) since then
+		-	without QRESYNC, the vanished mails can only be deduced if there
+			aren't any, i.e. if the number of mails matches
+		-	returns false if an incremental check isn't possible, such that 
+			all mails have to be checked
+\*------------------------------------------------------------------------------*/
+bool BmImap::CheckNewMsgs( const MailboxStatus& status, 
+								  const BmString& uidPrefix)
+{
+	const BmImapAccount::SyncState& oldState = mImapAccount->InboxSyncState();
+	if (!ThePrefs->GetBool( "ImapIncrementalSync", true))
+		return false;
+	SyncMode mode = ChooseSyncMode( status, oldState, mQResyncEnabled);
+	if (mode == SYNC_ALL)
+		return false;
+
+	MsgInfoVect infos;
+	UidRangeVect vanished;
+	if (mode != SYNC_UNCHANGED) {
+		// something has changed, so we ask for the mails that have been
+		// added (and, with QRESYNC, for the ones that have vanished):
+		BmString cmd("UID FETCH ");
+		if (mode == SYNC_QRESYNC)
+			cmd << "1:* (uid rfc822.size flags) (CHANGEDSINCE " 
+				 << oldState.highestModSeq << " VANISHED)";
+		else
+			cmd << oldState.uidNext << ":* (uid rfc822.size flags)";
+		SendCommand( cmd);
+		if (!CheckForPositiveAnswer())
+			return true;
+							// we have been stopped, there's nothing to do
+		if (!ParseMsgInfos( StatusText(), infos))
+			throw BM_network_error( BmString("answer to '") << cmd
+												<< "' has unknown format");
+		if (mode == SYNC_QRESYNC)
+			ParseVanished( StatusText(), vanished);
+	}
+
+	// the answer may contain old mails, too (changed flags or, for 
+	// "<uidnext>:*", the last mail if there is no newer one):
+	MsgInfoVect newInfos;
+	uint32 addedCount = 0;
+	for( uint32 i=0; i<infos.size(); ++i) {
+		if (infos[i].uid < oldState.uidNext)
+			continue;
+		addedCount++;
+		BmString uid = uidPrefix + (BmString() << infos[i].uid);
+		if (!mImapAccount->IsUIDDownloaded( uid))
+			newInfos.push_back( infos[i]);
+	}
+	if (!IncrementalCountMatches( status, oldState, addedCount, mode)) {
+		BM_LOG( BM_LogRecv,
+				  BmString("Inbox has ") << status.exists << " mails, but "
+				  		<< oldState.msgCount + addedCount 
+				  		<< " were expected from the last check,"
+				  		<< " so all mails will be checked.");
+		return false;
+	}
+
+	// find the local UIDs that have vanished and the ones that may have to 
+	// be removed from the server now:
+	vector<BmString> vanishedUids;
+	if (!vanished.empty() || mImapAccount->DeleteMailFromServer()) {
+		vector<BmString> localUids;
+		mImapAccount->GetDownloadedUids( uidPrefix, localUids);
+		for( uint32 i=0; i<localUids.size(); ++i) {
+			uint32 uid 
+				= strtoul( LocalUidToServerUid( localUids[i]).String(), NULL, 10);
+			if (ContainsUid( vanished, uid)) {
+				vanishedUids.push_back( localUids[i]);
+				continue;
+			}
+			BmString log;
+			bool shouldBeRemoved
+				= mImapAccount->ShouldUIDBeDeletedFromServer( localUids[i], log);
+			BM_LOG2( BM_LogRecv, log);
+			if (shouldBeRemoved)
+				mCleanupMsgUIDs.push_back( localUids[i]);
+		}
+	}
+	BM_LOG2( BM_LogRecv, 
+				BmString("Incremental check found ") << addedCount 
+					<< " added mails (" << newInfos.size() << " of them new) and " 
+					<< vanishedUids.size() << " vanished ones.");
+
+	for( uint32 i=0; i<newInfos.size(); ++i)
+		AddNewMsg( newInfos[i], uidPrefix);
+	BmString removedUids = mImapAccount->RemoveVanishedUids( vanishedUids);
+	BM_LOG( BM_LogRecv, removedUids);
+	return true;
+}
+
+/*------------------------------------------------------------------------------*\
+	ChooseSyncMode( status, oldState, qresyncEnabled)
+		-	decides how the inbox with the given status is checked, given the 
+			state stored during the last complete check
+		-	all mails have to be checked if the server doesn't report 
+			uidvalidity and uidnext, if the uidvalidity has changed (the UIDs
+			are meaningless then) or if nothing is known about the last check
+		-	QRESYNC is only used if it has been enabled and if both, the
+			server and the stored state, know the highestmodseq (a server 
+			without CONDSTORE doesn't report it)
+\*------------------------------------------------------------------------------*/
+BmImap::SyncMode BmImap::ChooseSyncMode( 
+	const MailboxStatus& status, const BmImapAccount::SyncState& oldState,
+	bool qresyncEnabled)
+{
+	if (!status.uidValidity || !status.uidNext
+	|| oldState.uidValidity != status.uidValidity || !oldState.uidNext)
+		return SYNC_ALL;
+	if (status.uidNext == oldState.uidNext 
+	&& status.exists == oldState.msgCount)
+		return SYNC_UNCHANGED;
+	if (qresyncEnabled && oldState.highestModSeq && status.highestModSeq)
+		return SYNC_QRESYNC;
+	return SYNC_ADDED;
+}
+
+/*------------------------------------------------------------------------------*\
+	IncrementalCountMatches( status, oldState, addedCount, mode)
+		-	returns whether or not the number of mails in the inbox can be
+			explained by the number of mails found during the last complete 
+			check and the ones added since then
+		-	without QRESYNC, we don't know about vanished mails, so the 
+			numbers must match exactly (otherwise all mails have to be 
+			checked)
+\*------------------------------------------------------------------------------*/
+bool BmImap::IncrementalCountMatches( const MailboxStatus& status, 
+												  const BmImapAccount::SyncState& oldState,
+												  uint32 addedCount, SyncMode mode)
+{
+	uint32 expectedCount = oldState.msgCount + addedCount;
+	return mode == SYNC_QRESYNC
+		? status.exists <= expectedCount
+		: status.exists == expectedCount;
+}
+
+/*------------------------------------------------------------------------------*\
+	AddNewMsg( info, uidPrefix)
+		-	registers the given message as one to be retrieved
+\*------------------------------------------------------------------------------*/
+void BmImap::AddNewMsg( const MsgInfo& info, const BmString& uidPrefix)
+{
+	mMsgUIDs.push_back( uidPrefix + (BmString() << info.uid));
+	mMsgSeqNrs.push_back( info.seqNr);
+	mMsgFlags.push_back( info.flags);
+	mNewMsgSizes.push_back( info.size);
+	mNewMsgTotalSize += info.size;
+	mNewMsgCount++;
+}
+
+/*------------------------------------------------------------------------------*\
+	ParseMailboxStatus( statusText, status)
+		-	extracts the number of mails, uidvalidity, uidnext and 
+			highestmodseq from the answer to a SELECT
+		-	returns false if the number of mails is missing
+\*------------------------------------------------------------------------------*/
+bool BmImap::ParseMailboxStatus( const BmString& statusText, 
+											MailboxStatus& status)
+{
+	Regexx rx;
+	if (!rx.exec( statusText, "^\\*\\s+(\\d+)\\s+exists",
+					  Regexx::newline | Regexx::nocase))
+		return false;
+	BmString str = rx.match[0].atom[0];
+	status.exists = strtoul( str.String(), NULL, 10);
+	status.uidValidity = status.uidNext = 0;
+	status.highestModSeq = 0;
+	if (rx.exec( statusText, "\\buidvalidity\\s+(\\d+)",
+					 Regexx::newline | Regexx::nocase)) {
+		str = rx.match[0].atom[0];
+		status.uidValidity = strtoul( str.String(), NULL, 10);
+	}
+	if (rx.exec( statusText, "\\buidnext\\s+(\\d+)",
+					 Regexx::newline | Regexx::nocase)) {
+		str = rx.match[0].atom[0];
+		status.uidNext = strtoul( str.String(), NULL, 10);
+	}
+	// (a server that indicates NOMODSEQ doesn't report a highestmodseq)
+	if (rx.exec( statusText, "\\bhighestmodseq\\s+(\\d+)",
+					 Regexx::newline | Regexx::nocase)) {
+		str = rx.match[0].atom[0];
+		status.highestModSeq = strtoull( str.String(), NULL, 10);
+	}
+	return true;
+}
+
+/*------------------------------------------------------------------------------*\
+	ParseMsgInfos( statusText, infos)
+		-	extracts uid, size and flags from every FETCH-line in the given 
+			answer, lines without uid or size (unsolicited flag-updates) are 
+			skipped
+		-	returns false if a line can't be parsed
+\*------------------------------------------------------------------------------*/
+bool BmImap::ParseMsgInfos( const BmString& statusText, MsgInfoVect& infos)
+{
+	infos.clear();
+	Regexx rx;
+	uint32 count = rx.exec(
+		statusText, "^\\*\\s+(\\d+)\\s+fetch\\s+(\\([^\\r\\n]*\\))",
+		Regexx::newline | Regexx::nocase | Regexx::global
+	);
+	BmImapNestedStringList nestedList;
+	for( uint32 i=0; i<count; ++i) {
+		MsgInfo info;
+		BmString nrStr = rx.match[i].atom[0];
+		info.seqNr = strtoul( nrStr.String(), NULL, 10);
+		info.flags = 0;
+		bool haveUid = false;
+		bool haveSize = false;
+		const char* posInText = statusText.String() + rx.match[i].atom[1].start();
+		if (!nestedList.Parse( posInText))
+			return false;
+		uint32 listSize = nestedList.Size();
+		if (listSize % 2 != 0)
+			return false;
+		for( uint32 l = 0; l < listSize; l += 2) {
+			const BmString& key = nestedList[l].Text();
+			if (key.ICompare("UID") == 0) {
+				info.uid = strtoul( nestedList[l+1].Text().String(), NULL, 10);
+				haveUid = true;
+			} else if (key.ICompare("FLAGS") == 0) {
+				info.flags = StringToFlags( nestedList[l+1]);
+			} else if (key.ICompare("RFC822.SIZE") == 0) {
+				info.size = strtoul( nestedList[l+1].Text().String(), NULL, 10);
+				haveSize = true;
+			}
+							// other items (like MODSEQ) are of no interest
+		}
+		if (haveUid && haveSize)
+			infos.push_back( info);
+	}
+	return true;
+}
+
+/*------------------------------------------------------------------------------*\
+	ParseUidSet( uidSet, ranges)
+		-	appends the ranges of the given UID-set (e.g. "3,7:9") to ranges
+		-	returns false if the set has an unknown format
+\*------------------------------------------------------------------------------*/
+bool BmImap::ParseUidSet( const BmString& uidSet, UidRangeVect& ranges)
+{
+	const char* pos = uidSet.String();
+	while( *pos) {
+		char* end;
+		UidRange range;
+		range.first = range.last = strtoul( pos, &end, 10);
+		if (end == pos)
+			return false;
+		if (*end == ':') {
+			pos = end+1;
+			range.last = strtoul( pos, &end, 10);
+			if (end == pos)
+				return false;
+			if (range.last < range.first)
+				std::swap( range.first, range.last);
+		}
+		ranges.push_back( range);
+		if (*end == ',')
+			end++;
+		else if (*end)
+			return false;
+		pos = end;
+	}
+	return true;
+}
+
+/*------------------------------------------------------------------------------*\
+	ParseVanished( statusText, ranges)
+		-	collects the UIDs from all "* VANISHED [(EARLIER)] <uid-set>" lines
+			in the given answer
+\*------------------------------------------------------------------------------*/
+void BmImap::ParseVanished( const BmString& statusText, UidRangeVect& ranges)
+{
+	Regexx rx;
+	uint32 count = rx.exec(
+		statusText, "^\\*\\s+vanished\\s+(\\(earlier\\)\\s+)?([\\d:,]+)",
+		Regexx::newline | Regexx::nocase | Regexx::global
+	);
+	for( uint32 i=0; i<count; ++i) {
+		BmString uidSet = rx.match[i].atom[1];
+		ParseUidSet( uidSet, ranges);
+							// an unparsable set is simply ignored, since the
+							// vanished mails will be dropped during the next
+							// full check anyway
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	ContainsUid( ranges, uid)
+		-	returns whether or not the given UID is part of one of the ranges
+\*------------------------------------------------------------------------------*/
+bool BmImap::ContainsUid( const UidRangeVect& ranges, uint32 uid)
+{
+	for( uint32 r=0; r<ranges.size(); ++r) {
+		if (uid >= ranges[r].first && uid <= ranges[r].last)
+			return true;
+	}
+	return false;
+}
+
+/*------------------------------------------------------------------------------*\
+	CountExpunged( statusText)
+		-	returns the number of mails reported as expunged (by "* <n> EXPUNGE"
+			or, with QRESYNC, by "* VANISHED <uid-set>") in the given answer
+\*------------------------------------------------------------------------------*/
+uint32 BmImap::CountExpunged( const BmString& statusText)
+{
+	Regexx rx;
+	uint32 count = rx.exec( statusText, "^\\*\\s+\\d+\\s+expunge\\b",
+									Regexx::newline | Regexx::nocase | Regexx::global);
+	uint32 vanishedCount = rx.exec( statusText, "^\\*\\s+vanished\\s+([\\d:,]+)",
+											  Regexx::newline | Regexx::nocase 
+											  | Regexx::global);
+	UidRangeVect ranges;
+	for( uint32 i=0; i<vanishedCount; ++i) {
+		BmString uidSet = rx.match[i].atom[0];
+		ParseUidSet( uidSet, ranges);
+	}
+	for( uint32 r=0; r<ranges.size(); ++r)
+		count += ranges[r].last - ranges[r].first + 1;
+	return count;
 }
 
 /*------------------------------------------------------------------------------*\
@@ -778,85 +1175,308 @@ void BmImap::StateCleanup() {
 /*------------------------------------------------------------------------------*\
 	StateRetrieve()
 		-	retrieves all new mails from server
+		-	the mails are fetched in batches (of up to "ImapFetchWindow" mails 
+			and "ImapFetchWindowSize" bytes) with a single UID FETCH each. 
+			Additionally, the next batch is requested before the mails of the 
+			current batch are filtered and stored, such that the server can 
+			already send while we are busy. Deletions from the server are
+			collected per batch and sent once no FETCH is outstanding.
 \*------------------------------------------------------------------------------*/
 void BmImap::StateRetrieve()
 {
 	UpdateMailStatus( -1, NULL, 0);
-	BmString cmd;
-	mCurrMailNr = 1;
-	for(uint32 i=0; mNewMsgCount>0 && i<mMsgCount; ++i) {
-		if (mImapAccount->IsUIDDownloaded( mMsgUIDs[i])) {
-			// msg is old (according to known UID), we skip it:
-			continue;
+	// StateCheck() has only collected the new msgs:
+	vector<uint32> newMsgs;
+	for(uint32 i=0; i<mMsgUIDs.size(); ++i)
+		newMsgs.push_back(i);
+	bool allStored = true;
+	vector<uint32> batch, nextBatch;
+	vector<BmString> deleteUIDs;
+	FetchedMsgVect fetchedMsgs;
+	BmString answer;
+	uint32 batchMailNr = 1;
+	// the fetched mails are filtered and stored in a separate thread, such 
+	// that we can carry on receiving meanwhile:
+	BmInboundStage inboundStage( Name());
+	bool fetchOutstanding = false;
+	try {
+		uint32 next = SendFetchBatch( newMsgs, 0, batch);
+		fetchOutstanding = !batch.empty();
+		while( !batch.empty()) {
+			fetchOutstanding = false;
+			if (!ReceiveFetchBatch( batch, batchMailNr, answer, fetchedMsgs))
+				goto CLEAN_UP;
+			// now that no command is outstanding, we can delete the mails that
+			// have been stored meanwhile...
+			TakeStoredMails( inboundStage, false, deleteUIDs, allStored);
+			if (!DeleteMailsFromServer( deleteUIDs))
+				goto CLEAN_UP;
+			deleteUIDs.clear();
+			// ...and request the next batch, which the server can send while
+			// we are busy with the current one:
+			next = SendFetchBatch( newMsgs, next, nextBatch);
+			fetchOutstanding = !nextBatch.empty();
+			for( uint32 b=0; b<batch.size(); ++b) {
+				mCurrMailNr = batchMailNr + b;
+				const FetchedMsg& msg = fetchedMsgs[b];
+				if (msg.length < 0) {
+					// the server didn't send this mail (it may have been removed
+					// in the meantime), we will try again next time:
+					BM_LOG( BM_LogRecv,
+							  BmString("Server didn't send mail with UID ")
+							  		<< mMsgUIDs[batch[b]] << ", skipping it.");
+					allStored = false;
+					continue;
+				}
+				BmString mailText( answer.String() + msg.start, msg.length);
+				if ((uint32)msg.length != mNewMsgSizes[mCurrMailNr-1]) {
+					// as this actually happens (what the heck?) we simply
+					// log it if in verbose mode:
+					BM_LOG2( BM_LogRecv,
+								BmString("Received mail has ") << msg.length
+									<< " bytes but it was announced to have "
+									<< mNewMsgSizes[mCurrMailNr-1] << " bytes."
+					);
+				}
+				if (!HandOverFetchedMail( inboundStage, batch[b], mailText))
+					goto CLEAN_UP;
+			}
+			batchMailNr += batch.size();
+			batch.swap( nextBatch);
 		}
-		// fetch current mail
-		BmString serverUID = LocalUidToServerUid(mMsgUIDs[i]);
-// TODO: May also add more stuff to FETCH, like "flags"
-		cmd = BmString("UID FETCH ") << serverUID << " rfc822";
-		SendCommand( cmd);
-		time_t before = time(NULL);
-		if (!CheckForPositiveAnswer( mNewMsgSizes[mCurrMailNr-1], false, true))
+		TakeStoredMails( inboundStage, true, deleteUIDs, allStored);
+		if (!DeleteMailsFromServer( deleteUIDs))
 			goto CLEAN_UP;
-		if (mAnswerText.Length() > ThePrefs->GetInt("LogSpeedThreshold",
-																  100*1024)) {
-			time_t after = time(NULL);
-			time_t duration = after-before > 0 ? after-before : 1;
-			// log speed for mails that exceed a certain size:
-			BM_LOG( BM_LogRecv,
-					  BmString("Received mail of size ")<<mAnswerText.Length()
-							<< " bytes in " << duration << " seconds => "
-							<< mAnswerText.Length()/duration/1024.0 << "KB/s");
+		if (mNewMsgCount)
+			UpdateMailStatus( 100.0, "done", mNewMsgCount);
+		mSyncComplete = allStored;
+	} catch(...) {
+		// a network-error unwinds past CLEAN_UP, but the stage stores the
+		// mails it has been handed in any case, so they must be marked as
+		// downloaded here, too (otherwise they'd be fetched again):
+		vector<BmString> uids;
+		bool stored = true;
+		TakeStoredMails( inboundStage, true, uids, stored);
+		mCurrMailNr = 0;
+		throw;
+	}
+CLEAN_UP:
+	if (fetchOutstanding) {
+		// consume the answer to the outstanding FETCH, such that the 
+		// following commands get their answers:
+		try {
+			CheckForPositiveAnswer();
+		} catch(...) {	}
+	}
+	{
+		// the mails that have been handed over are stored in any case, so
+		// they must be marked as downloaded (they will be deleted from the 
+		// server during one of the next checks):
+		vector<BmString> uids;
+		bool stored = true;
+		TakeStoredMails( inboundStage, true, uids, stored);
+	}
+	mCurrMailNr = 0;
+}
+
+/*------------------------------------------------------------------------------*\
+	SendFetchBatch( newMsgs, first, batch)
+		-	requests the next batch of new mails (starting at the given index
+			into newMsgs), the indices of the mails belonging to the batch
+			are returned in batch
+		-	returns the index of the first mail not contained in batch
+\*------------------------------------------------------------------------------*/
+uint32 BmImap::SendFetchBatch( const vector<uint32>& newMsgs, uint32 first,
+										 vector<uint32>& batch)
+{
+	batch.clear();
+	uint32 window 
+		= std::max( ThePrefs->GetInt( "ImapFetchWindow", 20), (int32)1);
+	uint32 windowSize = ThePrefs->GetInt( "ImapFetchWindowSize", 4*1024*1024);
+	uint32 batchSize = 0;
+	BmString uidSet;
+	uint32 rangeStart = 0, rangeEnd = 0;
+	uint32 next;
+	for( next = first; next < newMsgs.size() && batch.size() < window; ++next) {
+		uint32 size = mNewMsgSizes[next];
+		if (!batch.empty() && batchSize + size > windowSize)
+			break;
+		batch.push_back( newMsgs[next]);
+		batchSize += size;
+		// collapse consecutive UIDs into ranges:
+		uint32 uid = atoi( LocalUidToServerUid( mMsgUIDs[newMsgs[next]]).String());
+		if (batch.size() > 1 && uid == rangeEnd + 1)
+			rangeEnd = uid;
+		else {
+			if (batch.size() > 1) {
+				uidSet << (uidSet.Length() ? "," : "") << rangeStart;
+				if (rangeEnd != rangeStart)
+					uidSet << ":" << rangeEnd;
+			}
+			rangeStart = rangeEnd = uid;
 		}
-		if ((uint32)mAnswerText.Length() != mNewMsgSizes[mCurrMailNr-1]) {
-			// as this actually happens (what the heck?) we simply
-			// log it if in verbose mode:
-			BM_LOG2( BM_LogRecv,
-						BmString("Received mail has ") << mAnswerText.Length()
-							<< " bytes but it was announced to have "
-							<< mNewMsgSizes[mCurrMailNr-1] << " bytes."
-			);
+	}
+	if (batch.empty())
+		return next;
+	uidSet << (uidSet.Length() ? "," : "") << rangeStart;
+	if (rangeEnd != rangeStart)
+		uidSet << ":" << rangeEnd;
+	BmString cmd = BmString("UID FETCH ") << uidSet << " rfc822";
+	SendCommand( cmd);
+	return next;
+}
+
+/*------------------------------------------------------------------------------*\
+	ReceiveFetchBatch( batch, firstMailNr, answer, msgs)
+		-	reads the answer to the FETCH of the given batch and determines 
+			the position of each mail of the batch in the answer text 
+			(msgs[i] belongs to batch[i], its length is -1 if the server 
+			didn't send that mail)
+\*------------------------------------------------------------------------------*/
+bool BmImap::ReceiveFetchBatch( const vector<uint32>& batch, 
+										  uint32 firstMailNr, BmString& answer,
+										  FetchedMsgVect& msgs)
+{
+	uint32 expectedSize = 0;
+	for( uint32 b=0; b<batch.size(); ++b)
+		expectedSize += mNewMsgSizes[firstMailNr-1+b];
+	mCurrMailNr = firstMailNr;
+	time_t before = time(NULL);
+	if (!CheckForPositiveAnswer( expectedSize, false, true))
+		return false;
+	answer.Adopt( mAnswerText);
+	if (answer.Length() > ThePrefs->GetInt("LogSpeedThreshold", 100*1024)) {
+		time_t after = time(NULL);
+		time_t duration = after-before > 0 ? after-before : 1;
+		// log speed for batches that exceed a certain size:
+		BM_LOG( BM_LogRecv,
+				  BmString("Received ") << batch.size() << " mails of size "
+						<< answer.Length() << " bytes in " << duration 
+						<< " seconds => " << answer.Length()/duration/1024.0 
+						<< "KB/s");
+	}
+	FetchedMsgVect fetched;
+	if (!SplitFetchAnswer( StatusText(), answer.Length(), fetched))
+		throw BM_network_error( "answer to 'UID FETCH' has unknown format");
+	// assign the received messages to the mails of the batch, preferably 
+	// by UID, else by sequence number:
+	FetchedMsg missing;
+	missing.seqNr = 0;
+	missing.start = 0;
+	missing.length = -1;
+	msgs.assign( batch.size(), missing);
+	for( uint32 f=0; f<fetched.size(); ++f) {
+		for( uint32 b=0; b<batch.size(); ++b) {
+			bool matches = fetched[f].serverUID.Length()
+				? fetched[f].serverUID == LocalUidToServerUid( mMsgUIDs[batch[b]])
+				: fetched[f].seqNr == mMsgSeqNrs[batch[b]];
+			if (matches) {
+				msgs[b] = fetched[f];
+				break;
+			}
 		}
-		// now create a mail from the received data...
-		BM_LOG2( BM_LogRecv, "Creating mail...");
-		BmRef<BmMail> mail = new BmMail( mAnswerText, mImapAccount->Name());
-		if (mail->InitCheck() != B_OK)
-			goto CLEAN_UP;
-		// ...set IMAP UID - TODO: Use serverUID instead?
-		mail->ImapUID(mMsgUIDs[i]);
-		// ...set the message flags
-		uint32 flags = mMsgFlags[i];
-		if (flags & FLAG_ANSWERED)
-			mail->MarkAs("Replied");
-		else if (flags & FLAG_SEEN)
-			mail->MarkAs("Read");
-		else if (flags & FLAG_DRAFT)
-			mail->MarkAs("Draft");
-		// ...set default folder according to pop-account settings...
-		mail->SetDestFolderName( mImapAccount->HomeFolder());
-		// ...execute mail-filters for this mail...
-		BM_LOG2( BM_LogRecv, "...applying filters (in memory)...");
-		mail->ApplyInboundFilters();
-		// ...and store mail on disk:
-		BM_LOG2( BM_LogRecv, "...storing mail...");
-		if (!mail->Store())
-			goto CLEAN_UP;
-		BM_LOG2( BM_LogRecv, "...done");
-		mImapAccount->MarkUIDAsDownloaded( mMsgUIDs[i]);
-		//	delete the retrieved message if required to do so immediately:
+	}
+	return true;
+}
+
+/*------------------------------------------------------------------------------*\
+	SplitFetchAnswer( statusText, answerLength, msgs)
+		-	determines the messages contained in the answer to a FETCH of 
+			"rfc822": each literal has been announced by a status line 
+			"* <seqnr> FETCH (... {<length>}" and the literals have been 
+			collected (in that order) into the answer text
+		-	returns false if the literals do not match the answer text
+\*------------------------------------------------------------------------------*/
+bool BmImap::SplitFetchAnswer( const BmString& statusText, int32 answerLength,
+										 FetchedMsgVect& msgs)
+{
+	msgs.clear();
+	Regexx rx;
+	uint32 count = rx.exec( 
+		statusText, "^\\*\\s+(\\d+)\\s+fetch\\s+\\(([^\\n]*)\\{(\\d+)\\}\\s*$",
+		Regexx::newline | Regexx::nocase | Regexx::global
+	);
+	int32 pos = 0;
+	Regexx uidRx;
+	for( uint32 i=0; i<count; ++i) {
+		FetchedMsg msg;
+		BmString seqNrStr = rx.match[i].atom[0];
+		msg.seqNr = atoi( seqNrStr.String());
+		BmString items = rx.match[i].atom[1];
+		if (uidRx.exec( items, "\\buid\\s+(\\d+)", Regexx::nocase))
+			msg.serverUID = uidRx.match[0].atom[0];
+		BmString lengthStr = rx.match[i].atom[2];
+		msg.start = pos;
+		msg.length = atoi( lengthStr.String());
+		pos += msg.length;
+		if (pos > answerLength)
+			return false;
+		msgs.push_back( msg);
+	}
+	return pos == answerLength;
+}
+
+/*------------------------------------------------------------------------------*\
+	HandOverFetchedMail( stage, index, mailText)
+		-	creates a mail from the given text and hands it over to the given
+			stage for filtering and storing
+\*------------------------------------------------------------------------------*/
+bool BmImap::HandOverFetchedMail( BmInboundStage& stage, uint32 index,
+											 const BmString& mailText)
+{
+	// now create a mail from the received data...
+	BM_LOG2( BM_LogRecv, "Creating mail...");
+	BmRef<BmMail> mail = new BmMail( mailText, mImapAccount->Name());
+	if (mail->InitCheck() != B_OK)
+		return false;
+	// ...set IMAP UID - TODO: Use serverUID instead?
+	mail->ImapUID(mMsgUIDs[index]);
+	// ...set the message flags
+	uint32 flags = mMsgFlags[index];
+	if (flags & FLAG_ANSWERED)
+		mail->MarkAs("Replied");
+	else if (flags & FLAG_SEEN)
+		mail->MarkAs("Read");
+	else if (flags & FLAG_DRAFT)
+		mail->MarkAs("Draft");
+	// ...set default folder according to pop-account settings...
+	mail->SetDestFolderName( mImapAccount->HomeFolder());
+	// ...and hand it over for filtering and storing:
+	stage.AddMail( mail.Get(), index);
+	return true;
+}
+
+/*------------------------------------------------------------------------------*\
+	TakeStoredMails( stage, waitForAll, deleteUIDs, allStored)
+		-	marks the mails that have been stored by the given stage as 
+			downloaded and collects the UIDs of those that should be deleted
+			from the server now
+		-	allStored is cleared if any mail could not be stored (it will be
+			fetched again next time)
+\*------------------------------------------------------------------------------*/
+void BmImap::TakeStoredMails( BmInboundStage& stage, bool waitForAll,
+										vector<BmString>& deleteUIDs, bool& allStored)
+{
+	BmInboundStage::ResultVect results;
+	stage.TakeResults( results, waitForAll);
+	for( uint32 r=0; r<results.size(); ++r) {
+		const BmString& uid = mMsgUIDs[results[r].index];
+		if (!results[r].stored) {
+			BM_LOGERR( BmString("Unable to store mail with UID ") << uid
+							<< ", leaving it on the server.");
+			allStored = false;
+			continue;
+		}
+		mImapAccount->MarkUIDAsDownloaded( uid);
+		//	remember the retrieved message for deletion if required to do so 
+		// immediately:
 		BmString log;
 		bool shouldBeDeleted
-			= mImapAccount->ShouldUIDBeDeletedFromServer(mMsgUIDs[i], log);
+			= mImapAccount->ShouldUIDBeDeletedFromServer( uid, log);
 		BM_LOG2( BM_LogRecv, log);
-		if (shouldBeDeleted) {
-			if (!DeleteMailFromServer(mMsgUIDs[i]))
-				goto CLEAN_UP;
-		}
-		mCurrMailNr++;
+		if (shouldBeDeleted)
+			deleteUIDs.push_back( uid);
 	}
-	if (mNewMsgCount)
-		UpdateMailStatus( 100.0, "done", mNewMsgCount);
-CLEAN_UP:
-	mCurrMailNr = 0;
 }
 
 /*------------------------------------------------------------------------------*\
@@ -887,6 +1507,26 @@ bool BmImap::DeleteMailFromServer(const BmString& uid)
 	cmd = BmString("UID STORE ") << serverUID << " flags.silent (\\deleted)";
 	SendCommand( cmd);
 	mExpungeCount++;
+	mDeletedUIDs.push_back( uid);
+	return CheckForPositiveAnswer();
+}
+
+/*------------------------------------------------------------------------------*\
+	DeleteMailsFromServer(uids)
+		-	deletes all mails with the given UIDs with a single command
+\*------------------------------------------------------------------------------*/
+bool BmImap::DeleteMailsFromServer(const vector<BmString>& uids)
+{
+	if (uids.empty())
+		return true;
+	BmString uidSet;
+	for( uint32 i=0; i<uids.size(); ++i)
+		uidSet << (i ? "," : "") << LocalUidToServerUid(uids[i]);
+	BmString cmd;
+	cmd = BmString("UID STORE ") << uidSet << " flags.silent (\\deleted)";
+	SendCommand( cmd);
+	mExpungeCount += uids.size();
+	mDeletedUIDs.insert( mDeletedUIDs.end(), uids.begin(), uids.end());
 	return CheckForPositiveAnswer();
 }
 
@@ -901,10 +1541,312 @@ void BmImap::StateDisconnect()
 		SendCommand( cmd);
 		if (!CheckForPositiveAnswer())
 			return;
+		// the expunged mails are gone, so they are no longer part of the
+		// state we are going to store...
+		uint32 expunged = CountExpunged( StatusText());
+		mSyncState.msgCount -= std::min( expunged, mSyncState.msgCount);
+		// ...and we can drop their UIDs:
+		BmString removedUids = mImapAccount->RemoveVanishedUids( mDeletedUIDs);
+		BM_LOG2( BM_LogRecv, removedUids);
+		mDeletedUIDs.clear();
 	}
+	CommitSyncState();
 	Quit( true);
 }
 
+/*------------------------------------------------------------------------------*\
+	CommitSyncState()
+		-	stores the state of the inbox in the account, such that the next
+			check can be incremental
+		-	this only happens if all new mails have been retrieved, as the
+			next check won't look at mails older than the stored uidnext
+\*------------------------------------------------------------------------------*/
+void BmImap::CommitSyncState()
+{
+	if (!mSyncComplete || !mSyncState.uidValidity || !mSyncState.uidNext)
+		return;
+	const BmImapAccount::SyncState& oldState = mImapAccount->InboxSyncState();
+	if (oldState.uidValidity == mSyncState.uidValidity
+	&& oldState.uidNext == mSyncState.uidNext
+	&& oldState.msgCount == mSyncState.msgCount
+	&& oldState.highestModSeq == mSyncState.highestModSeq)
+		return;
+	mImapAccount->InboxSyncState( mSyncState);
+}
+
+/*------------------------------------------------------------------------------*\
+	StateIdle()
+		-	watches the inbox via IDLE until the connection breaks or the 
+			session is stopped
+		-	new mails are not fetched here, instead the account is asked to
+			start a (regular) check, such that all mails are handled the same
+			way
+		-	the IDLE-command is renewed every "ImapIdleRenewal" minutes, since
+			servers (and NAT-routers) tend to drop connections that look idle
+\*------------------------------------------------------------------------------*/
+void BmImap::StateIdle()
+{
+	if (!mServerSupportsIdle) {
+		BM_LOG( BM_LogRecv, 
+				  "Server doesn't support IDLE, falling back to checking at "
+				  "regular intervals");
+		mImapAccount->IdleNotSupported();
+		StopJob();
+		return;
+	}
+
+	// we only watch the inbox, so there is no need to select it read-write:
+	BmString cmd("EXAMINE inbox");
+	SendCommand( cmd);
+	if (!CheckForPositiveAnswer())
+		return;
+	MailboxStatus status;
+	if (!ParseMailboxStatus( StatusText(), status))
+		throw BM_network_error( BmString("answer to '") << cmd
+											<< "' has unknown format");
+	// mails that have arrived since the last complete check (or while we
+	// were disconnected) will not be announced, so we check for them now:
+	if (InboxChangedSince( status, mImapAccount->InboxSyncState()))
+		mImapAccount->TriggerAutoCheck();
+
+	IdleTracker tracker( 
+		status.exists, 
+		IdleRenewalTime( ThePrefs->GetInt( "ImapIdleRenewal", 10))
+	);
+	const bigtime_t feedbackTimeout = 200*1000;
+	// the server sends its responses whenever it likes, so we must keep 
+	// whatever has been read beyond the current line:
+	mPipelining = true;
+	while( ShouldContinue()) {
+		SendCommand( "IDLE");
+		tracker.IdleSent( system_time());
+		bool endedByServer = false;
+		while( ShouldContinue() && !tracker.NeedsRenewal( system_time())) {
+			if (tracker.ShouldTriggerCheck( system_time()))
+				mImapAccount->TriggerAutoCheck();
+			if (!HasBufferedInput() 
+			&& !mConnection->IsDataPending( feedbackTimeout))
+				continue;
+			ReceiveIdleLine();
+			if (tracker.HandleLine( StatusText(), BottomStatusText(), 
+											system_time())) {
+				// the server has terminated the IDLE-command by itself:
+				endedByServer = true;
+				break;
+			}
+		}
+		if (!ShouldContinue())
+			return;
+		if (endedByServer)
+			continue;
+		if (!tracker.IsIdling())
+			throw BM_network_error( "no answer to IDLE from server (timeout)");
+		// DONE is not a command of its own, so it must not be tagged:
+		inherited::SendCommand( "DONE");
+		if (!CheckForPositiveAnswer())
+			return;
+		tracker.HandleDoneAnswer( StatusText(), system_time());
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	ReceiveIdleLine()
+		-	fetches the next line the server has sent during IDLE
+		-	tells the status-filter to stop after that line, since the answer 
+			to IDLE ends only when we send DONE
+\*------------------------------------------------------------------------------*/
+void BmImap::ReceiveIdleLine()
+{
+	BMessage infoMsg;
+	infoMsg.AddBool( IMSG_SINGLE_LINE, true);
+	CheckForPositiveAnswer( 4096, false, false, &infoMsg);
+}
+
+/*------------------------------------------------------------------------------*\
+	HandleIdleResponse( statusText, msgCount)
+		-	looks at the untagged responses the server has sent during IDLE
+			and keeps the given number of mails in the inbox up-to-date
+		-	returns IDLE_NEW_MAIL if the number of mails has grown, IDLE_BYE
+			if the server is about to close the connection
+		-	expunged mails only change the number of mails, they are dealt 
+			with by the next regular check
+\*------------------------------------------------------------------------------*/
+BmImap::IdleEvent BmImap::HandleIdleResponse( const BmString& statusText, 
+															 uint32& msgCount)
+{
+	IdleEvent event = IDLE_NOTHING;
+	vector<BmString> lines = split( "\n", statusText);
+	Regexx rx;
+	for( uint32 i=0; i<lines.size(); ++i) {
+		if (rx.exec( lines[i], "^\\*\\s+bye\\b", Regexx::nocase))
+			return IDLE_BYE;
+		if (rx.exec( lines[i], "^\\*\\s+(\\d+)\\s+exists\\b", Regexx::nocase)) {
+			BmString str = rx.match[0].atom[0];
+			uint32 exists = strtoul( str.String(), NULL, 10);
+			if (exists > msgCount)
+				event = IDLE_NEW_MAIL;
+			msgCount = exists;
+		} else {
+			uint32 expunged = CountExpunged( lines[i]);
+			msgCount -= std::min( expunged, msgCount);
+		}
+	}
+	return event;
+}
+
+/*------------------------------------------------------------------------------*\
+	IdleRenewalTime( renewalMinutes)
+		-	returns the time after which IDLE is renewed (by sending DONE and
+			IDLE again), limited to 1-29 minutes, since servers are allowed to
+			drop an idling client after 30 minutes (RFC 2177)
+\*------------------------------------------------------------------------------*/
+bigtime_t BmImap::IdleRenewalTime( int32 renewalMinutes)
+{
+	renewalMinutes = std::min( std::max( renewalMinutes, (int32)1), (int32)29);
+	return renewalMinutes*60*1000*1000LL;
+}
+
+/*------------------------------------------------------------------------------*\
+	NextReconnectDelay( lastDelay)
+		-	returns the time to wait before the IDLE-session reconnects after
+			it has been interrupted (lastDelay is 0 if the previous connection
+			has been fine)
+		-	the delay is doubled with each failed attempt (10 secs at first,
+			10 minutes at most)
+\*------------------------------------------------------------------------------*/
+bigtime_t BmImap::NextReconnectDelay( bigtime_t lastDelay)
+{
+	const bigtime_t minReconnectDelay = 10*1000*1000LL;
+	const bigtime_t maxReconnectDelay = 10*60*1000*1000LL;
+	return lastDelay 
+		? std::min( 2*lastDelay, maxReconnectDelay) 
+		: minReconnectDelay;
+}
+
+/*------------------------------------------------------------------------------*\
+	InboxChangedSince( status, syncState)
+		-	returns whether or not the inbox (as reported by EXAMINE) may have
+			received mails since the given sync-state has been stored
+		-	such mails are not announced during IDLE, so they need a check
+\*------------------------------------------------------------------------------*/
+bool BmImap::InboxChangedSince( const MailboxStatus& status, 
+										  const BmImapAccount::SyncState& syncState)
+{
+	return status.uidValidity != syncState.uidValidity
+		|| status.uidNext != syncState.uidNext;
+}
+
+
+
+/********************************************************************************\
+	BmImap::IdleTracker
+\********************************************************************************/
+
+const bigtime_t BmImap::IdleTracker::SettleTime = 1000*1000;
+							// new mails often arrive in bursts, so we wait a 
+							// little before triggering a check
+
+/*------------------------------------------------------------------------------*\
+	IdleTracker( msgCount, renewal)
+		-	c'tor, msgCount is the number of mails in the inbox (as reported
+			by EXAMINE), renewal the time after which IDLE is to be renewed
+\*------------------------------------------------------------------------------*/
+BmImap::IdleTracker::IdleTracker( uint32 msgCount, bigtime_t renewal)
+	:	mMsgCount( msgCount)
+	,	mRenewal( renewal)
+	,	mRenewAt( 0)
+	,	mNotifyAt( 0)
+	,	mIdling( false)
+{
+}
+
+/*------------------------------------------------------------------------------*\
+	IdleSent( now)
+		-	notes that IDLE has just been sent to the server
+\*------------------------------------------------------------------------------*/
+void BmImap::IdleTracker::IdleSent( bigtime_t now)
+{
+	mIdling = false;
+	mRenewAt = now + mRenewal;
+}
+
+/*------------------------------------------------------------------------------*\
+	HandleLine( statusText, bottomStatusText, now)
+		-	evaluates a line the server has sent while we are (about to be) 
+			idling
+		-	returns true if the server has terminated the IDLE-command by 
+			itself (in which case IDLE has to be sent again)
+		-	throws if the server refuses to IDLE or ends the session
+\*------------------------------------------------------------------------------*/
+bool BmImap::IdleTracker::HandleLine( const BmString& statusText, 
+												  const BmString& bottomStatusText,
+												  bigtime_t now)
+{
+	if (bottomStatusText.Length()) {
+		if (!mIdling)
+			throw BM_network_error( 
+				BmString("Server refuses to IDLE:\n") << bottomStatusText
+			);
+		mIdling = false;
+		return true;
+	}
+	if (statusText.ByteAt(0) == '+') {
+		mIdling = true;
+		return false;
+	}
+	IdleEvent event = HandleIdleResponse( statusText, mMsgCount);
+	if (event == IDLE_BYE)
+		throw BM_network_error( BmString("Server ends the session:\n")
+											<< statusText);
+	NoteEvent( event, now);
+	return false;
+}
+
+/*------------------------------------------------------------------------------*\
+	HandleDoneAnswer( statusText, now)
+		-	evaluates the untagged lines of the answer to DONE
+\*------------------------------------------------------------------------------*/
+void BmImap::IdleTracker::HandleDoneAnswer( const BmString& statusText, 
+														  bigtime_t now)
+{
+	mIdling = false;
+	NoteEvent( HandleIdleResponse( statusText, mMsgCount), now);
+}
+
+/*------------------------------------------------------------------------------*\
+	NeedsRenewal( now)
+		-	returns whether or not IDLE has to be renewed now
+\*------------------------------------------------------------------------------*/
+bool BmImap::IdleTracker::NeedsRenewal( bigtime_t now) const
+{
+	return now >= mRenewAt;
+}
+
+/*------------------------------------------------------------------------------*\
+	ShouldTriggerCheck( now)
+		-	returns true (once) when a check should be triggered because new
+			mails have arrived (and have had some time to settle)
+\*------------------------------------------------------------------------------*/
+bool BmImap::IdleTracker::ShouldTriggerCheck( bigtime_t now)
+{
+	if (!mNotifyAt || now < mNotifyAt)
+		return false;
+	mNotifyAt = 0;
+	return true;
+}
+
+/*------------------------------------------------------------------------------*\
+	NoteEvent( event, now)
+		-	schedules a check if new mail has arrived (unless a check is 
+			already scheduled, such that a burst of mails leads to a single 
+			check)
+\*------------------------------------------------------------------------------*/
+void BmImap::IdleTracker::NoteEvent( IdleEvent event, bigtime_t now)
+{
+	if (event == IDLE_NEW_MAIL && !mNotifyAt)
+		mNotifyAt = now + SettleTime;
+}
+
 /*------------------------------------------------------------------------------*\
 	Quit( WaitForAnswer)
 		-	sends a QUIT to the server, waiting for answer only
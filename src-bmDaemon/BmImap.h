@@ -16,9 +16,10 @@
 #include "BmDaemon.h"
 
 #include "BmNetJobModel.h"
+#include "BmImapAccount.h"
 #include "BmImapNestedStringList.h"
 
-class BmImapAccount;
+class BmInboundStage;
 
 enum {
 	BM_IMAP_NEEDS_PWD	= 'bmIp'
@@ -67,6 +68,8 @@ public:
 	// alternate job-specifiers:
 	static const int32 BM_CHECK_CAPABILITIES_JOB;
 							// to find out about supported authentication types
+	static const int32 BM_IDLE_JOB;
+							// to keep an IDLE-session on the inbox
 
 	BmImap( const BmString& name, BmImapAccount* account);
 	virtual ~BmImap();
@@ -90,6 +93,118 @@ public:
 	// message components used for info-msgs (communication between
 	// protocol implementation and protocol-specific status filter):
 	static const char* const IMSG_NEEDED_TAG;
+	static const char* const IMSG_SINGLE_LINE;
+
+	// info about a single message contained in the answer to a 
+	// (batched) FETCH:
+	struct FetchedMsg {
+		uint32 seqNr;
+		BmString serverUID;
+							// empty if the server didn't send the UID before 
+							// the literal
+		int32 start;
+		int32 length;
+							// position of the message's literal in answer text
+	};
+	typedef vector<FetchedMsg> FetchedMsgVect;
+	static bool SplitFetchAnswer( const BmString& statusText, 
+											int32 answerLength, FetchedMsgVect& msgs);
+
+	// state of a mailbox as reported by SELECT:
+	struct MailboxStatus {
+		uint32 exists;
+		uint32 uidValidity;
+		uint32 uidNext;
+		uint64 highestModSeq;
+							// 0 if not reported by the server
+	};
+	static bool ParseMailboxStatus( const BmString& statusText, 
+											  MailboxStatus& status);
+
+	// how the inbox is checked (compared to the state stored during the 
+	// last complete check):
+	enum SyncMode {
+		SYNC_ALL = 0,
+							// fetch info about every mail
+		SYNC_UNCHANGED,
+							// nothing has been added or removed, fetch nothing
+		SYNC_ADDED,
+							// fetch the mails added since then ("<uidnext>:*")
+		SYNC_QRESYNC
+							// fetch added and vanished mails (CHANGEDSINCE)
+	};
+	static SyncMode ChooseSyncMode( const MailboxStatus& status, 
+											  const BmImapAccount::SyncState& oldState,
+											  bool qresyncEnabled);
+	static bool IncrementalCountMatches( const MailboxStatus& status, 
+													 const BmImapAccount::SyncState& oldState,
+													 uint32 addedCount, SyncMode mode);
+
+	// info about a single message contained in the answer to a FETCH
+	// of "uid rfc822.size flags":
+	struct MsgInfo {
+		uint32 seqNr;
+		uint32 uid;
+		uint32 size;
+		uint32 flags;
+	};
+	typedef vector<MsgInfo> MsgInfoVect;
+	static bool ParseMsgInfos( const BmString& statusText, MsgInfoVect& infos);
+
+	// a range of UIDs (as found in a VANISHED response):
+	struct UidRange {
+		uint32 first;
+		uint32 last;
+	};
+	typedef vector<UidRange> UidRangeVect;
+	static bool ParseUidSet( const BmString& uidSet, UidRangeVect& ranges);
+	static void ParseVanished( const BmString& statusText, 
+										UidRangeVect& ranges);
+	static bool ContainsUid( const UidRangeVect& ranges, uint32 uid);
+	static uint32 CountExpunged( const BmString& statusText);
+
+	// what an untagged response received during IDLE means to us:
+	enum IdleEvent {
+		IDLE_NOTHING = 0,
+		IDLE_NEW_MAIL,
+		IDLE_BYE
+	};
+	static IdleEvent HandleIdleResponse( const BmString& statusText, 
+													 uint32& msgCount);
+
+	// keeps track of an IDLE-session: decides when IDLE has to be renewed 
+	// and when a check has to be triggered (StateIdle() does the talking):
+	class IdleTracker {
+	public:
+		IdleTracker( uint32 msgCount, bigtime_t renewal);
+
+		void IdleSent( bigtime_t now);
+		bool HandleLine( const BmString& statusText, 
+							  const BmString& bottomStatusText, bigtime_t now);
+		void HandleDoneAnswer( const BmString& statusText, bigtime_t now);
+		bool NeedsRenewal( bigtime_t now) const;
+		bool ShouldTriggerCheck( bigtime_t now);
+
+		// getters:
+		inline bool IsIdling() const		{ return mIdling; }
+		inline uint32 MsgCount() const	{ return mMsgCount; }
+
+		static const bigtime_t SettleTime;
+	private:
+		void NoteEvent( IdleEvent event, bigtime_t now);
+
+		uint32 mMsgCount;
+		bigtime_t mRenewal;
+		bigtime_t mRenewAt;
+		bigtime_t mNotifyAt;
+							// 0 if no check is pending
+		bool mIdling;
+							// the server has accepted the current IDLE
+	};
+	static bigtime_t IdleRenewalTime( int32 renewalMinutes);
+	static bigtime_t NextReconnectDelay( bigtime_t lastDelay);
+	static bool InboxChangedSince( const MailboxStatus& status, 
+											 const BmImapAccount::SyncState& syncState);
 
 private:
 	// overrides of netjob-model base:
@@ -106,7 +221,28 @@ private:
 	void StateRetrieve();
 	void StateDisconnect();
 
+	void ParseCapabilities( const BmString& capabilities);
+	void EnableQResync();
+	void CheckAllMsgs( const BmString& uidPrefix);
+	bool CheckNewMsgs( const MailboxStatus& status, 
+							 const BmString& uidPrefix);
+	void AddNewMsg( const MsgInfo& info, const BmString& uidPrefix);
+	void CommitSyncState();
+
+	bool StartIdleJob();
+	void StateIdle();
+	void ReceiveIdleLine();
+
 	BmString LocalUidToServerUid(const BmString& uid) const;
+	uint32 SendFetchBatch( const vector<uint32>& newMsgs, uint32 first,
+								  vector<uint32>& batch);
+	bool ReceiveFetchBatch( const vector<uint32>& batch, uint32 firstMailNr,
+									BmString& answer, FetchedMsgVect& msgs);
+	bool HandOverFetchedMail( BmInboundStage& stage, uint32 index,
+									  const BmString& mailText);
+	void TakeStoredMails( BmInboundStage& stage, bool waitForAll,
+								 vector<BmString>& deleteUIDs, bool& allStored);
+	bool DeleteMailsFromServer( const vector<BmString>& uids);
 	bool DeleteMailFromServer(const BmString& uid);
 	void Quit( bool WaitForAnswer=false);
 	void UpdateIMAPStatus( const float, const char*, bool failed=false, 
@@ -132,6 +268,9 @@ private:
 							// Info about our pop-account
 	vector<BmString> mMsgUIDs;
 							// array of unique-IDs, one for each message
+							// (only the new ones after an incremental check)
+	vector<uint32> mMsgSeqNrs;
+							// sequence numbers, one for each message in mMsgUIDs
 	enum States {
 		IMAP_CONNECT = 0,
 		IMAP_CAPA,
@@ -162,6 +301,20 @@ private:
 							// list of auth-types the server indicates to support
 	bool mServerSupportsTLS;
 							// whether or not the server knows about STLS
+	bool mServerSupportsQResync;
+							// whether or not the server knows about QRESYNC
+	bool mQResyncEnabled;
+							// whether or not QRESYNC has been enabled
+	bool mServerSupportsIdle;
+							// whether or not the server knows about IDLE
+	BmImapAccount::SyncState mSyncState;
+							// state of the inbox as found by StateCheck, this
+							// is stored in the account once all new mails 
+							// have been retrieved
+	bool mSyncComplete;
+							// whether or not all new mails have been retrieved
+	vector<BmString> mDeletedUIDs;
+							// UIDs of msgs that have been marked as deleted
 	uint32 mExpungeCount;
 							// number of mails that need to be expunged
 	int32 mState;		
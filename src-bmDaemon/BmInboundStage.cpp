@@ -0,0 +1,208 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+
+#include <Autolock.h>
+
+#include "BmBasics.h"
+#include "BmInboundStage.h"
+#include "BmLogHandler.h"
+#include "BmMail.h"
+#include "BmPrefs.h"
+
+// standard logfile-name for this class:
+#undef BM_LOGNAME
+#define BM_LOGNAME mName
+
+/********************************************************************************\
+	BmInboundStage
+\********************************************************************************/
+
+/*------------------------------------------------------------------------------*\
+	BmInboundStage( name)
+		-	contructor, the thread is only spawned once the first mail arrives
+\*------------------------------------------------------------------------------*/
+BmInboundStage::BmInboundStage( const BmString& name)
+	:	mQueuedBytes( 0)
+	,	mPendingCount( 0)
+	,	mName( name)
+	,	mLocker( "beam_inbound_stage")
+	,	mWakeSem( -1)
+	,	mDoneSem( -1)
+	,	mThreadId( -1)
+	,	mShouldRun( true)
+{
+}
+
+/*------------------------------------------------------------------------------*\
+	~BmInboundStage()
+		-	destructor, waits until all mails that have been handed over are
+			stored
+\*------------------------------------------------------------------------------*/
+BmInboundStage::~BmInboundStage()
+{
+	if (mThreadId >= 0) {
+		mShouldRun = false;
+		release_sem( mWakeSem);
+		status_t exitVal;
+		wait_for_thread( mThreadId, &exitVal);
+	}
+	if (mWakeSem >= 0)
+		delete_sem( mWakeSem);
+	if (mDoneSem >= 0)
+		delete_sem( mDoneSem);
+}
+
+/*------------------------------------------------------------------------------*\
+	AddMail( mail, index)
+		-	hands over the given mail for filtering and storing
+		-	in order to limit the memory used, this waits if too many mails
+			(or too many bytes) are already waiting to be filtered. A mail
+			that exceeds the byte-limit on its own is accepted once the queue
+			is empty
+		-	if no thread can be spawned, the mail is dealt with right away
+\*------------------------------------------------------------------------------*/
+void BmInboundStage::AddMail( BmMail* mail, uint32 index)
+{
+	if (mThreadId < 0) {
+		mWakeSem = create_sem( 0, "beam_inbound_wake");
+		mDoneSem = create_sem( 0, "beam_inbound_done");
+		if (mWakeSem >= 0 && mDoneSem >= 0) {
+			BmString tname( BmString("inbound_") << mName);
+			tname.Truncate( B_OS_NAME_LENGTH);
+			mThreadId = spawn_thread( &BmInboundStage::ThreadEntry, 
+											  tname.String(), B_NORMAL_PRIORITY, this);
+		}
+		if (mThreadId < 0) {
+			BM_LOGERR( BmString("Unable to spawn thread for inbound filtering,")
+							<< " mail is filtered by receiving job.");
+			Result result;
+			result.index = index;
+			result.stored = FilterAndStore( mail);
+			BAutolock lock( mLocker);
+			mResults.push_back( result);
+			return;
+		}
+		resume_thread( mThreadId);
+	}
+	uint32 maxWaiting 
+		= std::max( ThePrefs->GetInt( "MaxMailsWaitingForFilters", 100), 
+						(int32)1);
+	int64 maxBytesWaiting 
+		= std::max( ThePrefs->GetInt( "MaxBytesWaitingForFilters", 
+												16*1024*1024), 
+						(int32)1);
+	int32 size = mail->RawTextLength();
+	while( true) {
+		{
+			BAutolock lock( mLocker);
+			if (mQueue.empty() 
+			|| (mQueue.size() < maxWaiting 
+				&& mQueuedBytes + size <= maxBytesWaiting)) {
+				Entry entry;
+				entry.mail = mail;
+				entry.index = index;
+				entry.size = size;
+				mQueue.push_back( entry);
+				mQueuedBytes += size;
+				mPendingCount++;
+				break;
+			}
+		}
+		acquire_sem_etc( mDoneSem, 1, B_RELATIVE_TIMEOUT, 200*1000);
+	}
+	release_sem( mWakeSem);
+}
+
+/*------------------------------------------------------------------------------*\
+	TakeResults( results, waitForAll)
+		-	hands out the results of all mails that have been dealt with since
+			the last call
+		-	if waitForAll is set, this waits until all mails that have been
+			handed over are done
+\*------------------------------------------------------------------------------*/
+void BmInboundStage::TakeResults( ResultVect& results, bool waitForAll)
+{
+	results.clear();
+	while( true) {
+		{
+			BAutolock lock( mLocker);
+			if (!waitForAll || !mPendingCount) {
+				results.swap( mResults);
+				return;
+			}
+		}
+		acquire_sem_etc( mDoneSem, 1, B_RELATIVE_TIMEOUT, 200*1000);
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	ThreadEntry( data)
+		-	
+\*------------------------------------------------------------------------------*/
+int32 BmInboundStage::ThreadEntry( void* data)
+{
+	BmInboundStage* stage = static_cast< BmInboundStage*>( data);
+	if (stage)
+		stage->WorkLoop();
+	return B_OK;
+}
+
+/*------------------------------------------------------------------------------*\
+	WorkLoop()
+		-	filters and stores one mail after the other, until asked to quit
+			(mails still waiting are always dealt with before quitting)
+\*------------------------------------------------------------------------------*/
+void BmInboundStage::WorkLoop()
+{
+	while( true) {
+		acquire_sem( mWakeSem);
+		Entry entry;
+		{
+			BAutolock lock( mLocker);
+			if (mQueue.empty()) {
+				if (!mShouldRun)
+					break;
+				continue;
+			}
+			entry = mQueue.front();
+			mQueue.pop_front();
+			mQueuedBytes -= entry.size;
+		}
+		Result result;
+		result.index = entry.index;
+		result.stored = FilterAndStore( entry.mail.Get());
+		entry.mail = NULL;
+		{
+			BAutolock lock( mLocker);
+			mResults.push_back( result);
+			mPendingCount--;
+		}
+		release_sem( mDoneSem);
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	FilterAndStore( mail)
+		-	executes the inbound mail-filters for the given mail and stores it
+		-	returns whether or not the mail has been stored
+\*------------------------------------------------------------------------------*/
+bool BmInboundStage::FilterAndStore( BmMail* mail)
+{
+	try {
+		BM_LOG2( BM_LogRecv, "...applying filters (in memory)...");
+		mail->ApplyInboundFilters();
+		BM_LOG2( BM_LogRecv, "...storing mail...");
+		if (!mail->Store())
+			return false;
+		BM_LOG2( BM_LogRecv, "...done");
+		return true;
+	} catch( BM_error& err) {
+		BM_LOGERR( BmString("Unable to filter and store mail: ") << err.what());
+		return false;
+	}
+}
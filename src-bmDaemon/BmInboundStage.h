@@ -0,0 +1,89 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+
+#ifndef _BmInboundStage_h
+#define _BmInboundStage_h
+
+#include <deque>
+#include <vector>
+
+#include <Locker.h>
+#include <OS.h>
+
+#include "BmDaemon.h"
+
+#include "BmRefManager.h"
+#include "BmString.h"
+
+using std::deque;
+using std::vector;
+
+class BmMail;
+
+/*------------------------------------------------------------------------------*\
+	class BmInboundStage
+		-	applies the inbound filters to fetched mails and stores them in a 
+			thread of its own, such that a receiving job can carry on talking
+			to the server while the mails are being filtered
+		-	the job hands over each mail (together with an index of its own
+			choosing) and collects the results whenever it suits it
+\*------------------------------------------------------------------------------*/
+class IMPEXPBMDAEMON BmInboundStage {
+
+public:
+	// the outcome for a single mail:
+	struct Result {
+		uint32 index;
+		bool stored;
+	};
+	typedef vector<Result> ResultVect;
+
+	BmInboundStage( const BmString& name);
+	~BmInboundStage();
+
+	// native methods:
+	void AddMail( BmMail* mail, uint32 index);
+	void TakeResults( ResultVect& results, bool waitForAll);
+
+	// getters:
+	inline const BmString& Name() const	{ return mName; }
+
+private:
+	static int32 ThreadEntry( void* data);
+	void WorkLoop();
+	bool FilterAndStore( BmMail* mail);
+
+	struct Entry {
+		BmRef<BmMail> mail;
+		uint32 index;
+		int32 size;
+	};
+	deque<Entry> mQueue;
+							// mails waiting to be filtered
+	int64 mQueuedBytes;
+							// total size of the mails waiting to be filtered
+	ResultVect mResults;
+							// results not yet taken by the job
+	uint32 mPendingCount;
+							// number of mails that have been handed over
+							// but haven't been stored yet
+	BmString mName;
+	BLocker mLocker;
+	sem_id mWakeSem;
+							// released once per mail (and once for quitting)
+	sem_id mDoneSem;
+							// released whenever a mail has been handled
+	thread_id mThreadId;
+	bool mShouldRun;
+
+	// Hide copy-constructor and assignment:
+	BmInboundStage( const BmInboundStage&);
+	BmInboundStage operator=( const BmInboundStage&);
+};
+
+#endif
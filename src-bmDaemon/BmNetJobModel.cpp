@@ -84,6 +84,7 @@ BmNetJobModel::BmNetJobModel( const BmString& name, uint32 logType,
 	,	mConnected( false)
 	,	mStatusFilter( statusFilter)
 	,	mLogType( logType)
+	,	mPipelining( false)
 {
 	mReader = new BmNetIBuf( this);
 	uint32 logLevel = ThePrefs->GetNumericLogLevelFor(mLogType);
@@ -147,6 +148,7 @@ void BmNetJobModel::Disconnect()
 		mConnection = NULL;
 	}
 	mConnected = false;
+	mPipelining = false;
 }
 
 /*------------------------------------------------------------------------------*\
@@ -195,6 +197,19 @@ bool BmNetJobModel::CheckForPositiveAnswer( uint32 expectedSize,
 	return mStatusFilter->CheckForPositiveAnswer() && ShouldContinue();
 }
 
+/*------------------------------------------------------------------------------*\
+	ResetKeepingInput()
+		-	resets the given filter, but keeps the input it has already read
+			and not yet filtered
+\*------------------------------------------------------------------------------*/
+static void ResetKeepingInput( BmMemFilter* filter, BmMemIBuf* input=NULL)
+{
+	BmString bufferedInput;
+	filter->TakeBufferedInput( bufferedInput);
+	filter->Reset( input);
+	filter->PushBackInput( bufferedInput.String(), bufferedInput.Length());
+}
+
 /*------------------------------------------------------------------------------*\
 	GetAnswer()
 		-	
@@ -202,8 +217,15 @@ bool BmNetJobModel::CheckForPositiveAnswer( uint32 expectedSize,
 void BmNetJobModel::GetAnswer( uint32 expectedSize, bool dotstuffDecoding,
 										 bool update, BMessage* infoMsg) 
 {
-	mIncomingLogger->Reset();
-	mStatusFilter->Reset( mIncomingLogger);
+	if (mPipelining) {
+		// the filters may already have read (part of) the answer to the next
+		// pipelined command, we must not drop that data:
+		ResetKeepingInput( mIncomingLogger);
+		ResetKeepingInput( mStatusFilter, mIncomingLogger);
+	} else {
+		mIncomingLogger->Reset();
+		mStatusFilter->Reset( mIncomingLogger);
+	}
 	mStatusFilter->DoUpdate( update);
 	if (!infoMsg) {
 		mInfoMsg.MakeEmpty();
@@ -223,11 +245,29 @@ void BmNetJobModel::GetAnswer( uint32 expectedSize, bool dotstuffDecoding,
 		}
 		BmDotstuffDecoder decoder( mStatusFilter, this, blockSize);
 		answerBuf.Write( &decoder, blockSize);
+		if (mPipelining) {
+			// hand back whatever the decoder has read beyond the end of
+			// this answer:
+			BmString readAhead;
+			decoder.TakeBufferedInput( readAhead);
+			mStatusFilter->PushBackInput( readAhead.String(), readAhead.Length());
+		}
 	} else
 		answerBuf.Write( mStatusFilter, blockSize);
 	mAnswerText.Adopt( answerBuf.TheString());
 }
 
+/*------------------------------------------------------------------------------*\
+	HasBufferedInput()
+		-	returns whether or not the filters hold data that has already been
+			received but not yet been looked at (only possible when pipelining)
+\*------------------------------------------------------------------------------*/
+bool BmNetJobModel::HasBufferedInput() const
+{
+	return mIncomingLogger->BufferedInputSize() > 0
+			 || mStatusFilter->BufferedInputSize() > 0;
+}
+
 /*------------------------------------------------------------------------------*\
 	SendCommand( cmd)
 		-	sends the specified command to the server.
@@ -647,6 +687,8 @@ void BmDotstuffEncoder::Finalize( char* destBuf, uint32& destLen)
 \*------------------------------------------------------------------------------*/
 BmNetIBuf::BmNetIBuf( BmNetJobModel* job)
 	:	mJob( job)
+	,	mFeedbackTimeout( "FeedbackTimeout", 200)
+	,	mReceiveTimeout( "ReceiveTimeout", 60)
 {
 }
 
@@ -656,8 +698,8 @@ BmNetIBuf::BmNetIBuf( BmNetJobModel* job)
 \*------------------------------------------------------------------------------*/
 uint32 BmNetIBuf::Read( char* dest, uint32 destLen)
 {
-	int32 feedbackTimeout = ThePrefs->GetInt("FeedbackTimeout", 200)*1000;
-	int32 timeout = ThePrefs->GetInt("ReceiveTimeout")*1000*1000;
+	int32 feedbackTimeout = mFeedbackTimeout.Value()*1000;
+	int32 timeout = mReceiveTimeout.Value()*1000*1000;
 	int32 timeWaiting = 0;
 	int32 numBytes = 0;
 	Connection()->SetTimeout( feedbackTimeout);
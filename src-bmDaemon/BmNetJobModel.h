@@ -14,6 +14,7 @@
 #include "BmDataModel.h"
 #include "BmMemIO.h"
 #include "BmNetEndpoint.h"
+#include "BmPrefs.h"
 #include "BmUtil.h"
 
 /*------------------------------------------------------------------------------*\
@@ -110,6 +111,7 @@ protected:
 									bool dotstuffDecoding=false,
 									bool update=false,
 									BMessage* infoMsg=NULL);
+	bool HasBufferedInput() const;
 	virtual void SendCommand( const BmString& cmd, 
 									  const BmString& secret=BM_DEFAULT_STRING,
 									  bool dotstuffEncoding=false,
@@ -147,6 +149,9 @@ protected:
 							// input stream logger
 	BmNetOBuf* mWriter;
 							// output stream
+	bool mPipelining;
+							// indicates that several commands may be in flight,
+							// so data following an answer belongs to the next one
 
 	// Hide copy-constructor and assignment:
 	BmNetJobModel( const BmNetJobModel&);
@@ -246,6 +251,8 @@ public:
 
 protected:
 	BmNetJobModel* mJob;
+	BmCachedIntPref mFeedbackTimeout;
+	BmCachedIntPref mReceiveTimeout;
 	
 };
 
@@ -23,6 +23,7 @@ using namespace regexx;
 
 #include "BmBasics.h"
 #include "BmFilter.h"
+#include "BmInboundStage.h"
 #include "BmLogHandler.h"
 #include "BmMail.h"
 #include "BmNetEndpointRoster.h"
@@ -160,6 +161,7 @@ BmPopper::BmPopper( const BmString& name, BmPopAccount* account)
 	,	mNewMsgCount( 0)
 	,	mNewMsgTotalSize( 1)
 	,	mServerSupportsTLS(false)
+	,	mServerSupportsPipelining(false)
 	,	mState( 0)
 {
 }
@@ -416,6 +418,10 @@ void BmPopper::StateCapa() {
 			mServerSupportsTLS = true;
 		else
 			mServerSupportsTLS = false;
+		if (rx.exec( mAnswerText, "^\\s*PIPELINING\\b", Regexx::newline))
+			mServerSupportsPipelining = true;
+		else
+			mServerSupportsPipelining = false;
 	} catch(...) {
 	}
 }
@@ -566,8 +572,16 @@ void BmPopper::StateAuth() {
 void BmPopper::StateCheck() {
 	uint32 msgNum = 0;
 
+	// now that we are authorized, we start pipelining (if the server allows 
+	// it), STAT, UIDL and LIST are then sent in one go:
+	mPipelining = mServerSupportsPipelining 
+						&& ThePrefs->GetInt( "PopPipelineWindow", 8) > 1;
+	if (mPipelining)
+		SendCommand( "STAT\r\nUIDL\r\nLIST");
+
 	BmString cmd("STAT");
-	SendCommand( cmd);
+	if (!mPipelining)
+		SendCommand( cmd);
 	if (!CheckForPositiveAnswer())
 		return;
 	Regexx rx;
@@ -580,12 +594,18 @@ void BmPopper::StateCheck() {
 		// we remove all local UIDs, since none are listed on the server:
 		BmString removedUids = mPopAccount->AdjustToCurrentServerUids( mMsgUIDs);
 		BM_LOG2( BM_LogRecv, removedUids);
+		if (mPipelining) {
+			// skip the (empty) answers to UIDL and LIST:
+			GetAnswer( 4096, true);
+			GetAnswer( 4096, true);
+		}
 		return;									// no messages found, nothing more to do
 	}
 
 	// we try to fetch a list of unique message IDs from server:
 	cmd = BmString("UIDL");
-	SendCommand( cmd);
+	if (!mPipelining)
+		SendCommand( cmd);
 	try {
 		// The UIDL-command may not be implemented by this server, so we
 		// do not require a positive answer, we just hope for it:
@@ -612,7 +632,8 @@ void BmPopper::StateCheck() {
 	mNewMsgCount = 0;
 	mCleanupMsgs.clear();
 	cmd = "LIST";
-	SendCommand( cmd);
+	if (!mPipelining)
+		SendCommand( cmd);
 	if (!CheckForPositiveAnswer( 16384, true))
 		return;
 	vector<BmString> listAnswerVect;
@@ -670,22 +691,58 @@ void BmPopper::StateCheck() {
 		-	deletes all old mails from server
 \*------------------------------------------------------------------------------*/
 void BmPopper::StateCleanup() {
-	BmString cmd;
 	uint32 count = mCleanupMsgs.size();
 	if (count == 0)
 		return;
-	for(uint32 i = 0; i < count; ++i) {
-		cmd = BmString("DELE ") << mCleanupMsgs[i];
-		SendCommand( cmd);
-		if (!CheckForPositiveAnswer())
-			return;
-		float delta = 100.0f / float(count != 0 ? count : 1);
-		UpdateCleanupStatus( delta, i + 1);
-	}
+	if (!DeleteMsgs( mCleanupMsgs, true))
+		return;
 	mCleanupMsgs.clear();
 	UpdateCleanupStatus( 100.0, count);
 }
 
+/*------------------------------------------------------------------------------*\
+	DeleteMsgs( msgNums, updateStatus)
+		-	deletes the messages with the given numbers from the server
+		-	when pipelining, a window of DELE-commands is kept in flight and
+			a DELE refused by the server does not stop the others
+\*------------------------------------------------------------------------------*/
+bool BmPopper::DeleteMsgs( const vector<int32>& msgNums, bool updateStatus) {
+	uint32 count = msgNums.size();
+	uint32 window = PipelineWindow();
+	uint32 sentCount = 0;
+	float delta = 100.0f / float(count != 0 ? count : 1);
+	for( uint32 i=0; i<count; ++i) {
+		BmString cmd;
+		for( ; sentCount<count && sentCount<i+window; ++sentCount) {
+			if (cmd.Length())
+				cmd << "\r\n";
+			cmd << "DELE " << msgNums[sentCount];
+		}
+		if (cmd.Length())
+			SendCommand( cmd);
+		GetAnswer();
+		if (mPipelining && StatusText().ByteAt(0) == '-')
+			BM_LOG( BM_LogRecv, 
+					  BmString("Server refused to delete msg ") << msgNums[i]
+					  	<< ": " << StatusText());
+		else if (!mStatusFilter->CheckForPositiveAnswer() || !ShouldContinue())
+			return false;
+		if (updateStatus)
+			UpdateCleanupStatus( delta, i + 1);
+	}
+	return true;
+}
+
+/*------------------------------------------------------------------------------*\
+	PipelineWindow()
+		-	returns the number of commands we may have in flight
+\*------------------------------------------------------------------------------*/
+uint32 BmPopper::PipelineWindow() const {
+	if (!mPipelining)
+		return 1;
+	return std::max( (int32)1, ThePrefs->GetInt( "PopPipelineWindow", 8));
+}
+
 /*------------------------------------------------------------------------------*\
 	StateRetrieve()
 		-	retrieves all new mails from server
@@ -693,69 +750,130 @@ void BmPopper::StateCleanup() {
 void BmPopper::StateRetrieve() {
 	UpdateMailStatus( -1, NULL, 0);
 	BmString cmd;
-	mCurrMailNr = 1;
+	vector<int32> newMsgs;
 	for( int32 i=0; mNewMsgCount>0 && i<mMsgCount; ++i) {
-		if (mPopAccount->IsUIDDownloaded( mMsgUIDs[i])) {
-			// msg is old (according to known UID), we skip it:
-			continue;
+		if (!mPopAccount->IsUIDDownloaded( mMsgUIDs[i]))
+			newMsgs.push_back( i);
+	}
+	// when pipelining, we keep a window of RETR-commands in flight, such that
+	// the server can send the mails back to back (DELE-commands are always
+	// sent after all mails have been received and stored):
+	uint32 window = PipelineWindow();
+	uint32 sentCount = 0;
+	vector<int32> deleteMsgs;
+	// the received mails are filtered and stored in a separate thread, such
+	// that we can carry on receiving meanwhile:
+	BmInboundStage inboundStage( Name());
+	try {
+		for( mCurrMailNr=1; mCurrMailNr<=(int32)newMsgs.size(); ++mCurrMailNr) {
+			cmd.Truncate( 0);
+			for( ; sentCount<newMsgs.size() && sentCount<mCurrMailNr-1+window; 
+					++sentCount) {
+				if (cmd.Length())
+					cmd << "\r\n";
+				cmd << "RETR " << newMsgs[sentCount]+1;
+			}
+			if (cmd.Length())
+				SendCommand( cmd);
+			int32 i = newMsgs[mCurrMailNr-1];
+			time_t before = time(NULL);
+			GetAnswer( mNewMsgSizes[mCurrMailNr-1], true, true);
+			if (mPipelining && StatusText().ByteAt(0) == '-') {
+				// the server refuses to hand out this mail, we leave it there
+				// and carry on with the others:
+				BM_LOG( BM_LogRecv, 
+						  BmString("Server refused to send msg ") << i+1 << ": "
+						  	<< StatusText());
+				continue;
+			}
+			if (!mStatusFilter->CheckForPositiveAnswer() || !ShouldContinue())
+				goto CLEAN_UP;
+			if (mAnswerText.Length() > ThePrefs->GetInt("LogSpeedThreshold",
+																	  100*1024)) {
+				time_t after = time(NULL);
+				time_t duration = after-before > 0 ? after-before : 1;
+				// log speed for mails that exceed a certain size:
+				BM_LOG( BM_LogRecv,
+						  BmString("Received mail of size ")<<mAnswerText.Length()
+								<< " bytes in " << duration << " seconds => "
+								<< mAnswerText.Length()/duration/1024.0 << "KB/s");
+			}
+			if (mAnswerText.Length() != mNewMsgSizes[mCurrMailNr-1]) {
+				// as this actually happens (what the heck?) we simply
+				// log it if in verbose mode:
+				BM_LOG2( BM_LogRecv,
+							BmString("Received mail has ") << mAnswerText.Length()
+								<< " bytes but it was announced to have "
+								<< mNewMsgSizes[mCurrMailNr-1] << " bytes."
+				);
+			}
+			// now create a mail from the received data...
+			BM_LOG2( BM_LogRecv, "Creating mail...");
+			BmRef<BmMail> mail = new BmMail( mAnswerText, mPopAccount->Name());
+			if (mail->InitCheck() != B_OK) {
+				if (!mPipelining)
+					goto CLEAN_UP;
+				// the following mails are already on their way, so we leave
+				// this one on the server and carry on:
+				BM_LOGERR( BmString("Unable to create msg ") << i+1 
+								<< ", leaving it on the server.");
+				continue;
+			}
+			// ...set default folder according to pop-account settings...
+			mail->SetDestFolderName( mPopAccount->HomeFolder());
+			// ...and hand it over for filtering and storing:
+			inboundStage.AddMail( mail.Get(), i);
 		}
-		cmd = BmString("RETR ") << i+1;
-		SendCommand( cmd);
-		time_t before = time(NULL);
-		if (!CheckForPositiveAnswer( mNewMsgSizes[mCurrMailNr-1], true, true))
+		// the mails are deleted once all of them have been stored:
+		TakeStoredMails( inboundStage, deleteMsgs);
+		if (deleteMsgs.size() && !DeleteMsgs( deleteMsgs, false))
 			goto CLEAN_UP;
-		if (mAnswerText.Length() > ThePrefs->GetInt("LogSpeedThreshold",
-																  100*1024)) {
-			time_t after = time(NULL);
-			time_t duration = after-before > 0 ? after-before : 1;
-			// log speed for mails that exceed a certain size:
-			BM_LOG( BM_LogRecv,
-					  BmString("Received mail of size ")<<mAnswerText.Length()
-							<< " bytes in " << duration << " seconds => "
-							<< mAnswerText.Length()/duration/1024.0 << "KB/s");
-		}
-		if (mAnswerText.Length() != mNewMsgSizes[mCurrMailNr-1]) {
-			// as this actually happens (what the heck?) we simply
-			// log it if in verbose mode:
-			BM_LOG2( BM_LogRecv,
-						BmString("Received mail has ") << mAnswerText.Length()
-							<< " bytes but it was announced to have "
-							<< mNewMsgSizes[mCurrMailNr-1] << " bytes."
-			);
+		if (mNewMsgCount)
+			UpdateMailStatus( 100.0, "done", mNewMsgCount);
+	} catch(...) {
+		// a network-error unwinds past CLEAN_UP, but the stage stores the
+		// mails it has been handed in any case, so they must be marked as
+		// downloaded here, too (otherwise they'd be fetched again):
+		deleteMsgs.clear();
+		TakeStoredMails( inboundStage, deleteMsgs);
+		mCurrMailNr = 0;
+		throw;
+	}
+CLEAN_UP:
+	// the mails that have been handed over are stored in any case, so they
+	// must be marked as downloaded:
+	deleteMsgs.clear();
+	TakeStoredMails( inboundStage, deleteMsgs);
+	mCurrMailNr = 0;
+}
+
+/*------------------------------------------------------------------------------*\
+	TakeStoredMails( stage, deleteMsgs)
+		-	waits until the given stage has stored all mails, marks them as
+			downloaded and collects the numbers of those that should be 
+			deleted from the server now
+\*------------------------------------------------------------------------------*/
+void BmPopper::TakeStoredMails( BmInboundStage& stage, 
+										  vector<int32>& deleteMsgs) {
+	BmInboundStage::ResultVect results;
+	stage.TakeResults( results, true);
+	for( uint32 r=0; r<results.size(); ++r) {
+		int32 i = results[r].index;
+		if (!results[r].stored) {
+			BM_LOGERR( BmString("Unable to store msg ") << i+1 
+							<< ", leaving it on the server.");
+			continue;
 		}
-		// now create a mail from the received data...
-		BM_LOG2( BM_LogRecv, "Creating mail...");
-		BmRef<BmMail> mail = new BmMail( mAnswerText, mPopAccount->Name());
-		if (mail->InitCheck() != B_OK)
-			goto CLEAN_UP;
-		// ...set default folder according to pop-account settings...
-		mail->SetDestFolderName( mPopAccount->HomeFolder());
-		// ...execute mail-filters for this mail...
-		BM_LOG2( BM_LogRecv, "...applying filters (in memory)...");
-		mail->ApplyInboundFilters();
-		// ...and store mail on disk:
-		BM_LOG2( BM_LogRecv, "...storing mail...");
-		if (!mail->Store())
-			goto CLEAN_UP;
-		BM_LOG2( BM_LogRecv, "...done");
 		mPopAccount->MarkUIDAsDownloaded( mMsgUIDs[i]);
-		//	delete the retrieved message if required to do so immediately:
+		//	remember the retrieved message for deletion if required to do so
+		// immediately:
 		BmString log;
 		bool shouldBeDeleted
 			= mPopAccount->ShouldUIDBeDeletedFromServer(mMsgUIDs[i], log);
 		BM_LOG2( BM_LogRecv, log);
-		if (shouldBeDeleted) {
-			cmd = BmString("DELE ") << i+1;
-			SendCommand( cmd);
-			if (!CheckForPositiveAnswer())
-				goto CLEAN_UP;
-		}
-		mCurrMailNr++;
+		if (shouldBeDeleted)
+			deleteMsgs.push_back( i+1);
 	}
-	if (mNewMsgCount)
-		UpdateMailStatus( 100.0, "done", mNewMsgCount);
-CLEAN_UP:
-	mCurrMailNr = 0;
 }
 
 /*------------------------------------------------------------------------------*\
@@ -17,6 +17,7 @@
 
 #include "BmNetJobModel.h"
 
+class BmInboundStage;
 class BmPopAccount;
 
 enum {
@@ -98,6 +99,10 @@ private:
 	void StateRetrieve();
 	void StateDisconnect();
 
+	bool DeleteMsgs( const vector<int32>& msgNums, bool updateStatus);
+	void TakeStoredMails( BmInboundStage& stage, vector<int32>& deleteMsgs);
+	uint32 PipelineWindow() const;
+
 	void Quit( bool WaitForAnswer=false);
 	void UpdatePOPStatus( const float, const char*, bool failed=false, 
 								 bool stopped=false);
@@ -129,6 +134,8 @@ private:
 							// list of auth-types the server indicates to support
 	bool mServerSupportsTLS;
 							// whether or not the server knows about STLS
+	bool mServerSupportsPipelining;
+							// whether or not the server accepts pipelined commands
 	int32 mState;		
 							// current POP3-state (refer enum below)
 	enum States {
@@ -177,6 +177,8 @@ BmSmtp::BmSmtp( const BmString& name, BmSmtpAccount* account)
 	,	mServerMayHaveSizeLimit( false)
 	,	mServerSupportsDSN( false)
 	,	mServerSupportsTLS( false)
+	,	mServerSupportsPipelining( false)
+	,	mServerSupportsChunking( false)
 {
 }
 
@@ -423,6 +425,16 @@ void BmSmtp::StateHelo() {
 		if (rx.exec( StatusText(), "^\\d\\d\\d.STARTTLS\\b", Regexx::newline)) {
 			mServerSupportsTLS = true;
 		}
+		// a second EHLO (after STARTTLS) may yield different results, so we
+		// make sure to forget about what we knew before:
+		if (rx.exec( StatusText(), "^\\d\\d\\d.PIPELINING\\b", Regexx::newline))
+			mServerSupportsPipelining = true;
+		else
+			mServerSupportsPipelining = false;
+		if (rx.exec( StatusText(), "^\\d\\d\\d.CHUNKING\\b", Regexx::newline))
+			mServerSupportsChunking = true;
+		else
+			mServerSupportsChunking = false;
 	} catch(...) {
 		cmd = BmString("HELO ") << domain;
 		SendCommand( cmd);
@@ -629,7 +641,7 @@ void BmSmtp::StateSendMails() {
 				continue;
 			}
 		}
-		mCurrMailSize = mail->RawText().Length();
+		mCurrMailSize = mail->RawTextLength();
 
 		BmString headerText = mail->HeaderText();
 		if (!mail->Header()->IsFieldEmpty(BM_FIELD_RESENT_BCC)) {
@@ -653,16 +665,23 @@ void BmSmtp::StateSendMails() {
 			BmRcptSet rcptSet;
 			if (ThePrefs->GetBool("SpecialHeaderForEachBcc")) {
 				if (HasStdRcpts( mail.Get(), rcptSet)) {
-					Mail( mail.Get());
-					Rcpt( rcptSet);
+					Mail( mail.Get(), rcptSet);
 					Data( mail.Get(), headerText);
 				}
-				BccRcpt( mail.Get(), true, headerText);
+				// send a personalized mail to each Bcc-recipient:
+				BmRcptSet bccSet;
+				HasBccRcpts( mail.Get(), bccSet);
+				BmRcptSet::const_iterator iter;
+				for( iter = bccSet.begin(); iter != bccSet.end(); ++iter) {
+					BmRcptSet singleBccSet;
+					singleBccSet.insert( *iter);
+					Mail( mail.Get(), singleBccSet);
+					Data( mail.Get(), headerText, *iter);
+				}
 			} else {
-				Mail( mail.Get());
-				if (HasStdRcpts( mail.Get(), rcptSet))
-					Rcpt( rcptSet);
-				BccRcpt( mail.Get(), false, headerText);
+				HasStdRcpts( mail.Get(), rcptSet);
+				HasBccRcpts( mail.Get(), rcptSet);
+				Mail( mail.Get(), rcptSet);
 				Data( mail.Get(), headerText);
 			}
 			if (ShouldContinue()) {
@@ -676,7 +695,9 @@ void BmSmtp::StateSendMails() {
 								<< " couldn't be sent.\n\nError:\n" << err.what());
 			mail->MarkAs( BM_MAIL_STATUS_ERROR);
 				// mark mail as ERROR since it couldn't be sent
+			mPipelining = false;
 			SendCommand("RSET");
+			GetAnswer();
 				// reset SMTP-state in order to start afresh with next mail
 		}
 	}
@@ -693,10 +714,13 @@ void BmSmtp::StateDisconnect() {
 }
 
 /*------------------------------------------------------------------------------*\
-	Mail( mail)
-		-	announces the given mail to the server
+	Mail( mail, rcptSet)
+		-	announces the given mail and all given recipients to the server
+		-	if the server supports pipelining, the MAIL- and RCPT-commands are
+			sent in batches and all answers are checked, such that every 
+			recipient refused by the server is reported (not just the first)
 \*------------------------------------------------------------------------------*/
-void BmSmtp::Mail( BmMail* mail) {
+void BmSmtp::Mail( BmMail* mail, const BmRcptSet& rcptSet) {
 	BmString sender = mail->Header()->DetermineSender();
 	Regexx rx;
 	if (!rx.exec( sender, "@\\w+")) {
@@ -706,13 +730,51 @@ void BmSmtp::Mail( BmMail* mail) {
 		BmString fqdn = mSmtpAccount->DomainToAnnounce();
 		sender << OwnDomain( fqdn);
 	}
+	vector<BmString> cmds;
 	BmString cmd = BmString("MAIL from:<") << sender <<">";
 	if (mServerMayHaveSizeLimit) {
-		int32 mailSize = mail->RawText().Length();
+		int32 mailSize = mail->RawTextLength();
 		cmd << " SIZE=" << mailSize;
 	}
-	SendCommand( cmd);
-	CheckForPositiveAnswer();
+	cmds.push_back( cmd);
+	BmRcptSet::const_iterator rcptIter;
+	for( rcptIter = rcptSet.begin(); rcptIter != rcptSet.end(); ++rcptIter)
+		cmds.push_back( BmString("RCPT to:<") << (*rcptIter) << ">");
+
+	if (!mServerSupportsPipelining) {
+		for( uint32 i=0; i<cmds.size(); ++i) {
+			SendCommand( cmds[i]);
+			CheckForPositiveAnswer();
+		}
+		return;
+	}
+
+	uint32 window 
+		= std::max( (int32)1, ThePrefs->GetInt( "SmtpPipelineWindow", 100));
+	BmString refusals;
+	mPipelining = true;
+	for( uint32 first=0; first<cmds.size() && ShouldContinue(); first+=window) {
+		uint32 last = std::min( first+window, (uint32)cmds.size());
+		BmString batch;
+		for( uint32 i=first; i<last; ++i) {
+			if (batch.Length())
+				batch << "\r\n";
+			batch << cmds[i];
+		}
+		SendCommand( batch);
+		for( uint32 i=first; i<last; ++i) {
+			GetAnswer();
+			if (StatusText().ByteAt(0) > '3')
+				refusals << "\n" << cmds[i] << "\n\t" << StatusText();
+		}
+	}
+	mPipelining = false;
+	if (refusals.Length()) {
+		BmString err("Server refuses:");
+		err << refusals;
+		err.RemoveAll( "\r");
+		throw BM_network_error( err);
+	}
 }
 
 /*------------------------------------------------------------------------------*\
@@ -749,40 +811,24 @@ bool BmSmtp::HasStdRcpts( BmMail* mail, BmRcptSet& rcptSet) {
 }
 
 /*------------------------------------------------------------------------------*\
-	bool Rcpt( rcptSet)
-		-	announces all given recipients to the server
-\*------------------------------------------------------------------------------*/
-void BmSmtp::Rcpt( const BmRcptSet& rcptSet) {
-	BmRcptSet::const_iterator rcptIter;
-	for( rcptIter = rcptSet.begin(); rcptIter != rcptSet.end(); ++rcptIter) {
-		BmString cmd = BmString("RCPT to:<") << (*rcptIter) << ">";
-		SendCommand( cmd);
-		CheckForPositiveAnswer();
-	}
-}
-
-/*------------------------------------------------------------------------------*\
-	BccRcpt( mail, sendDataForEachBcc)
-		-	announces all Bcc-recipients of given mail to the server
-		-	if param sendDataForEachBcc is set, a new mail will be created for each
-			Bcc-recipient, containing only it inside the Bcc-header
+	bool HasBccRcpts( mail)
+		-	adds all Bcc-recipients of the given mail to the given set
+		-	returns true if at least one Bcc-recipient has been found
 \*------------------------------------------------------------------------------*/
-void BmSmtp::BccRcpt( BmMail* mail, bool sendDataForEachBcc,
-							 const BmString& headerText) {
+bool BmSmtp::HasBccRcpts( BmMail* mail, BmRcptSet& rcptSet) {
+	bool found = false;
 	BmAddrList::const_iterator iter;
 	const BmAddressList& bccList
 		= mail->IsRedirect()
 			? mail->Header()->GetAddressList( BM_FIELD_RESENT_BCC)
 			: mail->Header()->GetAddressList( BM_FIELD_BCC);
 	for( iter=bccList.begin(); iter != bccList.end(); ++iter) {
-		if (sendDataForEachBcc)
-			Mail( mail);
-		BmString cmd = BmString("RCPT to:<") << iter->AddrSpec() <<">";
-		SendCommand( cmd);
-		CheckForPositiveAnswer();
-		if (sendDataForEachBcc)
-			Data( mail, headerText, iter->AddrSpec());
+		if (!iter->HasAddrSpec())
+			continue;
+		rcptSet.insert( iter->AddrSpec());
+		found = true;
 	}
+	return found;
 }
 
 /*------------------------------------------------------------------------------*\
@@ -792,9 +838,6 @@ void BmSmtp::BccRcpt( BmMail* mail, bool sendDataForEachBcc,
 			Bcc-header (only this address)
 \*------------------------------------------------------------------------------*/
 void BmSmtp::Data( BmMail* mail, const BmString& headerText, BmString forBcc) {
-	BmString cmd( "DATA");
-	SendCommand( cmd);
-	CheckForPositiveAnswer();
 	BmString completeHeader;
 	if (forBcc.Length()) {
 		if (mail->IsRedirect()) {
@@ -812,8 +855,17 @@ void BmSmtp::Data( BmMail* mail, const BmString& headerText, BmString forBcc) {
 	BmStringIBuf sendBuf( completeHeader);
 	sendBuf.AddBuffer( mail->RawText().String()+mail->HeaderLength());
 	time_t before = time(NULL);
-	SendCommandBuf( sendBuf, "", true, true);
-	int32 len = mail->RawText().Length();
+	if (mServerSupportsChunking 
+	&& ThePrefs->GetInt( "SmtpChunkSize", 1024*1024) > 0)
+		Bdat( sendBuf);
+	else {
+		BmString cmd( "DATA");
+		SendCommand( cmd);
+		CheckForPositiveAnswer();
+		SendCommandBuf( sendBuf, "", true, true);
+		CheckForPositiveAnswer();
+	}
+	int32 len = mail->RawTextLength();
 	if (len > ThePrefs->GetInt("LogSpeedThreshold", 100*1024)) {
 		time_t after = time(NULL);
 		time_t duration = after-before > 0 ? after-before : 1;
@@ -823,7 +875,58 @@ void BmSmtp::Data( BmMail* mail, const BmString& headerText, BmString forBcc) {
 						<< " bytes in " << duration << " seconds => "
 						<< len/duration/1024.0 << "KB/s");
 	}
-	CheckForPositiveAnswer();
+}
+
+/*------------------------------------------------------------------------------*\
+	Bdat( sendBuf)
+		-	sends the given mailtext to the server in chunks (RFC 3030), which
+			saves the dot-stuffing and the round trip for DATA
+		-	if the server supports pipelining, the answers are checked after
+			the last chunk has been sent
+\*------------------------------------------------------------------------------*/
+void BmSmtp::Bdat( BmStringIBuf& sendBuf) {
+	if (!sendBuf.EndsWithNewline())
+		// DATA completes the last line, too:
+		sendBuf.AddBuffer( "\r\n", 2);
+	uint32 chunkSize = ThePrefs->GetInt( "SmtpChunkSize", 1024*1024);
+	uint32 left = sendBuf.Size();
+	vector<char> chunk( std::max( (uint32)1, std::min( chunkSize, left)));
+	uint32 pendingAnswers = 0;
+	mPipelining = mServerSupportsPipelining;
+	while( left > 0 && ShouldContinue()) {
+		uint32 len = sendBuf.Read( &chunk[0], std::min( chunkSize, left));
+		if (!len)
+			break;
+		left -= len;
+		BmString cmd = BmString("BDAT ") << len;
+		if (!left)
+			cmd << " LAST";
+		SendCommand( cmd);
+		mWriter->DoUpdate( true);
+		if (mWriter->Write( &chunk[0], len) < len && ShouldContinue())
+			throw BM_network_error( 
+				BmString("Wrote only parts of a chunk of ") << len << " bytes"
+			);
+		pendingAnswers++;
+		if (!mPipelining) {
+			CheckForPositiveAnswer();
+			pendingAnswers--;
+		}
+	}
+	// fetch all outstanding answers before we complain about any of them:
+	BmString refusal;
+	for( ; pendingAnswers > 0; --pendingAnswers) {
+		GetAnswer();
+		if (!refusal.Length() && StatusText().ByteAt(0) > '3')
+			refusal = StatusText();
+	}
+	mPipelining = false;
+	if (refusal.Length()) {
+		BmString err("Server answers: \n");
+		err << refusal;
+		err.RemoveAll( "\r");
+		throw BM_network_error( err);
+	}
 }
 
 /*------------------------------------------------------------------------------*\
@@ -138,12 +138,11 @@ private:
 	void StateDisconnect();
 
 	void Quit( bool WaitForAnswer=false);
-	void Mail( BmMail *mail);
+	void Mail( BmMail *mail, const BmRcptSet& rcptSet);
 	bool HasStdRcpts( BmMail *mail, BmRcptSet& rcptSet);
-	void Rcpt( const BmRcptSet& rcptSet);
-	void BccRcpt( BmMail *mail, bool sendDataForEachBcc, 
-					  const BmString& headerText);
+	bool HasBccRcpts( BmMail *mail, BmRcptSet& rcptSet);
 	void Data( BmMail *mail, const BmString& headerText, BmString forBcc="");
+	void Bdat( BmStringIBuf& sendBuf);
 	void UpdateSMTPStatus( const float, const char*, bool failed=false, 
 								  bool stopped=false);
 	void UpdateMailStatus( const float, const char*, int32);
@@ -151,6 +150,8 @@ private:
 	bool mServerMayHaveSizeLimit;
 	bool mServerSupportsDSN;
 	bool mServerSupportsTLS;
+	bool mServerSupportsPipelining;
+	bool mServerSupportsChunking;
 	BmString mSupportedAuthTypes;
 	
 	BmQueuedRefVect mQueuedRefVect;
@@ -43,67 +43,169 @@ using namespace regexx;
 	BmContentField( ctString)
 	-	c'tor
 \*------------------------------------------------------------------------------*/
-BmContentField::BmContentField( const BmString cfString) {
+BmContentField::BmContentField( const BmStringView& cfString) {
 	SetTo( cfString);
 }
 
+/*------------------------------------------------------------------------------*\
+	DecodeExtendedValue( val)
+	-	decodes the %-escaped octets of an extended parameter-value (RFC 2231)
+\*------------------------------------------------------------------------------*/
+static BmString DecodeExtendedValue( const BmString& val) {
+	if (val.FindFirst( '%') < 0)
+		return val;
+	BmString decoded;
+	int32 len = val.Length();
+	for( int32 i=0; i<len; ++i) {
+		if (val[i] == '%' && i+2 < len && isxdigit( (unsigned char)val[i+1]) 
+		&& isxdigit( (unsigned char)val[i+2])) {
+			char hex[3] = { val[i+1], val[i+2], 0 };
+			decoded << (char)strtol( hex, NULL, 16);
+			i += 2;
+		} else
+			decoded << val[i];
+	}
+	return decoded;
+}
+
 /*------------------------------------------------------------------------------*\
 	SetTo( cfString)
 	-	parses given content-field
+	-	the field is scanned in place (no regular expressions involved), 
+		only the resulting value and parameters are copied
+	-	parameters that have been split into sections and/or carry a charset
+		(RFC 2231) are joined and converted to UTF-8
 \*------------------------------------------------------------------------------*/
-void BmContentField::SetTo( const BmString cfString) {
-	Regexx rx;
-
-	if (rx.exec( cfString, "^\\s*([^\\s;]+)\\s*([;\\s].*)?\\s*$", 
-					 Regexx::newline)) {
-		// extract value:
-		if (rx.match[0].atom.size() > 0) {
-			if (cfString[rx.match[0].atom[0].start()] == '"') {
+void BmContentField::SetTo( const BmStringView& cfString) {
+	mInitCheck = B_NO_INIT;
+	mValue.Truncate( 0);
+	mParams.clear();
+	const char* s = cfString.Data();
+	int32 len = cfString.Length();
+	int32 pos = 0;
+	// extract value:
+	while( pos < len && isspace( (unsigned char)s[pos]))
+		pos++;
+	int32 valStart = pos;
+	while( pos < len && s[pos] != ';' && !isspace( (unsigned char)s[pos]))
+		pos++;
+	int32 valLen = pos - valStart;
+	if (!valLen) {
+		BM_LOG(BM_LogMailParse, BmString("field-value <")
+							<<BmString( s, len)<<"> has unknown structure!");
+		return;
+	}
+	if (s[valStart] == '"' && valLen >= 2) {
+		// skip quotes during extraction:
+		mValue.SetTo( s+valStart+1, valLen-2);
+	} else
+		mValue.SetTo( s+valStart, valLen);
+	mValue.ToLower();
+	BM_LOG2( BM_LogMailParse, BmString("...found value: ")<<mValue);
+	// parse and extract parameters, each of the form
+	//		;? key[*section][*] = ("quoted value"|plain-value)
+	// with anything not matching this pattern being skipped (up to the 
+	// next ';'). Sections and extended values are collected first and 
+	// joined once all parameters have been seen:
+	typedef map< int32, BmString> BmSectionMap;
+	map< BmString, BmSectionMap> sectionedParams;
+	map< BmString, BmString> paramCharsets;
+	while( pos < len) {
+		int32 p = pos;
+		if (s[p] == ';')
+			p++;
+		while( p < len && isspace( (unsigned char)s[p]))
+			p++;
+		int32 keyStart = p;
+		while( p < len 
+		&& (isalnum( (unsigned char)s[p]) || s[p] == '_' || s[p] == '-'))
+			p++;
+		int32 keyLen = p - keyStart;
+		int32 section = -1;
+		bool extended = false;
+		if (p < len && s[p] == '*') {
+			p++;
+			if (p < len && isdigit( (unsigned char)s[p])) {
+				section = 0;
+				while( p < len && isdigit( (unsigned char)s[p])) {
+					if (section < 10000)
+						section = section*10 + s[p] - '0';
+					p++;
+				}
+				if (p < len && s[p] == '*') {
+					extended = true;
+					p++;
+				}
+			} else
+				extended = true;
+		}
+		while( p < len && isspace( (unsigned char)s[p]))
+			p++;
+		bool valid = keyLen && p < len && s[p] == '=';
+		BmString val;
+		if (valid) {
+			p++;
+			while( p < len && isspace( (unsigned char)s[p]))
+				p++;
+			if (p < len && s[p] == '"') {
 				// skip quotes during extraction:
-				cfString.CopyInto( mValue, rx.match[0].atom[0].start()+1, 
-										 rx.match[0].atom[0].Length()-2);
+				int32 valStart = ++p;
+				while( p < len && s[p] != '"')
+					p++;
+				val.SetTo( s+valStart, p-valStart);
+				if (p < len)
+					p++;
 			} else {
-				mValue = rx.match[0].atom[0];
+				int32 valStart = p;
+				while( p < len && s[p] != ';' && !isspace( (unsigned char)s[p]))
+					p++;
+				valid = p > valStart;
+				val.SetTo( s+valStart, p-valStart);
 			}
 		}
-		mValue.ToLower();
-		BM_LOG2( BM_LogMailParse, BmString("...found value: ")<<mValue);
-		// parse and extract parameters:
-		BmString params;
-		if (rx.match[0].atom.size() > 1)
-			params = rx.match[0].atom[1];
-		if (rx.exec( params, 
-						 ";?\\s*(\\w+)\\s*=\\s*((?:\\\"[^\"]+\\\"?)|(?:[^;\\s]+))", 
-						 Regexx::global)) {
-			for( uint32 i=0; i<rx.match.size(); ++i) {
-				BmString key;
-				BmString val;
-				if (rx.match[0].atom.size() > 0) {
-					key = rx.match[i].atom[0];
-					if (rx.match[0].atom.size() > 1) {
-						if (params[rx.match[i].atom[1].start()] == '"') {
-							// skip quotes during extraction:
-							int skip = params[rx.match[i].atom[1].start()
-													+rx.match[i].atom[1].Length()-1] == '"'
-											? 2 : 1;
-							params.CopyInto( val, rx.match[i].atom[1].start()+1, 
-												  rx.match[i].atom[1].Length()-skip);
-						} else {
-							val = rx.match[i].atom[1];
-						}
-					}
-					key.ToLower();
-					mParams[key] = val;
-					BM_LOG2( BM_LogMailParse, 
-								BmString("...found param: ")<<key
-									<<" with value: "<<val);
+		if (!valid) {
+			while( p < len && s[p] != ';')
+				p++;
+			pos = p;
+			continue;
+		}
+		BmString key( s+keyStart, keyLen);
+		key.ToLower();
+		BM_LOG2( BM_LogMailParse, 
+					BmString("...found param: ")<<BmString( s+keyStart, p-keyStart)
+						<<" with value: "<<val);
+		pos = p;
+		if (section < 0 && !extended) {
+			mParams[key] = val;
+			continue;
+		}
+		if (extended) {
+			if (section <= 0) {
+				// the first section starts with charset and language:
+				int32 q1 = val.FindFirst( '\'');
+				int32 q2 = q1 >= 0 ? val.FindFirst( '\'', q1+1) : -1;
+				if (q2 >= 0) {
+					BmString charset( val.String(), q1);
+					charset.ToLower();
+					paramCharsets[key] = charset;
+					val.Remove( 0, q2+1);
 				}
 			}
+			val = DecodeExtendedValue( val);
 		}
-	} else {
-		BM_LOG(BM_LogMailParse, BmString("field-value <")<<cfString
-							<<"> has unknown structure!");
-		return;
+		sectionedParams[key][std::max( section, (int32)0)] = val;
+	}
+	map< BmString, BmSectionMap>::const_iterator iter;
+	for( iter = sectionedParams.begin(); iter != sectionedParams.end(); ++iter) {
+		BmString joined;
+		BmSectionMap::const_iterator sec;
+		for( sec = iter->second.begin(); sec != iter->second.end(); ++sec)
+			joined << sec->second;
+		const BmString& charset = paramCharsets[iter->first];
+		if (charset.Length())
+			ConvertToUTF8( charset, joined, mParams[iter->first]);
+		else
+			mParams[iter->first] = joined;
 	}
 	mInitCheck = B_OK;
 }
@@ -190,6 +292,7 @@ BmBodyPart::BmBodyPart( BmBodyPartList* model, const BmString& msgtext,
 	,	mStartInRawText( 0)
 	,	mBodyLength( 0)
 	,	mHaveDecodedData( false)
+	,	mDecodedLength( -1)
 	,	mSuggestedCharset( defaultCharset)
 	,	mCurrentCharset( defaultCharset)
 	, 	mHadErrorDuringConversion( false)
@@ -217,6 +320,7 @@ BmBodyPart::BmBodyPart( BmBodyPartList* model, const entry_ref* ref,
 	// we can't store info about mailtext, since there is no mailtext available:
 	,	mBodyLength( 0)
 	,	mHaveDecodedData( false)
+	,	mDecodedLength( -1)
 	,	mSuggestedCharset( defaultCharset)
 	,	mCurrentCharset( defaultCharset)
 	, 	mHadErrorDuringConversion( false)
@@ -313,6 +417,7 @@ BmBodyPart::BmBodyPart( const BmBodyPart& in)
 	,	mStartInRawText( 0)
 	,	mBodyLength( 0)
 	,	mHaveDecodedData( false)
+	,	mDecodedLength( -1)
 	,	mSuggestedCharset( in.SuggestedCharset())
 	,	mCurrentCharset( in.CurrentCharset())
 	, 	mHadErrorDuringConversion( false)
@@ -353,14 +458,16 @@ void BmBodyPart::SetTo( const BmString& msgtext, int32 start, int32 length,
  	
  	mHadErrorDuringConversion = false;
  	mParsingErrors.Truncate(0);
+ 	mDecodedLength = -1;
  	
  	if (length < 0)
  		length = 0;
 
 	if (!header) {
 		// this is not the main body, so we have to split the MIME-headers from
-		// the MIME-bodypart:
-		BmString headerText;
+		// the MIME-bodypart (the MIME-header is parsed in place, from a view 
+		// into the mailtext):
+		BmStringView headerText;
 		if (!length) {
 			mStartInRawText = start;
 			mBodyLength = 0;
@@ -387,13 +494,13 @@ void BmBodyPart::SetTo( const BmString& msgtext, int32 start, int32 length,
 				} else
 					mStartInRawText = pos+4;
 			}
-			BM_LOG2( BM_LogMailParse, "...copying headerText...");
-			msgtext.CopyInto( headerText, start, pos-start+2);
-			BM_LOG2( BM_LogMailParse, "...done");
+			headerText = BmStringView( msgtext).Substr( start, pos-start+2);
 			mBodyLength = length - (mStartInRawText-start);
 		}
-		BM_LOG2( BM_LogMailParse, BmString("MIME-Header found: ") << headerText);
-		header = new BmMailHeader( headerText, NULL);
+		BM_LOG2( BM_LogMailParse, 
+					BmString("MIME-Header found: ") 
+						<< BmString( headerText.Data(), headerText.Length()));
+		header = new BmMailHeader( headerText, NULL, false);
 	} else {
 		mStartInRawText = start;
 		mBodyLength = length;
@@ -414,6 +521,11 @@ void BmBodyPart::SetTo( const BmString& msgtext, int32 start, int32 length,
 	mContentType.SetTo( type);
 	if (type.ICompare("multipart", 9) == 0) {
 		mIsMultiPart = true;
+	} else if (body->Mail()) {
+		// the body of a lazily loaded mail may have been left out of the
+		// mailtext, in which case its real length is taken from the mail:
+		mBodyLength = body->Mail()->RawBodyLength( mStartInRawText, 
+																 mBodyLength);
 	}
 	if (IsPlainText() && !body->EditableTextBody()) {
 		body->EditableTextBody( this);
@@ -518,8 +630,9 @@ void BmBodyPart::SetTo( const BmString& msgtext, int32 start, int32 length,
 		int32 foundBoundaryLen;
 							// length of current boundary that was found and matches the
 							// given boundary
-		int32 firstBoundaryLen=0;
-							// length of first (given) boundary
+		int32 startBoundaryLen=0;
+							// length of the boundary that starts the current
+							// subpart (these may differ in trailing whitespace)
 		while( !isLastBoundary) {
 			while( 1) {
 				// in this loop we determine the next occurence of the current 
@@ -541,8 +654,8 @@ void BmBodyPart::SetTo( const BmString& msgtext, int32 start, int32 length,
 					foundBoundaryLen++;
 				if (*(nPos+foundBoundaryLen)=='\n')
 					foundBoundaryLen++;
-				if (!firstBoundaryLen)
-					firstBoundaryLen = foundBoundaryLen;
+				if (nPos == startPos)
+					startBoundaryLen = foundBoundaryLen;
 				BM_LOG2( BM_LogMailParse, "finding next boundary...");
 				nPos = strstr( nPos+foundBoundaryLen, boundary.String());
 				if (!nPos) {
@@ -581,7 +694,7 @@ void BmBodyPart::SetTo( const BmString& msgtext, int32 start, int32 length,
 				}
 			}
 			if (nPos) {
-				int32 startOffs = startPos-msgtext.String()+firstBoundaryLen;
+				int32 startOffs = startPos-msgtext.String()+startBoundaryLen;
 				BM_LOG2( BM_LogMailParse, 
 							"Subpart of multipart found will be added to array");
 				int32 len = std::max((long)0,nPos-msgtext.String()-startOffs-2);
@@ -596,7 +709,7 @@ void BmBodyPart::SetTo( const BmString& msgtext, int32 start, int32 length,
 				AddSubItem( subPart);
 				startPos = nPos;
 			} else {
-				int32 startOffs = startPos-msgtext.String()+firstBoundaryLen;
+				int32 startOffs = startPos-msgtext.String()+startBoundaryLen;
 				if (start+length > startOffs) {
 					// the final boundary is missing, we include the remaining 
 					// part as a sub-bodypart anyway:
@@ -690,6 +803,40 @@ void BmBodyPart::DecodeText(const char* tryCharset) {
 	BM_LOG2( BM_LogMailParse, "...done (decoding of text-part)");
 }
 
+/*------------------------------------------------------------------------------*\
+	BmDecodedLengthCounter
+		-	functor that just counts the bytes it is fed
+\*------------------------------------------------------------------------------*/
+struct BmDecodedLengthCounter : public BmMemBufConsumer::Functor {
+	BmDecodedLengthCounter()
+		:	mLength( 0)							{}
+	status_t operator() (char*, uint32 bufLen) {
+		mLength += bufLen;
+		return B_OK;
+	}
+	int32 mLength;
+};
+
+/*------------------------------------------------------------------------------*\
+	BmFileWriter
+		-	functor that writes the data it is fed into the given file
+\*------------------------------------------------------------------------------*/
+struct BmFileWriter : public BmMemBufConsumer::Functor {
+	BmFileWriter( BFile& file)
+		:	mFile( file)
+		,	mStatus( B_OK)							{}
+	status_t operator() (char* buf, uint32 bufLen) {
+		ssize_t written = mFile.Write( buf, bufLen);
+		if (written < 0)
+			mStatus = written;
+		else if ((uint32)written != bufLen)
+			mStatus = B_IO_ERROR;
+		return mStatus;
+	}
+	BFile& mFile;
+	status_t mStatus;
+};
+
 /*------------------------------------------------------------------------------*\
 	DecodedData()
 	-	
@@ -709,50 +856,76 @@ const BmString& BmBodyPart::DecodedData() const {
 					BM_LOG2( BM_LogMailParse, 
 								BmString( "(re-)converting bodytext of ") 
 									<< mBodyLength << " bytes...");
-					BmCharsetVect charsetVect;
+					// the transfer-decoding is only done once, the result is then
+					// used to judge and convert the candidate charsets:
+					BmMemIBufRef text 
+						= mail->RawBodyFor( mStartInRawText, mBodyLength);
+					BmMemFilterRef decoder 
+						= FindDecoderFor( text.get(), mContentTransferEncoding);
+					BmLinebreakDecoder linebreakDecoder( decoder.get());
+					BmStringOBuf decodedIO( mBodyLength, 1.2f);
+					decodedIO.Write( &linebreakDecoder);
+					if (decoder->HaveStatusText())
+						AddParsingError(decoder->StatusText());
+					const BmString& decodedText = decodedIO.TheString();
+
+					BmCharsetScoreVect ranking;
 					if (mSuggestedCharset != mCurrentCharset 
 					|| !ThePrefs->GetBool("AutoCharsetDetectionInbound", true))
 						// user suggested a charset, we try that:
-						charsetVect.push_back( mSuggestedCharset);
-					else
+						ranking.push_back( BmCharsetScore( mSuggestedCharset, 100));
+					else {
 						// we try the native charset first and (in case of errors)
-						// all preferred charsets:
+						// all preferred charsets, in the order of their ranking:
+						BmCharsetVect charsetVect;
 						GetPreferredCharsets( charsetVect, mSuggestedCharset);
+						RankCharsets( decodedText, charsetVect, ranking);
+					}
+					// the declared charset is always tried first, if all fail,
+					// we stick with its result:
 					BmString charset;
-					for( uint32 i=0; i<charsetVect.size(); ++i) {
-						BmStringIBuf text( mail->RawText().String()+mStartInRawText,
-												 mBodyLength);
-						BmMemFilterRef decoder 
-							= FindDecoderFor( &text, mContentTransferEncoding);
-						BmLinebreakDecoder linebreakDecoder( decoder.get());
-						BmStringOBuf tempIO( mBodyLength, 1.2f);
-						charset = charsetVect[i];
+					BmString declaredResult;
+					bool converted = false;
+					for( uint32 i=0; i<ranking.size(); ++i) {
+						BmStringIBuf decodedBuf( decodedText);
+						BmStringOBuf tempIO( decodedText.Length(), 1.2f);
+						charset = ranking[i].charset;
 						BM_LOG2( BM_LogMailParse, 
-									BmString( "trying charset ") << charset);
-						BmUtf8Encoder textConverter( &linebreakDecoder, charset);
+									BmString( "trying charset ") << charset 
+										<< " (confidence " << ranking[i].confidence 
+										<< "%)");
+						BmUtf8Encoder textConverter( &decodedBuf, charset);
 						BmMailtextCleaner mailtextCleaner( &textConverter);
 						tempIO.Write( &mailtextCleaner);
 						mHadErrorDuringConversion = textConverter.HadToDiscardChars() 
 											|| textConverter.HadError();
-						if (decoder->HaveStatusText())
-							AddParsingError(decoder->StatusText());
-						if (!mHadErrorDuringConversion || i==charsetVect.size()-1) {
-							if (i>0) {
+						if (!mHadErrorDuringConversion) {
+							if (charset.ICompare( mSuggestedCharset) != 0) {
 								AddParsingError(
 									BmString("Autodetected charset (")
-										<< charset << "), may need manual correction"
+										<< charset << ", confidence " 
+										<< ranking[i].confidence 
+										<< "%), may need manual correction"
 								);
 							}
 							mDecodedData.Adopt( tempIO.TheString());
+							converted = true;
 							break;
 						}
+						if (i == 0)
+							declaredResult.Adopt( tempIO.TheString());
+					}
+					if (!converted) {
+						charset = ranking[0].charset;
+						mDecodedData.Adopt( declaredResult);
+						mHadErrorDuringConversion = true;
 					}
 					mCurrentCharset = mSuggestedCharset = charset;
 				} else {
-					BmStringIBuf text( mail->RawText().String()+mStartInRawText, 
-											 mBodyLength);
+					BmMemIBufRef text 
+						= mail->RawBodyFor( mStartInRawText, mBodyLength);
 					BmMemFilterRef decoder 
-						= FindDecoderFor( &text, mContentTransferEncoding);
+						= FindDecoderFor( text.get(), mContentTransferEncoding);
 					BmStringOBuf tempIO( mBodyLength, 1.2f);
 					BM_LOG2( BM_LogMailParse, 
 								BmString( "decoding bodytext of ") << mBodyLength 
@@ -771,6 +944,34 @@ const BmString& BmBodyPart::DecodedData() const {
 	return mDecodedData; 
 }
 
+/*------------------------------------------------------------------------------*\
+	DecodedLength()
+	-	returns the length of the decoded data
+	-	for non-text parts whose data has not been decoded yet, the length is
+		determined by decoding into a counter, such that listing the 
+		attachments of a mail doesn't materialize all of them
+\*------------------------------------------------------------------------------*/
+int32 BmBodyPart::DecodedLength() const {
+	if (mHaveDecodedData || IsText())
+		return DecodedData().Length();
+	if (mDecodedLength < 0) {
+		BmRef<BmListModel> listModel( ListModel());
+		BmBodyPartList* bodyPartList 
+			= dynamic_cast< BmBodyPartList*>( listModel.Get());
+		const BmMail* mail;
+		if (!bodyPartList || (mail=bodyPartList->Mail())==NULL)
+			return DecodedData().Length();
+		BmMemIBufRef text = mail->RawBodyFor( mStartInRawText, mBodyLength);
+		BmMemFilterRef decoder 
+			= FindDecoderFor( text.get(), mContentTransferEncoding);
+		BmMemBufConsumer consumer( 65536);
+		BmDecodedLengthCounter counter;
+		consumer.Consume( decoder.get(), &counter);
+		mDecodedLength = counter.mLength;
+	}
+	return mDecodedLength;
+}
+
 /*------------------------------------------------------------------------------*\
 	ContainsRef()
 	-	
@@ -790,12 +991,28 @@ bool BmBodyPart::ContainsRef( const entry_ref& ref) const {
 		-	
 \*------------------------------------------------------------------------------*/
 void BmBodyPart::WriteToFile( BFile& file) {
+	BmRef<BmListModel> listModel( ListModel());
+	BmBodyPartList* bodyPartList 
+		= dynamic_cast< BmBodyPartList*>( listModel.Get());
+	const BmMail* mail = bodyPartList ? bodyPartList->Mail() : NULL;
 	if (IsText() && !ThePrefs->GetBool( "ImportExportTextAsUtf8", true)) {
 		BmString convertedString;
 		ConvertFromUTF8( mSuggestedCharset, DecodedData(), convertedString);
 		file.Write( convertedString.String(), convertedString.Length());
+	} else if (!mHaveDecodedData && !IsText() && mail) {
+		// stream the decoded data directly from the mailtext (or the 
+		// mail-file) into the file, without materializing it in memory:
+		BmMemIBufRef text = mail->RawBodyFor( mStartInRawText, mBodyLength);
+		BmMemFilterRef decoder 
+			= FindDecoderFor( text.get(), mContentTransferEncoding);
+		BmMemBufConsumer consumer( 65536);
+		BmFileWriter writer( file);
+		consumer.Consume( decoder.get(), &writer);
+		if (writer.mStatus != B_OK)
+			BM_LOGERR( BmString("Could not write bodypart to file.\n\nError: ")
+							<< strerror( writer.mStatus));
 	} else
-		file.Write( DecodedData().String(), DecodedLength());
+		file.Write( DecodedData().String(), DecodedData().Length());
 	BNodeInfo fileInfo;
 	fileInfo.SetTo( &file);
 	fileInfo.SetType( MimeType().String());
@@ -1062,8 +1279,8 @@ void BmBodyPart::ConstructBodyForSending( BmStringOBuf &msgText) {
 			BM_LOG2( BM_LogMailParse, 
 						BmString( "copying bodytext of ") << mBodyLength 
 							<< " bytes...");
-			mBodyLength = msgText.Write( mail->RawText().String()+mStartInRawText, 
-												  mBodyLength);
+			BmMemIBufRef text = mail->RawBodyFor( mStartInRawText, mBodyLength);
+			mBodyLength = msgText.Write( text.get());
 			BM_LOG2( BM_LogMailParse, "...done (bodytext)");
 		} else {
 			if (IsText()) {
@@ -1161,7 +1378,7 @@ void BmBodyPartList::ParseMail() {
 	mEditableTextBody = NULL;
 	Cleanup();
 	if (mMail && mMail->HeaderLength() >= 2) {
-		const BmString& msgText = mMail->RawText();
+		const BmString& msgText = mMail->SkeletonText();
 		BmBodyPart* bodyPart 
 			= new BmBodyPart( this, msgText, mMail->HeaderLength()+2, 
 									MAX(msgText.Length()-mMail->HeaderLength()-2, 0), 
@@ -30,10 +30,10 @@ class IMPEXPBMMAILKIT BmContentField {
 public:
 	// c'tors and d'tor:
 	BmContentField()							{ mInitCheck = B_NO_INIT; }
-	BmContentField( const BmString cfString);
+	BmContentField( const BmStringView& cfString);
 	
 	// native methods:
-	void SetTo( const BmString cfString);
+	void SetTo( const BmStringView& cfString);
 	void SetParam( BmString key, BmString value);
 
 	// getters:
@@ -107,7 +107,7 @@ public:
 	inline bool IsMultiPart() const		{ return mIsMultiPart; }
 	void DecodeText(const char* tryCharset = NULL);
 	const BmString& DecodedData() const;
-	inline int32 DecodedLength() const	{ return DecodedData().Length(); }
+	int32 DecodedLength() const;
 	inline status_t InitCheck() const	{ return mInitCheck; }
 
 	inline const BmString ContentTypeAsString() const	
@@ -177,6 +177,10 @@ private:
 
 	mutable bool mHaveDecodedData;
 	mutable BmString mDecodedData;
+	mutable int32 mDecodedLength;
+							// decoded length of non-text parts, determined 
+							// without materializing the decoded data (-1 if
+							// not yet known)
 	int32 mStartInRawText;
 	int32 mBodyLength;
 	
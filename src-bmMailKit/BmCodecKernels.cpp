@@ -0,0 +1,560 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+
+#include <ctype.h>
+#include <string.h>
+
+#include "BmCodecKernels.h"
+
+// the vectorized kernels require a compiler that supports the x86-intrinsics
+// on a per-function basis (via the target-attribute), such that the rest of
+// Beam can still be compiled for plain x86:
+#if defined(__GNUC__) \
+	&& (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)) \
+	&& (defined(__i386__) || defined(__x86_64__))
+#	define BM_X86_KERNELS 1
+#	include <immintrin.h>
+#endif
+
+/*------------------------------------------------------------------------------*\
+	BmCodecTables
+		-	lookup-tables used by the plain kernels (and for the tails of the
+			vectorized ones)
+\*------------------------------------------------------------------------------*/
+static const char nBase64Chars[]
+	= "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+struct BmCodecTables {
+	BmCodecTables();
+
+	int8 base64Values[256];
+							// -1 for every char that isn't part of the alphabet
+	bool qpPlain[2][256];
+							// [isEncodedWord][c]
+	bool qpSafe[2][256];
+							// [safeForEBCDIC][c]
+};
+
+BmCodecTables::BmCodecTables() {
+	memset( base64Values, -1, sizeof(base64Values));
+	for( int i=0; i<64; ++i)
+		base64Values[(unsigned char)nBase64Chars[i]] = i;
+	for( int c=0; c<256; ++c) {
+		// the qp-decoder copies everything except carriage-returns, spaces,
+		// equal-signs and (in encoded-words) underscores:
+		qpPlain[0][c] = c!='\r' && c!=' ' && c!='=';
+		qpPlain[1][c] = qpPlain[0][c] && c!='_';
+		// the qp-encoder copies all alphanumeric chars and a set of safe ones
+		// (which is smaller if the result should survive EBCDIC):
+		bool alnum = c < 128 && isalnum( c);
+		qpSafe[0][c] = alnum
+			|| (c && strchr( "%&/()?+*,.;:<>-_!\"#$@[]\\^'{|}~", c) != NULL);
+		qpSafe[1][c] = alnum
+			|| (c && strchr( "%&/()?+*,.;:<>-_", c) != NULL);
+	}
+}
+
+static BmCodecTables nTables;
+
+/********************************************************************************\
+	plain kernels
+\********************************************************************************/
+
+/*------------------------------------------------------------------------------*\
+	Base64DecodePlain()
+		-	decodes one group of four chars per iteration
+\*------------------------------------------------------------------------------*/
+static uint32 Base64DecodePlain( const unsigned char* src, uint32 srcLen,
+											char* dest) {
+	const int8* values = nTables.base64Values;
+	const unsigned char* s = src;
+	const unsigned char* end = src + (srcLen & ~3UL);
+	for( ; s < end; s += 4, dest += 3) {
+		int32 a = values[s[0]];
+		int32 b = values[s[1]];
+		int32 c = values[s[2]];
+		int32 d = values[s[3]];
+		if ((a | b | c | d) < 0)
+			break;
+		uint32 concat = (a << 18) | (b << 12) | (c << 6) | d;
+		dest[0] = char(concat >> 16);
+		dest[1] = char(concat >> 8);
+		dest[2] = char(concat);
+	}
+	return s-src;
+}
+
+/*------------------------------------------------------------------------------*\
+	Base64EncodePlain()
+		-	encodes one group of three bytes per iteration
+\*------------------------------------------------------------------------------*/
+static void Base64EncodePlain( const unsigned char* src, uint32 srcLen,
+										 char* dest) {
+	const unsigned char* end = src + srcLen;
+	for( ; src < end; src += 3, dest += 4) {
+		uint32 concat = (src[0] << 16) | (src[1] << 8) | src[2];
+		dest[0] = nBase64Chars[(concat >> 18) & 63];
+		dest[1] = nBase64Chars[(concat >> 12) & 63];
+		dest[2] = nBase64Chars[(concat >> 6) & 63];
+		dest[3] = nBase64Chars[concat & 63];
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	QpRun()
+		-	returns the length of the run of chars that are marked in the given
+			table
+\*------------------------------------------------------------------------------*/
+static inline uint32 QpRun( const unsigned char* src, uint32 srcLen,
+									 const bool* table) {
+	uint32 i = 0;
+	while( i < srcLen && table[src[i]])
+		++i;
+	return i;
+}
+
+static uint32 QpPlainRunPlain( const unsigned char* src, uint32 srcLen,
+										 bool isEncodedWord) {
+	return QpRun( src, srcLen, nTables.qpPlain[isEncodedWord ? 1 : 0]);
+}
+
+static uint32 QpSafeRunPlain( const unsigned char* src, uint32 srcLen,
+										bool safeForEBCDIC) {
+	return QpRun( src, srcLen, nTables.qpSafe[safeForEBCDIC ? 1 : 0]);
+}
+
+#ifdef BM_X86_KERNELS
+
+/********************************************************************************\
+	SSE2/SSSE3 kernels
+\********************************************************************************/
+
+/*------------------------------------------------------------------------------*\
+	QpPlainRunSse2()
+		-	checks 16 chars at a time for any that needs special treatment
+\*------------------------------------------------------------------------------*/
+__attribute__((target("sse2")))
+static uint32 QpPlainRunSse2( const unsigned char* src, uint32 srcLen,
+										bool isEncodedWord) {
+	const __m128i cr = _mm_set1_epi8( '\r');
+	const __m128i space = _mm_set1_epi8( ' ');
+	const __m128i equal = _mm_set1_epi8( '=');
+	const __m128i underscore = _mm_set1_epi8( isEncodedWord ? '_' : '\r');
+	uint32 i = 0;
+	for( ; i+16 <= srcLen; i += 16) {
+		__m128i chars = _mm_loadu_si128( (const __m128i*)(src+i));
+		__m128i special
+			= _mm_or_si128(
+				_mm_or_si128( _mm_cmpeq_epi8( chars, cr),
+								  _mm_cmpeq_epi8( chars, space)),
+				_mm_or_si128( _mm_cmpeq_epi8( chars, equal),
+								  _mm_cmpeq_epi8( chars, underscore))
+			);
+		int mask = _mm_movemask_epi8( special);
+		if (mask)
+			return i + __builtin_ctz( mask);
+	}
+	return i + QpPlainRunPlain( src+i, srcLen-i, isEncodedWord);
+}
+
+/*------------------------------------------------------------------------------*\
+	QpSafeRunSse2()
+		-	checks 16 chars at a time for any that need to be encoded, i.e.
+			anything outside of '!'..'~' plus '=' and '`'
+		-	the smaller EBCDIC-safe set is handled by the plain kernel
+\*------------------------------------------------------------------------------*/
+__attribute__((target("sse2")))
+static uint32 QpSafeRunSse2( const unsigned char* src, uint32 srcLen,
+									  bool safeForEBCDIC) {
+	if (safeForEBCDIC)
+		return QpSafeRunPlain( src, srcLen, safeForEBCDIC);
+	const __m128i lowest = _mm_set1_epi8( '!');
+	const __m128i del = _mm_set1_epi8( 0x7F);
+	const __m128i equal = _mm_set1_epi8( '=');
+	const __m128i backtick = _mm_set1_epi8( '`');
+	uint32 i = 0;
+	for( ; i+16 <= srcLen; i += 16) {
+		__m128i chars = _mm_loadu_si128( (const __m128i*)(src+i));
+		// signed compare, so all chars >= 0x80 are caught here, too:
+		__m128i unsafe
+			= _mm_or_si128(
+				_mm_or_si128( _mm_cmpgt_epi8( lowest, chars),
+								  _mm_cmpeq_epi8( chars, del)),
+				_mm_or_si128( _mm_cmpeq_epi8( chars, equal),
+								  _mm_cmpeq_epi8( chars, backtick))
+			);
+		int mask = _mm_movemask_epi8( unsafe);
+		if (mask)
+			return i + __builtin_ctz( mask);
+	}
+	return i + QpSafeRunPlain( src+i, srcLen-i, safeForEBCDIC);
+}
+
+/*------------------------------------------------------------------------------*\
+	Base64DecodeSsse3()
+		-	decodes 16 chars into 12 bytes at a time (the char-classification
+			and the translation to 6-bit values are done via nibble-lookups)
+		-	stops at the first block that contains any char outside of the
+			alphabet and leaves that block to the plain kernel
+\*------------------------------------------------------------------------------*/
+__attribute__((target("ssse3")))
+static uint32 Base64DecodeSsse3( const unsigned char* src, uint32 srcLen,
+											char* dest) {
+	const __m128i lutLo = _mm_setr_epi8(
+		0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+		0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A
+	);
+	const __m128i lutHi = _mm_setr_epi8(
+		0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+		0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10
+	);
+	const __m128i lutRoll = _mm_setr_epi8(
+		0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0
+	);
+	const __m128i mask2F = _mm_set1_epi8( 0x2F);
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i packPairs = _mm_set1_epi32( 0x01400140);
+	const __m128i packQuads = _mm_set1_epi32( 0x00011000);
+	const __m128i packBytes = _mm_setr_epi8(
+		2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1
+	);
+	uint32 i = 0;
+	char* d = dest;
+	// each block writes 16 bytes (of which 12 are valid), so we stop early
+	// enough to stay within the 3/4 of srcLen the caller has provided:
+	for( ; i+32 <= srcLen; i += 16, d += 12) {
+		__m128i chars = _mm_loadu_si128( (const __m128i*)(src+i));
+		__m128i hiNibbles
+			= _mm_and_si128( _mm_srli_epi32( chars, 4), mask2F);
+		__m128i loNibbles = _mm_and_si128( chars, mask2F);
+		__m128i hi = _mm_shuffle_epi8( lutHi, hiNibbles);
+		__m128i lo = _mm_shuffle_epi8( lutLo, loNibbles);
+		if (_mm_movemask_epi8(
+			_mm_cmpeq_epi8( _mm_and_si128( lo, hi), zero)
+		) != 0xFFFF)
+			break;
+		__m128i roll = _mm_shuffle_epi8(
+			lutRoll,
+			_mm_add_epi8( _mm_cmpeq_epi8( chars, mask2F), hiNibbles)
+		);
+		__m128i values = _mm_add_epi8( chars, roll);
+		__m128i merged
+			= _mm_madd_epi16( _mm_maddubs_epi16( values, packPairs), packQuads);
+		_mm_storeu_si128( (__m128i*)d, _mm_shuffle_epi8( merged, packBytes));
+	}
+	return i + Base64DecodePlain( src+i, srcLen-i, d);
+}
+
+/*------------------------------------------------------------------------------*\
+	Base64Values()
+		-	spreads the 24 bits of each group of three bytes across the lower
+			six bits of four bytes
+\*------------------------------------------------------------------------------*/
+__attribute__((target("ssse3")))
+static inline __m128i Base64Values( __m128i bytes) {
+	bytes = _mm_shuffle_epi8( bytes, _mm_set_epi8(
+		10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1
+	));
+	__m128i t0 = _mm_and_si128( bytes, _mm_set1_epi32( 0x0FC0FC00));
+	__m128i t1 = _mm_mulhi_epu16( t0, _mm_set1_epi32( 0x04000040));
+	__m128i t2 = _mm_and_si128( bytes, _mm_set1_epi32( 0x003F03F0));
+	__m128i t3 = _mm_mullo_epi16( t2, _mm_set1_epi32( 0x01000010));
+	return _mm_or_si128( t1, t3);
+}
+
+/*------------------------------------------------------------------------------*\
+	Base64Chars()
+		-	translates 6-bit values into base64-chars by adding an offset that
+			depends on the range the value falls into
+\*------------------------------------------------------------------------------*/
+__attribute__((target("ssse3")))
+static inline __m128i Base64Chars( __m128i values) {
+	const __m128i offsets = _mm_setr_epi8(
+		'a'-26, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52,
+		'0'-52, '0'-52, '0'-52, '+'-62, '/'-63, 'A', 0, 0
+	);
+	// 0..51 -> 0, 52..61 -> 1..10, 62 -> 11, 63 -> 12:
+	__m128i index = _mm_subs_epu8( values, _mm_set1_epi8( 51));
+	// 0..25 -> 13:
+	__m128i upper = _mm_cmpgt_epi8( _mm_set1_epi8( 26), values);
+	index = _mm_or_si128( index, _mm_and_si128( upper, _mm_set1_epi8( 13)));
+	return _mm_add_epi8( values, _mm_shuffle_epi8( offsets, index));
+}
+
+/*------------------------------------------------------------------------------*\
+	Base64EncodeSsse3()
+		-	encodes 12 bytes into 16 chars at a time
+\*------------------------------------------------------------------------------*/
+__attribute__((target("ssse3")))
+static void Base64EncodeSsse3( const unsigned char* src, uint32 srcLen,
+										 char* dest) {
+	uint32 i = 0;
+	// each block reads 16 bytes (of which 12 are used):
+	for( ; i+16 <= srcLen; i += 12, dest += 16) {
+		__m128i bytes = _mm_loadu_si128( (const __m128i*)(src+i));
+		_mm_storeu_si128( (__m128i*)dest, Base64Chars( Base64Values( bytes)));
+	}
+	Base64EncodePlain( src+i, srcLen-i, dest);
+}
+
+/********************************************************************************\
+	AVX2 kernels
+\********************************************************************************/
+
+/*------------------------------------------------------------------------------*\
+	QpPlainRunAvx2()
+		-	checks 32 chars at a time for any that needs special treatment
+\*------------------------------------------------------------------------------*/
+__attribute__((target("avx2")))
+static uint32 QpPlainRunAvx2( const unsigned char* src, uint32 srcLen,
+										bool isEncodedWord) {
+	const __m256i cr = _mm256_set1_epi8( '\r');
+	const __m256i space = _mm256_set1_epi8( ' ');
+	const __m256i equal = _mm256_set1_epi8( '=');
+	const __m256i underscore = _mm256_set1_epi8( isEncodedWord ? '_' : '\r');
+	uint32 i = 0;
+	for( ; i+32 <= srcLen; i += 32) {
+		__m256i chars = _mm256_loadu_si256( (const __m256i*)(src+i));
+		__m256i special
+			= _mm256_or_si256(
+				_mm256_or_si256( _mm256_cmpeq_epi8( chars, cr),
+									  _mm256_cmpeq_epi8( chars, space)),
+				_mm256_or_si256( _mm256_cmpeq_epi8( chars, equal),
+									  _mm256_cmpeq_epi8( chars, underscore))
+			);
+		uint32 mask = (uint32)_mm256_movemask_epi8( special);
+		if (mask)
+			return i + __builtin_ctz( mask);
+	}
+	return i + QpPlainRunSse2( src+i, srcLen-i, isEncodedWord);
+}
+
+/*------------------------------------------------------------------------------*\
+	QpSafeRunAvx2()
+		-	checks 32 chars at a time for any that need to be encoded
+\*------------------------------------------------------------------------------*/
+__attribute__((target("avx2")))
+static uint32 QpSafeRunAvx2( const unsigned char* src, uint32 srcLen,
+									  bool safeForEBCDIC) {
+	if (safeForEBCDIC)
+		return QpSafeRunPlain( src, srcLen, safeForEBCDIC);
+	const __m256i lowest = _mm256_set1_epi8( '!');
+	const __m256i del = _mm256_set1_epi8( 0x7F);
+	const __m256i equal = _mm256_set1_epi8( '=');
+	const __m256i backtick = _mm256_set1_epi8( '`');
+	uint32 i = 0;
+	for( ; i+32 <= srcLen; i += 32) {
+		__m256i chars = _mm256_loadu_si256( (const __m256i*)(src+i));
+		__m256i unsafe
+			= _mm256_or_si256(
+				_mm256_or_si256( _mm256_cmpgt_epi8( lowest, chars),
+									  _mm256_cmpeq_epi8( chars, del)),
+				_mm256_or_si256( _mm256_cmpeq_epi8( chars, equal),
+									  _mm256_cmpeq_epi8( chars, backtick))
+			);
+		uint32 mask = (uint32)_mm256_movemask_epi8( unsafe);
+		if (mask)
+			return i + __builtin_ctz( mask);
+	}
+	return i + QpSafeRunSse2( src+i, srcLen-i, safeForEBCDIC);
+}
+
+/*------------------------------------------------------------------------------*\
+	Base64DecodeAvx2()
+		-	decodes 32 chars into 24 bytes at a time (same method as the SSSE3
+			kernel, just twice as wide)
+\*------------------------------------------------------------------------------*/
+__attribute__((target("avx2")))
+static uint32 Base64DecodeAvx2( const unsigned char* src, uint32 srcLen,
+										  char* dest) {
+	const __m256i lutLo = _mm256_setr_epi8(
+		0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+		0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A,
+		0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+		0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A
+	);
+	const __m256i lutHi = _mm256_setr_epi8(
+		0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+		0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+		0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+		0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10
+	);
+	const __m256i lutRoll = _mm256_setr_epi8(
+		0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+		0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0
+	);
+	const __m256i mask2F = _mm256_set1_epi8( 0x2F);
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i packPairs = _mm256_set1_epi32( 0x01400140);
+	const __m256i packQuads = _mm256_set1_epi32( 0x00011000);
+	const __m256i packBytes = _mm256_setr_epi8(
+		2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+		2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1
+	);
+	const __m256i packLanes = _mm256_setr_epi32( 0, 1, 2, 4, 5, 6, 7, 7);
+	uint32 i = 0;
+	char* d = dest;
+	// each block writes 32 bytes (of which 24 are valid), so we stop early
+	// enough to stay within the 3/4 of srcLen the caller has provided:
+	for( ; i+48 <= srcLen; i += 32, d += 24) {
+		__m256i chars = _mm256_loadu_si256( (const __m256i*)(src+i));
+		__m256i hiNibbles
+			= _mm256_and_si256( _mm256_srli_epi32( chars, 4), mask2F);
+		__m256i loNibbles = _mm256_and_si256( chars, mask2F);
+		__m256i hi = _mm256_shuffle_epi8( lutHi, hiNibbles);
+		__m256i lo = _mm256_shuffle_epi8( lutLo, loNibbles);
+		if ((uint32)_mm256_movemask_epi8(
+			_mm256_cmpeq_epi8( _mm256_and_si256( lo, hi), zero)
+		) != 0xFFFFFFFFUL)
+			break;
+		__m256i roll = _mm256_shuffle_epi8(
+			lutRoll,
+			_mm256_add_epi8( _mm256_cmpeq_epi8( chars, mask2F), hiNibbles)
+		);
+		__m256i values = _mm256_add_epi8( chars, roll);
+		__m256i merged = _mm256_madd_epi16(
+			_mm256_maddubs_epi16( values, packPairs), packQuads
+		);
+		merged = _mm256_shuffle_epi8( merged, packBytes);
+		_mm256_storeu_si256( (__m256i*)d,
+									_mm256_permutevar8x32_epi32( merged, packLanes));
+	}
+	return i + Base64DecodeSsse3( src+i, srcLen-i, d);
+}
+
+/*------------------------------------------------------------------------------*\
+	Base64EncodeAvx2()
+		-	encodes 24 bytes into 32 chars at a time (each 128-bit lane gets
+			12 bytes, which are then handled like in the SSSE3 kernel)
+\*------------------------------------------------------------------------------*/
+__attribute__((target("avx2")))
+static void Base64EncodeAvx2( const unsigned char* src, uint32 srcLen,
+										char* dest) {
+	const __m256i spread = _mm256_setr_epi8(
+		1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+		1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10
+	);
+	const __m256i offsets = _mm256_setr_epi8(
+		'a'-26, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52,
+		'0'-52, '0'-52, '0'-52, '+'-62, '/'-63, 'A', 0, 0,
+		'a'-26, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52,
+		'0'-52, '0'-52, '0'-52, '+'-62, '/'-63, 'A', 0, 0
+	);
+	uint32 i = 0;
+	// each block reads 28 bytes (of which 24 are used):
+	for( ; i+28 <= srcLen; i += 24, dest += 32) {
+		__m256i bytes = _mm256_inserti128_si256(
+			_mm256_castsi128_si256( _mm_loadu_si128( (const __m128i*)(src+i))),
+			_mm_loadu_si128( (const __m128i*)(src+i+12)),
+			1
+		);
+		bytes = _mm256_shuffle_epi8( bytes, spread);
+		__m256i t0 = _mm256_and_si256( bytes, _mm256_set1_epi32( 0x0FC0FC00));
+		__m256i t1 = _mm256_mulhi_epu16( t0, _mm256_set1_epi32( 0x04000040));
+		__m256i t2 = _mm256_and_si256( bytes, _mm256_set1_epi32( 0x003F03F0));
+		__m256i t3 = _mm256_mullo_epi16( t2, _mm256_set1_epi32( 0x01000010));
+		__m256i values = _mm256_or_si256( t1, t3);
+		__m256i index = _mm256_subs_epu8( values, _mm256_set1_epi8( 51));
+		__m256i upper = _mm256_cmpgt_epi8( _mm256_set1_epi8( 26), values);
+		index = _mm256_or_si256(
+			index, _mm256_and_si256( upper, _mm256_set1_epi8( 13))
+		);
+		_mm256_storeu_si256(
+			(__m256i*)dest,
+			_mm256_add_epi8( values, _mm256_shuffle_epi8( offsets, index))
+		);
+	}
+	Base64EncodeSsse3( src+i, srcLen-i, dest);
+}
+
+#endif	// BM_X86_KERNELS
+
+/********************************************************************************\
+	BmCodecKernels
+\********************************************************************************/
+
+static const BmCodecKernels nVariants[] = {
+#ifdef BM_X86_KERNELS
+	{ "avx2", Base64DecodeAvx2, Base64EncodeAvx2,
+	  QpPlainRunAvx2, QpSafeRunAvx2 },
+	{ "ssse3", Base64DecodeSsse3, Base64EncodeSsse3,
+	  QpPlainRunSse2, QpSafeRunSse2 },
+	{ "sse2", Base64DecodePlain, Base64EncodePlain,
+	  QpPlainRunSse2, QpSafeRunSse2 },
+#endif
+	{ "plain", Base64DecodePlain, Base64EncodePlain,
+	  QpPlainRunPlain, QpSafeRunPlain }
+};
+static const int32 nVariantCount = sizeof(nVariants)/sizeof(BmCodecKernels);
+
+static const BmCodecKernels* nActiveKernels = NULL;
+
+/*------------------------------------------------------------------------------*\
+	IsSupported( kernels)
+		-	checks whether the CPU supports the instructions used by the given
+			kernels
+\*------------------------------------------------------------------------------*/
+static bool IsSupported( const BmCodecKernels* kernels) {
+#ifdef BM_X86_KERNELS
+	__builtin_cpu_init();
+	if (!strcmp( kernels->name, "avx2"))
+		return __builtin_cpu_supports( "avx2");
+	if (!strcmp( kernels->name, "ssse3"))
+		return __builtin_cpu_supports( "ssse3");
+	if (!strcmp( kernels->name, "sse2"))
+		return __builtin_cpu_supports( "sse2");
+#endif
+	return true;
+}
+
+/*------------------------------------------------------------------------------*\
+	CountVariants()
+		-	returns the number of kernel-variants supported by this CPU
+\*------------------------------------------------------------------------------*/
+int32 BmCodecKernels::CountVariants() {
+	int32 count = 0;
+	for( int32 i=0; i<nVariantCount; ++i) {
+		if (IsSupported( &nVariants[i]))
+			count++;
+	}
+	return count;
+}
+
+/*------------------------------------------------------------------------------*\
+	VariantAt( index)
+		-	returns the kernel-variant at the given index, the variants are
+			ordered from fastest to slowest
+\*------------------------------------------------------------------------------*/
+const BmCodecKernels* BmCodecKernels::VariantAt( int32 index) {
+	for( int32 i=0; i<nVariantCount; ++i) {
+		if (IsSupported( &nVariants[i]) && index-- == 0)
+			return &nVariants[i];
+	}
+	return NULL;
+}
+
+/*------------------------------------------------------------------------------*\
+	Active()
+		-	returns the kernels in use, which (unless changed via Activate())
+			is the fastest variant supported by this CPU
+\*------------------------------------------------------------------------------*/
+const BmCodecKernels& BmCodecKernels::Active() {
+	if (!nActiveKernels)
+		nActiveKernels = VariantAt( 0);
+	return *nActiveKernels;
+}
+
+/*------------------------------------------------------------------------------*\
+	Activate( kernels)
+		-	makes the codecs use the given kernels (NULL selects the fastest
+			variant again)
+		-	meant for tests and benchmarks
+\*------------------------------------------------------------------------------*/
+void BmCodecKernels::Activate( const BmCodecKernels* kernels) {
+	nActiveKernels = kernels ? kernels : VariantAt( 0);
+}
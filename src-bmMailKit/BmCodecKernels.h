@@ -0,0 +1,55 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+
+#ifndef _BmCodecKernels_h
+#define _BmCodecKernels_h
+
+#include "BmMailKit.h"
+
+#include <SupportDefs.h>
+
+/*------------------------------------------------------------------------------*\
+	BmCodecKernels
+		-	the inner loops of the base64- and quoted-printable-codecs, each of
+			which works on a plain block of data (without any state)
+		-	there is a plain C variant of these kernels and (on x86) variants
+			using SSE2, SSSE3 and AVX2, the best one supported by the CPU is
+			selected at runtime
+\*------------------------------------------------------------------------------*/
+struct IMPEXPBMMAILKIT BmCodecKernels {
+	// decodes as many complete groups of four base64-chars as possible,
+	// stopping at the first group that contains a char which isn't part of
+	// the base64-alphabet (like a linebreak or padding). Returns the number
+	// of chars consumed, dest must have room for 3/4 of srcLen bytes:
+	typedef uint32 (*Base64DecodeFunc)( const unsigned char* src, uint32 srcLen,
+													char* dest);
+	// encodes srcLen (a multiple of three) bytes into 4/3 of srcLen
+	// base64-chars (without any linebreaks):
+	typedef void (*Base64EncodeFunc)( const unsigned char* src, uint32 srcLen,
+												 char* dest);
+	// returns the length of the run of chars at the start of src that can be
+	// passed on as-is (the flag selects a variant of the char-set):
+	typedef uint32 (*QpRunFunc)( const unsigned char* src, uint32 srcLen,
+										  bool flag);
+
+	const char* name;
+	Base64DecodeFunc Base64Decode;
+	Base64EncodeFunc Base64Encode;
+	QpRunFunc QpPlainRun;
+							// chars the qp-decoder copies (flag: is encoded-word)
+	QpRunFunc QpSafeRun;
+							// chars the qp-encoder copies (flag: safe for EBCDIC)
+
+	static const BmCodecKernels& Active();
+	static void Activate( const BmCodecKernels* kernels);
+	static int32 CountVariants();
+	static const BmCodecKernels* VariantAt( int32 index);
+							// only returns variants supported by the CPU
+};
+
+#endif
@@ -7,6 +7,7 @@
  */
 
 #include <Application.h>
+#include <Autolock.h>
 #include <DataIO.h>
 #include <Messenger.h>
 #include <File.h>
@@ -784,15 +785,77 @@ bool BmListModelItem
 	return true;
 }
 
+// #pragma mark - BmListModelBatch
+
+/*------------------------------------------------------------------------------*\
+	BmListModelBatch( modelName)
+		-	c'tor
+\*------------------------------------------------------------------------------*/
+BmListModelBatch::BmListModelBatch( const BmString& modelName)
+	:	mLocker( "beam_batch")
+	,	mIsClosed( false)
+	,	mAddedCount( 0)
+	,	mRemovedCount( 0)
+	,	mModelName( modelName)
+{
+}
+
+/*------------------------------------------------------------------------------*\
+	AddChange( type, item, flags, oldKey)
+		-	adds the given change to this batch
+		-	successive updates of an item are merged into one (by combining
+			their flags), unless the item has been renamed
+		-	returns false if the batch has already been closed (in which case
+			the change has not been added)
+\*------------------------------------------------------------------------------*/
+bool BmListModelBatch::AddChange( BmChangeType type, BmListModelItem* item, 
+											 BmUpdFlags flags, const BmString& oldKey) {
+	BAutolock lock( mLocker);
+	if (mIsClosed)
+		return false;
+	if (type == ITEM_UPDATED && !oldKey.Length()) {
+		BmUpdateIndexMap::iterator iter = mUpdateIndexMap.find( item);
+		if (iter != mUpdateIndexMap.end()) {
+			mChanges[iter->second].flags |= flags;
+			return true;
+		}
+		mUpdateIndexMap[item] = mChanges.size();
+	} else
+		mUpdateIndexMap.erase( item);
+	if (type == ITEM_ADDED)
+		mAddedCount++;
+	else if (type == ITEM_REMOVED)
+		mRemovedCount++;
+	BmChange change;
+	change.type = type;
+	change.item = item;
+	change.flags = flags;
+	change.oldKey = oldKey;
+	mChanges.push_back( change);
+	return true;
+}
+
+/*------------------------------------------------------------------------------*\
+	Close()
+		-	closes this batch, such that no more changes will be added
+		-	this is done by the first controller handling the batch, afterwards
+			the batch can be read without any locking
+\*------------------------------------------------------------------------------*/
+void BmListModelBatch::Close() {
+	BAutolock lock( mLocker);
+	mIsClosed = true;
+	mUpdateIndexMap.clear();
+}
+
+
+
 // #pragma mark - BmListModel
 
 const char* const BmListModel::MSG_VERSION = "bm:version";
 
 const char* const BmListModel::MSG_ITEMKEY 		=	"bm:ikey";
 const char* const BmListModel::MSG_PARENTKEY 	= 	"bm:pkey";
-const char* const BmListModel::MSG_MODELITEM 	= 	"bm:item";
-const char* const BmListModel::MSG_UPD_FLAGS		= 	"bm:updflags";
-const char* const BmListModel::MSG_OLD_KEY		= 	"bm:oldkey";
+const char* const BmListModel::MSG_BATCH 			= 	"bm:batch";
 
 /*------------------------------------------------------------------------------*\
 	ListModel()
@@ -1152,58 +1215,105 @@ void BmListModel::SetFilter(BmListModelItemFilter* filter) {
 }
 
 /*------------------------------------------------------------------------------*\
-	TellModelItemAdded( item)
-		-	tells all controllers that the given item has been added to hierarchy
+	AddController( controller)
+		-	extends base-method by closing the open batch, such that the new
+			controller will receive all further changes
 \*------------------------------------------------------------------------------*/
-void BmListModel::TellModelItemAdded( BmListModelItem* item) {
-	if (Frozen() || !item->IsValid())
-		return;
+void BmListModel::AddController( BmController* controller) {
 	BmAutolockCheckGlobal lock( mModelLocker);
 	if (!lock.IsLocked())
 		BM_THROW_RUNTIME( 
-			ModelNameNC() << ":TellModelItemRemoved(): Unable to get lock"
+			ModelNameNC() << ":AddController(): Unable to get lock"
 		);
-	if (HasControllers()) {
-		BMessage msg( BM_LISTMODEL_ADD);
-		msg.AddPointer( MSG_MODELITEM, static_cast<void*>(item));
-		// since each message will reference the item, we add
-		// as many refs to the item as we have controllers:
-		for( uint32 i=0; i<mControllerSet.size(); ++i)
-			item->AddRef();
-		BM_LOG2( BM_LogModelController, 
-					BmString("ListModel <") << ModelName() 
-						<< "> tells about added item " << item->Key());
-		TellControllers( &msg);
+	CloseOpenBatch();
+	inherited::AddController( controller);
+}
+
+/*------------------------------------------------------------------------------*\
+	RemoveController( controller)
+		-	extends base-method by closing the open batch, since the removed
+			controller may have been the only one that would have handled it
+\*------------------------------------------------------------------------------*/
+void BmListModel::RemoveController( BmController* controller) {
+	BmAutolockCheckGlobal lock( mModelLocker);
+	if (!lock.IsLocked())
+		BM_THROW_RUNTIME( 
+			ModelNameNC() << ":RemoveController(): Unable to get lock"
+		);
+	CloseOpenBatch();
+	inherited::RemoveController( controller);
+}
+
+/*------------------------------------------------------------------------------*\
+	CloseOpenBatch()
+		-	closes the currently open batch (if any), the next change will open
+			(and send) a new one
+\*------------------------------------------------------------------------------*/
+void BmListModel::CloseOpenBatch() {
+	if (mOpenBatch) {
+		mOpenBatch->Close();
+		mOpenBatch = NULL;
 	}
 }
 
 /*------------------------------------------------------------------------------*\
-	TellModelItemRemoved( item)
-		-	tells all controllers that the given item has been removed from 
-			hierarchy
-		-	the controllers are requested to acknowledge the removal, so that
-			they won't access the removed item (stale pointer)
+	TellModelItemChange( type, item, flags, oldKey)
+		-	adds the given change to the open batch
+		-	if there is no open batch (or if it has been closed by a controller 
+			in the meantime), a new batch is opened and sent to all controllers
 \*------------------------------------------------------------------------------*/
-void BmListModel::TellModelItemRemoved( BmListModelItem* item) {
+void BmListModel::TellModelItemChange( BmListModelBatch::BmChangeType type, 
+													BmListModelItem* item, 
+													BmUpdFlags flags,
+													const BmString& oldKey) {
 	if (Frozen() || !item->IsValid())
 		return;
 	BmAutolockCheckGlobal lock( mModelLocker);
 	if (!lock.IsLocked())
 		BM_THROW_RUNTIME( 
-			ModelNameNC() << ":TellModelItemRemoved(): Unable to get lock"
+			ModelNameNC() << ":TellModelItemChange(): Unable to get lock"
 		);
-	if (HasControllers()) {
-		BMessage msg( BM_LISTMODEL_REMOVE);
-		msg.AddPointer( MSG_MODELITEM, static_cast<void*>(item));
-		// since each message will reference the item, we add
-		// as many refs to the item as we have controllers:
-		for( uint32 i=0; i<mControllerSet.size(); ++i)
-			item->AddRef();
-		BM_LOG2( BM_LogModelController, 
-					BmString("ListModel <") << ModelName() 
-						<< "> tells about removed item " << item->Key());
-		TellControllers( &msg, true);
-	}
+	if (!HasControllers())
+		return;
+	if (mOpenBatch && mOpenBatch->AddChange( type, item, flags, oldKey))
+		return;
+	mOpenBatch = new BmListModelBatch( ModelName());
+	mOpenBatch->AddChange( type, item, flags, oldKey);
+	BMessage msg( BM_LISTMODEL_BATCH);
+	msg.AddPointer( MSG_BATCH, static_cast<void*>(mOpenBatch.Get()));
+	// since each message will reference the batch, we add
+	// as many refs to the batch as we have controllers:
+	for( uint32 i=0; i<mControllerSet.size(); ++i)
+		mOpenBatch->AddRef();
+	BM_LOG2( BM_LogModelController, 
+				BmString("ListModel <") << ModelName() 
+					<< "> sends a new batch of changes");
+	TellControllers( &msg);
+}
+
+/*------------------------------------------------------------------------------*\
+	TellModelItemAdded( item)
+		-	tells all controllers that the given item has been added to hierarchy
+\*------------------------------------------------------------------------------*/
+void BmListModel::TellModelItemAdded( BmListModelItem* item) {
+	BM_LOG2( BM_LogModelController, 
+				BmString("ListModel <") << ModelName() 
+					<< "> tells about added item " << item->Key());
+	TellModelItemChange( BmListModelBatch::ITEM_ADDED, item);
+}
+
+/*------------------------------------------------------------------------------*\
+	TellModelItemRemoved( item)
+		-	tells all controllers that the given item has been removed from 
+			hierarchy
+		-	the batch keeps a reference to the item, so the controllers won't 
+			access a stale pointer even if they handle the removal later
+\*------------------------------------------------------------------------------*/
+void BmListModel::TellModelItemRemoved( BmListModelItem* item) {
+	BM_LOG2( BM_LogModelController, 
+				BmString("ListModel <") << ModelName() 
+					<< "> tells about removed item " << item->Key());
+	TellModelItemChange( BmListModelBatch::ITEM_REMOVED, item);
 }
 
 /*------------------------------------------------------------------------------*\
@@ -1215,29 +1325,10 @@ void BmListModel::TellModelItemRemoved( BmListModelItem* item) {
 void BmListModel::TellModelItemUpdated( BmListModelItem* item, 
 													 BmUpdFlags flags,
 													 const BmString oldKey) {
-	if (Frozen() || !item->IsValid())
-		return;
-	BmAutolockCheckGlobal lock( mModelLocker);
-	if (!lock.IsLocked())
-		BM_THROW_RUNTIME( 
-			ModelNameNC() << ":TellModelItemUpdated(): Unable to get lock"
-		);
-	if (HasControllers()) {
-		BMessage msg( BM_LISTMODEL_UPDATE);
-		msg.AddPointer( MSG_MODELITEM, static_cast<void*>(item));
-		// since each message will reference the item, we add
-		// as many refs to the item as we have controllers:
-		for( uint32 i=0; i<mControllerSet.size(); ++i)
-			item->AddRef();
-		msg.AddInt32( MSG_UPD_FLAGS, flags);
-		if (oldKey.Length())
-			// item has been renamed, we include old key:
-			msg.AddString( MSG_OLD_KEY, oldKey.String());
-		BM_LOG2( BM_LogModelController, 
-					BmString("ListModel <") << ModelName() 
-						<< "> tells about updated item " << item->Key());
-		TellControllers( &msg);
-	}
+	BM_LOG2( BM_LogModelController, 
+				BmString("ListModel <") << ModelName() 
+					<< "> tells about updated item " << item->Key());
+	TellModelItemChange( BmListModelBatch::ITEM_UPDATED, item, flags, oldKey);
 }
 
 /*------------------------------------------------------------------------------*\
@@ -39,13 +39,10 @@ enum {
 							// the job has finished or was stopped
 	BM_JOB_UPDATE_STATE		=	'bmdb',
 							// the job wants to update (one of) its state(s)
-	BM_LISTMODEL_ADD			=	'bmdc',
-							// the listmodel has added a new item
-	BM_LISTMODEL_REMOVE		=	'bmdd',
-							// the listmodel has removed an item
-	BM_LISTMODEL_UPDATE		=	'bmde'
-							// the listmodel indicates a state-change of one of 
-							// its items
+	BM_LISTMODEL_BATCH		=	'bmdc'
+							// the listmodel has added, removed and/or updated
+							// items (the changes are contained in a 
+							// BmListModelBatch)
 };
 
 /*------------------------------------------------------------------------------*\
@@ -290,6 +287,64 @@ public:
  	virtual const BmString& Label() const = 0;
 };
 
+/*------------------------------------------------------------------------------*\
+	BmListModelBatch
+		-	collects changes of a listmodel's items, which are sent to the 
+			controllers within a single message
+		-	the batch is sent as soon as it has been opened, but keeps collecting
+			changes until the first controller fetches it from its message-queue,
+			so the busier a controller is, the more changes each batch contains
+\*------------------------------------------------------------------------------*/
+class IMPEXPBMMAILKIT BmListModelBatch : public BmRefObj {
+	typedef map< const BmListModelItem*, uint32> BmUpdateIndexMap;
+
+public:
+	enum BmChangeType {
+		ITEM_ADDED = 1,
+		ITEM_REMOVED,
+		ITEM_UPDATED
+	};
+	struct BmChange {
+		BmChangeType type;
+		BmRef<BmListModelItem> item;
+		BmUpdFlags flags;
+		BmString oldKey;
+	};
+	typedef vector< BmChange> BmChangeVect;
+
+	// c'tors & d'tor:
+	BmListModelBatch( const BmString& modelName);
+
+	// native methods:
+	bool AddChange( BmChangeType type, BmListModelItem* item, 
+						 BmUpdFlags flags=0, const BmString& oldKey="");
+	void Close();
+
+	// getters:
+	inline const BmChangeVect& Changes() const	
+													{ return mChanges; }
+	inline uint32 AddedCount() const		{ return mAddedCount; }
+	inline uint32 RemovedCount() const	{ return mRemovedCount; }
+
+	// overrides of BmRefObj
+	const BmString& RefName() const		{ return mModelName; }
+
+private:
+	BLocker mLocker;
+	bool mIsClosed;
+	BmChangeVect mChanges;
+	BmUpdateIndexMap mUpdateIndexMap;
+	uint32 mAddedCount;
+	uint32 mRemovedCount;
+	BmString mModelName;
+
+	// Hide copy-constructor and assignment:
+	BmListModelBatch( const BmListModelBatch&);
+#ifndef __POWERPC__
+	BmListModelBatch& operator=( const BmListModelBatch&);
+#endif
+};
+
 /*------------------------------------------------------------------------------*\
 	BmListModel
 		-	an interface that extends BmJobModel with the ability to
@@ -360,15 +415,17 @@ public:
 
 	bool ForEachItem(BmListModelItem::Collector& collector) const;
 
+	// overrides of datamodel base:
+	void AddController( BmController* controller);
+	void RemoveController( BmController* controller);
+
 	// overrides of Archivable base:
 	status_t Archive( BMessage* archive, bool deep) const;
 
 	//	message component definitions for status-msgs:
 	static const char* const MSG_ITEMKEY;
 	static const char* const MSG_PARENTKEY;
-	static const char* const MSG_MODELITEM;
-	static const char* const MSG_UPD_FLAGS;
-	static const char* const MSG_OLD_KEY;
+	static const char* const MSG_BATCH;
 
 	// getters:
 	BmModelItemMap::const_iterator begin() const;
@@ -388,6 +445,12 @@ public:
 protected:
 	static const char* const MSG_VERSION;
 
+	// native methods:
+	void TellModelItemChange( BmListModelBatch::BmChangeType type, 
+									  BmListModelItem* item, BmUpdFlags flags=0,
+									  const BmString& oldKey="");
+	void CloseOpenBatch();
+
 	// overrides of job-model base:
 	void TellJobIsDone( bool completed=true);
 	bool StartJob();
@@ -399,6 +462,7 @@ protected:
 	BmStoredActionManager mStoredActionManager;
 	uint32 mLogTerrain;
 	BmListModelItemFilter* mFilter;
+	BmRef<BmListModelBatch> mOpenBatch;
 
 private:
 	// Hide copy-constructor and assignment:
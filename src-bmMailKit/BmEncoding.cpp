@@ -13,6 +13,7 @@
 using namespace regexx;
 
 #include "BmBasics.h"
+#include "BmCodecKernels.h"
 #include "BmEncoding.h"
 using namespace BmEncoding;
 #include "BmLogHandler.h"
@@ -122,6 +123,153 @@ void BmEncoding::GetPreferredCharsets( BmCharsetVect& charsetVect,
 	charsetVect.push_back(nativeCharset);
 }
 
+/*------------------------------------------------------------------------------*\
+	BmCharsetStats
+		-	byte-statistics of a text, gathered in a single scan and then used
+			to judge all candidate charsets
+\*------------------------------------------------------------------------------*/
+struct BmCharsetStats {
+	BmCharsetStats( const BmString& text);
+	int32 Score( const BmString& charset) const;
+
+	uint32 highBytes;
+							// bytes >= 0x80
+	uint32 c1Bytes;
+							// bytes 0x80-0x9F (control chars in iso-8859-*)
+	uint32 cp1252Holes;
+							// bytes that are undefined in windows-1252
+	uint32 escapes;
+							// ISO-2022 escape sequences
+	uint32 utf8Sequences;
+	uint32 utf8Errors;
+};
+
+/*------------------------------------------------------------------------------*\
+	BmCharsetStats()
+		-	
+\*------------------------------------------------------------------------------*/
+BmCharsetStats::BmCharsetStats( const BmString& text)
+	:	highBytes( 0)
+	,	c1Bytes( 0)
+	,	cp1252Holes( 0)
+	,	escapes( 0)
+	,	utf8Sequences( 0)
+	,	utf8Errors( 0)
+{
+	const unsigned char* p = (const unsigned char*)text.String();
+	const unsigned char* end = p + text.Length();
+	int32 utf8Pending = 0;
+	while (p < end) {
+		unsigned char c = *p++;
+		if (c < 0x80) {
+			if (utf8Pending) {
+				utf8Errors++;
+				utf8Pending = 0;
+			}
+			if (c == 0x1B && p < end && (*p == '$' || *p == '(' || *p == ')'))
+				escapes++;
+			continue;
+		}
+		highBytes++;
+		if (c < 0xA0) {
+			c1Bytes++;
+			if (c == 0x81 || c == 0x8D || c == 0x8F || c == 0x90 || c == 0x9D)
+				cp1252Holes++;
+		}
+		if (utf8Pending) {
+			if ((c & 0xC0) == 0x80) {
+				if (--utf8Pending == 0)
+					utf8Sequences++;
+				continue;
+			}
+			utf8Errors++;
+			utf8Pending = 0;
+		}
+		if (c >= 0xC2 && c <= 0xDF)
+			utf8Pending = 1;
+		else if ((c & 0xF0) == 0xE0)
+			utf8Pending = 2;
+		else if (c >= 0xF0 && c <= 0xF4)
+			utf8Pending = 3;
+		else
+			utf8Errors++;
+	}
+	if (utf8Pending)
+		utf8Errors++;
+}
+
+/*------------------------------------------------------------------------------*\
+	Score()
+		-	returns how likely the text is in the given charset (0-100)
+\*------------------------------------------------------------------------------*/
+int32 BmCharsetStats::Score( const BmString& charset) const {
+	if (!highBytes && !escapes)
+		return 100;							// plain ascii fits every charset
+	bool looksLikeUtf8 = utf8Sequences && !utf8Errors;
+	if (!charset.ICompare( "utf-8") || !charset.ICompare( "utf8"))
+		return looksLikeUtf8 ? 100 : (utf8Errors ? 0 : 50);
+	if (!charset.ICompare( "iso-2022", 8))
+		return highBytes ? 0 : 95;
+	if (!charset.ICompare( "us-ascii") || !charset.ICompare( "ascii"))
+		return highBytes ? 0 : 50;
+	int32 score;
+	if (!charset.ICompare( "iso-8859", 8) || !charset.ICompare( "latin", 5))
+		// C1 control chars are very rare in real text:
+		score = 80 - 80 * c1Bytes / highBytes;
+	else if (!charset.ICompare( "windows-1252") || !charset.ICompare( "cp1252"))
+		score = cp1252Holes ? 0 : 75;
+	else if (!charset.ICompare( "windows-125", 11) 
+	|| !charset.ICompare( "cp125", 5))
+		score = 75;
+	else
+		return 50;							// can't tell, conversion will show
+	// a non-trivial text that happens to be valid UTF-8 is most probably
+	// just that:
+	if (looksLikeUtf8 && score > 40)
+		score = 40;
+	return score;
+}
+
+/*------------------------------------------------------------------------------*\
+	RankCharsets()
+		-	judges every given candidate charset by looking at the given 
+			(transfer-decoded) text and returns the candidates ordered by 
+			their confidence (ties are kept in the given order).
+		-	the first candidate is the charset declared by the mail, which 
+			stays first no matter how it scores: the statistics only know
+			about a few (mostly latin) charsets and can't prove a declared 
+			charset wrong, a failing conversion can. So the ranking just 
+			decides the order in which the fallbacks are tried.
+		-	this is cheap compared to trying the conversion with each 
+			charset, so only the best candidate(s) need to be converted
+\*------------------------------------------------------------------------------*/
+void BmEncoding::RankCharsets( const BmString& text, 
+										 const BmCharsetVect& candidates,
+										 BmCharsetScoreVect& ranking)
+{
+	ranking.clear();
+	BmCharsetStats stats( text);
+	for( uint32 i=0; i<candidates.size(); ++i) {
+		bool isDuplicate = false;
+		for( uint32 r=0; !isDuplicate && r<ranking.size(); ++r)
+			isDuplicate = !ranking[r].charset.ICompare( candidates[i]);
+		if (isDuplicate)
+			continue;
+		BmCharsetScore score( candidates[i], stats.Score( candidates[i]));
+		BM_LOG3( BM_LogMailParse, 
+					BmString("charset ") << score.charset << " scores " 
+						<< score.confidence);
+		// insert behind the declared charset and all candidates with the 
+		// same or a higher score:
+		BmCharsetScoreVect::iterator pos = ranking.begin();
+		if (pos != ranking.end())
+			++pos;
+		while (pos != ranking.end() && pos->confidence >= score.confidence)
+			++pos;
+		ranking.insert( pos, score);
+	}
+}
+
 /*------------------------------------------------------------------------------*\
 	()
 		-	
@@ -936,7 +1084,21 @@ void BmQuotedPrintableDecoder::Filter( const char* srcBuf, uint32& srcLen,
 
 	char c,c1,c2;
 	const BmString qpChars("abcdef0123456789ABCDEF");
+	const BmCodecKernels& kernels = BmCodecKernels::Active();
+	bool isEncodedWord = IsTagSet(nTagIsEncodedWord);
 	for( ; src<srcEnd && dest<destEnd; ++src) {
+		if (!mSoftbreakPending && !mSpacesThatMayNeedRemoval) {
+			// copy the run of chars that need no decoding in one go:
+			uint32 len = kernels.QpPlainRun( 
+				(const unsigned char*)src, std::min( (uint32)(srcEnd-src), (uint32)(destEnd-dest)),
+				isEncodedWord
+			);
+			memcpy( dest, src, len);
+			src += len;
+			dest += len;
+			if (src>=srcEnd || dest>=destEnd)
+				break;
+		}
 		c = *src;
 		if (c == '\r') {
 			// skip over carriage-returns:
@@ -996,7 +1158,7 @@ void BmQuotedPrintableDecoder::Filter( const char* srcBuf, uint32& srcLen,
 					// characters missing at end (broken encoding), we just copy:
 					*dest++ = c;
 				}
-			} else if (IsTagSet(nTagIsEncodedWord) && c == '_') {
+			} else if (isEncodedWord && c == '_') {
 				// in encoded-words, underlines are really spaces 
 				// (a real underline is encoded):
 				*dest++ = ' ';
@@ -1119,8 +1281,9 @@ void BmQuotedPrintableEncoder::Filter( const char* srcBuf, uint32& srcLen,
 	BM_LOG3( BM_LogMailParse, 
 				BmString("starting to encode quoted-printable of ") 
 						<< srcLen << " bytes");
+	bool safeForEBCDIC = ThePrefs->GetBool( "MakeQPSafeForEBCDIC", false);
 	const char* safeChars = 
-				(ThePrefs->GetBool( "MakeQPSafeForEBCDIC", false)
+				(safeForEBCDIC
 					? "%&/()?+*,.;:<>-_"
 					: "%&/()?+*,.;:<>-_!\"#$@[]\\^'{|}~");
 							// in bodies, the underscore is safe, i.e. it need
@@ -1130,9 +1293,30 @@ void BmQuotedPrintableEncoder::Filter( const char* srcBuf, uint32& srcLen,
 	char* dest = destBuf;
 	char* destEnd = destBuf+destLen;
 	char c;
+	const BmCodecKernels& kernels = BmCodecKernels::Active();
 	for( ; src<srcEnd && dest<destEnd; ++src) {
 		if (!OutputLineIfNeeded( dest, destEnd))
 			break;
+		int32 queuedLen = mQueuedChars.Length();
+		if (!mNeedFlush && !mSpacesThatMayNeedEncoding 
+		&& queuedLen <= BM_MAX_HEADER_LINE_LEN) {
+			// queue the run of safe chars in one go, but only as many as
+			// would have been queued before the line needs to be folded:
+			uint32 len = kernels.QpSafeRun( 
+				(const unsigned char*)src, 
+				std::min( (uint32)(srcEnd-src), 
+						  (uint32)(BM_MAX_HEADER_LINE_LEN-queuedLen+1)),
+				safeForEBCDIC
+			);
+			if (len) {
+				mQueuedChars.Put( src, len);
+				// same state as if the chars had been queued one by one:
+				mLastAddedLen = len>1 ? 1 : mCurrAddedLen;
+				mCurrAddedLen = 1;
+				src += len-1;
+				continue;
+			}
+		}
 		c = *src;
 		if (c=='\r')
 			continue;							// ignore '\r'
@@ -1639,7 +1823,18 @@ void BmBase64Decoder::Filter( const char* srcBuf, uint32& srcLen,
 	char* dest = destBuf;
 	char* destEnd = destBuf+destLen;
 		
+	const BmCodecKernels& kernels = BmCodecKernels::Active();
 	while( src<srcEnd && dest<=destEnd-3) {
+		if (!mIndex) {
+			// decode all complete groups up to the next linebreak in one go:
+			uint32 len = kernels.Base64Decode( 
+				src, std::min( (uint32)(srcEnd-src), (uint32)(destEnd-dest)/3*4), dest
+			);
+			src += len;
+			dest += len/4*3;
+			if (src>=srcEnd || dest>destEnd-3)
+				break;
+		}
 		if ((value = nBase64Alphabet[*src++])<0) {
 			if (value == -2) {
 				// padding-char ('=') encountered, we flush converted chars...
@@ -1735,7 +1930,31 @@ void BmBase64Encoder::Filter( const char* srcBuf, uint32& srcLen,
 	char* dest = destBuf;
 	char* destEnd = destBuf+destLen;
 		
+	const BmCodecKernels& kernels = BmCodecKernels::Active();
+	bool onSingleLine = IsTagSet(nTagOnSingleLine);
 	while( src<srcEnd && dest<=destEnd-6) {
+		if (!mIndex) {
+			// encode all complete groups up to the end of the line in one go:
+			uint32 groups 
+				= std::min( (uint32)(srcEnd-src)/3, (uint32)(destEnd-dest-2)/4);
+			if (!onSingleLine) {
+				int32 lineGroups 
+					= (BM_MAX_HEADER_LINE_LEN-mCurrLineLen+3)/4;
+				groups = std::min( groups, (uint32)std::max( lineGroups, (int32)1));
+			}
+			if (groups) {
+				kernels.Base64Encode( src, groups*3, dest);
+				src += groups*3;
+				dest += groups*4;
+				mCurrLineLen += groups*4;
+				if (!onSingleLine && mCurrLineLen >= BM_MAX_HEADER_LINE_LEN) {
+					*dest++ = '\r';
+					*dest++ = '\n';
+					mCurrLineLen = 0;
+				}
+				continue;
+			}
+		}
 		mConcat |= (*src++ << ((2-mIndex)*8));
 		if (++mIndex == 3) {
 			*dest++ = nBase64Alphabet[(mConcat >> 18) & 63];
@@ -1744,7 +1963,7 @@ void BmBase64Encoder::Filter( const char* srcBuf, uint32& srcLen,
 			*dest++ = nBase64Alphabet[mConcat & 63];
 			mConcat = mIndex = 0;
 			mCurrLineLen += 4;
-			if (!IsTagSet(nTagOnSingleLine) 
+			if (!onSingleLine 
 			&& mCurrLineLen >= BM_MAX_HEADER_LINE_LEN) {
 				*dest++ = '\r';
 				*dest++ = '\n';
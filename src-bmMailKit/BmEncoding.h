@@ -43,6 +43,19 @@ namespace BmEncoding {
 										const BmString& nativeCharset,
 										bool outbound = false);
 
+	struct IMPEXPBMMAILKIT BmCharsetScore {
+		BmCharsetScore( const BmString& cs, int32 conf)
+			:	charset( cs)
+			,	confidence( conf)					{}
+		BmString charset;
+		int32 confidence;
+							// 0 (impossible) ... 100 (certain)
+	};
+	typedef vector< BmCharsetScore> BmCharsetScoreVect;
+	IMPEXPBMMAILKIT 
+	void RankCharsets( const BmString& text, const BmCharsetVect& candidates,
+							 BmCharsetScoreVect& ranking);
+
 	IMPEXPBMMAILKIT 
 	void InitCharsetMap();
 
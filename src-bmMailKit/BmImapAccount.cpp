@@ -7,6 +7,7 @@
  */
 
 #include <Application.h>
+#include <Autolock.h>
 #include <ByteOrder.h>
 #include <File.h>
 #include <Message.h>
@@ -20,6 +21,7 @@ using namespace regexx;
 #include "BmLogHandler.h"
 #include "BmMailFolder.h"
 #include "BmImapAccount.h"
+#include "BmPrefs.h"
 #include "BmRosterBase.h"
 #include "BmUtil.h"
 
@@ -29,13 +31,70 @@ using namespace regexx;
 
 const char* const BmImapAccount::AUTH_LOGIN = "LOGIN";
 
+const char* const BmImapAccount::MSG_SYNC_UIDVALIDITY = 	"bm:syncuidvalidity";
+const char* const BmImapAccount::MSG_SYNC_UIDNEXT = 		"bm:syncuidnext";
+const char* const BmImapAccount::MSG_SYNC_MSGCOUNT = 		"bm:syncmsgcount";
+const char* const BmImapAccount::MSG_SYNC_MODSEQ = 		"bm:syncmodseq";
+
 const char* const BmImapAccount::nType = "IMAP";
+
+enum {
+	BM_SET_SYNC_STATE	= 'bmex'
+		// the state of the inbox after a complete check
+};
+
+/*------------------------------------------------------------------------------*\
+	ReadSyncState( msg, state)
+		-	reads the sync-state from the given archive or action (all fields
+			are optional, missing ones are set to 0)
+\*------------------------------------------------------------------------------*/
+static void ReadSyncState( const BMessage* msg, 
+									BmImapAccount::SyncState& state)
+{
+	int32 val;
+	int64 modSeq;
+	state.uidValidity 
+		= msg->FindInt32( BmImapAccount::MSG_SYNC_UIDVALIDITY, &val) == B_OK
+			? val : 0;
+	state.uidNext 
+		= msg->FindInt32( BmImapAccount::MSG_SYNC_UIDNEXT, &val) == B_OK
+			? val : 0;
+	state.msgCount 
+		= msg->FindInt32( BmImapAccount::MSG_SYNC_MSGCOUNT, &val) == B_OK
+			? val : 0;
+	state.highestModSeq 
+		= msg->FindInt64( BmImapAccount::MSG_SYNC_MODSEQ, &modSeq) == B_OK
+			? modSeq : 0;
+}
+
+/*------------------------------------------------------------------------------*\
+	WriteSyncState( msg, state)
+		-	adds the given sync-state to the given archive or action
+		-	returns the status of the first field that couldn't be added
+\*------------------------------------------------------------------------------*/
+static status_t WriteSyncState( BMessage* msg, 
+										  const BmImapAccount::SyncState& state)
+{
+	status_t ret = msg->AddInt32( BmImapAccount::MSG_SYNC_UIDVALIDITY, 
+											state.uidValidity);
+	if (ret == B_OK)
+		ret = msg->AddInt32( BmImapAccount::MSG_SYNC_UIDNEXT, state.uidNext);
+	if (ret == B_OK)
+		ret = msg->AddInt32( BmImapAccount::MSG_SYNC_MSGCOUNT, state.msgCount);
+	if (ret == B_OK)
+		ret = msg->AddInt64( BmImapAccount::MSG_SYNC_MODSEQ, 
+									state.highestModSeq);
+	return ret;
+}
+
 /*------------------------------------------------------------------------------*\
 	BmImapAccount()
 		-	c'tor
 \*------------------------------------------------------------------------------*/
 BmImapAccount::BmImapAccount( const char* name, BmRecvAccountList* model) 
 	:	inherited( name, model)
+	,	mIdleNotSupported( false)
+	,	mIdleLocker( "beam_imap_idle")
 {
 	mPortNr = 143;
 	mPortNrString = "143";
@@ -49,7 +108,10 @@ BmImapAccount::BmImapAccount( const char* name, BmRecvAccountList* model)
 \*------------------------------------------------------------------------------*/
 BmImapAccount::BmImapAccount( BMessage* archive, BmRecvAccountList* model) 
 	:	inherited( archive, model)
+	,	mIdleNotSupported( false)
+	,	mIdleLocker( "beam_imap_idle")
 {
+	ReadSyncState( archive, mInboxSyncState);
 	SetupIntervalRunner();
 }
 
@@ -72,3 +134,127 @@ void BmImapAccount::GetSupportedAuthTypes(vector<BmString>& outList) const
 	outList.push_back(AUTH_LOGIN);
 	outList.push_back(AUTH_NONE);
 }
+
+/*------------------------------------------------------------------------------*\
+	Archive( archive, deep)
+		-	extends base-method with the sync-state of the inbox
+\*------------------------------------------------------------------------------*/
+status_t BmImapAccount::Archive( BMessage* archive, bool deep) const {
+	status_t ret = inherited::Archive( archive, deep);
+	if (ret == B_OK)
+		ret = WriteSyncState( archive, mInboxSyncState);
+	return ret;
+}
+
+/*------------------------------------------------------------------------------*\
+	ExecuteAction( action)
+		-	extends base-method with the setting of the sync-state
+\*------------------------------------------------------------------------------*/
+void BmImapAccount::ExecuteAction( BMessage* action) {
+	if (action->what == BM_SET_SYNC_STATE)
+		ReadSyncState( action, mInboxSyncState);
+	else
+		inherited::ExecuteAction( action);
+}
+
+/*------------------------------------------------------------------------------*\
+	InboxSyncState( state)
+		-	sets the sync-state of the inbox
+		-	the state is appended to the settings-file right away (just like
+			the downloaded UIDs), such that it always matches these UIDs
+\*------------------------------------------------------------------------------*/
+void BmImapAccount::InboxSyncState( const SyncState& state) {
+	mInboxSyncState = state;
+	BMessage action( BM_SET_SYNC_STATE);
+	action.AddString( BmListModel::MSG_ITEMKEY, Key().String());
+	if (WriteSyncState( &action, state) == B_OK)
+		TheRecvAccountList->StoreAction(&action);
+}
+
+/*------------------------------------------------------------------------------*\
+	WantsIdleSession()
+		-	returns whether or not this account should be watched by an
+			IDLE-session instead of being checked at regular intervals
+		-	this requires that the account is meant to be checked regularly
+			and that the password is known (since the session runs without
+			any user-interaction)
+\*------------------------------------------------------------------------------*/
+bool BmImapAccount::WantsIdleSession() const {
+	return mCheckInterval > 0 && mPwdStoredOnDisk && !mIdleNotSupported
+			 && ThePrefs->GetBool( "ImapUseIdle", true);
+}
+
+/*------------------------------------------------------------------------------*\
+	SetupIntervalRunner()
+		-	extends base-method: if this account wants an IDLE-session, the app
+			is asked to start one (unless it is already running) and no 
+			interval-runner is needed
+\*------------------------------------------------------------------------------*/
+void BmImapAccount::SetupIntervalRunner() {
+	if (!WantsIdleSession()) {
+		inherited::SetupIntervalRunner();
+		return;
+	}
+	delete mIntervalRunner;
+	mIntervalRunner = NULL;
+	BAutolock lock( mIdleLocker);
+	if (mIdleJob && mIdleJob->IsJobRunning())
+		return;
+	BM_LOG( BM_LogRecv, 
+			  BmString("RecvAccount ") << Type() << ":" << Key() 
+			  	<< " asks for an IDLE-session");
+	BMessage msg( BM_IMAP_IDLE);
+	msg.AddString( BmRecvAccountList::MSG_ITEMKEY, Key().String());
+	be_app_messenger.SendMessage( &msg);
+}
+
+/*------------------------------------------------------------------------------*\
+	AdoptIdleJob( job)
+		-	registers the given job as the one keeping the IDLE-session
+		-	returns false if another IDLE-session is already running (in which
+			case the given job should not be started)
+\*------------------------------------------------------------------------------*/
+bool BmImapAccount::AdoptIdleJob( BmJobModel* job) {
+	BAutolock lock( mIdleLocker);
+	if (mIdleJob && mIdleJob->IsJobRunning())
+		return false;
+	mIdleJob = job;
+	return true;
+}
+
+/*------------------------------------------------------------------------------*\
+	IdleJobHasEnded( job)
+		-	called by the IDLE-session when it ends (for whatever reason),
+			we fall back to checking at regular intervals
+\*------------------------------------------------------------------------------*/
+void BmImapAccount::IdleJobHasEnded( BmJobModel* job) {
+	{
+		BAutolock lock( mIdleLocker);
+		if (mIdleJob != job)
+			return;
+		mIdleJob = NULL;
+	}
+	if (!BeamRoster->IsQuitting())
+		inherited::SetupIntervalRunner();
+}
+
+/*------------------------------------------------------------------------------*\
+	IdleNotSupported()
+		-	called by the IDLE-session if the server doesn't support IDLE,
+			such that we don't ask for another one
+\*------------------------------------------------------------------------------*/
+void BmImapAccount::IdleNotSupported() {
+	mIdleNotSupported = true;
+}
+
+/*------------------------------------------------------------------------------*\
+	TriggerAutoCheck()
+		-	asks the app to check this account (just like the interval-runner
+			does)
+\*------------------------------------------------------------------------------*/
+void BmImapAccount::TriggerAutoCheck() {
+	BMessage msg( JobType());
+	msg.AddString( BmRecvAccountList::MSG_ITEMKEY, Key().String());
+	msg.AddBool( BmRecvAccountList::MSG_AUTOCHECK, true);
+	be_app_messenger.SendMessage( &msg);
+}
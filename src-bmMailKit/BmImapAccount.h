@@ -9,14 +9,18 @@
 #ifndef _BmImapAccount_h
 #define _BmImapAccount_h
 
+#include <Locker.h>
+
 #include "BmMailKit.h"
 
 #include "BmRecvAccount.h"
 
 enum {
-	BM_JOBWIN_IMAP	= 'bmei'
+	BM_JOBWIN_IMAP	= 'bmei',
 		// sent to JobMetaController (or app) in order to 
 		// start pop-connection
+	BM_IMAP_IDLE	= 'bmeI'
+		// sent to app in order to start the IDLE-session of an account
 };
 
 /*------------------------------------------------------------------------------*\
@@ -32,6 +36,36 @@ public:
 	BmImapAccount( BMessage* archive, BmRecvAccountList* model);
 	virtual ~BmImapAccount();
 	
+	// state of the inbox at the end of the last complete check, which 
+	// allows to ask the server for the changes since then only
+	// (uidValidity is 0 if the state is unknown):
+	struct SyncState {
+		uint32 uidValidity;
+		uint32 uidNext;
+		uint32 msgCount;
+		uint64 highestModSeq;
+							// 0 if the server doesn't support CONDSTORE
+		SyncState()
+			:	uidValidity( 0)
+			,	uidNext( 0)
+			,	msgCount( 0)
+			,	highestModSeq( 0)					{ }
+	};
+
+	// getters:
+	inline const SyncState& InboxSyncState() const
+													{ return mInboxSyncState; }
+	bool WantsIdleSession() const;
+
+	// setters:
+	void InboxSyncState( const SyncState& state);
+
+	// native methods for the IDLE-session:
+	bool AdoptIdleJob( BmJobModel* job);
+	void IdleJobHasEnded( BmJobModel* job);
+	void IdleNotSupported();
+	void TriggerAutoCheck();
+
 	// overrides of BmRecvAccount base:
 	virtual const char* Type() const		{ return nType; }
 	virtual int32 JobType() const			{ return BM_JOBWIN_IMAP; }
@@ -42,10 +76,30 @@ public:
 
 	virtual void GetSupportedAuthTypes(vector<BmString>& outList) const;
 
+	status_t Archive( BMessage* archive, bool deep = true) const;
+	void ExecuteAction( BMessage* action);
+
 	static const char* const AUTH_LOGIN;
 
+	// archivable components:
+	static const char* const MSG_SYNC_UIDVALIDITY;
+	static const char* const MSG_SYNC_UIDNEXT;
+	static const char* const MSG_SYNC_MSGCOUNT;
+	static const char* const MSG_SYNC_MODSEQ;
+
 	static const char* const nType;
+protected:
+	// overrides of BmRecvAccount base:
+	void SetupIntervalRunner();
+
 private:
+	SyncState mInboxSyncState;
+	BmRef<BmJobModel> mIdleJob;
+							// the job keeping the IDLE-session (if any)
+	bool mIdleNotSupported;
+							// the server has turned out not to know IDLE
+	BLocker mIdleLocker;
+
 	BmImapAccount();					// hide default constructor
 	// Hide copy-constructor and assignment:
 	BmImapAccount( const BmImapAccount&);
@@ -26,6 +26,7 @@ using namespace regexx;
 #include "BmMailFolder.h"
 #include "BmMailFolderList.h"
 #include "BmMailHeader.h"
+#include "BmMailIndex.h"
 #include "BmMailRef.h"
 #include "BmPrefs.h"
 #include "BmSignature.h"
@@ -59,6 +60,7 @@ const char* BM_MAIL_ATTR_IDENTITY		= "MAIL:beam/identity";
 const char* BM_MAIL_ATTR_MARGIN	 		= "MAIL:beam/margin";
 const char* BM_MAIL_ATTR_WHEN_CREATED = "MAIL:beam/when-created";
 const char* BM_MAIL_ATTR_IMAP_UID	 	= "MAIL:beam/imap-uid";
+const char* BM_MAIL_ATTR_SPAM_FEATURES = "MAIL:beam/spam-features";
 
 const char* BM_FIELD_BCC 					= "Bcc";
 const char* BM_FIELD_CC 					= "Cc";
@@ -153,6 +155,8 @@ BmMail::BmMail( bool outbound)
 	,	mMailRef( NULL)
 	,	mHeader( NULL)
 	,	mBody( NULL)
+	,	mElidedBodyIsOverlapped( false)
+	,	mRawTextLength( 0)
 	,	mInitCheck( B_NO_INIT)
 	,	mOutbound( outbound)
 	,	mRightMargin( ThePrefs->GetInt( "MaxLineLen"))
@@ -187,6 +191,8 @@ BmMail::BmMail( const BmString &msgText, const BmString account)
 	:	inherited( "MailModel_dummy")
 	,	mHeader( NULL)
 	,	mBody( NULL)
+	,	mElidedBodyIsOverlapped( false)
+	,	mRawTextLength( 0)
 	,	mMailRef( NULL)
 	,	mInitCheck( B_NO_INIT)
 	,	mOutbound( false)
@@ -211,6 +217,8 @@ BmMail::BmMail( BmMailRef* ref)
 	:	inherited( BM_MAILKEY( ref))
 	,	mHeader( NULL)
 	,	mBody( NULL)
+	,	mElidedBodyIsOverlapped( false)
+	,	mRawTextLength( 0)
 	,	mMailRef( ref)
 	,	mInitCheck( B_NO_INIT)
 	,	mOutbound( false)
@@ -246,7 +254,17 @@ void BmMail::SetTo( const BmString &_text, const BmString account) {
 	text.ConvertLinebreaksToCRLF(&_text);
 	text.ReplaceAll( 0, 32);
 	BM_LOG2( BM_LogMailParse, "done (Converting Linebreaks to CRLF)");
+	ForgetElidedBodies();
+	AdoptNormalizedText( text, account);
+}
 
+/*------------------------------------------------------------------------------*\
+	AdoptNormalizedText( text, account)
+		-	initializes mail-object from the given text, which must already
+			use CRLF-linebreaks and must not contain any binary nulls
+		-	the text is adopted (i.e. the given string will be empty afterwards)
+\*------------------------------------------------------------------------------*/
+void BmMail::AdoptNormalizedText( BmString& text, const BmString account) {
 	// find end of header (and start of body):
 	int32 headerLen = text.FindFirst( "\r\n\r\n");
 							// STD11: empty-line seperates header from body
@@ -262,11 +280,8 @@ void BmMail::SetTo( const BmString &_text, const BmString account) {
 	BM_LOG2( BM_LogMailParse, "...done (Adopting mailtext)");
 	mAccountName = account;
 
-	BM_LOG2( BM_LogMailParse, "setting header-string...");
-	BmString header;
-	header.SetTo( mText, headerLen);
-	BM_LOG2( BM_LogMailParse, "...init header from header-string...");
-	mHeader = new BmMailHeader( header, this);
+	BM_LOG2( BM_LogMailParse, "init header from header-string...");
+	mHeader = new BmMailHeader( BmStringView( mText.String(), headerLen), this);
 	BM_LOG2( BM_LogMailParse, "...done (header)");
 
 	BM_LOG2( BM_LogMailParse, "init of body...");
@@ -276,6 +291,65 @@ void BmMail::SetTo( const BmString &_text, const BmString account) {
 
 	mInitCheck = B_OK;
 }
+
+/*------------------------------------------------------------------------------*\
+	ForgetElidedBodies()
+		-	drops the index of elided body-parts (and the mail-file they live
+			in), which is required whenever mText is replaced
+\*------------------------------------------------------------------------------*/
+void BmMail::ForgetElidedBodies() {
+	mElidedBodies.clear();
+	mMailFile.Unset();
+	mElidedBodyIsOverlapped = false;
+	mFullText.Truncate( 0, false);
+	mRawTextLength = 0;
+}
+
+/*------------------------------------------------------------------------------*\
+	FindElidedBody( startInText)
+		-	returns the index of the first elided body-part that starts at or
+			behind the given position of the skeleton
+\*------------------------------------------------------------------------------*/
+uint32 BmMail::FindElidedBody( int32 startInText) const {
+	uint32 lo = 0;
+	uint32 hi = mElidedBodies.size();
+	while( lo < hi) {
+		uint32 mid = (lo+hi)/2;
+		if (mElidedBodies[mid].startInText < startInText)
+			lo = mid+1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/*------------------------------------------------------------------------------*\
+	ElidedBodyAt( startInText)
+		-	returns the elided body-part that starts at the given position
+			of the skeleton (or NULL if there is none)
+\*------------------------------------------------------------------------------*/
+const BmElidedBody* BmMail::ElidedBodyAt( int32 startInText) const {
+	uint32 index = FindElidedBody( startInText);
+	if (index < mElidedBodies.size() 
+	&& mElidedBodies[index].startInText == startInText)
+		return &mElidedBodies[index];
+	return NULL;
+}
+
+/*------------------------------------------------------------------------------*\
+	ElidedBodiesMatchParts()
+		-	checks whether the parser has found each elided body-part exactly
+			as indexed (which may not be the case for a broken multipart)
+\*------------------------------------------------------------------------------*/
+bool BmMail::ElidedBodiesMatchParts() const {
+	if (mElidedBodyIsOverlapped)
+		return false;
+	for( uint32 i=0; i<mElidedBodies.size(); ++i) {
+		if (!mElidedBodies[i].isClaimed)
+			return false;
+	}
+	return true;
+}
 	
 // #pragma mark - Loading
 /*------------------------------------------------------------------------------*\
@@ -328,7 +402,6 @@ bool BmMail::StartJob() {
 		}
 		
 		// ...ok, mail-file found, we fetch the mail from it:
-		BmString mailText;
 		// read special attributes for mail-state...
 		mailFile.ReadAttr( BM_MAIL_ATTR_MARGIN, B_INT32_TYPE, 0, 
 								 &mRightMargin, sizeof(int32));
@@ -341,19 +414,27 @@ bool BmMail::StartJob() {
 			);
 		BM_LOG2( BM_LogMailParse, 
 					BmString("...should be reading ") << mailSize << " bytes");
-		char* buf = mailText.LockBuffer( int32(mailSize));
-		if (!buf)
-			throw BM_runtime_error( BmString("Not enough memory for mail from "
-														"file\n\t<") << eref.name << ">");
+		// the mail is read block by block and normalized (CRLF, no binary
+		// nulls) while being read. Since mails stored by Beam already are 
+		// in CRLF-format, the buffer usually doesn't need to grow at all.
+		// Large mails are only indexed: their big body-parts are left out
+		// and will be read from the file when they are needed:
+		bool lazy = mailSize > ThePrefs->GetInt( "LazyLoadThreshold", 
+															  256*1024);
+		BmStringOBuf mailText( lazy ? 65536 : int32(mailSize)+1, 1.2f);
+		BmNormalizingMailReader reader( mailText);
+		BmElidedBodyVect elidedBodies;
+		BmMailIndexer indexer( mailText, elidedBodies, 
+									  BmMailIndexer::nDefaultMaxInlineLength);
 		off_t realSize = 0;
 		const size_t blocksize = 65536;
-		for(  int32 offs=0; 
-				(skipChecks || ShouldContinue()) && offs < mailSize; ) {
-			char* pos = buf+offs;
+		vector<char> block( blocksize);
+		char* buf = &block[0];
+		while( (skipChecks || ShouldContinue()) && realSize < mailSize) {
 			ssize_t read = mailFile.Read( 
-				pos, 
-				mailSize-offs < blocksize 
-					? size_t(mailSize-offs)
+				buf, 
+				mailSize-realSize < blocksize 
+					? size_t(mailSize-realSize)
 					: blocksize
 			);
 			BM_LOG3( BM_LogMailParse, 
@@ -365,26 +446,45 @@ bool BmMail::StartJob() {
 													<< strerror(read));
 			if (!read)
 				break;
+			if (lazy)
+				indexer.Add( buf, read);
+			else
+				reader.Add( buf, read);
 			realSize += read;
-			offs += read;
 		}
 		if (!skipChecks && !ShouldContinue())
 			return false;
 		BM_LOG2( BM_LogMailParse, 
 					BmString("...real size is ") << realSize << " bytes");
-		if (realSize > mailSize)
-			throw BM_runtime_error( BmString("Real size is ") << realSize 
-							<< " bytes but expected size was only " << mailSize 
-							<< " bytes!?!");
-		buf[realSize] = '\0';
-		mailText.UnlockBuffer( int32(realSize));
-		// take care to remove all binary nulls:
-		mailText.ReplaceAll( 0, 32);
 		// we initialize the BmMail-internals from the plain text:
 		BM_LOG2( BM_LogMailParse, BmString("initializing BmMail from msgtext"));
 		mIdentityName = mMailRef->Identity();
 		mImapUID = mMailRef->ImapUID();
-		SetTo( mailText, mMailRef->Account());
+		ForgetElidedBodies();
+		if (lazy) {
+			indexer.Finish();
+			BM_LOG2( BM_LogMailParse, 
+						BmString("...") << elidedBodies.size() 
+							<< " body-parts have been elided");
+			if (!elidedBodies.empty()) {
+				mElidedBodies.swap( elidedBodies);
+				mMailFile = mailFile;
+				mRawTextLength = indexer.TextLength();
+			}
+		}
+		AdoptNormalizedText( mailText.TheString(), mMailRef->Account());
+		if (!mElidedBodies.empty() 
+		&& (indexer.IsAmbiguous() || !ElidedBodiesMatchParts())) {
+			// the body-parts of a broken multipart may not match the index,
+			// so we fall back to a complete load:
+			BM_LOG( BM_LogMailParse, 
+					  "body-parts don't match index, reloading complete mail");
+			RawText();
+			BmString text;
+			text.Adopt( mFullText);
+			ForgetElidedBodies();
+			AdoptNormalizedText( text, mMailRef->Account());
+		}
 		BM_LOG2( BM_LogMailParse, BmString("Done, mail is initialized"));
 	} catch (BM_error &e) {
 		BM_SHOWERR( e.what());
@@ -541,6 +641,9 @@ void BmMail::StoreIntoFile( BDirectory* destDir, BmString filename,
 		}
 	}
 
+	// a lazily loaded mail is put together before its file is replaced:
+	const BmString& text = RawText();
+
 	// we create/open the new mailfile (keeping a backup)...
 	BmBackedFile mailFile;
 	err = mailFile.SetTo( mEntry, "text/x-email", backupEntry);
@@ -557,8 +660,8 @@ void BmMail::StoreIntoFile( BDirectory* destDir, BmString filename,
 
 	// ...and finally write the raw mail into the file:
 	BM_LOG2( BM_LogMailParse, "storing mail-data...");
-	int32 len = mText.Length();
-	if ((res = mailFile.Write( mText.String(), len)) < len) {
+	int32 len = text.Length();
+	if ((res = mailFile.Write( text.String(), len)) < len) {
 		if (res < 0) {
 			BM_THROW_RUNTIME( BmString("Unable to write to mailfile <") 
 										<< filename << ">\n\n Result: " 
@@ -600,7 +703,7 @@ void BmMail::StoreAttributes( BNode& mailNode, const BmString& status,
 	}
 	//
 	int32 headerLength = HeaderLength();
-	int32 contentLength = MAX( 0, mText.Length()-headerLength);
+	int32 contentLength = MAX( 0, RawTextLength()-headerLength);
 	
 	mailNode.WriteAttr( BM_MAIL_ATTR_HEADER, B_INT32_TYPE, 0, 
 							  &headerLength, sizeof(int32));
@@ -900,6 +1003,7 @@ bool BmMail::ConstructRawText( const BmString& editedUtf8Text,
 	if (len && msgText.ByteAt( len-1) != '\n')
 		msgText << "\r\n";
 	mText.Adopt( msgText.TheString());
+	ForgetElidedBodies();
 	BM_LOG3( BM_LogMailParse, 
 				BmString("CONSTRUCTED MSG: \n-----START--------\n") << mText 
 					<< "\n-----END----------");
@@ -966,7 +1070,7 @@ void BmMail::SetNewHeader( const BmString& headerStr) {
 	uint32 len = newMsgText.Length();
 	if (!len || newMsgText[len-1] != '\n')
 		newMsgText << "\r\n";
-	newMsgText << mText.String() + HeaderLength();
+	newMsgText << RawText().String() + HeaderLength();
 	SetTo( newMsgText, mAccountName);
 	Store();
 	StartJobInThisThread();
@@ -1003,12 +1107,99 @@ const BmString& BmMail::HeaderText() const
 				: BM_DEFAULT_STRING; 
 }
 
+/*------------------------------------------------------------------------------*\
+	RawText()
+		-	returns the complete text of the mail
+		-	for a lazily loaded mail, the text is put together from the 
+			skeleton and the elided body-parts (only once), so this should be
+			avoided where the size or a single body-part would do
+\*------------------------------------------------------------------------------*/
+const BmString& BmMail::RawText() const
+{
+	if (mElidedBodies.empty())
+		return mText;
+	BmAutolockCheckGlobal lock( ModelLocker());
+	if (!lock.IsLocked())
+		BM_THROW_RUNTIME( "BmMail::RawText(): Unable to get lock");
+	if (!mFullText.Length()) {
+		BM_LOG2( BM_LogMailParse, "putting together complete mailtext...");
+		BmStringOBuf text( mRawTextLength+1, 1.2f);
+		int32 pos = 0;
+		for( uint32 i=0; i<mElidedBodies.size(); ++i) {
+			const BmElidedBody& body = mElidedBodies[i];
+			text.Write( mText.String()+pos, body.startInText-pos);
+			BmMailFileIBuf bodyText( &mMailFile, body.startInFile, 
+											 body.lengthInFile);
+			text.Write( &bodyText);
+			pos = body.startInText;
+		}
+		text.Write( mText.String()+pos, mText.Length()-pos);
+		mFullText.Adopt( text.TheString());
+		BM_LOG2( BM_LogMailParse, "...done (complete mailtext)");
+	}
+	return mFullText;
+}
+
+/*------------------------------------------------------------------------------*\
+	RawTextLength()
+		-	returns the length of the complete text of the mail, without
+			putting it together
+\*------------------------------------------------------------------------------*/
+int32 BmMail::RawTextLength() const
+{
+	return mElidedBodies.empty() 
+				? mText.Length() 
+				: mRawTextLength;
+}
+
+/*------------------------------------------------------------------------------*\
+	RawBodyLength( startInText, lengthInText)
+		-	returns the real length of the body-part found at the given range
+			of the skeleton (an elided body-part is empty in there)
+		-	is called by the parser for every body-part, which lets us check
+			that the index matches the body-parts (see ElidedBodiesMatchParts())
+\*------------------------------------------------------------------------------*/
+int32 BmMail::RawBodyLength( int32 startInText, int32 lengthInText)
+{
+	if (mElidedBodies.empty())
+		return lengthInText;
+	uint32 index = FindElidedBody( startInText);
+	if (index < mElidedBodies.size()) {
+		BmElidedBody& body = mElidedBodies[index];
+		if (!lengthInText && body.startInText == startInText) {
+			if (body.isClaimed)
+				mElidedBodyIsOverlapped = true;
+			body.isClaimed = true;
+			return body.length;
+		}
+		if (body.startInText < startInText+lengthInText)
+			mElidedBodyIsOverlapped = true;
+	}
+	return lengthInText;
+}
+
+/*------------------------------------------------------------------------------*\
+	RawBodyFor( startInText, lengthInText)
+		-	returns an input-buffer for the (still encoded) body-part found
+			at the given position
+		-	elided body-parts are read from the mail-file, piece by piece
+\*------------------------------------------------------------------------------*/
+BmMemIBufRef BmMail::RawBodyFor( int32 startInText, int32 lengthInText) const
+{
+	const BmElidedBody* body = ElidedBodyAt( startInText);
+	if (body)
+		return BmMemIBufRef( new BmMailFileIBuf( &mMailFile, body->startInFile, 
+															  body->lengthInFile));
+	return BmMemIBufRef( new BmStringIBuf( mText.String()+startInText, 
+														lengthInText));
+}
+
 // #pragma mark - Header Fields
 /*------------------------------------------------------------------------------*\
 	GetFieldVal()
 	-	
 \*------------------------------------------------------------------------------*/
-const BmString& BmMail::GetFieldVal( const BmString fieldName) {
+const BmString& BmMail::GetFieldVal( const BmString& fieldName) {
 	if (mHeader)
 		return mHeader->GetFieldVal( fieldName);
 	else
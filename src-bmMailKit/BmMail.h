@@ -22,6 +22,7 @@
 #include "BmBodyPartList.h"
 #include "BmDataModel.h"
 #include "BmMailFolder.h"
+#include "BmMailIndex.h"
 #include "BmMailRef.h"
 #include "BmUtil.h"
 
@@ -52,6 +53,7 @@ extern IMPEXPBMMAILKIT const char* BM_MAIL_ATTR_IDENTITY;
 extern IMPEXPBMMAILKIT const char* BM_MAIL_ATTR_MARGIN;
 extern IMPEXPBMMAILKIT const char* BM_MAIL_ATTR_WHEN_CREATED;
 extern IMPEXPBMMAILKIT const char* BM_MAIL_ATTR_IMAP_UID;
+extern IMPEXPBMMAILKIT const char* BM_MAIL_ATTR_SPAM_FEATURES;
 
 extern IMPEXPBMMAILKIT const char* BM_FIELD_BCC;
 extern IMPEXPBMMAILKIT const char* BM_FIELD_CC;
@@ -151,7 +153,7 @@ public:
 							  BEntry* backupEntry = NULL);
 	void ResyncFromDisk();
 	//
-	const BmString& GetFieldVal( const BmString fieldName);
+	const BmString& GetFieldVal( const BmString& fieldName);
 	bool HasAttachments() const;
 	bool HasComeFromList() const;
 	void DetermineRecvAddrAndIdentity( BmString& receivingAddr,
@@ -192,8 +194,12 @@ public:
 	BmMailHeader* Header() const;
 	int32 HeaderLength() const;
 	inline int32 RightMargin() const		{ return mRightMargin; }
-	inline const BmString& RawText() const		
+	const BmString& RawText() const;
+	int32 RawTextLength() const;
+	inline const BmString& SkeletonText() const		
 													{ return mText; }
+	int32 RawBodyLength( int32 startInText, int32 lengthInText);
+	BmMemIBufRef RawBodyFor( int32 startInText, int32 lengthInText) const;
 	const BmString& HeaderText() const;
 	inline const bool Outbound() const	{ return mOutbound; }
 	bool IsRedirect() const;
@@ -237,6 +243,11 @@ protected:
 
 private:
 	void SetDefaultHeaders( const BmString& defaultHeaders);
+	void AdoptNormalizedText( BmString& text, const BmString account);
+	void ForgetElidedBodies();
+	uint32 FindElidedBody( int32 startInText) const;
+	const BmElidedBody* ElidedBodyAt( int32 startInText) const;
+	bool ElidedBodiesMatchParts() const;
 	BmMail();
 	
 	const BmString& DefaultStatus() const;
@@ -246,7 +257,22 @@ private:
 	BmRef<BmBodyPartList> mBody;
 							// contains body-information (split into subparts)
 	BmString mText;
-							// text of complete message
+							// text of complete message (for a lazily loaded
+							// mail, this is just its skeleton, which lacks
+							// the elided body-parts)
+	BmElidedBodyVect mElidedBodies;
+							// index of the body-parts that have been left
+							// out of mText (sorted by their position)
+	mutable BFile mMailFile;
+							// the file the elided body-parts are read from
+	bool mElidedBodyIsOverlapped;
+							// the parser has found a body-part that includes
+							// an elided one (only happens with broken mails)
+	int32 mRawTextLength;
+							// length of the complete (normalized) message
+	mutable BmString mFullText;
+							// text of complete message, put together on
+							// demand from the skeleton and the elided parts
 	BmString mAccountName;
 							// name of account this message came from/is sent through
 	BmString mIdentityName;
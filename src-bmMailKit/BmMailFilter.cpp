@@ -9,6 +9,9 @@
 #include <memory>
 #include <stdio.h>
 
+#include <Autolock.h>
+#include <OS.h>
+
 #include "BmBasics.h"
 #include "BmLogHandler.h"
 #include "BmFilter.h"
@@ -16,6 +19,7 @@
 #include "BmMail.h"
 #include "BmMailFilter.h"
 #include "BmMailHeader.h"
+#include "BmPrefs.h"
 #include "BmRecvAccount.h"
 #include "BmSmtpAccount.h"
 #include "BmUtil.h"
@@ -32,6 +36,199 @@ const char* const BmMailFilter::MSG_TRAILING = 	"bm:trailing";
 const char* const BmMailFilter::MSG_LEADING = 	"bm:leading";
 const char* const BmMailFilter::MSG_REFS = 		"refs";
 
+/*------------------------------------------------------------------------------*\
+	BmMailFilterPipeline
+		-	reads and parses the mails of a filter-job and runs the filters on
+			them, using a pool of worker threads
+		-	the results are handed back to the filter-job in their original 
+			order, such that storing/moving the mails (and the status-updates)
+			still happens in the job's thread, one mail after the other
+		-	the workers never get more than a fixed window of mails ahead of
+			the filter-job, in order to keep memory usage bounded
+\*------------------------------------------------------------------------------*/
+class BmMailFilterPipeline {
+	struct Slot {
+		Slot() : msgContext( NULL), hasResults( false), ready( false) {}
+		BmRef<BmMail> mail;
+		BmMsgContext* msgContext;
+		bool hasResults;
+		bool ready;
+	};
+	typedef vector<Slot> SlotVect;
+	typedef vector<thread_id> ThreadVect;
+
+public:
+	BmMailFilterPipeline( BmMailFilter* job, BmMailRefVect* mailRefs, 
+								 int32 threadCount);
+	~BmMailFilterPipeline();
+
+	BmRef<BmMail> FetchMail( uint32 index, BmMsgContext** msgContext,
+									 bool* hasResults);
+
+private:
+	void Work();
+	static int32 _ThreadEntry( void* data);
+
+	BmMailFilter* mJob;
+	BmMailRefVect* mMailRefs;
+	SlotVect mSlots;
+	ThreadVect mThreads;
+	BLocker mLocker;
+	sem_id mReadySem;
+							// released whenever a worker has finished a mail
+	sem_id mWindowSem;
+							// limits the number of mails in flight
+	int32 mNextIndex;
+	volatile bool mShouldRun;
+
+	static const int32 nMailsInFlightPerThread = 4;
+
+	// Hide copy-constructor and assignment:
+	BmMailFilterPipeline( const BmMailFilterPipeline&);
+	BmMailFilterPipeline operator=( const BmMailFilterPipeline&);
+};
+
+/*------------------------------------------------------------------------------*\
+	BmMailFilterPipeline()
+		-	c'tor, starts the worker threads
+\*------------------------------------------------------------------------------*/
+BmMailFilterPipeline::BmMailFilterPipeline( BmMailFilter* job, 
+														  BmMailRefVect* mailRefs,
+														  int32 threadCount)
+	:	mJob( job)
+	,	mMailRefs( mailRefs)
+	,	mSlots( mailRefs->size())
+	,	mLocker( "MailFilterPipeline")
+	,	mReadySem( create_sem( 0, "MailFilterReady"))
+	,	mWindowSem( create_sem( threadCount*nMailsInFlightPerThread, 
+										"MailFilterWindow"))
+	,	mNextIndex( 0)
+	,	mShouldRun( true)
+{
+	if (mReadySem < 0 || mWindowSem < 0)
+		BM_THROW_RUNTIME( "BmMailFilterPipeline: Could not create semaphores");
+	for( int32 i=0; i<threadCount; ++i) {
+		BmString tname = BmString("FilterWorker_") << i;
+		thread_id tid = spawn_thread( BmMailFilterPipeline::_ThreadEntry, 
+												tname.String(), B_NORMAL_PRIORITY, 
+												this);
+		if (tid < 0)
+			break;
+		mThreads.push_back( tid);
+		resume_thread( tid);
+	}
+	if (mThreads.empty())
+		BM_THROW_RUNTIME( "BmMailFilterPipeline: Could not spawn any thread");
+	BM_LOG2( BM_LogFilter, 
+				BmString("Filter-pipeline started with ") << mThreads.size() 
+					<< " worker threads.");
+}
+
+/*------------------------------------------------------------------------------*\
+	~BmMailFilterPipeline()
+		-	d'tor, stops the worker threads and waits for them to finish
+\*------------------------------------------------------------------------------*/
+BmMailFilterPipeline::~BmMailFilterPipeline()
+{
+	mShouldRun = false;
+	// deleting the semaphores wakes up all workers that may be waiting:
+	delete_sem( mWindowSem);
+	delete_sem( mReadySem);
+	status_t exitVal;
+	for( uint32 i=0; i<mThreads.size(); ++i)
+		wait_for_thread( mThreads[i], &exitVal);
+	for( uint32 i=0; i<mSlots.size(); ++i)
+		delete mSlots[i].msgContext;
+}
+
+/*------------------------------------------------------------------------------*\
+	_ThreadEntry()
+		-	
+\*------------------------------------------------------------------------------*/
+int32 BmMailFilterPipeline::_ThreadEntry( void* data)
+{
+	BmMailFilterPipeline* pipeline = static_cast<BmMailFilterPipeline*>(data);
+	if (pipeline)
+		pipeline->Work();
+	return B_OK;
+}
+
+/*------------------------------------------------------------------------------*\
+	Work()
+		-	the worker loop: picks the next mail, reads and parses it and then 
+			executes the filters on it
+\*------------------------------------------------------------------------------*/
+void BmMailFilterPipeline::Work()
+{
+	while( mShouldRun) {
+		if (acquire_sem( mWindowSem) != B_OK)
+			break;
+		int32 index = atomic_add( &mNextIndex, 1);
+		if (!mShouldRun || index >= (int32)mSlots.size())
+			break;
+		BmRef<BmMail> mail;
+		BmMsgContext* msgContext = NULL;
+		bool hasResults = false;
+		try {
+			mail = BmMail::CreateInstance( (*mMailRefs)[index].Get());
+			if (mail) {
+				mail->StartJobInThisThread( BmMail::BM_READ_MAIL_JOB);
+				if (mail->InitCheck() == B_OK) {
+					msgContext = new BmMsgContext;
+					hasResults = mJob->RunFilters( mail.Get(), msgContext);
+				}
+			}
+		} catch( BM_error &err) {
+			BM_LOGERR( BmString("BmMailFilterPipeline: ") << err.what());
+		}
+		{
+			BAutolock lock( &mLocker);
+			Slot& slot = mSlots[index];
+			slot.mail = mail;
+			slot.msgContext = msgContext;
+			slot.hasResults = hasResults;
+			slot.ready = true;
+		}
+		release_sem( mReadySem);
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	FetchMail( index, msgContext, hasResults)
+		-	blocks until the mail with the given index has been processed by
+			a worker and then hands it (and the filter results) to the caller
+		-	the caller takes ownership of the returned msgContext
+\*------------------------------------------------------------------------------*/
+BmRef<BmMail> BmMailFilterPipeline::FetchMail( uint32 index, 
+															 BmMsgContext** msgContext,
+															 bool* hasResults)
+{
+	BmRef<BmMail> mail;
+	*msgContext = NULL;
+	*hasResults = false;
+	while( true) {
+		{
+			BAutolock lock( &mLocker);
+			Slot& slot = mSlots[index];
+			if (slot.ready) {
+				mail = slot.mail;
+				*msgContext = slot.msgContext;
+				*hasResults = slot.hasResults;
+				slot.mail = NULL;
+				slot.msgContext = NULL;
+				break;
+			}
+		}
+		if (acquire_sem( mReadySem) != B_OK)
+			return NULL;
+	}
+	// allow the workers to start on another mail:
+	release_sem( mWindowSem);
+	return mail;
+}
+
+
+
 /*------------------------------------------------------------------------------*\
 	BmMailFilter()
 		-	contructor
@@ -99,20 +296,33 @@ bool BmMailFilter::StartJob() {
 		BM_LOG2( BM_LogFilter, 
 					BmString("Starting filter-job for ") << count << " mails.");
 		const float delta =  100.0f / (float(count) / GRAIN);
-		if (mMailRefs) {
+		if (mMailRefs && mMailRefs->size()) {
+			// reading, parsing and filtering of the mails is done by a pool of
+			// worker threads, we just apply the results (in order):
+			int32 threadCount = ThePrefs->GetInt( "FilterThreads", 0);
+			if (threadCount <= 0) {
+				system_info sysInfo;
+				get_system_info( &sysInfo);
+				threadCount = sysInfo.cpu_count;
+			}
+			if (threadCount > (int32)mMailRefs->size())
+				threadCount = mMailRefs->size();
+			BmMailFilterPipeline pipeline( this, mMailRefs, threadCount);
 			BmRef<BmMail> mail;
 			for( uint32 i=0; ShouldContinue() && i<mMailRefs->size(); ++i) {
-				mail = BmMail::CreateInstance( (*mMailRefs)[i].Get());
-				if (mail) {
-					mail->StartJobInThisThread( BmMail::BM_READ_MAIL_JOB);
-					if (mail->InitCheck() == B_OK)
-					Execute( mail.Get());
-				}
+				BmMsgContext* msgContext;
+				bool hasResults;
+				mail = pipeline.FetchMail( i, &msgContext, &hasResults);
+				std::auto_ptr<BmMsgContext> msgContextDeleter( msgContext);
+				if (mail && hasResults)
+					ApplyFilterResults( mail.Get(), msgContext);
 				BmString currentCount = BmString()<<++c<<" of "<<count;
-				UpdateStatus( delta, mail->Name().String(), currentCount.String());
+				UpdateStatus( delta, mail ? mail->Name().String() : "", 
+								  currentCount.String());
 			}
-			mMailRefs->clear();
 		}
+		if (mMailRefs)
+			mMailRefs->clear();
 		for( uint32 i=0; ShouldContinue() && i<mMails.size(); ++i) {
 			if (mMails[i]->InitCheck() != B_OK)
 				continue;
@@ -145,7 +355,21 @@ bool BmMailFilter::StartJob() {
 \*------------------------------------------------------------------------------*/
 void BmMailFilter::Execute( BmMail* mail) {
 	BmMsgContext msgContext;
-	msgContext.mail = mail;
+	if (RunFilters( mail, &msgContext))
+		ApplyFilterResults( mail, &msgContext);
+}
+
+/*------------------------------------------------------------------------------*\
+	RunFilters()
+		-	executes the filters (or the filter-chain) on the given mail
+		-	the mail itself is not changed (except for its destination folder),
+			all results are collected in the given msg-context
+		-	this may be called from several threads at once (for different
+			mails)
+		-	returns false if there's nothing to do for the mail
+\*------------------------------------------------------------------------------*/
+bool BmMailFilter::RunFilters( BmMail* mail, BmMsgContext* msgContext) {
+	msgContext->mail = mail;
 
 	BmRef< BmListModelItem> accItem 
 		= TheRecvAccountList->FindItemByKey( mail->AccountName());
@@ -178,27 +402,48 @@ void BmMailFilter::Execute( BmMail* mail) {
 			BM_LOG2( BM_LogFilter, 
 						BmString("...found chain ") << chain->DisplayKey() 
 							<< ", applying all its filters...");
-			// execute all the chain's filters:
-			BmAutolockCheckGlobal lock( chain->ModelLocker());
-			if (!lock.IsLocked())
-				BM_THROW_RUNTIME( chain->ModelNameNC() << ": Unable to get lock");
-			BmFilterPosVect::const_iterator iter;
-			for( iter = chain->posBegin(); iter != chain->posEnd(); ++iter) {
-				BmChainedFilter* chainedFilter = *iter;
-				BmRef< BmListModelItem> filterItem 
-					= TheFilterList->FindItemByKey( chainedFilter->Key());
-				BmFilter* filter = dynamic_cast< BmFilter*>( filterItem.Get());
-				if (filter) {
-					if (!ExecuteFilter( mail, filter, &msgContext))
-						break;
+			// collect all the chain's filters (we do not keep the chain
+			// locked while executing them, since that would serialize all 
+			// concurrent filter-jobs using the same chain)...
+			vector< BmRef<BmFilter> > filters;
+			{
+				BmAutolockCheckGlobal lock( chain->ModelLocker());
+				if (!lock.IsLocked())
+					BM_THROW_RUNTIME( 
+						chain->ModelNameNC() << ": Unable to get lock"
+					);
+				BmFilterPosVect::const_iterator iter;
+				for( iter = chain->posBegin(); iter != chain->posEnd(); ++iter) {
+					BmChainedFilter* chainedFilter = *iter;
+					BmRef< BmListModelItem> filterItem 
+						= TheFilterList->FindItemByKey( chainedFilter->Key());
+					BmFilter* filter = dynamic_cast< BmFilter*>( filterItem.Get());
+					if (filter)
+						filters.push_back( filter);
 				}
 			}
+			// ...and execute them:
+			for( uint32 i=0; i<filters.size(); ++i) {
+				if (!ExecuteFilter( mail, filters[i].Get(), msgContext))
+					break;
+			}
 		} else {
 			BM_LOG2( BM_LogFilter, "...no chain found -> nothing to do.");
-			return;
+			return false;
 		}
 	} else
-		ExecuteFilter( mail, mFilter.Get(), &msgContext);
+		ExecuteFilter( mail, mFilter.Get(), msgContext);
+	return true;
+}
+
+/*------------------------------------------------------------------------------*\
+	ApplyFilterResults()
+		-	applies the results of the filters (as found in the given 
+			msg-context) to the mail and stores it, if required
+\*------------------------------------------------------------------------------*/
+void BmMailFilter::ApplyFilterResults( BmMail* mail, 
+													BmMsgContext* msgContextPtr) {
+	BmMsgContext& msgContext = *msgContextPtr;
 	bool needToStore = false;
 	bool learnAsSpam = msgContext.GetBool("LearnAsSpam");
 	if (learnAsSpam) {
@@ -19,6 +19,7 @@
 #include "BmUtil.h"
 
 class BmFilter;
+class BmMailFilterPipeline;
 class BmMsgContext;
 
 /*------------------------------------------------------------------------------*\
@@ -27,6 +28,7 @@ class BmMsgContext;
 \*------------------------------------------------------------------------------*/
 class IMPEXPBMMAILKIT BmMailFilter : public BmJobModel {
 	typedef BmJobModel inherited;
+	friend class BmMailFilterPipeline;
 
 	typedef vector< BmRef< BmMail> > BmMailVect;
 	typedef vector< const char**> BmHeaderVect;
@@ -57,6 +59,8 @@ public:
 
 private:
 	void Execute( BmMail* mail);
+	bool RunFilters( BmMail* mail, BmMsgContext* msgContext);
+	void ApplyFilterResults( BmMail* mail, BmMsgContext* msgContext);
 	bool ExecuteFilter( BmMail* mail, BmFilter* filter,
 							  BmMsgContext* msgContext);
 	void UpdateStatus( const float delta, const char* filename, 
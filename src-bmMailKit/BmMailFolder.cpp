@@ -435,6 +435,48 @@ void BmMailFolder::RemoveMailRef( const node_ref& nref) {
 		mMailCount = -1;
 }
 
+/*------------------------------------------------------------------------------*\
+	AddMailRefs( specs)
+		-	adds all given mails to this folder's mailref-list in one go, such
+			that the mail-count is only bumped once for the whole batch
+\*------------------------------------------------------------------------------*/
+void BmMailFolder::AddMailRefs( BmMailRefSpecVect& specs) {
+	BmRef<BmMailRefList> refList = MailRefList();
+	if (!refList) {
+		// ref-list couldn't be created (?!?) we mark the mail-count as unknown:
+		mMailCount = -1;
+		return;
+	}
+	BmAutolockCheckGlobal lock( refList->ModelLocker());
+	if (!lock.IsLocked())
+		BM_THROW_RUNTIME( Name() + ":AddMailRefs(): Unable to get lock");
+	refList->BeginMailCountBatch();
+	for( uint32 i=0; i<specs.size(); ++i)
+		AddMailRef( specs[i].eref, specs[i].st);
+	refList->EndMailCountBatch();
+}
+
+/*------------------------------------------------------------------------------*\
+	RemoveMailRefs( nrefs)
+		-	removes all given mails from this folder's mailref-list in one go,
+			such that the mail-count is only bumped once for the whole batch
+\*------------------------------------------------------------------------------*/
+void BmMailFolder::RemoveMailRefs( const vector<node_ref>& nrefs) {
+	BmRef<BmMailRefList> refList = MailRefList();
+	if (!refList) {
+		// ref-list couldn't be created (?!?) we mark the mail-count as unknown:
+		mMailCount = -1;
+		return;
+	}
+	BmAutolockCheckGlobal lock( refList->ModelLocker());
+	if (!lock.IsLocked())
+		BM_THROW_RUNTIME( Name() + ":RemoveMailRefs(): Unable to get lock");
+	refList->BeginMailCountBatch();
+	for( uint32 i=0; i<nrefs.size(); ++i)
+		RemoveMailRef( nrefs[i]);
+	refList->EndMailCountBatch();
+}
+
 /*------------------------------------------------------------------------------*\
 	RemoveMailRef( node)
 		-	removes the mail-ref specified by the given node from this folder's
@@ -54,6 +54,8 @@ public:
 	void RecreateCache();
 	void AddMailRef( entry_ref& eref, struct stat& st);
 	void RemoveMailRef( const node_ref& nref);
+	void AddMailRefs( BmMailRefSpecVect& specs);
+	void RemoveMailRefs( const vector<node_ref>& nrefs);
 	void UpdateMailRef( const node_ref& nref);
 	void UpdateName( const entry_ref &eref);
 	void CreateSubFolder( BmString name);
@@ -9,6 +9,7 @@
 #include <algorithm>
 #include <ctype.h>
 
+#include <Autolock.h>
 #include <List.h>
 #include <NodeInfo.h>
 
@@ -28,19 +29,149 @@ using namespace regexx;
 #undef BM_LOGNAME
 #define BM_LOGNAME "MailParser"
 
-static BmString BmAddressFieldNames = 
-	"<Bcc><Resent-Bcc><Cc><List-Id><Resent-Cc><From><Resent-From><Reply-To>"
-	"<Resent-Reply-To><Sender><Resent-Sender><To><Resent-To>";
+/********************************************************************************\
+	known header-fields
+\********************************************************************************/
 
-static BmString BmIdentificationFieldNames = 
-	"<Message-ID><In-Reply-To><References>";
+enum {
+	FIELD_IS_ADDRESS			= 1<<0,
+	FIELD_IS_IDENTIFICATION	= 1<<1,
+	FIELD_NO_ENCODING			= 1<<2,
+	FIELD_NO_STRIPPING		= 1<<3
+};
 
-static BmString BmNoEncodingFieldNames = 
-	"<Received><Message-ID><Resent-Message-ID><In-Reply-To><References><Date>"
-	"<Resent-Date>";
+struct BmKnownField {
+	const char* name;
+	uint32 flags;
+};
 
-static BmString BmNoStrippingFieldNames = 
-	"<Received><Subject><UserAgent>";
+// the header-fields Beam knows about, each of these is interned to an id 
+// (its index in this table), such that it can be found without having to 
+// compare strings:
+static const BmKnownField nKnownFields[] = {
+	{ "Bcc", 							FIELD_IS_ADDRESS },
+	{ "Cc", 								FIELD_IS_ADDRESS },
+	{ "Content-Description",		0 },
+	{ "Content-Disposition",		0 },
+	{ "Content-Id",					0 },
+	{ "Content-Language",			0 },
+	{ "Content-Transfer-Encoding",0 },
+	{ "Content-Type",					0 },
+	{ "Date",							FIELD_NO_ENCODING },
+	{ "From",							FIELD_IS_ADDRESS },
+	{ "In-Reply-To",					FIELD_IS_IDENTIFICATION | FIELD_NO_ENCODING },
+	{ "List-Archive",					0 },
+	{ "List-Help",						0 },
+	{ "List-Id",						FIELD_IS_ADDRESS },
+	{ "List-Post",						0 },
+	{ "List-Subscribe",				0 },
+	{ "List-Unsubscribe",			0 },
+	{ "Mail-Followup-To",			0 },
+	{ "Mail-Reply-To",				0 },
+	{ "Mailing-List",					0 },
+	{ "Message-Id",					FIELD_IS_IDENTIFICATION | FIELD_NO_ENCODING },
+	{ "Mime-Version",					0 },
+	{ "Priority",						0 },
+	{ "Received",						FIELD_NO_ENCODING | FIELD_NO_STRIPPING },
+	{ "References",					FIELD_IS_IDENTIFICATION | FIELD_NO_ENCODING },
+	{ "Reply-To",						FIELD_IS_ADDRESS },
+	{ "Resent-Bcc",					FIELD_IS_ADDRESS },
+	{ "Resent-Cc",						FIELD_IS_ADDRESS },
+	{ "Resent-Date",					FIELD_NO_ENCODING },
+	{ "Resent-From",					FIELD_IS_ADDRESS },
+	{ "Resent-Message-Id",			FIELD_NO_ENCODING },
+	{ "Resent-Reply-To",				FIELD_IS_ADDRESS },
+	{ "Resent-Sender",				FIELD_IS_ADDRESS },
+	{ "Resent-To",						FIELD_IS_ADDRESS },
+	{ "Sender",							FIELD_IS_ADDRESS },
+	{ "Subject",						FIELD_NO_STRIPPING },
+	{ "To",								FIELD_IS_ADDRESS },
+	{ "User-Agent",					0 },
+	{ "Useragent",						FIELD_NO_STRIPPING },
+							// (sic!), this is how it has always been...
+	{ "X-Beenthere",					0 },
+	{ "X-List",							0 },
+	{ "X-Mailer",						0 },
+	{ "X-Priority",					0 },
+};
+static const int32 nKnownFieldCount 
+	= sizeof(nKnownFields) / sizeof(nKnownFields[0]);
+
+/*------------------------------------------------------------------------------*\
+	HashFieldName( name)
+		-	case-insensitive hash for header-field names
+\*------------------------------------------------------------------------------*/
+static inline uint32 HashFieldName( const BmString& name)
+{
+	uint32 hash = 5381;
+	const unsigned char* p = (const unsigned char*)name.String();
+	for( const unsigned char* end = p+name.Length(); p<end; ++p)
+		hash = (hash << 5) + hash + tolower( *p);
+	return hash;
+}
+
+/*------------------------------------------------------------------------------*\
+	BmKnownFieldIndex
+		-	maps the (case-insensitive) names of all known fields to their id
+\*------------------------------------------------------------------------------*/
+static class BmKnownFieldIndex {
+public:
+	BmKnownFieldIndex() {
+		for( uint32 s=0; s<nSlotCount; ++s)
+			mSlots[s] = -1;
+		for( int32 id=0; id<nKnownFieldCount; ++id) {
+			mNames[id] = nKnownFields[id].name;
+			mFlags[id] = nKnownFields[id].flags;
+			uint32 s = HashFieldName( mNames[id]) & (nSlotCount-1);
+			while( mSlots[s] >= 0)
+				s = (s+1) & (nSlotCount-1);
+			mSlots[s] = id;
+		}
+	}
+	// returns the id of the given field or -1 if it isn't a known one:
+	inline int32 IdFor( const BmString& fieldName, uint32 hash) const {
+		uint32 s = hash & (nSlotCount-1);
+		for( int32 id; (id = mSlots[s]) >= 0; s = (s+1) & (nSlotCount-1)) {
+			if (mNames[id].Length() == fieldName.Length()
+			&& !mNames[id].ICompare( fieldName))
+				return id;
+		}
+		return -1;
+	}
+	inline int32 IdFor( const BmString& fieldName) const {
+		return IdFor( fieldName, HashFieldName( fieldName));
+	}
+	inline const BmString& NameOf( int32 id) const { return mNames[id]; }
+	inline uint32 FlagsOf( int32 id) const { return mFlags[id]; }
+private:
+	static const uint32 nSlotCount = 128;
+	int32 mSlots[nSlotCount];
+	BmString mNames[nKnownFieldCount];
+	uint32 mFlags[nKnownFieldCount];
+} nKnownFieldIndex;
+
+/*------------------------------------------------------------------------------*\
+	FieldFlags( fieldName)
+		-	returns the flags of the given field, unknown fields have none
+\*------------------------------------------------------------------------------*/
+static inline uint32 FieldFlags( const BmString& fieldName)
+{
+	int32 id = nKnownFieldIndex.IdFor( fieldName);
+	return id < 0 ? 0 : nKnownFieldIndex.FlagsOf( id);
+}
+
+/*------------------------------------------------------------------------------*\
+	AddressFieldName( fieldName)
+		-	returns the (interned) name of the given field if it is an 
+			address-field, NULL otherwise
+\*------------------------------------------------------------------------------*/
+static inline const BmString* AddressFieldName( const BmString& fieldName)
+{
+	int32 id = nKnownFieldIndex.IdFor( fieldName);
+	if (id < 0 || !(nKnownFieldIndex.FlagsOf( id) & FIELD_IS_ADDRESS))
+		return NULL;
+	return &nKnownFieldIndex.NameOf( id);
+}
 
 /********************************************************************************\
 	BmAddress
@@ -428,13 +559,147 @@ void BmAddressList::ConstructRawText( BmStringOBuf& header,
 	BmHeaderList
 \********************************************************************************/
 
+/*------------------------------------------------------------------------------*\
+	BmHeaderList()
+		-	c'tor
+\*------------------------------------------------------------------------------*/
+BmMailHeader::BmHeaderList::BmHeaderList()
+	:	mKnownFields( nKnownFieldCount, (BmValueList*)NULL)
+	,	mOtherCount( 0)
+	,	mHeaderInfos( NULL)
+	,	mHeaderInfoLock( "HeaderInfoLock")
+{
+	BuildOtherIndex();
+}
+
+/*------------------------------------------------------------------------------*\
+	~BmHeaderList()
+		-	d'tor
+\*------------------------------------------------------------------------------*/
+BmMailHeader::BmHeaderList::~BmHeaderList()
+{
+	Changed();
+}
+
+/*------------------------------------------------------------------------------*\
+	Changed()
+		-	drops the header-infos, since they no longer reflect the fields
+		-	message-contexts that still use them keep their own reference
+\*------------------------------------------------------------------------------*/
+void BmMailHeader::BmHeaderList::Changed()
+{
+	BAutolock lock( mHeaderInfoLock);
+	if (mHeaderInfos) {
+		mHeaderInfos->RemoveRef();
+		mHeaderInfos = NULL;
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	ValuesFor( fieldName)
+		-	returns the value-list for the given (canonical) fieldName, 
+			creating it if necessary
+\*------------------------------------------------------------------------------*/
+BmMailHeader::BmValueList& 
+BmMailHeader::BmHeaderList::ValuesFor( const BmString& fieldName) {
+	Changed();
+	uint32 hash = HashFieldName( fieldName);
+	int32 id = nKnownFieldIndex.IdFor( fieldName, hash);
+	if (id >= 0 && mKnownFields[id])
+		return *mKnownFields[id];
+	BmHeaderMap::iterator pos = mHeaders.find( fieldName);
+	if (pos == mHeaders.end()) {
+		pos = mHeaders.insert( 
+			BmHeaderMap::value_type( fieldName, BmValueList())
+		).first;
+		if (id >= 0)
+			mKnownFields[id] = &pos->second;
+		else
+			AddToOtherIndex( hash, &pos->first, &pos->second);
+	}
+	return pos->second;
+}
+
+/*------------------------------------------------------------------------------*\
+	AddToOtherIndex( hash, name, values)
+		-	adds the given field (which isn't a known one) to the hash-index,
+			growing the index if it gets more than half full
+\*------------------------------------------------------------------------------*/
+void BmMailHeader::BmHeaderList::AddToOtherIndex( uint32 hash, 
+																  const BmString* name,
+																  BmValueList* values) {
+	if (2 * (mOtherCount+1) > mOtherIndex.size()) {
+		// rebuilding picks up the new field from mHeaders:
+		BuildOtherIndex();
+		return;
+	}
+	uint32 mask = mOtherIndex.size()-1;
+	uint32 s = hash & mask;
+	while( mOtherIndex[s].values)
+		s = (s+1) & mask;
+	mOtherIndex[s].hash = hash;
+	mOtherIndex[s].values = values;
+	mOtherIndex[s].name = name;
+	mOtherCount++;
+}
+
+/*------------------------------------------------------------------------------*\
+	BuildOtherIndex()
+		-	builds the hash-index of all fields which aren't known ones
+		-	the index is kept up-to-date whenever fields are added or removed,
+			such that the const lookups never have to modify it (and can 
+			safely be used by several threads at once)
+\*------------------------------------------------------------------------------*/
+void BmMailHeader::BmHeaderList::BuildOtherIndex() {
+	uint32 size = 16;
+	while( size < 2 * (mHeaders.size()+1))
+		size *= 2;
+	OtherField empty = { 0, NULL, NULL };
+	mOtherIndex.assign( size, empty);
+	mOtherCount = 0;
+	BmHeaderMap::iterator iter;
+	for( iter=mHeaders.begin(); iter != mHeaders.end(); ++iter) {
+		uint32 hash = HashFieldName( iter->first);
+		if (nKnownFieldIndex.IdFor( iter->first, hash) >= 0)
+			continue;
+		uint32 s = hash & (size-1);
+		while( mOtherIndex[s].values)
+			s = (s+1) & (size-1);
+		mOtherIndex[s].hash = hash;
+		mOtherIndex[s].values = &iter->second;
+		mOtherIndex[s].name = &iter->first;
+		mOtherCount++;
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	Find( fieldName)
+		-	returns the value-list for the given fieldName (case-insensitive),
+			or NULL if there is no such field
+\*------------------------------------------------------------------------------*/
+const BmMailHeader::BmValueList* 
+BmMailHeader::BmHeaderList::Find( const BmString& fieldName) const {
+	uint32 hash = HashFieldName( fieldName);
+	int32 id = nKnownFieldIndex.IdFor( fieldName, hash);
+	if (id >= 0)
+		return mKnownFields[id];
+	uint32 mask = mOtherIndex.size()-1;
+	for( uint32 s = hash & mask; mOtherIndex[s].values; s = (s+1) & mask) {
+		const OtherField& field = mOtherIndex[s];
+		if (field.hash == hash && field.name->Length() == fieldName.Length()
+		&& !field.name->ICompare( fieldName))
+			return field.values;
+	}
+	return NULL;
+}
+
 /*------------------------------------------------------------------------------*\
 	Set( fieldName, value)
 		-	
 \*------------------------------------------------------------------------------*/
 void BmMailHeader::BmHeaderList::Set( const BmString& fieldName, 
 												  const BmString value) {
-	BmValueList& valueList = mHeaders[fieldName];
+	BmValueList& valueList = ValuesFor( fieldName);
 	valueList.clear();
 	valueList.push_back( value);
 }
@@ -445,7 +710,7 @@ void BmMailHeader::BmHeaderList::Set( const BmString& fieldName,
 \*------------------------------------------------------------------------------*/
 void BmMailHeader::BmHeaderList::Add( const BmString& fieldName, 
 												  const BmString value) {
-	BmValueList& valueList = mHeaders[fieldName];
+	BmValueList& valueList = ValuesFor( fieldName);
 	valueList.push_back( value);
 }
 
@@ -454,7 +719,13 @@ void BmMailHeader::BmHeaderList::Add( const BmString& fieldName,
 		-	
 \*------------------------------------------------------------------------------*/
 void BmMailHeader::BmHeaderList::Remove( const BmString& fieldName) {
+	Changed();
+	int32 id = nKnownFieldIndex.IdFor( fieldName);
+	if (id >= 0)
+		mKnownFields[id] = NULL;
 	mHeaders.erase( fieldName);
+	if (id < 0)
+		BuildOtherIndex();
 }
 
 /*------------------------------------------------------------------------------*\
@@ -463,34 +734,35 @@ void BmMailHeader::BmHeaderList::Remove( const BmString& fieldName) {
 \*------------------------------------------------------------------------------*/
 void BmMailHeader::BmHeaderList::RemoveFieldVal( const BmString& fieldName,
 																 const BmString& val) {
-	BmHeaderMap::iterator pos = mHeaders.find(fieldName);
-	if (pos != mHeaders.end()) {
-		BmValueList& valueList = pos->second;
+	BmValueList* valueList = const_cast<BmValueList*>( Find( fieldName));
+	if (valueList) {
 		BmValueList::iterator valPos 
-			= find(valueList.begin(),valueList.end(),val);
-		if (valPos != valueList.end())
-			valueList.erase(valPos);
+			= find(valueList->begin(),valueList->end(),val);
+		if (valPos != valueList->end()) {
+			Changed();
+			valueList->erase(valPos);
+		}
 	}
 }
 
 /*------------------------------------------------------------------------------*\
-	()
-		-	returns all values found for given fieldName
+	GetAllValues( msgContext)
+		-	hands all fields and their values to the given message-context
+		-	the set of header-infos is built only once (unless the fields
+			change) and shared by all message-contexts
+		-	the set is built under a lock, since several filter-threads may
+			ask for it at the same time
 \*------------------------------------------------------------------------------*/
 void BmMailHeader::BmHeaderList::GetAllValues( BmMsgContext& msgContext) const {
-	msgContext.headerInfoCount = mHeaders.size();
-	msgContext.headerInfos = new BmHeaderInfo [msgContext.headerInfoCount];
-	int i = 0;
-	BmHeaderMap::const_iterator iter;
-	for( iter=mHeaders.begin(); iter != mHeaders.end(); ++iter, ++i) {
-		const BmValueList& valueList = iter->second;
-		const char** values = new const char* [valueList.size()+1];
-		for( uint32 v=0; v<valueList.size(); ++v)
-			values[v] = valueList[v].String();
-		values[valueList.size()] = NULL;
-		msgContext.headerInfos[i].values = values;
-		msgContext.headerInfos[i].fieldName = iter->first;
+	BAutolock lock( mHeaderInfoLock);
+	if (!mHeaderInfos) {
+		mHeaderInfos = new BmHeaderInfoSet( mHeaders.size());
+		int i = 0;
+		BmHeaderMap::const_iterator iter;
+		for( iter=mHeaders.begin(); iter != mHeaders.end(); ++iter, ++i)
+			mHeaderInfos->SetInfo( i, iter->first, iter->second);
 	}
+	msgContext.ShareHeaderInfos( mHeaderInfos);
 }
 
 /*------------------------------------------------------------------------------*\
@@ -512,8 +784,8 @@ void BmMailHeader::BmHeaderList
 \*------------------------------------------------------------------------------*/
 uint32 BmMailHeader::BmHeaderList::CountValuesFor(const BmString& fieldName) const
 {
-	BmHeaderMap::const_iterator iter = mHeaders.find(fieldName);
-	return (iter == mHeaders.end()) ? 0 : iter->second.size();
+	const BmValueList* valueList = Find( fieldName);
+	return valueList ? valueList->size() : 0;
 }
 
 /*------------------------------------------------------------------------------*\
@@ -523,13 +795,10 @@ uint32 BmMailHeader::BmHeaderList::CountValuesFor(const BmString& fieldName) con
 const BmString& BmMailHeader::BmHeaderList
 ::ValueAt(const BmString& fieldName, uint32 idx) const 
 {
-	BmHeaderMap::const_iterator iter = mHeaders.find(fieldName);
-	if (iter == mHeaders.end())
+	const BmValueList* valueList = Find( fieldName);
+	if (!valueList || valueList->size() <= idx)
 		return BM_DEFAULT_STRING;
-	const BmValueList& valueList = iter->second;
-	if (valueList.size() <= idx)
-		return BM_DEFAULT_STRING;
-	return valueList[idx];
+	return (*valueList)[idx];
 }
 
 /*------------------------------------------------------------------------------*\
@@ -560,17 +829,24 @@ struct subpart {
 };
 
 /*------------------------------------------------------------------------------*\
-	BmMailHeader( headerText)
+	BmMailHeader( headerText, mail, keepHeaderText)
 		-	constructor
+		-	if keepHeaderText is false, the header is parsed directly from the
+			given text without keeping a copy of it (HeaderString() will then
+			be empty)
 \*------------------------------------------------------------------------------*/
-BmMailHeader::BmMailHeader( const BmString &headerText, BmMail* mail)
-	:	mHeaderString( headerText)
-	,	mMail( mail)
+BmMailHeader::BmMailHeader( const BmStringView& headerText, BmMail* mail,
+									 bool keepHeaderText)
+	:	mMail( mail)
 	,	mKey( RefPrintHex())
 							// generate dummy identifier from our address
 	,	mIsRedirect( false)
 {
-	ParseHeader( headerText);
+	if (keepHeaderText) {
+		headerText.CopyInto( mHeaderString);
+		ParseHeader( mHeaderString);
+	} else
+		ParseHeader( headerText);
 }
 	
 /*------------------------------------------------------------------------------*\
@@ -584,49 +860,43 @@ BmMailHeader::~BmMailHeader() {
 	IsAddressField()
 	-	
 \*------------------------------------------------------------------------------*/
-bool BmMailHeader::IsAddressField( BmString fieldName) {
-	BmString fname = BmString("<") << fieldName.CapitalizeEachWord() << ">";
-	return BmAddressFieldNames.IFindFirst( fname) != B_ERROR;
+bool BmMailHeader::IsAddressField( const BmString& fieldName) {
+	return (FieldFlags( fieldName) & FIELD_IS_ADDRESS) != 0;
 }
 
 /*------------------------------------------------------------------------------*\
 	IsIdentificationField()
 	-	
 \*------------------------------------------------------------------------------*/
-bool BmMailHeader::IsIdentificationField( BmString fieldName) {
-	BmString fname = BmString("<") << fieldName.CapitalizeEachWord() << ">";
-	return BmIdentificationFieldNames.IFindFirst( fname) != B_ERROR;
+bool BmMailHeader::IsIdentificationField( const BmString& fieldName) {
+	return (FieldFlags( fieldName) & FIELD_IS_IDENTIFICATION) != 0;
 }
 
 /*------------------------------------------------------------------------------*\
 	IsEncodingOkForField()
 	-	
 \*------------------------------------------------------------------------------*/
-bool BmMailHeader::IsEncodingOkForField( BmString fieldName) {
+bool BmMailHeader::IsEncodingOkForField( const BmString& fieldName) {
 	if (fieldName.ICompare("Content-", 8) == 0)
 		return false;
-	BmString fname = BmString("<") << fieldName.CapitalizeEachWord() << ">";
-	return BmNoEncodingFieldNames.IFindFirst( fname) == B_ERROR;
+	return (FieldFlags( fieldName) & FIELD_NO_ENCODING) == 0;
 }
 
 /*------------------------------------------------------------------------------*\
 	IsStrippingOkForField()
 	-	
 \*------------------------------------------------------------------------------*/
-bool BmMailHeader::IsStrippingOkForField( BmString fieldName) {
-	fieldName.CapitalizeEachWord();	
-	if (fieldName.Compare( "X-", 2) == 0)
+bool BmMailHeader::IsStrippingOkForField( const BmString& fieldName) {
+	if (fieldName.ICompare( "X-", 2) == 0)
 		return false;							// no stripping for unknown fields
-	BmString fname = BmString("<") << fieldName << ">";
-	return BmNoStrippingFieldNames.IFindFirst( fname) == B_ERROR;
+	return (FieldFlags( fieldName) & FIELD_NO_STRIPPING) == 0;
 }
 
 /*------------------------------------------------------------------------------*\
 	IsFieldEmpty()
 	-	
 \*------------------------------------------------------------------------------*/
-bool BmMailHeader::IsFieldEmpty( BmString fieldName) {
-	fieldName.CapitalizeEachWord();
+bool BmMailHeader::IsFieldEmpty( const BmString& fieldName) {
 	return GetFieldVal( fieldName).Length() == 0;
 }
 
@@ -642,10 +912,11 @@ void BmMailHeader::GetAllFieldValues( BmMsgContext& msgContext) const {
 	GetFieldVal()
 	-	
 \*------------------------------------------------------------------------------*/
-const BmString& BmMailHeader::GetFieldVal( BmString fieldName, uint32 idx) {
-	fieldName.CapitalizeEachWord();
-	if (IsAddressField( fieldName))
-		return mAddrMap[fieldName].AddrString();
+const BmString& BmMailHeader::GetFieldVal( const BmString& fieldName, 
+														 uint32 idx) {
+	const BmString* addrFieldName = AddressFieldName( fieldName);
+	if (addrFieldName)
+		return mAddrMap[*addrFieldName].AddrString();
 	else
 		return mHeaders.ValueAt(fieldName, idx);
 }
@@ -662,8 +933,7 @@ void BmMailHeader::GetAllFieldNames(vector<BmString>& fieldNamesVect) const {
 	CountFieldVals()
 	-	
 \*------------------------------------------------------------------------------*/
-uint32 BmMailHeader::CountFieldVals( BmString fieldName) {
-	fieldName.CapitalizeEachWord();
+uint32 BmMailHeader::CountFieldVals( const BmString& fieldName) {
 	return mHeaders.CountValuesFor(fieldName);
 }
 
@@ -671,44 +941,44 @@ uint32 BmMailHeader::CountFieldVals( BmString fieldName) {
 	AddressFieldContainsAddrSpec()
 		-	
 \*------------------------------------------------------------------------------*/
-bool BmMailHeader::AddressFieldContainsAddrSpec( BmString fieldName, 
-																 const BmString addrSpec) {
-	fieldName.CapitalizeEachWord();
-	if (!IsAddressField( fieldName))
+bool BmMailHeader::AddressFieldContainsAddrSpec( const BmString& fieldName, 
+																 const BmString& addrSpec) {
+	const BmString* addrFieldName = AddressFieldName( fieldName);
+	if (!addrFieldName)
 		BM_THROW_RUNTIME( 
 			"BmMailHeader.AddressFieldContainsAddrSpec(): Field is not an "
 			"address-field."
 		);
-	return mAddrMap[fieldName].ContainsAddrSpec( addrSpec);
+	return mAddrMap[*addrFieldName].ContainsAddrSpec( addrSpec);
 }
 
 /*------------------------------------------------------------------------------*\
 	AddressFieldContainsAddress()
 		-	
 \*------------------------------------------------------------------------------*/
-bool BmMailHeader::AddressFieldContainsAddress( BmString fieldName, 
+bool BmMailHeader::AddressFieldContainsAddress( const BmString& fieldName, 
 																const BmString& address) {
-	fieldName.CapitalizeEachWord();
-	if (!IsAddressField( fieldName))
+	const BmString* addrFieldName = AddressFieldName( fieldName);
+	if (!addrFieldName)
 		BM_THROW_RUNTIME( 
 			"BmMailHeader.AddressFieldContainsAddress(): Field is not an "
 			"address-field."
 		);
 	BmAddress addr( address);
-	return mAddrMap[fieldName].ContainsAddrSpec( addr.AddrSpec());
+	return mAddrMap[*addrFieldName].ContainsAddrSpec( addr.AddrSpec());
 }
 
 /*------------------------------------------------------------------------------*\
 	GetAddressList()
 		-	
 \*------------------------------------------------------------------------------*/
-const BmAddressList& BmMailHeader::GetAddressList( BmString fieldName) {
-	fieldName.CapitalizeEachWord();
-	if (!IsAddressField( fieldName))
+const BmAddressList& BmMailHeader::GetAddressList( const BmString& fieldName) {
+	const BmString* addrFieldName = AddressFieldName( fieldName);
+	if (!addrFieldName)
 		BM_THROW_RUNTIME( 
 			"BmMailHeader.GetAddressList(): Field is not an address-field."
 		);
-	return mAddrMap[fieldName];
+	return mAddrMap[*addrFieldName];
 }
 
 /*------------------------------------------------------------------------------*\
@@ -804,17 +1074,18 @@ BmAddressList BmMailHeader::DetermineOriginator( bool bypassReplyTo) {
 		-	
 \*------------------------------------------------------------------------------*/
 BmString BmMailHeader::DetermineSender() {
-	BmAddressList addrList = mAddrMap[BM_FIELD_SENDER];
-	if (!addrList.InitOK()) {
-		addrList = mAddrMap[BM_FIELD_FROM];
-		if (!addrList.InitOK()) {
+	// refer to the address-lists (copying them would be costly):
+	const BmAddressList* addrList = &mAddrMap[BM_FIELD_SENDER];
+	if (!addrList->InitOK()) {
+		addrList = &mAddrMap[BM_FIELD_FROM];
+		if (!addrList->InitOK()) {
 			BM_LOG( BM_LogMailParse, "Unable to determine sender of mail!");
 			return "";
 		}
 	}
-	if (addrList.IsGroup())
-		return addrList.GroupName();
-	return addrList.FirstAddress().AddrSpec();
+	if (addrList->IsGroup())
+		return addrList->GroupName();
+	return addrList->FirstAddress().AddrSpec();
 }
 
 /*------------------------------------------------------------------------------*\
@@ -1019,7 +1290,7 @@ void BmMailHeader::AddParsingError( const BmString& errStr)
 			used for header-field conversion (if and only if nothing else is 
 			specified in a header-field)
 \*------------------------------------------------------------------------------*/
-void BmMailHeader::ParseHeader( const BmString &header) {
+void BmMailHeader::ParseHeader( const BmStringView& header) {
 	Regexx rxUnfold, rx;
 
 	mParsingErrors.Truncate(0);
@@ -1039,11 +1310,12 @@ void BmMailHeader::ParseHeader( const BmString &header) {
 	if (!nm && mMail) {
 		BM_LOGERR ( 
 			BmString("Could not find any header-fields in this header: \n") 
-				<< header
+				<< BmString( header.Data(), header.Length())
 		);
 	}
 	BM_LOG( BM_LogMailParse, "The mail-header");
-	BM_LOG3( BM_LogMailParse, BmString(header) << "\n------------------");
+	BM_LOG3( BM_LogMailParse, 
+				BmString( header.Data(), header.Length()) << "\n------------------");
 	BM_LOG( BM_LogMailParse, BmString("contains ") << nm << " headerfields\n");
 
 	BmSubpartVect::const_iterator i;
@@ -1051,7 +1323,7 @@ void BmMailHeader::ParseHeader( const BmString &header) {
 
 		// split each headerfield into field-name and field-body:
 		BmString fieldName, fieldBody;
-		BmString headerField( header.String()+i->pos, i->len);
+		BmString headerField( header.Data()+i->pos, i->len);
 		int32 pos = headerField.FindFirst( ':');
 		if (pos == B_ERROR) { 
 			BmString errStr 
@@ -14,6 +14,8 @@
 #include <map>
 #include <vector>
 
+#include <Locker.h>
+
 #include "BmBasics.h"
 #include "BmFilterAddon.h"
 #include "BmIdentity.h"
@@ -154,8 +156,18 @@ public:
 	typedef map< BmString, BmValueList> BmHeaderMap;
 
 private:
+	// all fields of a header, ordered by their (capitalized) name. 
+	// Fields known to Beam are indexed by their interned id, all others
+	// by a case-insensitive hash of their name:
 	class IMPEXPBMMAILKIT BmHeaderList {
+		struct OtherField {
+			uint32 hash;
+			BmValueList* values;
+			const BmString* name;
+		};
 	public:
+		BmHeaderList();
+		~BmHeaderList();
 		void Set( const BmString& fieldName, const BmString content);
 		void Add( const BmString& fieldName, const BmString content);
 		void Remove( const BmString& fieldName);
@@ -171,14 +183,36 @@ private:
 		void GetAllNames(vector<BmString>& fieldNamesVect) const;
 
 	private:
+		BmValueList& ValuesFor( const BmString& fieldName);
+		const BmValueList* Find( const BmString& fieldName) const;
+		void AddToOtherIndex( uint32 hash, const BmString* name, 
+									 BmValueList* values);
+		void BuildOtherIndex();
+		void Changed();
+
 		BmHeaderMap mHeaders;
+		vector<BmValueList*> mKnownFields;
+							// values of known fields, indexed by field-id
+		vector<OtherField> mOtherIndex;
+		uint32 mOtherCount;
+							// hash-index (open addressing) of all other fields,
+							// kept up-to-date by all methods changing the fields
+		mutable BmHeaderInfoSet* mHeaderInfos;
+		mutable BLocker mHeaderInfoLock;
+							// the header-infos handed out to message-contexts,
+							// built on demand (once per header)
+
+		// Hide copy-constructor and assignment:
+		BmHeaderList( const BmHeaderList&);
+		BmHeaderList operator=( const BmHeaderList&);
 	};
 
 	typedef map< BmString, BmAddressList> BmAddrMap;
 	
 public:
 	// c'tors and d'tor:
-	BmMailHeader( const BmString &headerText, BmMail* mail);
+	BmMailHeader( const BmStringView& headerText, BmMail* mail,
+					  bool keepHeaderText=true);
 	~BmMailHeader();
 
 	// native methods:
@@ -190,11 +224,11 @@ public:
 	void RemoveFieldVal( const BmString fieldName,
 								const BmString& val);
 	void RemoveAddrFieldVal( BmString fieldName, const BmString address);
-	const BmAddressList& GetAddressList( BmString fieldName);
-	bool IsFieldEmpty( BmString fieldName);
-	bool AddressFieldContainsAddrSpec( BmString fieldName, 
-												  const BmString addrSpec);
-	bool AddressFieldContainsAddress( BmString fieldName, 
+	const BmAddressList& GetAddressList( const BmString& fieldName);
+	bool IsFieldEmpty( const BmString& fieldName);
+	bool AddressFieldContainsAddrSpec( const BmString& fieldName, 
+												  const BmString& addrSpec);
+	bool AddressFieldContainsAddress( const BmString& fieldName, 
 												 const BmString& address);
 	//
 	BmString DetermineSender();
@@ -209,8 +243,8 @@ public:
 	bool ConstructRawText( BmStringOBuf& header, const BmString& charset);
 	//
 	void GetAllFieldValues( BmMsgContext& msgContext) const;
-	const BmString& GetFieldVal( BmString fieldName, uint32 idx=0);
-	uint32 CountFieldVals( BmString fieldName);
+	const BmString& GetFieldVal( const BmString& fieldName, uint32 idx=0);
+	uint32 CountFieldVals( const BmString& fieldName);
 	void GetAllFieldNames(vector<BmString>& fieldNamesVect) const;
 
 	// overrides of BmRefObj
@@ -233,13 +267,13 @@ public:
 	inline void IsRedirect( bool b)		{ mIsRedirect = b; }
 
 	// class-functions:
-	static bool IsAddressField( const BmString fieldName);
-	static bool IsIdentificationField( const BmString fieldName);
-	static bool IsEncodingOkForField( const BmString fieldName);
-	static bool IsStrippingOkForField( const BmString fieldName);
+	static bool IsAddressField( const BmString& fieldName);
+	static bool IsIdentificationField( const BmString& fieldName);
+	static bool IsEncodingOkForField( const BmString& fieldName);
+	static bool IsStrippingOkForField( const BmString& fieldName);
 
 protected:
-	void ParseHeader( const BmString &header);
+	void ParseHeader( const BmStringView& header);
 	BmString ParseHeaderField( BmString fieldName, BmString fieldValue);
 	BmString StripField( BmString fieldValue, BmString* commentBuffer=NULL);
 	void DetermineName();
@@ -248,7 +282,9 @@ private:
 	void AddParsingError( const BmString& errStr);
 
 	BmString mHeaderString;
-							// the complete original mail-header
+							// the complete original mail-header (empty if the
+							// header has been parsed from a view without keeping
+							// a copy, as is done for MIME-headers of bodyparts)
 	BmHeaderList mHeaders;
 							// contains all stripped headers as a list of corresponding
 							// values. For simplicity, this map contains even fields
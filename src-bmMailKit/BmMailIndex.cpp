@@ -0,0 +1,422 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+
+#include <algorithm>
+#include <ctype.h>
+#include <string.h>
+
+#include "BmBasics.h"
+#include "BmBodyPartList.h"
+#include "BmLogHandler.h"
+#include "BmMail.h"
+#include "BmMailHeader.h"
+#include "BmMailIndex.h"
+
+/********************************************************************************\
+	BmNormalizingMailReader
+\********************************************************************************/
+
+/*------------------------------------------------------------------------------*\
+	Add( buf, len)
+		-	appends the given block to the output, the block itself is modified
+			(binary nulls are replaced in place)
+\*------------------------------------------------------------------------------*/
+void BmNormalizingMailReader::Add( char* buf, int32 len) {
+	int32 runStart = 0;
+	for( int32 i=0; i<len; ++i) {
+		char c = buf[i];
+		if (c == '\0')
+			buf[i] = ' ';
+		else if (c == '\n' && !(i ? buf[i-1] == '\r' : mLastWasCR)) {
+			mOut.Write( buf+runStart, i-runStart);
+			mOut.Write( "\r", 1);
+			runStart = i;
+		}
+	}
+	mOut.Write( buf+runStart, len-runStart);
+	if (len)
+		mLastWasCR = buf[len-1] == '\r';
+}
+
+/********************************************************************************\
+	BmMailIndexer
+\********************************************************************************/
+
+const int32 BmMailIndexer::nDefaultMaxInlineLength = 16384;
+const int32 BmMailIndexer::nMaxLineLength = 1024;
+
+/*------------------------------------------------------------------------------*\
+	BmMailIndexer( skeleton, elidedBodies, maxInlineLength)
+		-	constructor
+\*------------------------------------------------------------------------------*/
+BmMailIndexer::BmMailIndexer( BmStringOBuf& skeleton,
+										BmElidedBodyVect& elidedBodies,
+										int32 maxInlineLength)
+	:	mSkeleton( skeleton)
+	,	mElidedBodies( elidedBodies)
+	,	mMaxInlineLength( maxInlineLength)
+	,	mState( IN_HEADER)
+	,	mHeaderStart( 0)
+	,	mLineStartInFile( 0)
+	,	mLineIsSpilled( false)
+	,	mLastLinebreakLen( 0)
+	,	mLastWasCR( false)
+	,	mFilePos( 0)
+	,	mBodyStartInFile( 0)
+	,	mIsEliding( false)
+	,	mBodyHasBoundary( false)
+	,	mMaxBoundaryLength( 0)
+	,	mIsAmbiguous( false)
+	,	mTextLength( 0)
+{
+}
+
+/*------------------------------------------------------------------------------*\
+	Add( buf, len)
+		-	splits the given block of raw mail-data into lines and handles
+			those
+		-	just like BmNormalizingMailReader, this modifies the given block
+\*------------------------------------------------------------------------------*/
+void BmMailIndexer::Add( char* buf, int32 len) {
+	for( int32 i=0; i<len; ++i) {
+		if (buf[i] == '\0')
+			buf[i] = ' ';
+	}
+	const char* pos = buf;
+	const char* end = buf+len;
+	while( pos < end) {
+		const char* nl = (const char*)memchr( pos, '\n', end-pos);
+		if (nl) {
+			AddLinePiece( pos, nl+1-pos, true);
+			pos = nl+1;
+		} else {
+			AddLinePiece( pos, end-pos, false);
+			pos = end;
+		}
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	Finish()
+		-	handles the last line (if it has no linebreak) and closes the
+			current body-part
+\*------------------------------------------------------------------------------*/
+void BmMailIndexer::Finish() {
+	if (!mLineIsSpilled && mLine.Length()) {
+		HandleLine( mLine.String(), mLine.Length(), false);
+		mLine.Truncate( 0);
+	}
+	if (mState == IN_BODY)
+		FinishBodyPart( mFilePos, true);
+}
+
+/*------------------------------------------------------------------------------*\
+	AddLinePiece( piece, len, complete)
+		-	collects the given piece of a line until the line is complete
+		-	overlong lines within body-parts are passed on in pieces, such
+			that a single huge line can't make the line-buffer explode
+\*------------------------------------------------------------------------------*/
+void BmMailIndexer::AddLinePiece( const char* piece, int32 len,
+											 bool complete) {
+	mFilePos += len;
+	if (mLineIsSpilled) {
+		if (complete) {
+			mLastLinebreakLen
+				= (len > 1 ? piece[len-2] == '\r' : mLastWasCR) ? 2 : 1;
+			mLineIsSpilled = false;
+			mLineStartInFile = mFilePos;
+		}
+		Emit( piece, len);
+		return;
+	}
+	mLine.Append( piece, len);
+	if (complete) {
+		HandleLine( mLine.String(), mLine.Length(), true);
+		mLine.Truncate( 0);
+		mLineStartInFile = mFilePos;
+	} else if (mLine.Length() > nMaxLineLength && mState != IN_HEADER) {
+		Emit( mLine.String(), mLine.Length());
+		mLine.Truncate( 0);
+		mLineIsSpilled = true;
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	HandleLine( line, len, complete)
+		-	passes on the given line and keeps track of the MIME-structure
+		-	complete is false for the last line of a mail that doesn't end
+			with a linebreak
+\*------------------------------------------------------------------------------*/
+void BmMailIndexer::HandleLine( const char* line, int32 len, bool complete) {
+	int32 linebreakLen = 0;
+	if (complete)
+		linebreakLen = (len > 1 && line[len-2] == '\r') ? 2 : 1;
+	int32 contentLen = len-linebreakLen;
+	bool isLast;
+	if (CheckBoundary( line, contentLen, isLast)) {
+		if (mState == IN_BODY)
+			FinishBodyPart( mLineStartInFile-mLastLinebreakLen, false);
+		mState = isLast ? IN_MULTIPART_TEXT : IN_HEADER;
+		Emit( line, len);
+		mHeaderStart = mSkeleton.CurrPos();
+	} else {
+		int32 lineStart = mSkeleton.CurrPos();
+		Emit( line, len);
+		// an empty line ends the header, but (just like in BmMail) the
+		// main header is never empty:
+		if (mState == IN_HEADER && complete && !contentLen
+		&& (mHeaderStart > 0 || lineStart > 0))
+			StartBodyPart( mSkeleton.Buffer()+mHeaderStart,
+								lineStart-mHeaderStart);
+	}
+	if (complete)
+		mLastLinebreakLen = linebreakLen;
+}
+
+/*------------------------------------------------------------------------------*\
+	CheckBoundary( line, len, isLast)
+		-	checks whether the given line (without linebreak) is a boundary of
+			one of the multiparts, following the rules of BmBodyPart::SetTo()
+		-	sets isLast if the line is a closing boundary
+\*------------------------------------------------------------------------------*/
+bool BmMailIndexer::CheckBoundary( const char* line, int32 len, 
+											  bool& isLast) const {
+	if (mBoundaries.empty() || len < 2 || line[0] != '-' || line[1] != '-')
+		return false;
+	// just like the parser, we only look at the line up to the first CR:
+	const char* cr = (const char*)memchr( line, '\r', len);
+	if (cr)
+		len = cr-line;
+	while( len && isspace( (unsigned char)line[len-1]))
+		len--;
+	for( uint32 i=0; i<mBoundaries.size(); ++i) {
+		const BmString& boundary = mBoundaries[i];
+		int32 boundaryLen = boundary.Length();
+		if (len < boundaryLen
+		|| memcmp( line, boundary.String(), boundaryLen) != 0)
+			continue;
+		if (len == boundaryLen+2 && line[len-2] == '-' && line[len-1] == '-') {
+			isLast = true;
+			return true;
+		}
+		if (len == boundaryLen) {
+			isLast = false;
+			return true;
+		}
+	}
+	return false;
+}
+
+/*------------------------------------------------------------------------------*\
+	ContainsBoundary( data, len)
+		-	checks whether the given data contains the boundary of any of the
+			multiparts (anywhere, not just at the start of a line)
+\*------------------------------------------------------------------------------*/
+bool BmMailIndexer::ContainsBoundary( const char* data, int32 len) const {
+	const char* end = data+len;
+	for( const char* pos = data; 
+		  (pos = (const char*)memchr( pos, '-', end-pos)) != NULL; ++pos) {
+		for( uint32 i=0; i<mBoundaries.size(); ++i) {
+			const BmString& boundary = mBoundaries[i];
+			if (end-pos >= boundary.Length()
+			&& memcmp( pos, boundary.String(), boundary.Length()) == 0)
+				return true;
+		}
+	}
+	return false;
+}
+
+/*------------------------------------------------------------------------------*\
+	CheckBodyForBoundary( data, len)
+		-	checks whether the given piece of the current body-part contains
+			a boundary, including one that started in the previous piece
+			(which is possible for the pieces of a long line)
+\*------------------------------------------------------------------------------*/
+void BmMailIndexer::CheckBodyForBoundary( const char* data, int32 len) {
+	if (mBoundaries.empty())
+		return;
+	int32 tailLen = mMaxBoundaryLength-1;
+	BmString junction( mBodyTail);
+	junction.Append( data, MIN( len, tailLen));
+	mBodyHasBoundary 
+		= ContainsBoundary( junction.String(), junction.Length())
+			|| ContainsBoundary( data, len);
+	if (len >= tailLen)
+		mBodyTail.SetTo( data+len-tailLen, tailLen);
+	else if (junction.Length() > tailLen)
+		mBodyTail.SetTo( junction.String()+junction.Length()-tailLen, tailLen);
+	else
+		mBodyTail = junction;
+}
+
+/*------------------------------------------------------------------------------*\
+	StartBodyPart( header, len)
+		-	parses the given MIME-header (from the skeleton) and starts
+			the corresponding body-part
+\*------------------------------------------------------------------------------*/
+void BmMailIndexer::StartBodyPart( const char* header, int32 len) {
+	BmRef<BmMailHeader> mimeHeader
+		= new BmMailHeader( BmStringView( header, len), NULL, false);
+	BmString type = mimeHeader->GetFieldVal( BM_FIELD_CONTENT_TYPE);
+	if (type.ICompare( "multipart", 9) == 0) {
+		BmContentField contentType( type);
+		BmString boundary = contentType.Param( "boundary");
+		if (boundary.Length()) {
+			mBoundaries.push_back( BmString("--") << boundary);
+			mMaxBoundaryLength = MAX( mMaxBoundaryLength, 
+											  mBoundaries.back().Length());
+		}
+		mState = IN_MULTIPART_TEXT;
+	} else {
+		mState = IN_BODY;
+		mBodyStartInFile = mFilePos;
+		mBodyText.Truncate( 0);
+		mIsEliding = false;
+		mBodyHasBoundary = false;
+		mBodyTail.Truncate( 0);
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	FinishBodyPart( endInFile, atEnd)
+		-	ends the current body-part, which either is added to the index
+			(if it has been elided) or to the skeleton
+		-	unless the body-part ends the mail (atEnd), the linebreak in front
+			of the boundary doesn't belong to it
+\*------------------------------------------------------------------------------*/
+void BmMailIndexer::FinishBodyPart( off_t endInFile, bool atEnd) {
+	if (mIsEliding) {
+		// the parser would look at any boundary within the body-part,
+		// so it can't be left out in that case:
+		if (mBodyHasBoundary)
+			mIsAmbiguous = true;
+		mElidedBody.lengthInFile = endInFile-mElidedBody.startInFile;
+		if (!atEnd) {
+			mElidedBody.length -= 2;
+			mSkeleton.Write( "\r\n", 2);
+		}
+		mElidedBodies.push_back( mElidedBody);
+		mIsEliding = false;
+	} else
+		mSkeleton.Write( mBodyText.String(), mBodyText.Length());
+	mBodyText.Truncate( 0);
+}
+
+/*------------------------------------------------------------------------------*\
+	Emit( data, len)
+		-	normalizes linebreaks of the given data and passes it on
+\*------------------------------------------------------------------------------*/
+void BmMailIndexer::Emit( const char* data, int32 len) {
+	if (mState == IN_BODY && !mBodyHasBoundary)
+		CheckBodyForBoundary( data, len);
+	int32 runStart = 0;
+	for( int32 i=0; i<len; ++i) {
+		if (data[i] == '\n' && !(i ? data[i-1] == '\r' : mLastWasCR)) {
+			Put( data+runStart, i-runStart);
+			Put( "\r", 1);
+			runStart = i;
+		}
+	}
+	Put( data+runStart, len-runStart);
+	if (len)
+		mLastWasCR = data[len-1] == '\r';
+}
+
+/*------------------------------------------------------------------------------*\
+	Put( data, len)
+		-	writes the given (normalized) data into the skeleton or the
+			current body-part
+		-	as soon as the body-part gets longer than mMaxInlineLength, it
+			is elided, i.e. it is only counted from then on
+\*------------------------------------------------------------------------------*/
+void BmMailIndexer::Put( const char* data, int32 len) {
+	mTextLength += len;
+	if (mState != IN_BODY)
+		mSkeleton.Write( data, len);
+	else if (mIsEliding)
+		mElidedBody.length += len;
+	else {
+		mBodyText.Append( data, len);
+		if (mBodyText.Length() > mMaxInlineLength) {
+			mIsEliding = true;
+			mElidedBody.startInText = mSkeleton.CurrPos();
+			mElidedBody.startInFile = mBodyStartInFile;
+			mElidedBody.length = mBodyText.Length();
+			mBodyText.Truncate( 0);
+		}
+	}
+}
+
+/********************************************************************************\
+	BmMailFileIBuf
+\********************************************************************************/
+
+/*------------------------------------------------------------------------------*\
+	BmMailFileIBuf( file, start, length, blockSize)
+		-	constructor
+\*------------------------------------------------------------------------------*/
+BmMailFileIBuf::BmMailFileIBuf( BFile* file, off_t start, off_t length,
+										  uint32 blockSize)
+	:	mFile( file)
+	,	mFilePos( start)
+	,	mFileEnd( start+length)
+	,	mBlock( blockSize)
+	,	mBuf( blockSize+blockSize/4, 2.0f)
+	,	mReader( mBuf)
+	,	mBufPos( 0)
+	,	mHadError( false)
+{
+}
+
+/*------------------------------------------------------------------------------*\
+	Read( data, reqLen)
+		-	reads up to reqLen bytes of normalized mail-data into data
+\*------------------------------------------------------------------------------*/
+uint32 BmMailFileIBuf::Read( char* data, uint32 reqLen) {
+	uint32 readLen = 0;
+	while( readLen < reqLen) {
+		if (mBufPos >= mBuf.CurrPos()) {
+			if (mHadError || mFilePos >= mFileEnd)
+				break;
+			FillBuffer();
+			continue;
+		}
+		uint32 len = std::min( reqLen-readLen, mBuf.CurrPos()-mBufPos);
+		memcpy( data+readLen, mBuf.Buffer()+mBufPos, len);
+		mBufPos += len;
+		readLen += len;
+	}
+	return readLen;
+}
+
+/*------------------------------------------------------------------------------*\
+	IsAtEnd()
+		-	
+\*------------------------------------------------------------------------------*/
+bool BmMailFileIBuf::IsAtEnd() {
+	return mBufPos >= mBuf.CurrPos() && (mHadError || mFilePos >= mFileEnd);
+}
+
+/*------------------------------------------------------------------------------*\
+	FillBuffer()
+		-	reads the next block from the file and normalizes it
+\*------------------------------------------------------------------------------*/
+void BmMailFileIBuf::FillBuffer() {
+	mBuf.Reset();
+	mBufPos = 0;
+	size_t len = (size_t)std::min( (off_t)mBlock.size(), mFileEnd-mFilePos);
+	ssize_t read = mFile->ReadAt( mFilePos, &mBlock[0], len);
+	if (read <= 0) {
+		BM_LOGERR( BmString("Could not read mail-data from file.\n\nError: ")
+						<< strerror( read < 0 ? read : B_ERROR));
+		mHadError = true;
+		return;
+	}
+	mFilePos += read;
+	mReader.Add( &mBlock[0], read);
+}
@@ -0,0 +1,192 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+
+#ifndef _BmMailIndex_h
+#define _BmMailIndex_h
+
+#include "BmMailKit.h"
+
+#include <memory>
+#include <vector>
+
+#include <File.h>
+
+#include "BmMemIO.h"
+#include "BmString.h"
+
+using std::auto_ptr;
+using std::vector;
+
+typedef auto_ptr<BmMemIBuf> BmMemIBufRef;
+
+/*------------------------------------------------------------------------------*\
+	BmNormalizingMailReader
+		-	appends blocks of raw mail-data to a buffer, converting linebreaks
+			to CRLF and binary nulls to spaces on the fly, such that a mail
+			read from disk only exists in memory once (instead of once as read
+			and once more as converted)
+\*------------------------------------------------------------------------------*/
+class IMPEXPBMMAILKIT BmNormalizingMailReader {
+public:
+	BmNormalizingMailReader( BmStringOBuf& out)
+		:	mOut( out)
+		,	mLastWasCR( false)						{}
+	void Add( char* buf, int32 len);
+private:
+	BmStringOBuf& mOut;
+	bool mLastWasCR;
+};
+
+/*------------------------------------------------------------------------------*\
+	BmElidedBody
+		-	the position of a body-part that has been left out of the text of
+			a lazily loaded mail (its skeleton): it starts at startInText
+			within the skeleton, spans length bytes of the normalized
+			mail-text and can be read from the given range of the mail-file
+		-	isClaimed is set once the parser has found the body-part
+\*------------------------------------------------------------------------------*/
+struct BmElidedBody {
+	BmElidedBody()
+		:	startInText( 0)
+		,	length( 0)
+		,	startInFile( 0)
+		,	lengthInFile( 0)
+		,	isClaimed( false)						{}
+	int32 startInText;
+	int32 length;
+	off_t startInFile;
+	off_t lengthInFile;
+	bool isClaimed;
+};
+
+typedef vector<BmElidedBody> BmElidedBodyVect;
+
+/*------------------------------------------------------------------------------*\
+	BmMailIndexer
+		-	splits a raw mail (fed block by block) into a skeleton, containing
+			all headers, MIME-boundaries and the smaller body-parts, and an
+			index of the body-parts that have been left out since they are
+			longer than maxInlineLength
+		-	the skeleton is normalized just like BmNormalizingMailReader does,
+			the body-parts are parsed from it as usual (each elided body-part
+			is empty in there)
+\*------------------------------------------------------------------------------*/
+class IMPEXPBMMAILKIT BmMailIndexer {
+public:
+	BmMailIndexer( BmStringOBuf& skeleton, BmElidedBodyVect& elidedBodies,
+						int32 maxInlineLength);
+
+	// native methods:
+	void Add( char* buf, int32 len);
+	void Finish();
+
+	// getters:
+	inline int32 TextLength() const		{ return mTextLength; }
+							// length of the complete (normalized) mail-text
+	inline bool IsAmbiguous() const		{ return mIsAmbiguous; }
+							// an elided body-part contains a boundary, such
+							// that the index can't be trusted
+
+	static const int32 nDefaultMaxInlineLength;
+							// body-parts longer than this are elided when
+							// BmMail loads a large mail
+	static const int32 nMaxLineLength;
+							// lines of a body-part that are longer than this
+							// are passed on in pieces (a boundary-line is
+							// always shorter)
+
+private:
+	enum State {
+		IN_HEADER = 0,
+		IN_BODY,
+		IN_MULTIPART_TEXT
+							// preamble or epilogue of a multipart
+	};
+	void AddLinePiece( const char* piece, int32 len, bool complete);
+	void HandleLine( const char* line, int32 len, bool complete);
+	bool CheckBoundary( const char* line, int32 len, bool& isLast) const;
+	bool ContainsBoundary( const char* data, int32 len) const;
+	void CheckBodyForBoundary( const char* data, int32 len);
+	void StartBodyPart( const char* header, int32 len);
+	void FinishBodyPart( off_t endInFile, bool atEnd);
+	void Emit( const char* data, int32 len);
+	void Put( const char* data, int32 len);
+
+	BmStringOBuf& mSkeleton;
+	BmElidedBodyVect& mElidedBodies;
+	int32 mMaxInlineLength;
+	State mState;
+	vector<BmString> mBoundaries;
+							// "--"+boundary for every multipart seen so far
+							// (the parser doesn't stop looking for the
+							// boundary of an unterminated multipart at the
+							// end of its parent)
+	int32 mHeaderStart;
+							// start of current MIME-header within skeleton
+	BmString mLine;
+	off_t mLineStartInFile;
+	bool mLineIsSpilled;
+							// the current line has been passed on in pieces
+	int32 mLastLinebreakLen;
+							// length of the linebreak of the last line
+							// (within the mail-file)
+	bool mLastWasCR;
+	off_t mFilePos;
+	BmString mBodyText;
+							// the current body-part, as long as it's short
+	off_t mBodyStartInFile;
+	bool mIsEliding;
+	bool mBodyHasBoundary;
+	BmString mBodyTail;
+							// end of the last piece of the current body-part
+							// (shorter than any boundary)
+	int32 mMaxBoundaryLength;
+	bool mIsAmbiguous;
+	BmElidedBody mElidedBody;
+	int32 mTextLength;
+
+	// Hide copy-constructor and assignment:
+	BmMailIndexer( const BmMailIndexer&);
+	BmMailIndexer operator=( const BmMailIndexer&);
+};
+
+/*------------------------------------------------------------------------------*\
+	BmMailFileIBuf
+		-	reads the given range of a mail-file, normalizing it on the fly
+			(the file is read via ReadAt(), so it may be shared by several
+			readers)
+\*------------------------------------------------------------------------------*/
+class IMPEXPBMMAILKIT BmMailFileIBuf : public BmMemIBuf {
+	typedef BmMemIBuf inherited;
+
+public:
+	BmMailFileIBuf( BFile* file, off_t start, off_t length,
+						 uint32 blockSize=65536);
+
+	// overrides of BmMemIBuf base:
+	uint32 Read( char* data, uint32 reqLen);
+	bool IsAtEnd();
+
+private:
+	void FillBuffer();
+
+	BFile* mFile;
+	off_t mFilePos;
+	off_t mFileEnd;
+	vector<char> mBlock;
+	BmStringOBuf mBuf;
+	BmNormalizingMailReader mReader;
+	uint32 mBufPos;
+	bool mHadError;
+
+	// Hide copy-constructor and assignment:
+	BmMailFileIBuf( const BmMailFileIBuf&);
+	BmMailFileIBuf operator=( const BmMailFileIBuf&);
+};
+
+#endif
@@ -16,6 +16,7 @@
 
 #include <deque>
 #include <map>
+#include <set>
 
 #include "BmBasics.h"
 #include "BmLogHandler.h"
@@ -28,6 +29,7 @@
 using std::deque;
 using std::map;
 using std::pair;
+using std::set;
 
 /********************************************************************************\
 	BmMailMonitorWorker
@@ -36,6 +38,7 @@ class BmMailMonitorWorker {
 
 public:
 	BmMailMonitorWorker();
+	~BmMailMonitorWorker();
 
 	void Run();
 	void Quit();
@@ -45,6 +48,9 @@ public:
 	void AddMessage(BMessage* msg);
 	//
 	void CacheRefToFolder( node_ref& nref, const BmString& fKey);
+	//
+	void ExpectMoves( const BmExpectedMoveMap& moves);
+	void CancelExpectedMoves( const BmExpectedMoveMap& moves);
 
 private:
 	//	native methods:
@@ -53,6 +59,14 @@ private:
 	//
 	void HandleMailMonitorMsg( BMessage* msg);
 	void HandleQueryUpdateMsg( BMessage* msg);
+	bool ConsumeExpectedMove( const node_ref& nref);
+	//
+	void AddMailRefLater( BmMailFolder* folder, entry_ref& eref, 
+								 struct stat& st);
+	void RemoveMailRefLater( BmMailFolder* folder, const node_ref& nref);
+	void DropAddedMailRef( const node_ref& nref);
+	void FlushMailRefChangesFor( const node_ref& nref);
+	void FlushMailRefChanges();
 	//
 	static int32 ThreadEntry(void* data);
 
@@ -63,6 +77,7 @@ private:
 						  entry_ref& eref, struct stat& st,
 						  BmMailFolder* oldParent, entry_ref& erefFrom);
 	void EntryChanged( node_ref& nref);
+	void EntryVanished( BMessage* msg, const node_ref& nref);
 
 	// When trying to handle B_ATTR_CHANGED events for a mail-ref whose
 	// ref-list isn't loaded, the given info isn't enough to find out the 
@@ -77,15 +92,46 @@ private:
 	typedef map<BmString, FolderInfo> CachedRefToFolderMap;
 	CachedRefToFolderMap mCachedRefToFolderMap;
 
+	// When the mail-mover moves a batch of mails, it updates the affected
+	// ref-lists itself (in one go) and announces the moves to us beforehand,
+	// such that we can drop the corresponding move-events. As an event may
+	// get lost, announcements expire after a while:
+	struct ExpectedMove {
+		ExpectedMove( int32 c, bigtime_t e) : eventCount(c), expiry(e) {}
+		int32 eventCount;
+		bigtime_t expiry;
+	};
+	typedef map<BmString, ExpectedMove> ExpectedMoveMap;
+	ExpectedMoveMap mExpectedMoveMap;
+
+	// The mail-ref changes caused by a batch of messages are not applied
+	// one by one, but are collected per folder and applied in one go once
+	// the batch has been handled (or before any message that depends on
+	// them). Changes that cancel each other out (e.g. a mail that has been
+	// created and removed again) never reach the ref-lists at all:
+	struct FolderChanges {
+		BmRef<BmMailFolder> folder;
+		map<BmString, BmMailRefSpec> addedRefs;
+		map<BmString, node_ref> removedRefs;
+	};
+	typedef map<BmString, FolderChanges> FolderChangesMap;
+	FolderChangesMap mFolderChanges;
+							// folder-key -> pending changes of its ref-list
+	set<BmString> mChangedNodes;
+							// node-keys of all mails with pending changes
+
 	// deque for incoming node-monitor messages:
 	typedef deque<BMessage*> MessageList;
 	MessageList mMessageList;
 
 	BLocker mLocker;
+	sem_id mWakeSem;
+	bool mWakeupPending;
 	bool mShouldRun;
 	thread_id mThreadId;
 	uint32 mCounter;
-	uint32 mIdleTimeInMSecs;
+	bool mIsBusy;
+	bigtime_t mIdleSince;
 
 	// Hide copy-constructor and assignment:
 	BmMailMonitorWorker( const BmMailMonitorWorker&);
@@ -98,11 +144,26 @@ private:
 \*------------------------------------------------------------------------------*/
 BmMailMonitorWorker::BmMailMonitorWorker()
 	:	mLocker("MailMonitorWorkerLock")
+	,	mWakeSem(-1)
+	,	mWakeupPending(false)
 	,	mShouldRun(false)
 	,	mThreadId(-1)
 	,	mCounter(0)
-	,	mIdleTimeInMSecs(0)
+	,	mIsBusy(false)
+	,	mIdleSince(system_time())
+{
+}
+
+/*------------------------------------------------------------------------------*\
+	~BmMailMonitorWorker()
+		-	standard d'tor
+\*------------------------------------------------------------------------------*/
+BmMailMonitorWorker::~BmMailMonitorWorker()
 {
+	if (mWakeSem >= 0)
+		delete_sem(mWakeSem);
+	for( uint32 i=0; i<mMessageList.size(); ++i)
+		delete mMessageList[i];
 }
 
 /*------------------------------------------------------------------------------*\
@@ -112,6 +173,9 @@ BmMailMonitorWorker::BmMailMonitorWorker()
 void BmMailMonitorWorker::Run()
 {
 	mShouldRun = true;
+	mWakeSem = create_sem(0, "MailMonitorWorkerWake");
+	if (mWakeSem < 0)
+		throw BM_runtime_error("MailMonitor::Run(): Could not create semaphore");
 	// start new thread for worker:
 	BmString tname( "MailMonitorWorker");
 	mThreadId = spawn_thread( BmMailMonitorWorker::ThreadEntry, 
@@ -128,6 +192,7 @@ void BmMailMonitorWorker::Run()
 void BmMailMonitorWorker::Quit()
 {
 	mShouldRun = false;
+	release_sem(mWakeSem);
 	status_t exitVal;
 	wait_for_thread(mThreadId, &exitVal);
 }
@@ -146,28 +211,33 @@ int32 BmMailMonitorWorker::ThreadEntry(void* data)
 
 /*------------------------------------------------------------------------------*\
 	MessageLoop()
-		-	
+		-	sleeps until messages arrive and then handles all messages that
+			have been queued in the meantime as one batch
 \*------------------------------------------------------------------------------*/
 void BmMailMonitorWorker::MessageLoop()
 {
-	const int32 snoozeMSecs = 50;
-	BMessage* msg = NULL;
+	MessageList batch;
 	while(mShouldRun) {
+		acquire_sem(mWakeSem);
 		if (mLocker.Lock()) {
-			if (!mMessageList.empty()) {
-				mIdleTimeInMSecs = 0;
-				msg = mMessageList.front();
-				mMessageList.pop_front();
-			} else
-				msg = NULL;
+			batch.swap(mMessageList);
+			mWakeupPending = false;
+			mIsBusy = !batch.empty();
 			mLocker.Unlock();
 		}
-		if (msg) {
-			MessageReceived(msg);
-			delete msg;
-		} else {
-			snooze(snoozeMSecs*1000);
-			mIdleTimeInMSecs += snoozeMSecs;
+		if (batch.empty())
+			continue;
+		for( uint32 i=0; i<batch.size(); ++i) {
+			if (mShouldRun)
+				MessageReceived(batch[i]);
+			delete batch[i];
+		}
+		batch.clear();
+		FlushMailRefChanges();
+		if (mLocker.Lock()) {
+			mIsBusy = false;
+			mIdleSince = system_time();
+			mLocker.Unlock();
 		}
 	}
 }
@@ -204,7 +274,12 @@ void BmMailMonitorWorker::MessageReceived( BMessage* msg) {
 void BmMailMonitorWorker::AddMessage( BMessage* msg) {
 	if (mLocker.Lock()) {
 		mMessageList.push_back(msg);
+		// the worker only needs to be woken once per batch:
+		bool needWakeup = !mWakeupPending;
+		mWakeupPending = true;
 		mLocker.Unlock();
+		if (needWakeup)
+			release_sem(mWakeSem);
 	}
 }
 
@@ -216,8 +291,9 @@ bool BmMailMonitorWorker::IsIdle(uint32 msecs) {
 	bool res = false;
 	if (mLocker.LockWithTimeout(20*1000) == B_OK) {
 		// Mailmonitor is idle if the message list is empty and if
-		// it has been so for the given amount of microseconds:
-		res = mMessageList.empty() && mIdleTimeInMSecs > msecs;
+		// it has been so for the given amount of milliseconds:
+		res = mMessageList.empty() && !mIsBusy
+				&& system_time() - mIdleSince > bigtime_t(msecs)*1000;
 		mLocker.Unlock();
 	}
 	return res;
@@ -258,6 +334,15 @@ void BmMailMonitorWorker::HandleMailMonitorMsg( BMessage* msg) {
 				pnref.node = eref.directory;
 				if ((err = msg->FindInt64( "node", &nref.node)) != B_OK)
 					BM_THROW_RUNTIME( "Field 'node' not found in msg !?!");
+				if (opcode == B_ENTRY_MOVED && ConsumeExpectedMove( nref)) {
+					BM_LOG2( BM_LogMailTracking, 
+								BmString("Move-event of mail <") << nref.node 
+									<< "> has already been handled by mover.");
+					// if the mail has been created in this batch, the mover
+					// has taken care of it, too:
+					DropAddedMailRef( nref);
+					return;
+				}
 				if (opcode != B_ENTRY_REMOVED) {
 					BNode aNode;
 					if ((err = msg->FindString( "name", &name)) != B_OK)
@@ -270,6 +355,8 @@ void BmMailMonitorWorker::HandleMailMonitorMsg( BMessage* msg) {
 						  		<< eref.directory << "> and name <" << eref.name 
 						  		<< "> \n\nError:" << strerror(err)
 						);
+						if (opcode == B_ENTRY_MOVED)
+							EntryVanished( msg, nref);
 						return;
 					}
 					if ((err = aNode.GetStat( &st)) != B_OK) {
@@ -330,6 +417,7 @@ void BmMailMonitorWorker::HandleMailMonitorMsg( BMessage* msg) {
 					BM_THROW_RUNTIME( "Field 'node' not found in msg !?!");
 				if ((err = msg->FindInt32( "device", &nref.device)) != B_OK)
 					BM_THROW_RUNTIME( "Field 'device' not found in msg !?!");
+				FlushMailRefChangesFor( nref);
 				EntryChanged( nref);
 				break;
 			}
@@ -356,6 +444,7 @@ void BmMailMonitorWorker::EntryCreated( BmMailFolder* parent, node_ref& nref,
 		BM_LOG2( BM_LogMailTracking, 
 					BmString("New mail folder <") << eref.name 
 						<< "," << nref.node << "> detected.");
+		FlushMailRefChanges();
 		TheMailFolderList->AddMailFolder( eref, nref.node, parent, st.st_mtime);
 	} else {
 		// a new mail has been created, we add it to the 
@@ -363,7 +452,7 @@ void BmMailMonitorWorker::EntryCreated( BmMailFolder* parent, node_ref& nref,
 		BM_LOG2( BM_LogMailTracking, 
 					BmString("New mail <") << eref.name 
 						<< "," << nref.node << "> detected.");
-		parent->AddMailRef( eref, st);
+		AddMailRefLater( parent, eref, st);
 	}
 }
 
@@ -390,6 +479,7 @@ void BmMailMonitorWorker::EntryRemoved( BmMailFolder* parent, node_ref& nref) {
 		BM_LOG2( BM_LogMailTracking, 
 					BmString("Removal of mail folder <") 
 						<< nref.node << "> detected.");
+		FlushMailRefChanges();
 		BmAutolockCheckGlobal lock( TheMailFolderList->ModelLocker());
 		if (!lock.IsLocked())
 			BM_THROW_RUNTIME( "MailMonitor::EntryRemoved(): Unable to get lock");
@@ -406,7 +496,7 @@ void BmMailMonitorWorker::EntryRemoved( BmMailFolder* parent, node_ref& nref) {
 					BmString("Removal of mail <") << nref.node 
 						<< "> detected.");
 		if (parent)
-			parent->RemoveMailRef( nref);
+			RemoveMailRefLater( parent, nref);
 	}
 }
 
@@ -439,6 +529,7 @@ void BmMailMonitorWorker::EntryMoved( BmMailFolder* parent, node_ref& nref,
 	// ok, now do actual processing:
 	if (S_ISDIR(st.st_mode)) {
 		// it's a mail-folder, we check for type of change:
+		FlushMailRefChanges();
 		BmRef<BmMailFolder> folder;
 		folder = dynamic_cast<BmMailFolder*>( 
 			TheMailFolderList->FindItemByKey( BM_REFKEY( nref)).Get()
@@ -519,9 +610,143 @@ void BmMailMonitorWorker::EntryMoved( BmMailFolder* parent, node_ref& nref,
 					BmString("Move of mail <") << eref.name 
 						<< "," << nref.node << "> detected.");
 		if (oldParent)
-			oldParent->RemoveMailRef( nref);
+			RemoveMailRefLater( oldParent, nref);
 		if (parent)
-			parent->AddMailRef( eref, st);
+			AddMailRefLater( parent, eref, st);
+	}
+}
+
+
+/*------------------------------------------------------------------------------*\
+	EntryVanished()
+		-	the entry of a move-event has already gone away again (as the 
+			events are handled in batches, this happens to every mail that
+			is moved and then removed in a burst), so all that's left to do
+			is to remove it from the folder it has been moved out of
+\*------------------------------------------------------------------------------*/
+void BmMailMonitorWorker::EntryVanished( BMessage* msg, const node_ref& nref) {
+	node_ref opnref;
+	if (msg->FindInt64( "from directory", &opnref.node) != B_OK)
+		return;
+	opnref.device = nref.device;
+	BmRef<BmMailFolder> oldParent = dynamic_cast<BmMailFolder*>( 
+		TheMailFolderList->FindItemByKey( BM_REFKEY( opnref)).Get()
+	);
+	if (oldParent)
+		RemoveMailRefLater( oldParent.Get(), nref);
+}
+
+
+/*------------------------------------------------------------------------------*\
+	AddMailRefLater()
+		-	notes that a mail-ref for the given entry has to be added to the
+			given folder
+\*------------------------------------------------------------------------------*/
+void BmMailMonitorWorker::AddMailRefLater( BmMailFolder* folder, 
+														 entry_ref& eref, struct stat& st) {
+	node_ref nref;
+	nref.node = st.st_ino;
+	nref.device = st.st_dev;
+	BmString key( BM_REFKEY( nref));
+	FolderChanges& changes = mFolderChanges[folder->Key()];
+	changes.folder = folder;
+	BmMailRefSpec& spec = changes.addedRefs[key];
+	spec.eref = eref;
+	spec.st = st;
+	mChangedNodes.insert( key);
+}
+
+/*------------------------------------------------------------------------------*\
+	RemoveMailRefLater()
+		-	notes that the mail-ref for the given node has to be removed from 
+			the given folder
+		-	if the mail-ref has been added in the same batch, both changes 
+			cancel each other out
+\*------------------------------------------------------------------------------*/
+void BmMailMonitorWorker::RemoveMailRefLater( BmMailFolder* folder, 
+															 const node_ref& nref) {
+	BmString key( BM_REFKEY( nref));
+	FolderChanges& changes = mFolderChanges[folder->Key()];
+	changes.folder = folder;
+	if (!changes.addedRefs.erase( key))
+		changes.removedRefs[key] = nref;
+	mChangedNodes.insert( key);
+}
+
+/*------------------------------------------------------------------------------*\
+	DropAddedMailRef()
+		-	forgets about any pending addition of the mail-ref for the given
+			node (which would otherwise resurrect the mail in the folder it 
+			has been created in, after the mover has already moved it away)
+\*------------------------------------------------------------------------------*/
+void BmMailMonitorWorker::DropAddedMailRef( const node_ref& nref) {
+	BmString key( BM_REFKEY( nref));
+	if (mChangedNodes.find( key) == mChangedNodes.end())
+		return;
+	bool stillChanged = false;
+	FolderChangesMap::iterator iter;
+	for( iter = mFolderChanges.begin(); iter != mFolderChanges.end(); ) {
+		FolderChanges& changes = iter->second;
+		changes.addedRefs.erase( key);
+		if (changes.removedRefs.find( key) != changes.removedRefs.end())
+			stillChanged = true;
+		if (changes.addedRefs.empty() && changes.removedRefs.empty())
+			mFolderChanges.erase( iter++);
+		else
+			++iter;
+	}
+	if (!stillChanged)
+		mChangedNodes.erase( key);
+}
+
+/*------------------------------------------------------------------------------*\
+	FlushMailRefChangesFor()
+		-	applies the pending changes, if any of them refers to the given node
+			(which is what a message about that node may depend on)
+\*------------------------------------------------------------------------------*/
+void BmMailMonitorWorker::FlushMailRefChangesFor( const node_ref& nref) {
+	if (!mChangedNodes.empty() 
+	&& mChangedNodes.find( BM_REFKEY( nref)) != mChangedNodes.end())
+		FlushMailRefChanges();
+}
+
+/*------------------------------------------------------------------------------*\
+	FlushMailRefChanges()
+		-	applies all pending changes, such that each ref-list is updated
+			in one go: removals first (in order to cope with mails that have 
+			been removed and then added again, i.e. renamed), then additions
+\*------------------------------------------------------------------------------*/
+void BmMailMonitorWorker::FlushMailRefChanges() {
+	if (mFolderChanges.empty())
+		return;
+	FolderChangesMap folderChanges;
+	folderChanges.swap( mFolderChanges);
+	mChangedNodes.clear();
+	FolderChangesMap::iterator iter;
+	for( iter = folderChanges.begin(); iter != folderChanges.end(); ++iter) {
+		FolderChanges& changes = iter->second;
+		try {
+			if (!changes.removedRefs.empty()) {
+				vector<node_ref> nrefs;
+				nrefs.reserve( changes.removedRefs.size());
+				map<BmString, node_ref>::const_iterator pos;
+				for( pos = changes.removedRefs.begin(); 
+					  pos != changes.removedRefs.end(); ++pos)
+					nrefs.push_back( pos->second);
+				changes.folder->RemoveMailRefs( nrefs);
+			}
+			if (!changes.addedRefs.empty()) {
+				BmMailRefSpecVect specs;
+				specs.reserve( changes.addedRefs.size());
+				map<BmString, BmMailRefSpec>::const_iterator pos;
+				for( pos = changes.addedRefs.begin(); 
+					  pos != changes.addedRefs.end(); ++pos)
+					specs.push_back( pos->second);
+				changes.folder->AddMailRefs( specs);
+			}
+		} catch( BM_error &err) {
+			BM_SHOWERR( BmString("MailMonitorWorker: ") << err.what());
+		}
 	}
 }
 
@@ -593,6 +818,85 @@ void BmMailMonitorWorker::CacheRefToFolder( node_ref& nref,
 	}
 }
 
+/*------------------------------------------------------------------------------*\
+	ExpectMoves()
+		-	registers the given mail-moves, whose move-events shall be dropped
+			(as the ref-lists have been/will be updated by the mover)
+\*------------------------------------------------------------------------------*/
+void BmMailMonitorWorker::ExpectMoves( const BmExpectedMoveMap& moves) {
+	const bigtime_t expiryTime = 60*1000*1000;
+	BmAutolockCheckGlobal lock( &mLocker);
+	if (!lock.IsLocked())
+		BM_THROW_RUNTIME( "MailMonitor::ExpectMoves(): Unable to get lock");
+	bigtime_t expiry = system_time() + expiryTime;
+	BmExpectedMoveMap::const_iterator iter;
+	for( iter = moves.begin(); iter != moves.end(); ++iter) {
+		ExpectedMoveMap::iterator pos = mExpectedMoveMap.find( iter->first);
+		if (pos != mExpectedMoveMap.end()) {
+			pos->second.eventCount += iter->second;
+			pos->second.expiry = expiry;
+		} else
+			mExpectedMoveMap.insert( 
+				pair<const BmString, ExpectedMove>( 
+					iter->first, ExpectedMove( iter->second, expiry)
+				)
+			);
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	CancelExpectedMoves()
+		-	withdraws the given mail-moves (which have not happened after all)
+\*------------------------------------------------------------------------------*/
+void BmMailMonitorWorker::CancelExpectedMoves( const BmExpectedMoveMap& moves) {
+	BmAutolockCheckGlobal lock( &mLocker);
+	if (!lock.IsLocked())
+		BM_THROW_RUNTIME( 
+			"MailMonitor::CancelExpectedMoves(): Unable to get lock"
+		);
+	BmExpectedMoveMap::const_iterator iter;
+	for( iter = moves.begin(); iter != moves.end(); ++iter) {
+		ExpectedMoveMap::iterator pos = mExpectedMoveMap.find( iter->first);
+		if (pos == mExpectedMoveMap.end())
+			continue;
+		pos->second.eventCount -= iter->second;
+		if (pos->second.eventCount <= 0)
+			mExpectedMoveMap.erase( pos);
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	ConsumeExpectedMove()
+		-	returns whether or not a move-event for the given node has been
+			announced (in which case the event should be dropped)
+		-	expired announcements are cleaned up whenever an unexpected event
+			comes along
+\*------------------------------------------------------------------------------*/
+bool BmMailMonitorWorker::ConsumeExpectedMove( const node_ref& nref) {
+	BmAutolockCheckGlobal lock( &mLocker);
+	if (!lock.IsLocked())
+		BM_THROW_RUNTIME( 
+			"MailMonitor::ConsumeExpectedMove(): Unable to get lock"
+		);
+	if (mExpectedMoveMap.empty())
+		return false;
+	bigtime_t now = system_time();
+	ExpectedMoveMap::iterator pos = mExpectedMoveMap.find( BM_REFKEY( nref));
+	bool expected = pos != mExpectedMoveMap.end() && pos->second.expiry > now;
+	if (expected) {
+		if (--pos->second.eventCount <= 0)
+			mExpectedMoveMap.erase( pos);
+		return true;
+	}
+	for( pos = mExpectedMoveMap.begin(); pos != mExpectedMoveMap.end(); ) {
+		if (pos->second.expiry <= now)
+			mExpectedMoveMap.erase( pos++);
+		else
+			++pos;
+	}
+	return false;
+}
+
 /*------------------------------------------------------------------------------*\
 	HandleQueryUpdateMsg()
 		-	
@@ -615,6 +919,7 @@ void BmMailMonitorWorker::HandleQueryUpdateMsg( BMessage* msg) {
 				if ((err = msg->FindInt64( "node", &nref.node)) != B_OK)
 					BM_THROW_RUNTIME( "Field 'node' not found in msg !?!");
 				pnref.device = nref.device;
+				FlushMailRefChangesFor( nref);
 				{	// scope for lock
 					BmAutolockCheckGlobal lock( TheMailFolderList->ModelLocker());
 					if (!lock.IsLocked())
@@ -696,6 +1001,22 @@ void BmMailMonitor::CacheRefToFolder( node_ref& nref, const BmString& fKey) {
 	mWorker->CacheRefToFolder(nref, fKey);
 }
 
+/*------------------------------------------------------------------------------*\
+	ExpectMoves()
+		-	
+\*------------------------------------------------------------------------------*/
+void BmMailMonitor::ExpectMoves( const BmExpectedMoveMap& moves) {
+	mWorker->ExpectMoves( moves);
+}
+
+/*------------------------------------------------------------------------------*\
+	CancelExpectedMoves()
+		-	
+\*------------------------------------------------------------------------------*/
+void BmMailMonitor::CancelExpectedMoves( const BmExpectedMoveMap& moves) {
+	mWorker->CancelExpectedMoves( moves);
+}
+
 /*------------------------------------------------------------------------------*\
 	IsIdle()
 		-	
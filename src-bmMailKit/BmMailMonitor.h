@@ -11,10 +11,20 @@
 
 #include "BmMailKit.h"
 
+#include <map>
+
 #include <Locker.h>
 #include <Looper.h>
 
+#include "BmString.h"
+
+using std::map;
+
 class BmMailFolder;
+
+typedef map< BmString, int32> BmExpectedMoveMap;
+							// node-key -> number of expected move-events
+
 /*------------------------------------------------------------------------------*\
 	BmMailMonitor
 		-	class 
@@ -29,6 +39,8 @@ public:
 	~BmMailMonitor();
 
 	void CacheRefToFolder( node_ref& nref, const BmString& fKey);
+	void ExpectMoves( const BmExpectedMoveMap& moves);
+	void CancelExpectedMoves( const BmExpectedMoveMap& moves);
 	bool IsIdle(uint32 msecs = 1000);
 
 	// overrides of looper base:
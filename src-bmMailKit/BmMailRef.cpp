@@ -132,6 +132,37 @@ BmRef<BmMailRef> BmMailRef::CreateInstance( BMessage* archive) {
 	}
 }
 
+/*------------------------------------------------------------------------------*\
+	CreateInstance( data)
+		-	static creator-func, used when reading the binary mail-ref cache
+		-	N.B.: In here, we lock the GlobalLocker manually (*not* BmAutolock),
+			because otherwise we may risk deadlocks
+\*------------------------------------------------------------------------------*/
+BmRef<BmMailRef> BmMailRef::CreateInstance( const BmMailRefData& data) {
+	node_ref nref;
+	nref.node = data.inode;
+	nref.device = ThePrefs->MailboxVolume.Device();
+	BmString key( BM_REFKEY( nref));
+	GlobalLocker()->Lock();
+	if (!GlobalLocker()->IsLocked()) {
+		BM_SHOWERR("BmMailRef::CreateInstance(): Could not acquire global lock!");
+		return NULL;
+	}
+	BmRef<BmMailRef> mailRef( 
+		dynamic_cast<BmMailRef*>( 
+			BmRefObj::FetchObject( typeid(BmMailRef).name(), key)
+		)
+	);
+	GlobalLocker()->Unlock();
+	if (mailRef)
+		return mailRef;
+	else {
+		mailRef = new BmMailRef( data, nref);
+		mailRef->Initialize();
+		return mailRef;
+	}
+}
+
 /*------------------------------------------------------------------------------*\
 	BmMailRef( eref, nref)
 		-	standard c'tor
@@ -237,6 +268,39 @@ BmMailRef::BmMailRef( BMessage* archive, node_ref& nref)
 	}
 }
 
+/*------------------------------------------------------------------------------*\
+	BmMailRef( data, nref)
+		-	c'tor used when reading the binary mail-ref cache
+\*------------------------------------------------------------------------------*/
+BmMailRef::BmMailRef( const BmMailRefData& data, node_ref& nref)
+	:	inherited( BM_REFKEY( nref), NULL, (BmListModelItem*)NULL)
+	,	mEntryRef( nref.device, data.directory, data.trackerName)
+	,	mNodeRef( nref)
+	,	mImapUID( data.imapUID)
+	,	mAccount( data.account)
+	,	mCc( data.cc)
+	,	mFrom( data.from)
+	,	mName( data.name)
+	,	mPriority( data.priority)
+	,	mReplyTo( data.replyTo)
+	,	mStatus( data.status)
+	,	mSubject( data.subject)
+	,	mTo( data.to)
+	,	mWhen( data.when)
+	,	mWhenCreated( data.whenCreated)
+	,	mSize( data.size)
+	,	mHasAttachments( data.hasAttachments)
+	,	mIdentity( data.identity)
+	,	mClassification( data.classification)
+	,	mRatioSpam( data.ratioSpam)
+	,	mInitCheck( B_OK)
+{
+	mIsValid = data.isValid;
+	mSizeString = BytesToString( int32(mSize), true);
+	if (mRatioSpam != UNKNOWN_RATIO)
+		mRatioSpamString << mRatioSpam;
+}
+
 /*------------------------------------------------------------------------------*\
 	~BmMailRef()
 		-	d'tor
@@ -277,6 +341,36 @@ status_t BmMailRef::Archive( BMessage* archive, bool) const {
 	return ret;
 }
 
+/*------------------------------------------------------------------------------*\
+	GetData( data)
+		-	fills the given struct with the values of this mail-ref (the strings
+			point into this mail-ref, so they are only valid as long as it lives
+			and isn't changed)
+\*------------------------------------------------------------------------------*/
+void BmMailRef::GetData( BmMailRefData& data) const {
+	data.inode = mNodeRef.node;
+	data.directory = mEntryRef.directory;
+	data.whenCreated = mWhenCreated;
+	data.size = mSize;
+	data.when = mWhen;
+	data.ratioSpam = mRatioSpam;
+	data.isValid = mIsValid;
+	data.hasAttachments = mHasAttachments;
+	data.trackerName = mEntryRef.name ? mEntryRef.name : "";
+	data.account = mAccount.String();
+	data.cc = mCc.String();
+	data.from = mFrom.String();
+	data.name = mName.String();
+	data.priority = mPriority.String();
+	data.replyTo = mReplyTo.String();
+	data.status = mStatus.String();
+	data.subject = mSubject.String();
+	data.to = mTo.String();
+	data.identity = mIdentity.String();
+	data.classification = mClassification.String();
+	data.imapUID = mImapUID.String();
+}
+
 /*------------------------------------------------------------------------------*\
 	Initialize()
 		-	unarchive c'tor
@@ -21,6 +21,36 @@
 
 class BmMail;
 class BmMailRefList;
+/*------------------------------------------------------------------------------*\
+	BmMailRefData
+		-	the plain values of a mail-ref, as kept in the columns of the 
+			binary mail-ref cache (see BmMailRefList)
+		-	the strings are not owned by this struct
+\*------------------------------------------------------------------------------*/
+struct BmMailRefData {
+	ino_t inode;
+	ino_t directory;
+	bigtime_t whenCreated;
+	off_t size;
+	time_t when;
+	float ratioSpam;
+	bool isValid;
+	bool hasAttachments;
+	const char* trackerName;
+	const char* account;
+	const char* cc;
+	const char* from;
+	const char* name;
+	const char* priority;
+	const char* replyTo;
+	const char* status;
+	const char* subject;
+	const char* to;
+	const char* identity;
+	const char* classification;
+	const char* imapUID;
+};
+
 /*------------------------------------------------------------------------------*\
 	BmMailRef
 		-	class 
@@ -56,6 +86,7 @@ public:
 	static BmRef<BmMailRef> CreateInstance( entry_ref &eref, 
 												 		 struct stat* st = NULL);
 	static BmRef<BmMailRef> CreateInstance( BMessage* archive);
+	static BmRef<BmMailRef> CreateInstance( const BmMailRefData& data);
 	virtual ~BmMailRef();
 
 	// native methods:
@@ -69,6 +100,7 @@ public:
 
 	// overrides of archivable base:
 	status_t Archive( BMessage* archive, bool deep = true) const;
+	void GetData( BmMailRefData& data) const;
 	int16 ArchiveVersion() const			{ return nArchiveVersion; }
 
 	// getters:
@@ -149,6 +181,7 @@ protected:
 	BmMailRef( entry_ref &eref, struct stat& st);
 	BmMailRef( entry_ref &eref, const node_ref& nref);
 	BmMailRef( BMessage* archive, node_ref& nref);
+	BmMailRef( const BmMailRefData& data, node_ref& nref);
 	void Initialize();
 
 private:
@@ -22,6 +22,7 @@ using namespace regexx;
 #include "BmMailRef.h"
 #include "BmMailRefFilter.h"
 #include "BmMailRefList.h"
+#include "BmMemIO.h"
 #include "BmPrefs.h"
 #include "BmRosterBase.h"
 #include "BmUtil.h"
@@ -29,10 +30,68 @@ using namespace regexx;
 //******************************************************************************
 // #pragma mark -	BmMailRefList
 //******************************************************************************
-const int16 BmMailRefList::nArchiveVersion = 3;
+const int16 BmMailRefList::nArchiveVersion = 4;
+	// version 4 introduced the binary cache-table, caches of version 3 
+	// (one archived message per mail-ref) can still be read
+const int16 BmMailRefList::nLegacyArchiveVersion = 3;
 
 const char* const BmMailRefList::MSG_FILTER_ARCHIVE = "bm:fila";
 
+/*------------------------------------------------------------------------------*\
+	binary cache-table
+		-	the cache-file starts with a (flattened) header-message, which is
+			followed by a table containing the values of all mail-refs in 
+			columns. The fixed-width columns come first (ordered by alignment),
+			then the string-columns (offsets into a pool of zero-terminated,
+			deduplicated strings), the flags and finally the string-pool 
+			itself.
+			As the table contains no pointers, it can be used directly from
+			a memory buffer (or mapping). Any stored actions are appended
+			to the table, as before.
+\*------------------------------------------------------------------------------*/
+static const uint32 nCacheTableMagic = 'BmRT';
+
+struct BmCacheTableHeader {
+	uint32 magic;
+	uint32 rowCount;
+	uint32 poolSize;
+	uint32 reserved;
+};
+
+enum {
+	BM_COL_TRACKERNAME = 0,
+	BM_COL_ACCOUNT,
+	BM_COL_CC,
+	BM_COL_FROM,
+	BM_COL_NAME,
+	BM_COL_PRIORITY,
+	BM_COL_REPLYTO,
+	BM_COL_STATUS,
+	BM_COL_SUBJECT,
+	BM_COL_TO,
+	BM_COL_IDENTITY,
+	BM_COL_CLASSIFICATION,
+	BM_COL_IMAP_UID,
+	BM_STRING_COLUMN_COUNT
+};
+
+enum {
+	BM_ROWFLAG_VALID = 1<<0,
+	BM_ROWFLAG_ATTACHMENTS = 1<<1
+};
+
+// the size of a cache-table with the given number of rows and the given 
+// size of the string-pool (computed in 64 bits, as both are read from the 
+// cache-file and may be anything):
+static inline uint64 CacheTableSize( uint32 rowCount, uint32 poolSize)
+{
+	return (uint64)sizeof(BmCacheTableHeader)
+		+ (uint64)rowCount * (4 * sizeof(int64) + sizeof(int32) + sizeof(float)
+									 + BM_STRING_COLUMN_COUNT * sizeof(uint32) 
+									 + sizeof(uint8))
+		+ poolSize;
+}
+
 /*------------------------------------------------------------------------------*\
 	BmMailRefList()
 		-	standard c'tor
@@ -42,6 +101,8 @@ BmMailRefList::BmMailRefList( BmMailFolder* folder)
 							<< " (" << folder->Name()<<")", BM_LogMailTracking)
 	,	mFolder( folder)
 	,	mNeedsCacheUpdate( false)
+	,	mMailCountBatchDepth( 0)
+	,	mBatchedMailCountOffset( 0)
 {
 	if (folder) {
 		mSettingsFileName = BmString("folder_")
@@ -86,6 +147,46 @@ void BmMailRefList::StoreAndCleanup() {
 	Cleanup();
 }
 
+/*------------------------------------------------------------------------------*\
+	BeginMailCountBatch()
+		-	starts a batch of additions/removals, during which changes to the
+			mail-count are collected instead of being passed on to the folder
+		-	the caller is expected to hold the model-lock until the batch is
+			ended via EndMailCountBatch()
+\*------------------------------------------------------------------------------*/
+void BmMailRefList::BeginMailCountBatch() {
+	mMailCountBatchDepth++;
+}
+
+/*------------------------------------------------------------------------------*\
+	EndMailCountBatch()
+		-	ends a batch of additions/removals and bumps the folder's mail-count
+			once (by the sum of all changes of the batch)
+\*------------------------------------------------------------------------------*/
+void BmMailRefList::EndMailCountBatch() {
+	if (mMailCountBatchDepth <= 0 || --mMailCountBatchDepth > 0)
+		return;
+	int32 offset = mBatchedMailCountOffset;
+	mBatchedMailCountOffset = 0;
+	BumpFolderMailCount( offset);
+}
+
+/*------------------------------------------------------------------------------*\
+	BumpFolderMailCount( offset)
+		-	bumps the mail-count of our folder, unless a batch is running, in
+			which case the offset is collected until the batch ends
+\*------------------------------------------------------------------------------*/
+void BmMailRefList::BumpFolderMailCount( int32 offset) {
+	if (mMailCountBatchDepth > 0) {
+		mBatchedMailCountOffset += offset;
+		return;
+	}
+	BmRef<BmMailFolder> folder( mFolder.Get());
+		// hold a ref on the corresponding folder while we use it
+	if (folder)
+		folder->BumpMailCount( offset);
+}
+
 /*------------------------------------------------------------------------------*\
 	IsJobCompleted()
 		-	checks if this job has been completed
@@ -127,7 +228,7 @@ bool BmMailRefList::Store() {
 				ModelNameNC() << ":Store(): Unable to get lock"
 			);
 		BMallocIO memIO;
-		memIO.SetBlockSize( 1200 * MAX( size(), 1));
+		memIO.SetBlockSize( 400 * MAX( size(), 1));
 			// acquire enough mem for complete archive, avoids realloc()
 	
 		BmString filename = SettingsFileName();
@@ -152,13 +253,7 @@ bool BmMailRefList::Store() {
 			BM_LOG( BM_LogModelController, 
 					  BmString("ListModel <") << ModelName() 
 					  		<< "> begins to archive...");
-			BmModelItemMap::const_iterator iter;
-			for( iter = begin(); iter != end() && ret == B_OK; ++iter) {
-				BMessage msg;
-				ret = iter->second->Archive( &msg, true);
-				if (ret == B_OK)
-					ret = msg.Flatten( &memIO);
-			}
+			ret = WriteCacheTable( memIO);
 			BM_LOG( BM_LogModelController, 
 					  BmString("ListModel <") << ModelName() 
 					  		<< "> finished with archive, writing to file...");
@@ -174,6 +269,82 @@ bool BmMailRefList::Store() {
 	return true;
 }
 
+/*------------------------------------------------------------------------------*\
+	WriteCacheTable( memIO)
+		-	writes the values of all mail-refs as binary cache-table
+\*------------------------------------------------------------------------------*/
+status_t BmMailRefList::WriteCacheTable( BMallocIO& memIO) {
+	uint32 rowCount = size();
+	vector<int64> inodes( rowCount), dirs( rowCount), whenCreated( rowCount), 
+		sizes( rowCount);
+	vector<int32> whens( rowCount);
+	vector<float> ratios( rowCount);
+	vector<uint32> strings( rowCount * BM_STRING_COLUMN_COUNT);
+	vector<uint8> flags( rowCount);
+	BmStringOBuf pool( 64 * MAX( rowCount, 1));
+	typedef map< BmString, uint32> BmPoolIndex;
+	BmPoolIndex poolIndex;
+
+	BmMailRefData data;
+	uint32 row = 0;
+	BmModelItemMap::const_iterator iter;
+	for( iter = begin(); iter != end(); ++iter, ++row) {
+		BmMailRef* ref = dynamic_cast< BmMailRef*>( iter->second.Get());
+		if (!ref)
+			return B_BAD_VALUE;
+		ref->GetData( data);
+		inodes[row] = data.inode;
+		dirs[row] = data.directory;
+		whenCreated[row] = data.whenCreated;
+		sizes[row] = data.size;
+		whens[row] = data.when;
+		ratios[row] = data.ratioSpam;
+		flags[row] = (data.isValid ? BM_ROWFLAG_VALID : 0)
+						| (data.hasAttachments ? BM_ROWFLAG_ATTACHMENTS : 0);
+		const char* rowStrings[BM_STRING_COLUMN_COUNT] = {
+			data.trackerName, data.account, data.cc, data.from, data.name, 
+			data.priority, data.replyTo, data.status, data.subject, data.to, 
+			data.identity, data.classification, data.imapUID
+		};
+		for( int col=0; col<BM_STRING_COLUMN_COUNT; ++col) {
+			// most of the short strings (status, account, identity...) are
+			// shared by many mails, so we store each string only once:
+			BmString str( rowStrings[col]);
+			BmPoolIndex::const_iterator pos = poolIndex.find( str);
+			uint32 offset;
+			if (pos == poolIndex.end()) {
+				offset = pool.CurrPos();
+				pool.Write( str.String(), str.Length()+1);
+				poolIndex[str] = offset;
+			} else
+				offset = pos->second;
+			strings[col * rowCount + row] = offset;
+		}
+	}
+
+	BmCacheTableHeader header;
+	header.magic = nCacheTableMagic;
+	header.rowCount = rowCount;
+	header.poolSize = pool.CurrPos();
+	header.reserved = 0;
+	uint64 tableSize = CacheTableSize( rowCount, header.poolSize);
+	ssize_t written = memIO.Write( &header, sizeof(header));
+	if (rowCount) {
+		written += memIO.Write( &inodes[0], rowCount * sizeof(int64));
+		written += memIO.Write( &dirs[0], rowCount * sizeof(int64));
+		written += memIO.Write( &whenCreated[0], rowCount * sizeof(int64));
+		written += memIO.Write( &sizes[0], rowCount * sizeof(int64));
+		written += memIO.Write( &whens[0], rowCount * sizeof(int32));
+		written += memIO.Write( &ratios[0], rowCount * sizeof(float));
+		written += memIO.Write( &strings[0], 
+										strings.size() * sizeof(uint32));
+		written += memIO.Write( &flags[0], rowCount * sizeof(uint8));
+	}
+	if (header.poolSize)
+		written += memIO.Write( pool.Buffer(), header.poolSize);
+	return (uint64)written == tableSize ? B_OK : B_IO_ERROR;
+}
+
 /*------------------------------------------------------------------------------*\
 	StartJob()
 		-	
@@ -195,6 +366,7 @@ bool BmMailRefList::StartJob() {
 	Freeze();									// we shut up for better performance
 	try {
 		bool cacheFileUpToDate = false;
+		int16 version = 0;
 		BmString filename = SettingsFileName();
 		BMessage msg;
 		{ // scope for lock
@@ -234,16 +406,40 @@ bool BmMailRefList::StartJob() {
 				if (!mNeedsCacheUpdate && !folder->CheckIfModifiedSince( mtime)) {
 					// archive up-to-date, but is it the correct format-version?
 					msg.Unflatten( &cacheFile);
-					int16 version;
 					if (msg.FindInt16( MSG_VERSION, &version) == B_OK 
-					&& version == nArchiveVersion)
+					&& (version == nArchiveVersion 
+						|| version == nLegacyArchiveVersion))
 						cacheFileUpToDate = true;
 				}
 			}
 		}
-		if (cacheFileUpToDate) {
-			// ...ok, cache-file should contain up-to-date info, 
-			// we fetch our data from it:
+		if (cacheFileUpToDate && version == nArchiveVersion) {
+			// ...ok, cache-file should contain up-to-date info, we read 
+			// the cache-table (and any stored actions) in one go and 
+			// create the mail-refs directly from its columns:
+			off_t sz = 0;
+			if ((err = cacheFile.GetSize(&sz)) != B_OK)
+				BM_THROW_RUNTIME( 
+					BmString("couldn't get size for cache-file <") << filename 
+						<< "> \n\nError:" << strerror(err)
+				);
+			sz -= cacheFile.Position();
+			vector<char> buf( size_t(sz) + 1);
+			if ((err = cacheFile.Read(&buf[0], size_t(sz))) < B_OK)
+				BM_THROW_RUNTIME( 
+					BmString("couldn't read from cache-file <") << filename 
+						<< "> \n\nError:" << strerror(err)
+				);
+			if (err < sz)
+				BM_THROW_RUNTIME( 
+					BmString("couldn't read ") << sz << " bytes from cache-file <"
+						<< filename << ">, read only " << err << " bytes"
+				);
+			InstantiateItemsFromCache( &buf[0], size_t(sz), &msg);
+		} else if (cacheFileUpToDate) {
+			// ...cache-file in old format (one archive per mail-ref), we 
+			// fetch our data from it (the cache will be rewritten in the
+			// current format when it is stored the next time):
 #ifdef __HAIKU__
 			// On haiku, this is considerably faster than unflattening from a file.
 			// TODO: find out why haiku is much slower than R5 in this!
@@ -270,6 +466,11 @@ bool BmMailRefList::StartJob() {
 #else
 			InstantiateItemsFromStream( &cacheFile, &msg);
 #endif
+			// rewrite the cache in the current format, unless the job has
+			// been stopped (the list has been cleaned up then and storing 
+			// it would wipe the cache):
+			if (InitCheck() == B_OK)
+				mNeedsStore = true;
 		} else {
 			// ...caching disabled or no cache file found or update 
 			// required/requested, we fetch the existing mails from disk...
@@ -308,10 +509,7 @@ BmRef<BmMailRef> BmMailRefList::AddMailRef( entry_ref& eref, struct stat& st) {
 				  BmString("Storing created-action for ref ") 
 				  	<< newMailRef->Key());
 		if (StoreAction(&action)) {
-			BmRef<BmMailFolder> folder( mFolder.Get());
-				// hold a ref on the corresponding folder while we use it
-			if (folder)
-				folder->BumpMailCount(1);
+			BumpFolderMailCount( 1);
 			return newMailRef;
 		}
 	}
@@ -340,12 +538,8 @@ BmRef<BmListModelItem> BmMailRefList::RemoveMailRef( const BmString& key) {
 		action.AddString( MSG_ITEMKEY, key.String());
 		BM_LOG( BM_LogMailTracking, 
 				  BmString("Storing removed-action for ref ") << key);
-		if (StoreAction(&action)) {
-			BmRef<BmMailFolder> folder( mFolder.Get());
-				// hold a ref on the corresponding folder while we use it
-			if (folder)
-				folder->BumpMailCount(-1);
-		}
+		if (StoreAction(&action))
+			BumpFolderMailCount( -1);
 	}
 	return removedRef;
 }
@@ -523,6 +717,130 @@ void BmMailRefList::InstantiateItemsFromStream( BDataIO* dataIO, BMessage* heade
 	}
 }
 
+/*------------------------------------------------------------------------------*\
+	InstantiateItemsFromCache( data, size, headerMsg)
+		-	creates all mail-refs from the binary cache-table in the given 
+			buffer and then executes any actions that have been stored after
+			the table
+\*------------------------------------------------------------------------------*/
+void BmMailRefList::InstantiateItemsFromCache( const char* data, size_t size,
+															  BMessage* headerMsg) {
+	if (!headerMsg)
+		return;
+
+	BMessage filterArchive;
+	if (headerMsg->FindMessage(MSG_FILTER_ARCHIVE, &filterArchive) == B_OK) {
+		BmMailRefFilter* filter = new BmMailRefFilter(&filterArchive);
+		SetFilter(filter);
+	}
+
+	BmCacheTableHeader header;
+	if (size < sizeof(header))
+		BM_THROW_RUNTIME( "Cache-file is truncated, please recreate cache.");
+	memcpy( &header, data, sizeof(header));
+	uint64 tableSize = CacheTableSize( header.rowCount, header.poolSize);
+	if (header.magic != nCacheTableMagic || tableSize > (uint64)size
+	|| header.rowCount != (uint32)FindMsgInt32( headerMsg, 
+															 BmListModelItem::MSG_NUMCHILDREN))
+		BM_THROW_RUNTIME( "Cache-file is corrupt, please recreate cache.");
+
+	// the columns are unaligned within the buffer (the header-message has
+	// an arbitrary size), so we copy the values out of them:
+	uint32 rows = header.rowCount;
+	const char* inodes = data + sizeof(header);
+	const char* dirs = inodes + rows * sizeof(int64);
+	const char* whenCreated = dirs + rows * sizeof(int64);
+	const char* sizes = whenCreated + rows * sizeof(int64);
+	const char* whens = sizes + rows * sizeof(int64);
+	const char* ratios = whens + rows * sizeof(int32);
+	const char* strings = ratios + rows * sizeof(float);
+	const uint8* flags = (const uint8*)(strings 
+						+ rows * BM_STRING_COLUMN_COUNT * sizeof(uint32));
+	const char* pool = (const char*)(flags + rows);
+
+	BmRef<BmMailFolder> folder( mFolder.Get());	
+							// hold a ref on the corresponding folder while we use it
+	BM_LOG( BM_LogMailTracking, 
+			  BmString("Start of InstantiateMailRefs() for folder ") 
+			  		<< folder->Name());
+	bool stopped = false;
+	BmMailRefData refData;
+	const char** rowStrings[BM_STRING_COLUMN_COUNT] = {
+		&refData.trackerName, &refData.account, &refData.cc, &refData.from, 
+		&refData.name, &refData.priority, &refData.replyTo, &refData.status, 
+		&refData.subject, &refData.to, &refData.identity, 
+		&refData.classification, &refData.imapUID
+	};
+	for( uint32 row=0; !stopped && row<rows; ++row) {
+		int64 i64;
+		int32 i32;
+		memcpy( &i64, inodes + row * sizeof(int64), sizeof(int64));
+		refData.inode = i64;
+		memcpy( &i64, dirs + row * sizeof(int64), sizeof(int64));
+		refData.directory = i64;
+		memcpy( &i64, whenCreated + row * sizeof(int64), sizeof(int64));
+		refData.whenCreated = i64;
+		memcpy( &i64, sizes + row * sizeof(int64), sizeof(int64));
+		refData.size = i64;
+		memcpy( &i32, whens + row * sizeof(int32), sizeof(int32));
+		refData.when = i32;
+		memcpy( &refData.ratioSpam, ratios + row * sizeof(float), sizeof(float));
+		refData.isValid = (flags[row] & BM_ROWFLAG_VALID) != 0;
+		refData.hasAttachments = (flags[row] & BM_ROWFLAG_ATTACHMENTS) != 0;
+		for( int col=0; col<BM_STRING_COLUMN_COUNT; ++col) {
+			uint32 offset;
+			memcpy( &offset, strings + (col * rows + row) * sizeof(uint32), 
+					  sizeof(uint32));
+			if (offset >= header.poolSize)
+				BM_THROW_RUNTIME( "Cache-file is corrupt, please recreate cache.");
+			*rowStrings[col] = pool + offset;
+		}
+		BmRef<BmMailRef> newRef( BmMailRef::CreateInstance( refData));
+		if (newRef) {
+			BM_LOG3( BM_LogMailTracking, 
+						BmString("MailRef <") << newRef->TrackerName() << "," 
+							<< newRef->Key() << "> read");
+			AddItemToList( newRef.Get());
+		}
+
+		if (!ShouldContinue()) {
+			stopped = true;
+			BM_LOG2( BM_LogMailTracking, 
+						BmString("InstantiateMailRefs() stopped for folder ") 
+							<< folder->Name());
+		}
+	}
+	{  // now lock the list, as we must avoid the race condition where the 
+		// node monitor appends to the file while we fetch appended items 
+		// from it
+		BmAutolockCheckGlobal lock( ModelLocker());
+		if (!lock.IsLocked())
+			BM_THROW_RUNTIME( ModelNameNC() << ": Unable to get lock");
+		bool needsStore = false;
+		if (!stopped) {
+			BM_LOG( BM_LogMailTracking, 
+					  BmString("Fetching stored actions for folder ")
+					  		<< folder->Name());
+			BMemoryIO actionIO( data + size_t(tableSize), 
+									  size - size_t(tableSize));
+			if (RestoreAndExecuteActionsFrom( &actionIO))
+				needsStore = true;
+		}
+		BM_LOG( BM_LogMailTracking, 
+				  BmString("End of InstantiateMailRefs() for folder ") 
+				  		<< folder->Name());
+		if (stopped) {
+			Cleanup();
+		} else {
+			folder->MailCount( ValidCount());
+			mNeedsCacheUpdate = false;
+			mNeedsStore = needsStore;
+				// overrule changes caused by reading the cache
+			mInitCheck = B_OK;
+		}
+	}
+}
+
 /*------------------------------------------------------------------------------*\
 	AddItemToList( item, parent)
 		-	extends base-method with automatic updating of the corresponding 
@@ -531,12 +849,8 @@ void BmMailRefList::InstantiateItemsFromStream( BDataIO* dataIO, BMessage* heade
 bool BmMailRefList::AddItemToList( BmListModelItem* item, 
 											  BmListModelItem* parent) {
 	bool res = inherited::AddItemToList( item, parent);
-	if (res && !Frozen()) {
-		BmRef<BmMailFolder> folder( mFolder.Get());
-			// hold a ref on the corresponding folder while we use it
-		if (folder && item->IsValid())
-			folder->BumpMailCount( 1);
-	}
+	if (res && !Frozen() && item->IsValid())
+		BumpFolderMailCount( 1);
 	return res;
 }
 
@@ -547,12 +861,8 @@ bool BmMailRefList::AddItemToList( BmListModelItem* item,
 \*------------------------------------------------------------------------------*/
 void BmMailRefList::RemoveItemFromList( BmListModelItem* item) {
 	inherited::RemoveItemFromList( item);
-	if (!Frozen()) {
-		BmRef<BmMailFolder> folder( mFolder.Get());
-			// hold a ref on the corresponding folder while we use it
-		if (folder && item->IsValid())
-			folder->BumpMailCount( -1);
-	}
+	if (!Frozen() && item->IsValid())
+		BumpFolderMailCount( -1);
 }
 
 /*------------------------------------------------------------------------------*\
@@ -563,12 +873,8 @@ void BmMailRefList::SetItemValidity( BmListModelItem* item, bool isValid) {
 	if (!item || item->IsValid() == isValid)
 		return;
 	inherited::SetItemValidity( item, isValid);
-	if (!Frozen()) {
-		BmRef<BmMailFolder> folder( mFolder.Get());
-			// hold a ref on the corresponding folder while we use it
-		if (folder)
-			folder->BumpMailCount( isValid ? 1 : -1);
-	}
+	if (!Frozen())
+		BumpFolderMailCount( isValid ? 1 : -1);
 }
 
 /*------------------------------------------------------------------------------*\
@@ -15,9 +15,20 @@
 
 #include "BmDataModel.h"
 
+class BMallocIO;
 class BmMailFolder;
 class BmMailRef;
 
+/*------------------------------------------------------------------------------*\
+	BmMailRefSpec
+		-	entry and stat-info of a mail that is added as part of a batch
+\*------------------------------------------------------------------------------*/
+struct BmMailRefSpec {
+	entry_ref eref;
+	struct stat st;
+};
+typedef vector< BmMailRefSpec> BmMailRefSpecVect;
+
 /*------------------------------------------------------------------------------*\
 	BmMailRefList
 		-	class 
@@ -26,6 +37,7 @@ class IMPEXPBMMAILKIT BmMailRefList : public BmListModel {
 	typedef BmListModel inherited;
 
 	static const int16 nArchiveVersion;
+	static const int16 nLegacyArchiveVersion;
 
 	static const char* const MSG_FILTER_ARCHIVE;
 
@@ -41,6 +53,8 @@ public:
 	void UpdateMailRef( const BmString& key);
 	void MarkCacheAsDirty();
 	void StoreAndCleanup();
+	void BeginMailCountBatch();
+	void EndMailCountBatch();
 
 	// overrides of list-model base:
 	bool Store();
@@ -65,13 +79,20 @@ protected:
 	// native methods:
 	void InitializeItems();
 	void InstantiateItemsFromStream( BDataIO* dataIO, BMessage* headerMsg = NULL);
+	void InstantiateItemsFromCache( const char* data, size_t size,
+											  BMessage* headerMsg);
+	status_t WriteCacheTable( BMallocIO& memIO);
 
 private:
 
+	void BumpFolderMailCount( int32 offset);
+
 	// the following members will NOT be archived at all:
 	BmWeakRef<BmMailFolder> mFolder;
 	bool mNeedsCacheUpdate;
 	BmString mSettingsFileName;
+	int32 mMailCountBatchDepth;
+	int32 mBatchedMailCountOffset;
 
 	// Hide copy-constructor and assignment:
 	BmMailRefList( const BmMailRefList&);
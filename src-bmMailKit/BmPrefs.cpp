@@ -23,6 +23,143 @@
 #include "BmUtil.h"
 
 
+/********************************************************************************\
+	BmPrefsSnapshot
+\********************************************************************************/
+
+/*------------------------------------------------------------------------------*\
+	BmPrefsSnapshot( prefsMsg, defaultsMsg)
+		-	c'tor, copies the given prefs (the defaults are never changed, so
+			we simply refer to them)
+\*------------------------------------------------------------------------------*/
+BmPrefsSnapshot::BmPrefsSnapshot( const BMessage& prefsMsg, 
+											 const BMessage& defaultsMsg)
+	:	mPrefsMsg( prefsMsg)
+	,	mDefaultsMsg( defaultsMsg)
+{
+}
+
+/********************************************************************************\
+	BmPrefsReader
+\********************************************************************************/
+
+/*------------------------------------------------------------------------------*\
+	BmPrefsReader( prefs)
+		-	c'tor, registers as active reader and fetches the current snapshot
+		-	the order matters: once we are counted, PublishSnapshot() won't 
+			delete any snapshot we might fetch
+\*------------------------------------------------------------------------------*/
+BmPrefsReader::BmPrefsReader( BmPrefs* prefs)
+	:	mPrefs( prefs)
+{
+	atomic_add( &mPrefs->mActiveReaderCount, 1);
+	atomic_add( &mPrefs->mSnapshotReadCount, 1);
+	mSnapshot = mPrefs->mSnapshot;
+}
+
+/*------------------------------------------------------------------------------*\
+	~BmPrefsReader()
+		-	d'tor, unregisters as active reader
+\*------------------------------------------------------------------------------*/
+BmPrefsReader::~BmPrefsReader()
+{
+	atomic_add( &mPrefs->mActiveReaderCount, -1);
+}
+
+/*------------------------------------------------------------------------------*\
+	FindBool( name, val)
+		-	fetches the prefs-value (a boolean) of the given name, falling back
+			to the defaults if the prefs do not contain it
+\*------------------------------------------------------------------------------*/
+bool BmPrefsSnapshot::FindBool( const char* name, bool& val) const {
+	return mPrefsMsg.FindBool( name, &val) == B_OK
+		|| mDefaultsMsg.FindBool( name, &val) == B_OK;
+}
+
+/*------------------------------------------------------------------------------*\
+	FindInt( name, val)
+		-	fetches the prefs-value (an integer) of the given name, falling back
+			to the defaults if the prefs do not contain it
+\*------------------------------------------------------------------------------*/
+bool BmPrefsSnapshot::FindInt( const char* name, int32& val) const {
+	return mPrefsMsg.FindInt32( name, &val) == B_OK
+		|| mDefaultsMsg.FindInt32( name, &val) == B_OK;
+}
+
+/*------------------------------------------------------------------------------*\
+	FindString( name, val)
+		-	fetches the prefs-value (a string) of the given name, falling back
+			to the defaults if the prefs do not contain it
+		-	the returned string belongs to the snapshot
+\*------------------------------------------------------------------------------*/
+bool BmPrefsSnapshot::FindString( const char* name, const char*& val) const {
+	return mPrefsMsg.FindString( name, &val) == B_OK
+		|| mDefaultsMsg.FindString( name, &val) == B_OK;
+}
+
+/********************************************************************************\
+	BmCachedIntPref, BmCachedStringPref
+\********************************************************************************/
+
+/*------------------------------------------------------------------------------*\
+	BmCachedIntPref( name, defaultVal)
+		-	c'tor
+\*------------------------------------------------------------------------------*/
+BmCachedIntPref::BmCachedIntPref( const char* name, int32 defaultVal)
+	:	mName( name)
+	,	mDefaultVal( defaultVal)
+	,	mValue( defaultVal)
+	,	mGeneration( -1)
+{
+}
+
+/*------------------------------------------------------------------------------*\
+	Value()
+		-	returns the current value, which is only looked up again if the
+			prefs have changed since the last call
+\*------------------------------------------------------------------------------*/
+int32 BmCachedIntPref::Value() {
+	int32 generation = ThePrefs->Generation();
+	if (generation != mGeneration) {
+		mValue = ThePrefs->GetInt( mName, mDefaultVal);
+		mGeneration = generation;
+	} else
+		ThePrefs->CountCachedRead();
+	return mValue;
+}
+
+/*------------------------------------------------------------------------------*\
+	BmCachedStringPref( name, defaultVal)
+		-	c'tor
+\*------------------------------------------------------------------------------*/
+BmCachedStringPref::BmCachedStringPref( const char* name, 
+													 const BmString& defaultVal)
+	:	mName( name)
+	,	mDefaultVal( defaultVal)
+	,	mValue( defaultVal)
+	,	mGeneration( -1)
+{
+}
+
+/*------------------------------------------------------------------------------*\
+	Value()
+		-	returns the current value, which is only looked up again if the
+			prefs have changed since the last call
+\*------------------------------------------------------------------------------*/
+const BmString& BmCachedStringPref::Value() {
+	int32 generation = ThePrefs->Generation();
+	if (generation != mGeneration) {
+		mValue = ThePrefs->GetString( mName, mDefaultVal);
+		mGeneration = generation;
+	} else
+		ThePrefs->CountCachedRead();
+	return mValue;
+}
+
+/********************************************************************************\
+	BmPrefs
+\********************************************************************************/
+
 BmPrefs* BmPrefs::theInstance = NULL;
 
 const char* const BmPrefs::PREFS_FILENAME = 	"General Settings";
@@ -128,10 +265,18 @@ BmPrefs* BmPrefs::CreateInstance() {
 BmPrefs::BmPrefs( void)
 	:	BArchivable() 
 	,	mLocker( "PrefsLock")
+	,	mSnapshot( NULL)
+	,	mGeneration( 0)
+	,	mActiveReaderCount( 0)
+	,	mSnapshotReadCount( 0)
+	,	mCachedReadCount( 0)
+	,	mLockedReadCount( 0)
+	,	mLastStatisticsTime( system_time())
 {
 	theInstance = this;
 	InitDefaults(mDefaultsMsg);
 	mSavedPrefsMsg = mPrefsMsg = mDefaultsMsg;
+	PublishSnapshot();
 	SetLoglevels();
 	SetupMailboxVolume();
 	if (mPrefsMsg.FindMessage( "Shortcuts", &mShortcutsMsg) != B_OK)
@@ -147,6 +292,13 @@ BmPrefs::BmPrefs( void)
 BmPrefs::BmPrefs( BMessage* archive) 
 	:	BArchivable( archive)
 	,	mLocker( "PrefsLock")
+	,	mSnapshot( NULL)
+	,	mGeneration( 0)
+	,	mActiveReaderCount( 0)
+	,	mSnapshotReadCount( 0)
+	,	mCachedReadCount( 0)
+	,	mLockedReadCount( 0)
+	,	mLastStatisticsTime( system_time())
 {
 	theInstance = this;
 	InitDefaults(mDefaultsMsg);
@@ -331,6 +483,7 @@ BmPrefs::BmPrefs( BMessage* archive)
 		mPrefsMsg.AddString( "IconPath", defaultIconPath.String());
 	}
 	mSavedPrefsMsg = mPrefsMsg;
+	PublishSnapshot();
 	
 	SetLoglevels();
 	SetupMailboxVolume();
@@ -352,6 +505,9 @@ BmPrefs::BmPrefs( BMessage* archive)
 \*------------------------------------------------------------------------------*/
 BmPrefs::~BmPrefs() {
 	theInstance = NULL;
+	for( uint32 i=0; i<mRetiredSnapshots.size(); ++i)
+		delete mRetiredSnapshots[i];
+	delete mSnapshot;
 }
 
 /*------------------------------------------------------------------------------*\
@@ -363,6 +519,7 @@ void BmPrefs::ResetToSaved() {
 	if (!lock.IsLocked())
 		BM_THROW_RUNTIME( "Prefs: Unable to get lock!");
 	mPrefsMsg = mSavedPrefsMsg;
+	PublishSnapshot();
 	SetLoglevels();
 	if (mPrefsMsg.FindMessage( "Shortcuts", &mShortcutsMsg) == B_OK) {
 		// add any missing (new) shortcuts:
@@ -382,6 +539,7 @@ void BmPrefs::ResetToDefault() {
 	if (!lock.IsLocked())
 		BM_THROW_RUNTIME( "Prefs: Unable to get lock!");
 	mPrefsMsg = mDefaultsMsg;
+	PublishSnapshot();
 	SetLoglevels();
 	mShortcutsMsg.MakeEmpty();
 	GetShortcutDefaults( &mShortcutsMsg);
@@ -447,6 +605,7 @@ void BmPrefs::InitDefaults(BMessage& defaultsMsg) {
 	defaultsMsg.AddBool( "DynamicStatusWin", true);
 	defaultsMsg.AddInt32( "ExpandCollapseDelay", 1000);
 	defaultsMsg.AddInt32( "FeedbackTimeout", 200);
+	defaultsMsg.AddInt32( "FilterThreads", 0);
 	defaultsMsg.AddString( "ForwardIntroStr", "On %d at %t, %f wrote:");
 	defaultsMsg.AddString( "ForwardSubjectRX", 
 									"^\\s*\\[?\\s*Fwd(\\[\\d+\\])?:");
@@ -458,8 +617,14 @@ void BmPrefs::InitDefaults(BMessage& defaultsMsg) {
 	defaultsMsg.AddString( "HeaderListSmall", "Subject,From,Date");
 	BmString defaultIconPath = BeamRoster->AppPath() + nDefaultIconset;
 	defaultsMsg.AddString( "IconPath", defaultIconPath.String());
+	defaultsMsg.AddInt32( "ImapFetchWindow", 20);
+	defaultsMsg.AddInt32( "ImapFetchWindowSize", 4*1024*1024);
+	defaultsMsg.AddInt32( "ImapIdleRenewal", 10);
+	defaultsMsg.AddBool( "ImapIncrementalSync", true);
+	defaultsMsg.AddBool( "ImapUseIdle", true);
 	defaultsMsg.AddBool( "InOutAlwaysAtTop", true);
 	defaultsMsg.AddBool( "ImportExportTextAsUtf8", true);
+	defaultsMsg.AddInt32( "LazyLoadThreshold", 256*1024);
 	defaultsMsg.AddString( "ListFields", "Mail-Followup-To,Reply-To");
 	defaultsMsg.AddBool( "ListviewLikeTracker", false);
 	defaultsMsg.AddInt32( "ListviewFlatMinItemHeight", 16);
@@ -473,10 +638,14 @@ void BmPrefs::InitDefaults(BMessage& defaultsMsg) {
 	defaultsMsg.AddBool( "MakeQPSafeForEBCDIC", true);
 	defaultsMsg.AddBool( "MapClassificationGenuineToTofu", true);
 	defaultsMsg.AddInt32( "MarkAsReadDelay", 500);
+	defaultsMsg.AddInt32( "MaxBytesWaitingForFilters", 16*1024*1024);
 	defaultsMsg.AddInt32( "MaxLineLen", 76);
 	defaultsMsg.AddInt32( "MaxLineLenForHardWrap", 998);
 	defaultsMsg.AddInt32( "MinLogfileSize", 50*1024);
 	defaultsMsg.AddInt32( "MaxLogfileSize", 200*1024);
+	defaultsMsg.AddInt32( "MaxMailsWaitingForFilters", 100);
+	defaultsMsg.AddInt32( "MaxNetworkJobs", 3);
+	defaultsMsg.AddInt32( "MaxNetworkJobsPerServer", 2);
 	defaultsMsg.AddBool( "NeverExceed78Chars", false);
 	defaultsMsg.AddString( 
 		"MimeTypeTrustInfo", 
@@ -496,6 +665,7 @@ void BmPrefs::InitDefaults(BMessage& defaultsMsg) {
 									"^((?:\\w?\\w?\\w?[>|]|[ \\t]*)*)(.*?)$");
 	defaultsMsg.AddString( "QuotingString", "> ");
 	defaultsMsg.AddString( "PeopleFolder", "/boot/home/people");
+	defaultsMsg.AddInt32( "PopPipelineWindow", 8);
 	defaultsMsg.AddBool( "PreferReplyToList", true);
 	defaultsMsg.AddBool( "PreferUserAgentOverX-Mailer", true);
 	defaultsMsg.AddInt32( "PulsedScrollDelay", 100);
@@ -515,6 +685,8 @@ void BmPrefs::InitDefaults(BMessage& defaultsMsg) {
 	defaultsMsg.AddBool( "ShowToolbarIcons", true);
 	defaultsMsg.AddString( "ShowToolbarLabel", "Right");
 	defaultsMsg.AddBool( "ShowTooltips", true);
+	defaultsMsg.AddInt32( "SmtpChunkSize", 1024*1024);
+	defaultsMsg.AddInt32( "SmtpPipelineWindow", 100);
 	defaultsMsg.AddString( "SignatureRX", "^---?\\s*\\n");
 	defaultsMsg.AddInt32( "SpacesPerTab", 4);
 	defaultsMsg.AddBool("SpecialHeaderForEachBcc", false);
@@ -645,25 +817,25 @@ BMessage* BmPrefs::GetShortcutDefaults( BMessage* shortcutsMsg) {
 uint32 BmPrefs::GetNumericLogLevelFor( uint32 terrain) {
 	uint32 level = 0;
 	if (terrain == BM_LogRecv)
-		level = mPrefsMsg.FindInt32("Loglevel_Recv");
+		level = GetInt( "Loglevel_Recv", 0);
 	else if (terrain == BM_LogSmtp)
-		level = mPrefsMsg.FindInt32("Loglevel_Smtp");
+		level = GetInt( "Loglevel_Smtp", 0);
 	else if (terrain == BM_LogApp)
-		level = mPrefsMsg.FindInt32("Loglevel_App");
+		level = GetInt( "Loglevel_App", 0);
 	else if (terrain == BM_LogFilter)
-		level = mPrefsMsg.FindInt32("Loglevel_Filter");
+		level = GetInt( "Loglevel_Filter", 0);
 	else if (terrain == BM_LogMailParse)
-		level = mPrefsMsg.FindInt32("Loglevel_MailParse");
+		level = GetInt( "Loglevel_MailParse", 0);
 	else if (terrain == BM_LogMailTracking)
-		level = mPrefsMsg.FindInt32("Loglevel_MailTracking");
+		level = GetInt( "Loglevel_MailTracking", 0);
 	else if (terrain == BM_LogJobWin)
-		level = mPrefsMsg.FindInt32("Loglevel_JobWin");
+		level = GetInt( "Loglevel_JobWin", 0);
 	else if (terrain == BM_LogGui)
-		level = mPrefsMsg.FindInt32("Loglevel_Gui");
+		level = GetInt( "Loglevel_Gui", 0);
 	else if (terrain == BM_LogModelController)
-		level = mPrefsMsg.FindInt32("Loglevel_ModelController");
+		level = GetInt( "Loglevel_ModelController", 0);
 	else if (terrain == BM_LogRefCount)
-		level = mPrefsMsg.FindInt32("Loglevel_RefCount");
+		level = GetInt( "Loglevel_RefCount", 0);
 	return level;
 }
 /*------------------------------------------------------------------------------*\
@@ -698,6 +870,9 @@ void BmPrefs::SetLogLevelForTo( uint32 terrain, BmString loglevel) {
 	else
 		level = 0;
 
+	BAutolock lock( mLocker);
+	if (!lock.IsLocked())
+		BM_THROW_RUNTIME( "Prefs: Unable to get lock!");
 	if (terrain == BM_LogRecv)
 		mPrefsMsg.ReplaceInt32("Loglevel_Recv", level);
 	else if (terrain == BM_LogSmtp)
@@ -718,6 +893,7 @@ void BmPrefs::SetLogLevelForTo( uint32 terrain, BmString loglevel) {
 		mPrefsMsg.ReplaceInt32("Loglevel_ModelController", level);
 	else if (terrain == BM_LogRefCount)
 		mPrefsMsg.ReplaceInt32("Loglevel_RefCount", level);
+	PublishSnapshot();
 	
 	SetLoglevels();
 }
@@ -758,6 +934,77 @@ void BmPrefs::SetLoglevels() {
 				BmString("Initialized log levels to binary value ") << s);
 }
 
+/*------------------------------------------------------------------------------*\
+	PublishSnapshot( )
+		-	replaces the current snapshot by a fresh copy of the prefs and bumps
+			the prefs-generation (which invalidates all cached prefs-values)
+		-	the caller is expected to hold the prefs-lock (unless we are just
+			being constructed)
+		-	a replaced snapshot may still be in use by a reader, so it is kept
+			until no reader is active anymore
+\*------------------------------------------------------------------------------*/
+void BmPrefs::PublishSnapshot() {
+	BmPrefsSnapshot* oldSnapshot = mSnapshot;
+	mSnapshot = new BmPrefsSnapshot( mPrefsMsg, mDefaultsMsg);
+	atomic_add( &mGeneration, 1);
+							// (the atomic operation makes sure the new snapshot
+							// is visible before we look at the readers)
+	if (oldSnapshot)
+		mRetiredSnapshots.push_back( oldSnapshot);
+	ReclaimRetiredSnapshots();
+}
+
+/*------------------------------------------------------------------------------*\
+	ReclaimRetiredSnapshots( )
+		-	deletes all replaced snapshots if no reader is active: any reader 
+			that comes along later fetches the current snapshot, so nobody can
+			refer to a replaced one anymore
+		-	if there are active readers, the replaced snapshots are kept until
+			the next time the prefs are published (they are small and readers
+			are short-lived, so they will not pile up)
+		-	the caller is expected to hold the prefs-lock
+\*------------------------------------------------------------------------------*/
+void BmPrefs::ReclaimRetiredSnapshots() {
+	if (atomic_get( &mActiveReaderCount) != 0)
+		return;
+	for( uint32 i=0; i<mRetiredSnapshots.size(); ++i)
+		delete mRetiredSnapshots[i];
+	mRetiredSnapshots.clear();
+}
+
+/*------------------------------------------------------------------------------*\
+	RetiredSnapshotCount( )
+		-	returns the number of replaced snapshots that have not been 
+			deleted yet
+\*------------------------------------------------------------------------------*/
+uint32 BmPrefs::RetiredSnapshotCount() {
+	BAutolock lock( mLocker);
+	return mRetiredSnapshots.size();
+}
+
+/*------------------------------------------------------------------------------*\
+	LogReadStatistics( )
+		-	logs how often the prefs have been read (per second) since the last 
+			call, split by the kind of access
+\*------------------------------------------------------------------------------*/
+void BmPrefs::LogReadStatistics() {
+	bigtime_t now = system_time();
+	int32 snapshotReads = atomic_and( &mSnapshotReadCount, 0);
+	int32 cachedReads = atomic_and( &mCachedReadCount, 0);
+	int32 lockedReads = atomic_and( &mLockedReadCount, 0);
+	double secs = (now - mLastStatisticsTime) / 1000000.0;
+	mLastStatisticsTime = now;
+	if (secs <= 0)
+		return;
+	BM_LOG( BM_LogApp, 
+			  BmString("Prefs were read ") 
+			  	<< (snapshotReads+cachedReads+lockedReads) / secs 
+			  	<< " times per second during the last " << secs 
+			  	<< " seconds (snapshot: " << snapshotReads / secs
+			  	<< ", cached: " << cachedReads / secs
+			  	<< ", locked: " << lockedReads / secs << ")");
+}
+
 /*------------------------------------------------------------------------------*\
 	SetupMailboxVolume( )
 		-	
@@ -844,6 +1091,7 @@ bool BmPrefs::Store() {
 
 		// update saved state to current:
 		mSavedPrefsMsg = mPrefsMsg;
+		PublishSnapshot();
 	} catch( BM_error &e) {
 		BM_SHOWERR( e.what());
 		return false;
@@ -854,153 +1102,109 @@ bool BmPrefs::Store() {
 /*------------------------------------------------------------------------------*\
 	GetString( name)
 		-	returns the prefs-value (a string) for the given name
-		-	if the current prefs do not contain such a value, the value is copied
-			over from the defaults-msg
+		-	if the current prefs do not contain such a value, the value is taken
+			from the defaults-msg
 		-	if neither the current prefs nor the defaults-msg contain the specified
 			value, an error message is shown
+		-	reads from the current snapshot, so no lock is required
 \*------------------------------------------------------------------------------*/
 BmString BmPrefs::GetString( const char* name) {
-	BAutolock lock( mLocker);
-	if (!lock.IsLocked())
-		BM_THROW_RUNTIME( "Prefs: Unable to get lock!");
 	const char* val;
-	if (mPrefsMsg.FindString( name, &val) == B_OK)
+	BmPrefsReader snapshot( this);
+	if (snapshot->FindString( name, val))
 		return val;
-	else {
-		if (mDefaultsMsg.FindString( name, &val) == B_OK) {
-			mPrefsMsg.AddString( name, val);
-			return val;
-		} else {
-			BM_SHOWERR( BmString("The preferences-field ") << name 
-								<< " of type string is unknown");
-			return "";
-		}
-	}
+	BM_SHOWERR( BmString("The preferences-field ") << name 
+						<< " of type string is unknown");
+	return "";
 }
 
 /*------------------------------------------------------------------------------*\
 	GetString( name, defaultVal)
 		-	returns the prefs-value (a string) for the given name
-		-	if the current prefs do not contain such a value, the value is copied
-			over from the defaults-msg
+		-	if the current prefs do not contain such a value, the value is taken
+			from the defaults-msg
 		-	if neither the current prefs nor the defaults-msg contain the specified
 			value, the given default-value is returned
+		-	reads from the current snapshot, so no lock is required
 \*------------------------------------------------------------------------------*/
-BmString BmPrefs::GetString( const char* name, const BmString defaultVal) {
-	BAutolock lock( mLocker);
-	if (!lock.IsLocked())
-		BM_THROW_RUNTIME( "Prefs: Unable to get lock!");
+BmString BmPrefs::GetString( const char* name, 
+									  const BmString& defaultVal) {
 	const char* val;
-	if (mPrefsMsg.FindString( name, &val) == B_OK)
+	BmPrefsReader snapshot( this);
+	if (snapshot->FindString( name, val))
 		return val;
-	else {
-		if (mDefaultsMsg.FindString( name, &val) == B_OK) {
-			mPrefsMsg.AddString( name, val);
-			return val;
-		} else
-			return defaultVal;
-	}
+	return defaultVal;
 }
 
 /*------------------------------------------------------------------------------*\
 	GetBool( name)
 		-	returns the prefs-value (a boolean) for the given name
-		-	if the current prefs do not contain such a value, the value is copied
-			over from the defaults-msg
+		-	if the current prefs do not contain such a value, the value is taken
+			from the defaults-msg
 		-	if neither the current prefs nor the defaults-msg contain the specified
 			value, an error message is shown
+		-	reads from the current snapshot, so no lock is required
 \*------------------------------------------------------------------------------*/
 bool BmPrefs::GetBool( const char* name) {
-	BAutolock lock( mLocker);
-	if (!lock.IsLocked())
-		BM_THROW_RUNTIME( "Prefs: Unable to get lock!");
 	bool val;
-	if (mPrefsMsg.FindBool( name, &val) == B_OK)
+	BmPrefsReader snapshot( this);
+	if (snapshot->FindBool( name, val))
 		return val;
-	else {
-		if (mDefaultsMsg.FindBool( name, &val) == B_OK) {
-			mPrefsMsg.AddBool( name, val);
-			return val;
-		} else {
-			BM_SHOWERR( BmString("The preferences-field ") << name << " of type bool is unknown");
-			return false;
-		}
-	}
+	BM_SHOWERR( BmString("The preferences-field ") << name << " of type bool is unknown");
+	return false;
 }
 
 /*------------------------------------------------------------------------------*\
 	GetBool( name, defaultVal)
 		-	returns the prefs-value (a boolean) for the given name
-		-	if the current prefs do not contain such a value, the value is copied
-			over from the defaults-msg
+		-	if the current prefs do not contain such a value, the value is taken
+			from the defaults-msg
 		-	if neither the current prefs nor the defaults-msg contain the specified
 			value, the given default-value is returned
+		-	reads from the current snapshot, so no lock is required
 \*------------------------------------------------------------------------------*/
 bool BmPrefs::GetBool( const char* name, const bool defaultVal) {
-	BAutolock lock( mLocker);
-	if (!lock.IsLocked())
-		BM_THROW_RUNTIME( "Prefs: Unable to get lock!");
 	bool val;
-	if (mPrefsMsg.FindBool( name, &val) == B_OK)
+	BmPrefsReader snapshot( this);
+	if (snapshot->FindBool( name, val))
 		return val;
-	else {
-		if (mDefaultsMsg.FindBool( name, &val) == B_OK) {
-			mPrefsMsg.AddBool( name, val);
-			return val;
-		} else
-			return defaultVal;
-	}
+	return defaultVal;
 }
 
 /*------------------------------------------------------------------------------*\
 	GetInt( name)
 		-	returns the prefs-value (an integer) for the given name
-		-	if the current prefs do not contain such a value, the value is copied
-			over from the defaults-msg
+		-	if the current prefs do not contain such a value, the value is taken
+			from the defaults-msg
 		-	if neither the current prefs nor the defaults-msg contain the specified
 			value, an error message is shown
+		-	reads from the current snapshot, so no lock is required
 \*------------------------------------------------------------------------------*/
 int32 BmPrefs::GetInt( const char* name) {
-	BAutolock lock( mLocker);
-	if (!lock.IsLocked())
-		BM_THROW_RUNTIME( "Prefs: Unable to get lock!");
 	int32 val;
-	if (mPrefsMsg.FindInt32( name, &val) == B_OK)
+	BmPrefsReader snapshot( this);
+	if (snapshot->FindInt( name, val))
 		return val;
-	else {
-		if (mDefaultsMsg.FindInt32( name, &val) == B_OK) {
-			mPrefsMsg.AddInt32( name, val);
-			return val;
-		} else {
-			BM_SHOWERR( BmString("The preferences-field ") << name 
-								<< " of type int32 is unknown");
-			return 0;
-		}
-	}
+	BM_SHOWERR( BmString("The preferences-field ") << name 
+						<< " of type int32 is unknown");
+	return 0;
 }
 
 /*------------------------------------------------------------------------------*\
 	GetInt( name, defaultVal)
 		-	returns the prefs-value (an integer) for the given name
-		-	if the current prefs do not contain such a value, the value is copied
-			over from the defaults-msg
+		-	if the current prefs do not contain such a value, the value is taken
+			from the defaults-msg
 		-	if neither the current prefs nor the defaults-msg contain the specified
 			value, the given default-value is returned
+		-	reads from the current snapshot, so no lock is required
 \*------------------------------------------------------------------------------*/
 int32 BmPrefs::GetInt( const char* name, const int32 defaultVal) {
-	BAutolock lock( mLocker);
-	if (!lock.IsLocked())
-		BM_THROW_RUNTIME( "Prefs: Unable to get lock!");
 	int32 val;
-	if (mPrefsMsg.FindInt32( name, &val) == B_OK)
+	BmPrefsReader snapshot( this);
+	if (snapshot->FindInt( name, val))
 		return val;
-	else {
-		if (mDefaultsMsg.FindInt32( name, &val) == B_OK) {
-			mPrefsMsg.AddInt32( name, val);
-			return val;
-		} else
-			return defaultVal;
-	}
+	return defaultVal;
 }
 
 /*------------------------------------------------------------------------------*\
@@ -1016,6 +1220,7 @@ BMessage* BmPrefs::GetMsg( const char* name) {
 	BAutolock lock( mLocker);
 	if (!lock.IsLocked())
 		BM_THROW_RUNTIME( "Prefs: Unable to get lock!");
+	atomic_add( &mLockedReadCount, 1);
 	BMessage* msg = new BMessage();
 	if (mPrefsMsg.FindMessage( name, msg) == B_OK) {
 		return msg;
@@ -1044,6 +1249,7 @@ void BmPrefs::SetBool( const char* name, const bool val) {
 		BM_THROW_RUNTIME( "Prefs: Unable to get lock!");
 	mPrefsMsg.RemoveName( name);
 	mPrefsMsg.AddBool( name, val);
+	PublishSnapshot();
 }
 
 /*------------------------------------------------------------------------------*\
@@ -1058,6 +1264,7 @@ void BmPrefs::SetInt( const char* name, const int32 val) {
 		BM_THROW_RUNTIME( "Prefs: Unable to get lock!");
 	mPrefsMsg.RemoveName( name);
 	mPrefsMsg.AddInt32( name, val);
+	PublishSnapshot();
 }
 
 /*------------------------------------------------------------------------------*\
@@ -1073,6 +1280,7 @@ void BmPrefs::SetMsg( const char* name, const BMessage* val) {
 		BM_THROW_RUNTIME( "Prefs: Unable to get lock!");
 	mPrefsMsg.RemoveName( name);
 	mPrefsMsg.AddMessage( name, val);
+	PublishSnapshot();
 }
 
 /*------------------------------------------------------------------------------*\
@@ -1087,4 +1295,5 @@ void BmPrefs::SetString( const char* name, const BmString val) {
 		BM_THROW_RUNTIME( "Prefs: Unable to get lock!");
 	mPrefsMsg.RemoveName( name);
 	mPrefsMsg.AddString( name, val.String());
+	PublishSnapshot();
 }
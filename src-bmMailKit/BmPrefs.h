@@ -11,6 +11,8 @@
 
 #include "BmMailKit.h"
 
+#include <vector>
+
 #include <Archivable.h>
 #include <Locker.h>
 #include <Message.h>
@@ -18,6 +20,33 @@
 #include <Volume.h>
 #include "BmString.h"
 
+using std::vector;
+
+/*------------------------------------------------------------------------------*\
+	BmPrefsSnapshot
+		-	an immutable copy of the preferences at a specific point in time
+		-	a new snapshot is published whenever the prefs are changed, so
+			reading from a snapshot does not require the prefs-lock
+\*------------------------------------------------------------------------------*/
+class IMPEXPBMMAILKIT BmPrefsSnapshot {
+
+public:
+	BmPrefsSnapshot( const BMessage& prefsMsg, const BMessage& defaultsMsg);
+
+	// native methods:
+	bool FindBool( const char* name, bool& val) const;
+	bool FindInt( const char* name, int32& val) const;
+	bool FindString( const char* name, const char*& val) const;
+
+private:
+	BMessage mPrefsMsg;
+	const BMessage& mDefaultsMsg;
+
+	// Hide copy-constructor and assignment:
+	BmPrefsSnapshot( const BmPrefsSnapshot&);
+	BmPrefsSnapshot operator=( const BmPrefsSnapshot&);
+};
+
 /*------------------------------------------------------------------------------*\
 	BmPrefs 
 		-	holds preference information for Beam
@@ -27,6 +56,8 @@
 class IMPEXPBMMAILKIT BmPrefs : public BArchivable {
 	typedef BArchivable inherited;
 
+	friend class BmPrefsReader;
+
 	static const char* const PREFS_FILENAME;
 
 	static const char* const MSG_VERSION;
@@ -48,7 +79,7 @@ public:
 	int32 GetInt( const char* name, const int32 defaultVal);
 	BMessage* GetMsg( const char* name);
 	BmString GetString( const char* name);
-	BmString GetString( const char* name, const BmString defaultVal);
+	BmString GetString( const char* name, const BmString& defaultVal);
 	void SetBool( const char* name, const bool val);
 	void SetInt( const char* name, const int32 val);
 	void SetMsg( const char* name, const BMessage* val);
@@ -60,6 +91,9 @@ public:
 	BmString GetShortcutFor( const char* shortcutID);
 	void SetShortcutFor( const char* name, const BmString val);
 
+	void LogReadStatistics();
+	inline void CountCachedRead()		{ atomic_add( &mCachedReadCount, 1); }
+
 	uint32 GetNumericLogLevelFor( uint32 terrain);
 	const char* GetLogLevelFor( uint32 terrain);
 	void SetLogLevelForTo( uint32 terrain, BmString level);
@@ -67,6 +101,8 @@ public:
 	// getters:
 	BMessage* ShortcutsMsg()				{ return &mShortcutsMsg; }
 	BLocker& Locker()							{ return mLocker; }
+	inline int32 Generation()				{ return atomic_get( &mGeneration); }
+	uint32 RetiredSnapshotCount();
 
 	static BmPrefs* theInstance;
 
@@ -86,6 +122,8 @@ public:
 private:
 
 	void SetLoglevels();
+	void PublishSnapshot();
+	void ReclaimRetiredSnapshots();
 	static void InitDefaults(BMessage& defaultsMsg);
 	static BMessage* GetShortcutDefaults( BMessage* msg=NULL);
 	static void SetShortcutIfNew( BMessage* msg, const char* name, const BmString val);
@@ -97,6 +135,21 @@ private:
 
 	BLocker mLocker;
 
+	// the snapshot all typed getters read from (it is never modified, but
+	// replaced as a whole by PublishSnapshot()):
+	BmPrefsSnapshot* volatile mSnapshot;
+	int32 mGeneration;
+	// replaced snapshots may still be in use by readers, so they are only
+	// deleted once no reader is active:
+	vector<BmPrefsSnapshot*> mRetiredSnapshots;
+	int32 mActiveReaderCount;
+
+	// read-counters (for LogReadStatistics()):
+	int32 mSnapshotReadCount;
+	int32 mCachedReadCount;
+	int32 mLockedReadCount;
+	bigtime_t mLastStatisticsTime;
+
 	// Hide copy-constructor and assignment:
 	BmPrefs( const BmPrefs&);
 	BmPrefs operator=( const BmPrefs&);
@@ -105,4 +158,65 @@ private:
 
 #define ThePrefs BmPrefs::theInstance
 
+/*------------------------------------------------------------------------------*\
+	BmPrefsReader
+		-	pins the current prefs-snapshot for as long as the reader exists,
+			i.e. the snapshot will not be deleted while it is being read
+\*------------------------------------------------------------------------------*/
+class IMPEXPBMMAILKIT BmPrefsReader {
+
+public:
+	BmPrefsReader( BmPrefs* prefs);
+	~BmPrefsReader();
+
+	// operators:
+	inline const BmPrefsSnapshot* operator->() const
+													{ return mSnapshot; }
+
+private:
+	BmPrefs* mPrefs;
+	const BmPrefsSnapshot* mSnapshot;
+
+	// Hide copy-constructor and assignment:
+	BmPrefsReader( const BmPrefsReader&);
+	BmPrefsReader operator=( const BmPrefsReader&);
+};
+
+/*------------------------------------------------------------------------------*\
+	BmCachedIntPref, BmCachedStringPref
+		-	handles for prefs-values that are read on hot paths: the name is
+			resolved only when the prefs have changed (i.e. when the prefs-
+			generation differs from the one the cached value belongs to)
+		-	an instance must not be shared between threads, as the cached
+			value itself is not protected
+\*------------------------------------------------------------------------------*/
+class IMPEXPBMMAILKIT BmCachedIntPref {
+
+public:
+	BmCachedIntPref( const char* name, int32 defaultVal);
+
+	int32 Value();
+
+private:
+	const char* mName;
+	int32 mDefaultVal;
+	int32 mValue;
+	int32 mGeneration;
+};
+
+class IMPEXPBMMAILKIT BmCachedStringPref {
+
+public:
+	BmCachedStringPref( const char* name, const BmString& defaultVal);
+
+	const BmString& Value();
+
+private:
+	const char* mName;
+	BmString mDefaultVal;
+	BmString mValue;
+	int32 mGeneration;
+};
+
+
 #endif
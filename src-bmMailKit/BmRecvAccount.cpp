@@ -383,19 +383,64 @@ BmString BmRecvAccount
 			BmString uid = curr->first;
 			removedInfo << "Removed local UID " << uid
 							<< " since it is not listed by the server anymore.\n";
-			// remove the UID...
-			mUIDs.erase(curr);
-			// ...and append info about removed UID to settings-file
-			// (just in order to be sure not to lose any info in case of a crash...):
-			BMessage action( BM_REMOVE_UID);
-			action.AddString( BmListModel::MSG_ITEMKEY, Key().String());
-			action.AddString( MSG_UID, uid.String());
-			TheRecvAccountList->StoreAction(&action);
+			RemoveUid( uid);
 		}
 	}
 	return removedInfo;
 }
 
+/*------------------------------------------------------------------------------*\
+	RemoveVanishedUids( vanishedUids)
+		-	removes all the given UIDs (as the corresponding mails do not 
+			exist on the server anymore)
+\*------------------------------------------------------------------------------*/
+BmString BmRecvAccount
+::RemoveVanishedUids(const vector<BmString>& vanishedUids)
+{
+	BmString removedInfo;
+	for( uint32 i=0; i<vanishedUids.size(); ++i) {
+		if (!IsUIDDownloaded( vanishedUids[i]))
+			continue;
+		removedInfo << "Removed local UID " << vanishedUids[i]
+						<< " since it does not exist on the server anymore.\n";
+		RemoveUid( vanishedUids[i]);
+	}
+	return removedInfo;
+}
+
+/*------------------------------------------------------------------------------*\
+	GetDownloadedUids( prefix, uids)
+		-	fills uids with all downloaded UIDs that start with the given 
+			prefix
+\*------------------------------------------------------------------------------*/
+void BmRecvAccount::GetDownloadedUids( const BmString& prefix, 
+													vector<BmString>& uids) const
+{
+	uids.clear();
+	BmUidMap::const_iterator iter;
+	for( iter = mUIDs.lower_bound( prefix); iter != mUIDs.end(); ++iter) {
+		if (iter->first.Compare( prefix, prefix.Length()) != 0)
+			break;
+		uids.push_back( iter->first);
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	RemoveUid( uid)
+		-	removes the given UID
+\*------------------------------------------------------------------------------*/
+void BmRecvAccount::RemoveUid( const BmString& uid)
+{
+	// remove the UID...
+	mUIDs.erase( uid);
+	// ...and append info about removed UID to settings-file
+	// (just in order to be sure not to lose any info in case of a crash...):
+	BMessage action( BM_REMOVE_UID);
+	action.AddString( BmListModel::MSG_ITEMKEY, Key().String());
+	action.AddString( MSG_UID, uid.String());
+	TheRecvAccountList->StoreAction(&action);
+}
+
 /*------------------------------------------------------------------------------*\
 	CheckInterval( interval)
 		-	sets the regular check interval to the given interval (in minutes)
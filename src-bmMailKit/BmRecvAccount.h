@@ -48,6 +48,9 @@ public:
 	bool ShouldUIDBeDeletedFromServer( const BmString& uid, 
 												  BmString& logOutput) const;
 	BmString AdjustToCurrentServerUids( const vector<BmString>& serverUids);
+	BmString RemoveVanishedUids( const vector<BmString>& vanishedUids);
+	void GetDownloadedUids( const BmString& prefix, 
+									vector<BmString>& uids) const;
 	//	
 	BmString GetDomainName() const;
 	bool SanityCheck( BmString& complaint, BmString& fieldName) const;
@@ -129,7 +132,8 @@ public:
 													  		= BmString()<<(uint32)i;
 													  TellModelItemUpdated( UPD_ALL); }
 	inline void PwdStoredOnDisk( bool b){ mPwdStoredOnDisk = b;  
-													  TellModelItemUpdated( UPD_ALL); }
+													  TellModelItemUpdated( UPD_ALL);
+													  SetupIntervalRunner(); }
 	inline void Username( const BmString &s) 	
 													{ mUsername = s;  
 													  TellModelItemUpdated( UPD_ALL); }
@@ -181,7 +185,8 @@ public:
 	static const int16 nArchiveVersion;
 
 protected:
-	void SetupIntervalRunner();
+	virtual void SetupIntervalRunner();
+	void RemoveUid( const BmString& uid);
 
 	//BmString mName;					// name is stored in key (base-class)
 	BmString mUsername;
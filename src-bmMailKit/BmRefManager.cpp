@@ -97,30 +97,44 @@ void BmObjectList::CleanupObjectLists()
 /*------------------------------------------------------------------------------*\
 	AddRef()
 		-	add one reference to object
+		-	as long as the object is alive (ref-count > 0), this is just an atomic
+			increment, the global lock is only taken when the object becomes
+			alive (0->1), as only then it needs to be entered into the object-list
 \*------------------------------------------------------------------------------*/
 void BmRefObj::AddRef() 
 {
-	BAutolock lock( GlobalLocker());
-	if (!lock.IsLocked())
-		throw BM_runtime_error( "AddRef(): Could not acquire global lock!");
-	BmObjectList* objList = BmObjectList::GetObjectList( ObjectListName());
-	BM_ASSERT( objList!=NULL && mRefCount >= 0);
-	int32 lastCount = atomic_add( &mRefCount, 1);
-	if (lastCount == 0) {
-		objList->ObjectMap.insert( std::pair<const BmString, BmRefObj*>( RefName(), 
-																					 this));
+	int32 lastCount = atomic_get( &mRefCount);
+	while( lastCount > 0) {
+		int32 prevCount 
+			= atomic_test_and_set( &mRefCount, lastCount+1, lastCount);
+		if (prevCount == lastCount)
+			break;
+		lastCount = prevCount;
+	}
+	if (lastCount <= 0) {
+		BAutolock lock( GlobalLocker());
+		if (!lock.IsLocked())
+			throw BM_runtime_error( "AddRef(): Could not acquire global lock!");
+		BmObjectList* objList = BmObjectList::GetObjectList( ObjectListName());
+		BM_ASSERT( objList!=NULL && mRefCount >= 0);
+		lastCount = atomic_add( &mRefCount, 1);
+		if (lastCount == 0) {
+			objList->ObjectMap.insert( 
+				std::pair<const BmString, BmRefObj*>( RefName(), this)
+			);
+		}
 	}
 #ifdef BM_REF_DEBUGGING
 	// check again to ensure no-one has clobbered with ref-count...
-	BM_ASSERT( mRefCount > 0 && mRefCount == lastCount+1);
+	BM_ASSERT( mRefCount > 0);
 	BM_LOG2( BM_LogRefCount, 
 				BmString("RefManager: reference to <") << typeid(*this).name() 
 					<< ":" << RefName() << ":"<<RefPrintHex() 
-					<< "> added, ref-count is "<<mRefCount);
+					<< "> added, ref-count is "<<lastCount+1);
 #else
 	BM_LOG2( BM_LogRefCount, 
 				BmString("RefManager: reference to <") << RefName() << ":" 
-					<< RefPrintHex()<<"> added, ref-count is "<<mRefCount);
+					<< RefPrintHex()<<"> added, ref-count is "<<lastCount+1);
 #endif
 }
 
@@ -164,9 +178,27 @@ void BmRefObj::RenameRef( const char* newName)
 	RemoveRef()
 		-	removes one reference from object and deletes the object
 			if the new reference count is zero
+		-	as long as other references remain, this is just an atomic decrement,
+			only the removal of the last reference (1->0) is done with the global
+			lock held. That way, FetchObject() (which requires the global lock)
+			can never hand out an object that is just about to be deleted.
 \*------------------------------------------------------------------------------*/
 void BmRefObj::RemoveRef() 
 {
+	int32 lastCount = atomic_get( &mRefCount);
+	while( lastCount > 1) {
+		int32 prevCount 
+			= atomic_test_and_set( &mRefCount, lastCount-1, lastCount);
+		if (prevCount == lastCount) {
+			BM_LOG2( BM_LogRefCount, 
+						BmString("RefManager: reference to <") << RefName() << ":"
+							<< RefPrintHex() << "> removed, new ref-count is "
+							<< lastCount-1);
+			return;
+		}
+		lastCount = prevCount;
+	}
+
 	bool needsDelete = false;
 	{	// scope for lock
 		BAutolock lock( GlobalLocker());
@@ -175,19 +207,21 @@ void BmRefObj::RemoveRef()
 		BmObjectList* objList = BmObjectList::GetObjectList( ObjectListName());
 		BM_ASSERT( objList!=NULL && mRefCount >= 0);
 
-		int32 lastCount = atomic_add( &mRefCount, -1);
+		// the ref-count may have been raised by now (lock-free AddRef()), 
+		// so we check again:
+		lastCount = atomic_add( &mRefCount, -1);
 	
 #ifdef BM_REF_DEBUGGING
 		BM_ASSERT( lastCount > 0);
 		BM_LOG2( BM_LogRefCount, 
 					BmString("RefManager: reference to <") << typeid(*this).name() 
 						<< ":" << RefName() << ":" << RefPrintHex()
-						<< "> removed, new ref-count is "<<mRefCount);
+						<< "> removed, new ref-count is "<<lastCount-1);
 #else
 		BM_LOG2( BM_LogRefCount, 
 					BmString("RefManager: reference to <") << RefName() << ":"
 						<< RefPrintHex() << "> removed, new ref-count is "
-						<< mRefCount);
+						<< lastCount-1);
 #endif
 
 		if (lastCount == 1) {
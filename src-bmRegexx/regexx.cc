@@ -26,35 +26,209 @@
 // $Revision$
 // $Date$
 
+#include <list>
+#include <map>
+
+#include <Autolock.h>
+#include <Locker.h>
+
 #include "regexx.hh"
 #include "pcre.h"
 
 BmString regexx::BM_REGEXX_DEFAULT_STRING;
 
+namespace regexx {
+
+  /// A compiled (and maybe studied) expression, shared via RegexxCache.
+  struct RegexxCacheEntry
+  {
+    pair<BmString,int> key;
+    pcre* preg;
+    pcre_extra* extra;
+    int capturecount;
+    int32 refCount;
+  };
+
+}
+
+using regexx::RegexxCacheEntry;
+
+typedef pair<BmString,int> CacheKey;
+typedef std::list<RegexxCacheEntry*> CacheList;
+typedef std::map<CacheKey,CacheList::iterator> CacheMap;
+
+// bit that is added to the compile-flags of studied expressions:
+static const int nStudiedKeyFlag = 1<<30;
+
+static BLocker nCacheLock("RegexxCacheLock");
+static CacheList nCacheList;
+			// most recently used entry first
+static CacheMap nCacheMap;
+static uint32 nCacheCapacity = 128;
+static int32 nCacheHits = 0;
+static int32 nCacheMisses = 0;
+
+static void
+FreeEntry(RegexxCacheEntry* _entry)
+{
+  free(_entry->preg);
+  if(_entry->extra)
+    free(_entry->extra);
+  delete _entry;
+}
+
+static void
+ReleaseEntry(RegexxCacheEntry* _entry)
+{
+  // the cache itself holds a reference to every cached entry, so the
+  // count can only drop to zero once an entry has been evicted:
+  if(atomic_add(&_entry->refCount, -1) == 1)
+    FreeEntry(_entry);
+}
+
+static void
+TrimCache(uint32 _capacity)
+{
+  // nCacheLock must be held
+  while(nCacheList.size() > _capacity) {
+    RegexxCacheEntry* entry = nCacheList.back();
+    nCacheList.pop_back();
+    nCacheMap.erase(entry->key);
+    ReleaseEntry(entry);
+  }
+}
+
+static RegexxCacheEntry*
+CompileEntry(const CacheKey& _key)
+  throw(regexx::Regexx::CompileException)
+{
+  const char *errptr;
+  int erroffset;
+  RegexxCacheEntry* entry = new RegexxCacheEntry;
+  entry->key = _key;
+  entry->extra = NULL;
+  entry->refCount = 1;
+  entry->preg = pcre_compile(_key.first.String(), _key.second & ~nStudiedKeyFlag,
+                             &errptr, &erroffset, 0);
+  if(entry->preg == NULL) {
+    delete entry;
+    throw regexx::Regexx::CompileException(errptr);
+  }
+  pcre_fullinfo(entry->preg, NULL, PCRE_INFO_CAPTURECOUNT, 
+                (void*)&entry->capturecount);
+  if(_key.second & nStudiedKeyFlag) {
+    entry->extra = pcre_study(entry->preg, 0, &errptr);
+    if(errptr != NULL) {
+      FreeEntry(entry);
+      throw regexx::Regexx::CompileException(errptr);
+    }
+  }
+  return entry;
+}
+
+static RegexxCacheEntry*
+AcquireEntry(const CacheKey& _key)
+  throw(regexx::Regexx::CompileException)
+{
+  {
+    BAutolock lock(&nCacheLock);
+    CacheMap::iterator pos = nCacheMap.find(_key);
+    if(pos != nCacheMap.end()) {
+      RegexxCacheEntry* entry = *pos->second;
+      nCacheList.splice(nCacheList.begin(), nCacheList, pos->second);
+      atomic_add(&entry->refCount, 1);
+      atomic_add(&nCacheHits, 1);
+      return entry;
+    }
+  }
+
+  // compile without holding the lock, other threads may well be
+  // busy with different expressions:
+  atomic_add(&nCacheMisses, 1);
+  RegexxCacheEntry* entry = CompileEntry(_key);
+
+  BAutolock lock(&nCacheLock);
+  if(nCacheCapacity == 0)
+    return entry;
+  CacheMap::iterator pos = nCacheMap.find(_key);
+  if(pos != nCacheMap.end()) {
+    // someone else has been quicker, so we use that entry instead:
+    FreeEntry(entry);
+    entry = *pos->second;
+    nCacheList.splice(nCacheList.begin(), nCacheList, pos->second);
+    atomic_add(&entry->refCount, 1);
+    return entry;
+  }
+  atomic_add(&entry->refCount, 1);
+  nCacheList.push_front(entry);
+  nCacheMap[_key] = nCacheList.begin();
+  TrimCache(nCacheCapacity);
+  return entry;
+}
+
+uint32
+regexx::RegexxCache::Hits()
+{
+  return nCacheHits;
+}
+
+uint32
+regexx::RegexxCache::Misses()
+{
+  return nCacheMisses;
+}
+
+void
+regexx::RegexxCache::ResetCounters()
+{
+  BAutolock lock(&nCacheLock);
+  nCacheHits = 0;
+  nCacheMisses = 0;
+}
+
+uint32
+regexx::RegexxCache::Capacity()
+{
+  return nCacheCapacity;
+}
+
+void
+regexx::RegexxCache::SetCapacity(uint32 _capacity)
+{
+  BAutolock lock(&nCacheLock);
+  nCacheCapacity = _capacity;
+  TrimCache(nCacheCapacity);
+}
+
+void
+regexx::Regexx::release()
+{
+  ReleaseEntry(m_entry);
+  m_entry = NULL;
+  m_preg = NULL;
+  m_extra = NULL;
+  m_compiled = false;
+  m_study = false;
+}
+
 const unsigned int&
 regexx::Regexx::exec(int _flags)
   throw(CompileException)
 {
+  if(m_compiled && !m_study && (_flags&study))
+    release();		// switch to the studied variant of the expression
+
   if(!m_compiled) {
-    const char *errptr;
-    int erroffset;
     int cflags =
       ((_flags&nocase)?PCRE_CASELESS:0)
-      | ((_flags&newline)?PCRE_MULTILINE:0);
-    m_preg = pcre_compile(m_expr.String(),cflags,&errptr,&erroffset,0);
-    if(m_preg == NULL) {
-      throw CompileException(errptr);
-    }
-    pcre_fullinfo(m_preg, NULL, PCRE_INFO_CAPTURECOUNT, (void*)&m_capturecount);
+      | ((_flags&newline)?PCRE_MULTILINE:0)
+      | ((_flags&study)?nStudiedKeyFlag:0);
+    m_entry = AcquireEntry(CacheKey(m_expr, cflags));
+    m_preg = m_entry->preg;
+    m_extra = m_entry->extra;
+    m_capturecount = m_entry->capturecount;
     m_compiled = true;
-  }
-
-  if(!m_study && (_flags&study)) {
-    const char *errptr;
-    m_extra = pcre_study(m_preg, 0, &errptr);
-    if(errptr != NULL)
-      throw CompileException(errptr);
-    m_study = true;
+    m_study = (_flags&study) != 0;
   }
 
   match.clear();
@@ -48,6 +48,8 @@ using std::vector;
 namespace regexx {
 
 	extern IMPEXPBMREGEXX BmString BM_REGEXX_DEFAULT_STRING;
+
+  struct RegexxCacheEntry;
 	
   /** Class to store atoms.
    *
@@ -293,13 +295,14 @@ namespace regexx {
     /// Constructor
     inline
     Regexx()
-      : m_compiled(false), m_study(false), m_matches(0), m_extra(NULL)
+      : m_compiled(false), m_study(false), m_matches(0), m_entry(NULL),
+	m_extra(NULL)
     {}
 
     /// Destructor
     inline
     ~Regexx()
-    { if(m_compiled) { free(m_preg); if(m_study) free(m_extra); } }
+    { if(m_compiled) release(); }
 
     /** Constructor with regular expression execution.
      *
@@ -312,7 +315,8 @@ namespace regexx {
     inline
     Regexx(const BmString& _str, const BmString& _expr, int _flags = 0)
       throw(CompileException)
-      : m_compiled(false), m_study(false), m_matches(0), m_extra(NULL)
+      : m_compiled(false), m_study(false), m_matches(0), m_entry(NULL),
+	m_extra(NULL)
     { exec(_str,_expr,_flags); }
 
     /** Constructor with regular expression string replacing.
@@ -327,7 +331,8 @@ namespace regexx {
     Regexx(const BmString& _str, const BmString& _expr, 
 	   const BmString& _repstr, int _flags = 0)
       throw(CompileException)
-      : m_compiled(false), m_study(false), m_matches(0), m_extra(NULL)
+      : m_compiled(false), m_study(false), m_matches(0), m_entry(NULL),
+	m_extra(NULL)
     { replace(_str,_expr,_repstr,_flags); }
     
     /** Set the regular expression to use with exec() and replace().
@@ -523,6 +528,10 @@ namespace regexx {
     vector<RegexxMatch> match;
 
   private:
+
+    /// Hands the compiled expression back to the RegexxCache.
+    void
+    release();
     
     bool m_compiled;
     bool m_study;
@@ -533,23 +542,50 @@ namespace regexx {
     unsigned int m_matches;
     BmString m_replaced;
 
+    RegexxCacheEntry* m_entry;
     pcre* m_preg;
     pcre_extra* m_extra;
 
   };
 
+  /** Process-wide cache of compiled expressions.
+   *
+   *  Most Regexx objects live on the stack and execute their expression
+   *  only once, so compiling (and studying) would dominate the cost.
+   *  Instead, all compiled expressions are kept in a thread-safe 
+   *  LRU-cache (keyed by expression and compile-flags) and shared
+   *  between all Regexx objects using them.
+   *
+   */
+  class IMPEXPBMREGEXX RegexxCache
+  {
+  public:
+    /// Number of expressions that were found in the cache.
+    static uint32
+    Hits();
+
+    /// Number of expressions that had to be compiled.
+    static uint32
+    Misses();
+
+    static void
+    ResetCounters();
+
+    static uint32
+    Capacity();
+
+    /** Sets the maximum number of cached expressions, dropping the least
+     *  recently used ones if necessary. A capacity of 0 disables caching.
+     */
+    static void
+    SetCapacity(uint32 _capacity);
+  };
+
   Regexx&
   Regexx::expr(const BmString& _expr)
   {
-    if(m_compiled) {
-      free(m_preg);
-      m_compiled = false;
-      if(m_study) {
-	free(m_extra);
-	m_study = false;
-	m_extra = NULL;
-      }
-    }
+    if(m_compiled)
+      release();
     m_expr = _expr;
     return *this;
   }
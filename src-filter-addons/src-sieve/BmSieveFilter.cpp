@@ -6,6 +6,8 @@
  *		Oliver Tappe <beam@hirschkaefer.de>
  */
 
+#include <strings.h>
+
 #include <Alert.h>
 #include <Application.h>
 #include <File.h>
@@ -64,7 +66,7 @@ BmFilterAddonPrefsView* InstantiateFilterPrefs( float minx, float miny,
 const char* const BmSieveFilter::MSG_VERSION = 		"bm:version";
 const char* const BmSieveFilter::MSG_CONTENT = 		"bm:content";
 const int16 BmSieveFilter::nArchiveVersion = 1;
-BLocker* BmSieveFilter::nSieveLock = NULL;
+BLocker* BmSieveFilter::nSieveParseLock = NULL;
 
 // standard logfile-name for this class:
 #undef BM_LOGNAME
@@ -87,6 +89,28 @@ static const BmString BmNotifyStopProcessing = "BeamStopProcessing";
 static const BmString BmNotifySetSpamTofu = "BeamSetSpamTofu";
 static const BmString BmNotifySetListId = "BeamSetListId";
 
+/*------------------------------------------------------------------------------*\
+	BmSieveExecContext
+		-	holds the state of a single execution of a SIEVE-script, this is 
+			what the SIEVE-callbacks get passed as message-context
+		-	since nothing is shared between executions, several scripts (or
+			the same script) can be executed by different threads at once
+\*------------------------------------------------------------------------------*/
+struct BmSieveExecContext {
+	BmSieveExecContext( BmMsgContext* mc)
+		:	msgContext( mc)						{ fakes[0] = fakes[1] = NULL; }
+	BmMsgContext* msgContext;
+	const char* fakes[2];
+							// value-list of the current pseudo-header
+};
+
+static inline BmMsgContext* MsgContextFor( void* message_context)
+{
+	BmSieveExecContext* execContext 
+		= static_cast< BmSieveExecContext*>( message_context);
+	return execContext ? execContext->msgContext : NULL;
+}
+
 /*------------------------------------------------------------------------------*\
 	BmSieveFilter( archive)
 		-	c'tor
@@ -96,6 +120,8 @@ BmSieveFilter::BmSieveFilter( const BmString& name, const BMessage* archive)
 	:	mName( name)
 	,	mCompiledScript( NULL)
 	,	mSieveInterp( NULL)
+	,	mScriptLock( "SieveScriptLock", true)
+	,	mExecCount( 0)
 {
 	int16 version;
 	if (archive->FindInt16( MSG_VERSION, &version) != B_OK)
@@ -110,17 +136,37 @@ BmSieveFilter::BmSieveFilter( const BmString& name, const BMessage* archive)
 BmSieveFilter::~BmSieveFilter() {
 	if (mCompiledScript)
 		sieve_script_free( &mCompiledScript);
+	for( uint32 i=0; i<mRetiredScripts.size(); ++i)
+		sieve_script_free( &mRetiredScripts[i]);
 	if (mSieveInterp)
 		sieve_interp_free( &mSieveInterp);
 }
 
 /*------------------------------------------------------------------------------*\
-	SieveLock()
+	SieveParseLock()
+		-	the SIEVE-parser (yacc-generated) isn't reentrant, so compilation
+			of scripts needs to be serialized (execution does not)
+\*------------------------------------------------------------------------------*/
+BLocker* BmSieveFilter::SieveParseLock() {
+	if (!nSieveParseLock)
+		nSieveParseLock = new BLocker( "SieveParseLock", true);
+	return nSieveParseLock;
+}
+
+/*------------------------------------------------------------------------------*\
+	RetireCompiledScript()
+		-	drops the current compiled script, if any executions of it are still
+			running, freeing it is deferred until they have finished
+		-	mScriptLock must be held by caller
 \*------------------------------------------------------------------------------*/
-BLocker* BmSieveFilter::SieveLock() {
-	if (!nSieveLock)
-		nSieveLock = new BLocker( "SieveLock", true);
-	return nSieveLock;
+void BmSieveFilter::RetireCompiledScript() {
+	if (!mCompiledScript)
+		return;
+	if (mExecCount > 0)
+		mRetiredScripts.push_back( mCompiledScript);
+	else
+		sieve_script_free( &mCompiledScript);
+	mCompiledScript = NULL;
 }
 
 /*------------------------------------------------------------------------------*\
@@ -148,28 +194,48 @@ BmSieveFilter::Execute( BmMsgContext* msgContext, const BMessage* /*jobSpecs*/)
 									<< Name() 
 									<< "> on mail with Id <" << mailId << ">");
 
-	// set lock to serialize SIEVE-calls:
-	BAutolock lock( SieveLock());
-	if (!lock.IsLocked()) {
-		mLastErr = "Unable to get SIEVE-lock";
-		return false;
-	}
-
-	if (!mCompiledScript) {
-		bool scriptOK = CompileScript();
-		if (!scriptOK || !mCompiledScript) {
-			BmString errString = LastErr() + "\n" 
-										<< "Error: " 
-										<< sieve_strerror(LastErrVal()) 
-										<< "\n"
-										<< LastSieveErr();
-			BM_LOGERR( BmString("Sieve-Addon: compilation failed.\n")<<errString);
+	// fetch the compiled script (compiling it if required):
+	sieve_script_t* script = NULL;
+	{
+		BAutolock lock( mScriptLock);
+		if (!lock.IsLocked()) {
+			// the error-members are guarded by this very lock, so we can only
+			// log the failure:
+			BM_LOGERR( BmString("Sieve-Addon: ") << Name() 
+							<< ": unable to get script-lock");
 			return false;
 		}
+		if (!mCompiledScript) {
+			bool scriptOK = CompileScript();
+			if (!scriptOK || !mCompiledScript) {
+				BmString errString = LastErr() + "\n" 
+											<< "Error: " 
+											<< sieve_strerror(LastErrVal()) 
+											<< "\n"
+											<< LastSieveErr();
+				BM_LOGERR( BmString("Sieve-Addon: compilation failed.\n")
+								<< errString);
+				return false;
+			}
+		}
+		script = mCompiledScript;
+		mExecCount++;
 	}
+
+	// execute it without holding any lock:
 	BM_LOG2( BM_LogFilter, "Sieve-Addon: starting execution of script...");
-	int res = sieve_execute_script( mCompiledScript, msgContext);
+	BmSieveExecContext execContext( msgContext);
+	int res = sieve_execute_script( script, &execContext);
 	BM_LOG2( BM_LogFilter, "Sieve-Addon: done with script.");
+
+	{
+		BAutolock lock( mScriptLock);
+		if (--mExecCount == 0) {
+			for( uint32 i=0; i<mRetiredScripts.size(); ++i)
+				sieve_script_free( &mRetiredScripts[i]);
+			mRetiredScripts.clear();
+		}
+	}
 	return res == SIEVE_OK;
 }
 
@@ -188,21 +254,31 @@ bool BmSieveFilter::CompileScript() {
 			  BmString("Sieve-Addon: compiling SIEVE-script of filter ") 
 					<< Name()); 
 
-	// set lock to serialize SIEVE-calls:
-	BAutolock lock( SieveLock());
-	if (!lock.IsLocked()) {
-		mLastErr = "Unable to get SIEVE-lock";
+	BAutolock scriptLock( mScriptLock);
+	if (!scriptLock.IsLocked()) {
+		// don't touch the error-members without holding their lock:
+		BM_LOGERR( BmString("Sieve-Addon: ") << Name() 
+						<< ": unable to get script-lock");
 		return false;
 	}
 	if (mCompiledScript)
 		// script has already been compiled
 		return true;
 
+	// set lock to serialize SIEVE-parser calls:
+	BAutolock lock( SieveParseLock());
+	if (!lock.IsLocked()) {
+		mLastErr = "Unable to get SIEVE-lock";
+		return false;
+	}
+
 	mLastErr = mLastSieveErr = "";
 
 	BM_LOG2( BM_LogFilter, "Sieve-Addon: compilation...register");
 
 	// create sieve interpreter:
+	if (mSieveInterp)
+		sieve_interp_free( &mSieveInterp);
 	int res = sieve_interp_alloc( &mSieveInterp, this);
 	if (res != SIEVE_OK) {
 		mLastErr = BmString(Name()) << ": Could not create SIEVE-interpreter";
@@ -234,10 +310,7 @@ bool BmSieveFilter::CompileScript() {
 		goto cleanup;
 	}
 	// ...and compile the script:	
-	if (mCompiledScript) {
-		sieve_script_free( &mCompiledScript);
-		mCompiledScript = NULL;
-	}
+	RetireCompiledScript();
 	BM_LOG2( BM_LogFilter, "Sieve-Addon: compilation...parsing");
 	res = sieve_script_parse( mSieveInterp, scriptFile, this, &mCompiledScript);
 	if (res != SIEVE_OK) {
@@ -261,11 +334,9 @@ cleanup:
 \*------------------------------------------------------------------------------*/
 void BmSieveFilter::Content( const BmString &s)
 {
+	BAutolock lock( mScriptLock);
 	mContent = s;
-	if (mCompiledScript) {
-		sieve_script_free(&mCompiledScript);
-		mCompiledScript = NULL; 
-	}
+	RetireCompiledScript();
 }
 
 /*------------------------------------------------------------------------------*\
@@ -304,10 +375,12 @@ int BmSieveFilter::sieve_parse_error( int lineno, const char* msg,
 }
 
 /*------------------------------------------------------------------------------*\
-	sieve_parse_error()
-		-	
+	ErrorString()
+		-	the error-members are only written while compiling (with the
+			script-lock held), so we take it, too
 \*------------------------------------------------------------------------------*/
 BmString BmSieveFilter::ErrorString() const {
+	BAutolock lock( mScriptLock);
 	return LastErr() + "\n\n" 
 				<< "Error: " << sieve_strerror(LastErrVal()) << "\n\n"
 				<< LastSieveErr();
@@ -374,7 +447,7 @@ int BmSieveFilter::sieve_keep( void* action_context, void*,
 			   				  		 void*, void* message_context, 
 			   				  		 const char**) {
 	BM_LOG3( BM_LogFilter, BmString("Sieve-Addon: sieve_keep called")); 
-	BmMsgContext* msgContext = static_cast< BmMsgContext*>( message_context);
+	BmMsgContext* msgContext = MsgContextFor( message_context);
 	sieve_keep_context* keepContext 
 		= static_cast< sieve_keep_context*>( action_context);
 	if (msgContext && keepContext)
@@ -390,7 +463,7 @@ int BmSieveFilter::sieve_discard( void* /*action_context*/, void*,
 			   				  		    void*, void* message_context, 
 			   				  		    const char**) {
 	BM_LOG3( BM_LogFilter, BmString("Sieve-Addon: sieve_discard called")); 
-	BmMsgContext* msgContext = static_cast< BmMsgContext*>( message_context);
+	BmMsgContext* msgContext = MsgContextFor( message_context);
 	if (msgContext)
 		msgContext->SetBool("MoveToTrash", true);
 	return SIEVE_OK;
@@ -403,7 +476,7 @@ int BmSieveFilter::sieve_discard( void* /*action_context*/, void*,
 int BmSieveFilter::sieve_fileinto( void* action_context, void* script_context, 
 			   				  			 void*, void* message_context, 
 			   				 			 const char**) {
-	BmMsgContext* msgContext = static_cast< BmMsgContext*>( message_context);
+	BmMsgContext* msgContext = MsgContextFor( message_context);
 	sieve_fileinto_context* fileintoContext 
 		= static_cast< sieve_fileinto_context*>( action_context);
 	BmSieveFilter* filter = static_cast< BmSieveFilter*>( script_context);
@@ -443,7 +516,7 @@ int BmSieveFilter::sieve_fileinto( void* action_context, void* script_context,
 int BmSieveFilter::sieve_reject( void* action_context, void* script_context, 
 			   				  			void*, void* message_context, 
 			   				 			const char**) {
-	BmMsgContext* msgContext = static_cast< BmMsgContext*>( message_context);
+	BmMsgContext* msgContext = MsgContextFor( message_context);
 	sieve_reject_context* rejectContext 
 		= static_cast< sieve_reject_context*>( action_context);
 	BmSieveFilter* filter = static_cast< BmSieveFilter*>( script_context);
@@ -463,7 +536,7 @@ int BmSieveFilter::sieve_reject( void* action_context, void* script_context,
 int BmSieveFilter::sieve_notify( void* action_context, void*, 
 			   				  		   void*, void* message_context, 
 			   				  		   const char**) {
-	BmMsgContext* msgContext = static_cast< BmMsgContext*>( message_context);
+	BmMsgContext* msgContext = MsgContextFor( message_context);
 	sieve_notify_context* notifyContext 
 		= static_cast< sieve_notify_context*>( action_context);
 	if (msgContext && notifyContext) {
@@ -506,12 +579,12 @@ int BmSieveFilter::sieve_notify( void* action_context, void*,
 		-	
 \*------------------------------------------------------------------------------*/
 int BmSieveFilter::sieve_get_size( void* message_context, int* sizePtr) {
-	BmMsgContext* msgContext = static_cast< BmMsgContext*>( message_context);
+	BmMsgContext* msgContext = MsgContextFor( message_context);
 	if (msgContext && sizePtr)
-		*sizePtr = msgContext->mail->RawText().Length();
+		*sizePtr = msgContext->mail->RawTextLength();
 	BM_LOG3( BM_LogFilter, 
 				BmString("Sieve-Addon: sieve_get_size called, answer = ")
-					<< msgContext->mail->RawText().Length());
+					<< msgContext->mail->RawTextLength());
 	return SIEVE_OK;
 }
 
@@ -524,32 +597,32 @@ int BmSieveFilter::sieve_get_header( void* message_context, const char* header,
 	BM_LOG3( BM_LogFilter, 
 				BmString("Sieve-Addon: sieve_get_header called for header ")
 					<< header);
-	static const char* fakes[2] = { NULL, NULL };
-	BmMsgContext* msgContext = static_cast< BmMsgContext*>( message_context);
+	BmSieveExecContext* execContext 
+		= static_cast< BmSieveExecContext*>( message_context);
+	BmMsgContext* msgContext = MsgContextFor( message_context);
 	if (msgContext && contentsPtr && header) {
 		*contentsPtr = NULL;
-		BmString headerName( header);
-		if (headerName.ICompare("Status") == 0) {
+		const char** fakes = execContext->fakes;
+		if (strcasecmp( header, "Status") == 0) {
 			fakes[0] = msgContext->mail->Status().String();
 			*contentsPtr = fakes;
-		} else if (headerName.ICompare("Account") == 0) {
+		} else if (strcasecmp( header, "Account") == 0) {
 			fakes[0] = msgContext->mail->AccountName().String();
 			*contentsPtr = fakes;
-		} else if (headerName.ICompare("Outbound") == 0) {
+		} else if (strcasecmp( header, "Outbound") == 0) {
 			fakes[0] = msgContext->mail->Outbound() ? "true" : "false";
 			*contentsPtr = fakes;
 		} else {
 			if (!msgContext->headerInfos)
 				msgContext->mail->Header()->GetAllFieldValues( *msgContext);
-			for( int i=0; i<msgContext->headerInfoCount; ++i) {
-				if (!msgContext->headerInfos[i].fieldName.ICompare( header)) {
-					*contentsPtr = msgContext->headerInfos[i].values;
-					for( int v=0; msgContext->headerInfos[i].values[v]; ++v) {
-						BM_LOG3( BM_LogFilter, 
-									BmString("Sieve-Addon: sieve_get_header returns value[")
-										<<v<<"] = " <<msgContext->headerInfos[i].values[v]);
-					}
-					break;
+			const BmHeaderInfo* headerInfo 
+				= msgContext->FindHeaderInfo( header);
+			if (headerInfo) {
+				*contentsPtr = headerInfo->values;
+				for( int v=0; headerInfo->values[v]; ++v) {
+					BM_LOG3( BM_LogFilter, 
+								BmString("Sieve-Addon: sieve_get_header returns value[")
+									<<v<<"] = " << headerInfo->values[v]);
 				}
 			}
 		}
@@ -572,7 +645,7 @@ int BmSieveFilter::sieve_execute_error( const char* msg, void*,
 		if (filter)
 			filterName = filter->Name();
 	}
-	BmMsgContext* msgContext = static_cast< BmMsgContext*>( message_context);
+	BmMsgContext* msgContext = MsgContextFor( message_context);
 	if (msgContext)
 		mailName = msgContext->mail->Name();
 	BmString err("An error occurred during execution of a mail-filter.");
@@ -12,6 +12,8 @@
 #include <Archivable.h>
 #include <Autolock.h>
 
+#include <vector>
+
 extern "C" {
 	#include "sieve_interface.h"
 }
@@ -36,7 +38,7 @@ public:
 	
 	// native methods:
 	bool CompileScript();
-	BLocker* SieveLock();
+	static BLocker* SieveParseLock();
 	virtual bool AskBeforeFileInto()		{ return false; }
 
 	// implementations for abstract BmFilterAddon-methods:
@@ -99,6 +101,7 @@ public:
 
 protected:
 	void RegisterCallbacks( sieve_interp_t* interp);
+	void RetireCompiledScript();
 
 	BmString mName;
 							// the name of this filter-implementation
@@ -108,13 +111,21 @@ protected:
 							// the compiled SIEVE-script, ready to be thrown at mails
 	sieve_interp_t* mSieveInterp;
 							// the interpreter that compiled the SIEVE-script
+	mutable BLocker mScriptLock;
+							// protects the compiled script (not its execution)
+	int32 mExecCount;
+							// number of executions currently running
+	std::vector<sieve_script_t*> mRetiredScripts;
+							// compiled scripts that have been replaced while
+							// still being executed, they are freed as soon as
+							// no execution is running anymore
 	int mLastErrVal;
 							// last error-value we got
 	BmString mLastErr;
 							// the last (general) error that occurred
 	BmString mLastSieveErr;
 							// the last SIEVE-error that occurred
-	static BLocker* nSieveLock;
+	static BLocker* nSieveParseLock;
 
 private:
 	BmSieveFilter();									// hide default constructor
@@ -61,7 +61,6 @@ int sieve_interp_alloc(sieve_interp_t **interp, void *interp_context)
     i->vacation = NULL;
     i->notify = NULL;
 
-    i->curflags.flag = NULL; i->curflags.nflags = 0;
     i->markflags = NULL;
 
     i->interp_context = interp_context;
@@ -95,7 +94,6 @@ void free_imapflags(sieve_imapflags_t *imapflags)
   
 int sieve_interp_free(sieve_interp_t **interp)
 {
-    free_imapflags(&(*interp)->curflags);
     free(*interp);
     
     return SIEVE_OK;
@@ -41,9 +41,6 @@ struct sieve_interp {
 
     sieve_parse_error *err;
 
-    /* current imapflags state */
-    sieve_imapflags_t curflags;
-
     /* site-specific imapflags for mark/unmark */
     sieve_imapflags_t *markflags;
 
@@ -406,7 +406,7 @@ static int evaltest(sieve_interp_t *i, test_t *t, void *m)
    be ok here; otherwise we'd want to transform it a little smarter */
 static int eval(sieve_interp_t *i, commandlist_t *c, 
 		void *m, action_list_t *actions, notify_list_t *notify_list,
-		const char **errmsg)
+		sieve_imapflags_t *curflags, const char **errmsg)
 {
     int res = 0;
     stringlist_t *sl;
@@ -415,9 +415,11 @@ static int eval(sieve_interp_t *i, commandlist_t *c,
 	switch (c->type) {
 	case IF:
 	    if (evaltest(i, c->u.i.t, m))
-		res = eval(i, c->u.i.do_then, m, actions, notify_list, errmsg);
+		res = eval(i, c->u.i.do_then, m, actions, notify_list, curflags,
+			   errmsg);
 	    else
-		res = eval(i, c->u.i.do_else, m, actions, notify_list, errmsg);
+		res = eval(i, c->u.i.do_else, m, actions, notify_list, curflags,
+			   errmsg);
 	    break;
 	case REJCT:
 	    res = do_reject(actions, c->u.str);
@@ -425,7 +427,7 @@ static int eval(sieve_interp_t *i, commandlist_t *c,
 		*errmsg = "Reject can not be used with any other action";
 	    break;
 	case FILEINTO:
-	    res = do_fileinto(actions, c->u.str, &i->curflags);
+	    res = do_fileinto(actions, c->u.str, curflags);
 	    if (res == SIEVE_RUN_ERROR)
 		*errmsg = "Fileinto can not be used with Reject";
 	    break;
@@ -435,7 +437,7 @@ static int eval(sieve_interp_t *i, commandlist_t *c,
 		*errmsg = "Redirect can not be used with Reject";
 	    break;
 	case KEEP:
-	    res = do_keep(actions, &i->curflags);
+	    res = do_keep(actions, curflags);
 	    if (res == SIEVE_RUN_ERROR)
 		*errmsg = "Keep can not be used with Reject";
 
@@ -872,7 +874,10 @@ static int makehash(unsigned char hash[HASHSIZE], char *s1, char *s2)
 
 /* execute a script on a message, producing side effects via callbacks.
    it is the responsibility of the caller to save a message if this
-   returns anything but SIEVE_OK. */
+   returns anything but SIEVE_OK.
+   all state of an execution is kept local to this function (the script
+   itself is not modified), so the same script may be executed by several
+   threads at once. */
 int sieve_execute_script(sieve_script_t *s, void *message_context)
 {
     int ret = 0;
@@ -882,6 +887,7 @@ int sieve_execute_script(sieve_script_t *s, void *message_context)
     notify_list_t *notify_list = NULL;
     char actions_string[BUF_SZ+1] = "";
     const char *errmsg = NULL;
+    sieve_imapflags_t curflags = { NULL, 0 };
 
     if (s->support.notify) {
 	notify_list = new_notify_list();
@@ -895,11 +901,11 @@ int sieve_execute_script(sieve_script_t *s, void *message_context)
 	goto error;
     }
  
-    free_imapflags(&s->interp.curflags);
- 
     if (eval(&s->interp, s->cmds, message_context, actions,
-	     notify_list, &errmsg) < 0)
-	return SIEVE_RUN_ERROR;
+	     notify_list, &curflags, &errmsg) < 0) {
+	ret = SIEVE_RUN_ERROR;
+	goto cleanup;
+    }
   
     strcpy(actions_string,"Action(s) taken:\n");
   
@@ -914,7 +920,7 @@ int sieve_execute_script(sieve_script_t *s, void *message_context)
 	case ACTION_REJECT:
 	    implicit_keep = 0;
 	    if (!s->interp.reject)
-		return SIEVE_INTERNAL_ERROR;
+		{ ret = SIEVE_INTERNAL_ERROR; goto cleanup; }
 	    ret = s->interp.reject(&a->u.rej,
 				   s->interp.interp_context,
 				   s->script_context,
@@ -937,7 +943,7 @@ int sieve_execute_script(sieve_script_t *s, void *message_context)
 	case ACTION_FILEINTO:
 	    implicit_keep = 0;
 	    if (!s->interp.fileinto)
-		return SIEVE_INTERNAL_ERROR;
+		{ ret = SIEVE_INTERNAL_ERROR; goto cleanup; }
 	    ret = s->interp.fileinto(&a->u.fil,
 				     s->interp.interp_context,
 				     s->script_context,
@@ -959,7 +965,7 @@ int sieve_execute_script(sieve_script_t *s, void *message_context)
 	case ACTION_KEEP:
 	    implicit_keep = 0;
 	    if (!s->interp.keep)
-		return SIEVE_INTERNAL_ERROR;
+		{ ret = SIEVE_INTERNAL_ERROR; goto cleanup; }
 	    ret = s->interp.keep(&a->u.keep,
 				 s->interp.interp_context,
 				 s->script_context,
@@ -978,7 +984,7 @@ int sieve_execute_script(sieve_script_t *s, void *message_context)
 	case ACTION_REDIRECT:
 	    implicit_keep = 0;
 	    if (!s->interp.redirect)
-		return SIEVE_INTERNAL_ERROR;
+		{ ret = SIEVE_INTERNAL_ERROR; goto cleanup; }
 	    ret = s->interp.redirect(&a->u.red,
 				     s->interp.interp_context,
 				     s->script_context,
@@ -1019,7 +1025,7 @@ int sieve_execute_script(sieve_script_t *s, void *message_context)
 		unsigned char hash[HASHSIZE];
 
 		if (!s->interp.vacation)
-		    return SIEVE_INTERNAL_ERROR;
+		    { ret = SIEVE_INTERNAL_ERROR; goto cleanup; }
 
 		/* first, let's figure out if we should respond to this */
 		ret = makehash(hash, a->u.vac.send.addr,
@@ -1069,14 +1075,14 @@ int sieve_execute_script(sieve_script_t *s, void *message_context)
 
  
 	case ACTION_SETFLAG:
-	    free_imapflags(&s->interp.curflags);
-	    ret = sieve_addflag(&s->interp.curflags, a->u.fla.flag);
+	    free_imapflags(&curflags);
+	    ret = sieve_addflag(&curflags, a->u.fla.flag);
 	    break;
 	case ACTION_ADDFLAG:
-	    ret = sieve_addflag(&s->interp.curflags, a->u.fla.flag);
+	    ret = sieve_addflag(&curflags, a->u.fla.flag);
 	    break;
 	case ACTION_REMOVEFLAG:
-	    ret = sieve_removeflag(&s->interp.curflags, a->u.fla.flag);
+	    ret = sieve_removeflag(&curflags, a->u.fla.flag);
 	    break;
 	case ACTION_MARK:
 	    {
@@ -1084,7 +1090,7 @@ int sieve_execute_script(sieve_script_t *s, void *message_context)
 
 		ret = SIEVE_OK;
 		while (n && ret == SIEVE_OK) {
-		    ret = sieve_addflag(&s->interp.curflags,
+		    ret = sieve_addflag(&curflags,
 					s->interp.markflags->flag[--n]);
 		}
 		break;
@@ -1095,7 +1101,7 @@ int sieve_execute_script(sieve_script_t *s, void *message_context)
 
 		ret = SIEVE_OK;
 		while (n && ret == SIEVE_OK) {
-		    ret = sieve_removeflag(&s->interp.curflags,
+		    ret = sieve_removeflag(&curflags,
 					   s->interp.markflags->flag[--n]);
 		}
 		break;
@@ -1177,7 +1183,7 @@ int sieve_execute_script(sieve_script_t *s, void *message_context)
 
 	implicit_keep = 0;	/* don't try an implicit keep again */
 
-	keep_context.imapflags = &s->interp.curflags;
+	keep_context.imapflags = &curflags;
  
 	lastaction = ACTION_KEEP;
 	keep_ret = s->interp.keep(&keep_context, s->interp.interp_context,
@@ -1220,8 +1226,12 @@ int sieve_execute_script(sieve_script_t *s, void *message_context)
 	}
     }
  
+ cleanup: /* all state of this execution is freed here */
+
+    if (notify_list) free_notify_list(notify_list);
     if (actions)
 	free_action_list(actions);
+    free_imapflags(&curflags);
   
     return ret;
 }
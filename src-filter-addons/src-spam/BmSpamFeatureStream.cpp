@@ -0,0 +1,125 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+
+#include <string.h>
+#include <sys/stat.h>
+
+#include <Message.h>
+
+#include "BmSpamFilter.h"
+
+
+/********************************************************************************\
+	BmSpamFilter::OsbfClassifier::FeatureStream
+\********************************************************************************/
+// #pragma mark --- FeatureStream ---
+
+const uint32 BmSpamFilter::OsbfClassifier
+::FeatureStream::Magic = 'OSF1';
+const uint32 BmSpamFilter::OsbfClassifier
+::FeatureStream::FormatVersion = 2;
+const uint32 BmSpamFilter::OsbfClassifier
+::FeatureStream::OptionDeHtml = 1UL << 0;
+const uint32 BmSpamFilter::OsbfClassifier
+::FeatureStream::OptionKeepATags = 1UL << 1;
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	
+\*------------------------------------------------------------------------------*/
+BmSpamFilter::OsbfClassifier
+::FeatureStream::FeatureStream( uint32 options, uint32 mailStamp)
+	:	mOptions( options)
+	,	mMailStamp( mailStamp)
+{
+}
+
+/*------------------------------------------------------------------------------*\
+	OptionsFor()
+		-	returns the options that influence the selection of the mailtext
+			in the given job
+\*------------------------------------------------------------------------------*/
+uint32 BmSpamFilter::OsbfClassifier
+::FeatureStream::OptionsFor( const BMessage* jobSpecs)
+{
+	uint32 options = 0;
+	if (jobSpecs && jobSpecs->FindBool("DeHtml"))
+		options |= OptionDeHtml;
+	if (jobSpecs && jobSpecs->FindBool("KeepATags"))
+		options |= OptionKeepATags;
+	return options;
+}
+
+/*------------------------------------------------------------------------------*\
+	MailStampFor()
+		-	returns the stamp of a mail-file with the given stat-info
+		-	the stamp is built from the file's metadata only (device, inode,
+			size and time of last modification), such that the mailtext 
+			doesn't have to be read in order to find out whether stored 
+			features still match (writing attributes doesn't change any of 
+			these)
+\*------------------------------------------------------------------------------*/
+uint32 BmSpamFilter::OsbfClassifier
+::FeatureStream::MailStampFor( const struct stat& st)
+{
+	uint64 values[4] = { 
+		(uint64)st.st_dev, (uint64)st.st_ino, (uint64)st.st_size, 
+		(uint64)st.st_mtime 
+	};
+	uint32 stamp = 0;
+	for( int32 i=0; i<4; ++i) {
+		stamp = stamp*31 + (uint32)values[i];
+		stamp = stamp*31 + (uint32)(values[i] >> 32);
+	}
+	return stamp;
+}
+
+/*------------------------------------------------------------------------------*\
+	Flatten()
+		-	writes the stream into the given buffer: a small header (magic, 
+			format-version, size of a pair, options and mail-stamp) followed 
+			by the pairs themselves
+\*------------------------------------------------------------------------------*/
+void BmSpamFilter::OsbfClassifier
+::FeatureStream::Flatten( vector<char>& data) const
+{
+	uint32 header[HeaderWords] = { 
+		Magic, FormatVersion, sizeof(FeaturePair), mOptions, mMailStamp
+	};
+	size_t pairsSize = mPairs.size() * sizeof(FeaturePair);
+	data.resize( sizeof(header) + pairsSize);
+	memcpy( &data[0], header, sizeof(header));
+	if (pairsSize)
+		memcpy( &data[sizeof(header)], &mPairs[0], pairsSize);
+}
+
+/*------------------------------------------------------------------------------*\
+	Unflatten()
+		-	reads the stream from the given buffer
+		-	returns false if the data doesn't belong to a stream that has been
+			collected from the same mailtext (mail-stamp), with the options and
+			the tokenizer (format-version) of this one (or on a platform with 
+			a different size of the hashes)
+\*------------------------------------------------------------------------------*/
+bool BmSpamFilter::OsbfClassifier
+::FeatureStream::Unflatten( const void* data, ssize_t size)
+{
+	uint32 header[HeaderWords];
+	if (!data || size < (ssize_t)sizeof(header))
+		return false;
+	memcpy( header, data, sizeof(header));
+	size -= sizeof(header);
+	if (header[0] != Magic || header[1] != FormatVersion
+	|| header[2] != sizeof(FeaturePair) || header[3] != mOptions 
+	|| header[4] != mMailStamp || size % sizeof(FeaturePair) != 0)
+		return false;
+	mPairs.resize( size / sizeof(FeaturePair));
+	if (size)
+		memcpy( &mPairs[0], (const char*)data + sizeof(header), size);
+	return true;
+}
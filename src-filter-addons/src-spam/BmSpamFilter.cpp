@@ -24,6 +24,13 @@
 
 #include <cctype>
 
+#ifdef __HAIKU__
+#	include <errno.h>
+#	include <fcntl.h>
+#	include <unistd.h>
+#	include <sys/mman.h>
+#endif
+
 #include "BubbleHelper.h"
 
 #include "BmLogHandler.h"
@@ -118,15 +125,13 @@ unsigned long strnhash (char *str, long len)
 		-	
 \*------------------------------------------------------------------------------*/
 BmSpamFilter::OsbfClassifier::SpamRelevantMailtextSelector::HtmlRemover
-::HtmlRemover( BmMemIBuf* input, uint32 blockSize)
+::HtmlRemover( BmMemIBuf* input, bool keepATags, uint32 blockSize)
 	:	inherited( input, blockSize)
 	,	mInTag(false)
 	,	mInQuot(false)
-	,	mKeepATags(false)
+	,	mKeepATags(keepATags)
 	,	mKeepThisTagsContent(false)
 {
-	if (mJobSpecs)
-		mJobSpecs->FindBool("KeepATags", &mKeepATags);
 }
 
 /*------------------------------------------------------------------------------*\
@@ -183,9 +188,11 @@ void BmSpamFilter::OsbfClassifier::SpamRelevantMailtextSelector::HtmlRemover
 		-	
 \*------------------------------------------------------------------------------*/
 BmSpamFilter::OsbfClassifier::SpamRelevantMailtextSelector
-::SpamRelevantMailtextSelector(BmMail* mail)
+::SpamRelevantMailtextSelector(BmMail* mail, const BMessage* jobSpecs)
 	:	mMail(mail)
 	,	mDeHtmlBuf(4096)
+	,	mDeHtml(jobSpecs ? jobSpecs->FindBool("DeHtml") : false)
+	,	mKeepATags(jobSpecs ? jobSpecs->FindBool("KeepATags") : false)
 {
 }
 
@@ -264,10 +271,9 @@ void BmSpamFilter::OsbfClassifier::SpamRelevantMailtextSelector
 		int32 bodyLen = MIN(body->DecodedData().Length(), maxBodySize);
 			// use only first 64 KB of text in order to avoid stuffing too much
 			// data from one single mail into our database
-		bool deHtml = mJobSpecs ? mJobSpecs->FindBool("DeHtml") : false;
-		if (deHtml && body->MimeType().ICompare("text/html") == 0) {
+		if (mDeHtml && body->MimeType().ICompare("text/html") == 0) {
 			BmStringIBuf htmlIn(body->DecodedData().String(), bodyLen);
-			HtmlRemover htmlRemover(&htmlIn);
+			HtmlRemover htmlRemover(&htmlIn, mKeepATags);
 			mDeHtmlBuf.Write(&htmlRemover);
 			inBuf.AddBuffer(mDeHtmlBuf.TheString());
 		} else
@@ -380,20 +386,17 @@ void BmSpamFilter::OsbfClassifier
 
 
 /********************************************************************************\
-	BmSpamFilter::OsbfClassifier::FeatureLearner
+	BmSpamFilter::OsbfClassifier::FeatureCollector
 \********************************************************************************/
-// #pragma mark --- FeatureLearner ---
+// #pragma mark --- FeatureCollector ---
 
 /*------------------------------------------------------------------------------*\
 	()
 		-	
 \*------------------------------------------------------------------------------*/
 BmSpamFilter::OsbfClassifier
-::FeatureLearner::FeatureLearner( FeatureBucket* hash, Header* header, 	
-											 bool revert)
-	:	mHash( hash)
-	,	mHeader( header)
-	,	mRevert( revert)
+::FeatureCollector::FeatureCollector( FeatureStream& stream)
+	:	mStream( stream)
 	,	mStatus( B_OK)
 {
    //  init the hashpipe with 0xDEADBEEF 
@@ -401,6 +404,62 @@ BmSpamFilter::OsbfClassifier
       mHashpipe.push_back( 0xDEADBEEF);
 }
 
+/*------------------------------------------------------------------------------*\
+	()
+		-	
+\*------------------------------------------------------------------------------*/
+status_t BmSpamFilter::OsbfClassifier
+::FeatureCollector::operator()( char* buf, uint32 bufLen)
+{
+	if (!buf || !bufLen) {
+		mStatus = B_BAD_VALUE;
+		return mStatus;
+	}
+
+	BM_LOG3( BM_LogFilter, BmString("found feature: ") << BmString( buf, bufLen));
+
+   // Shift hash value of feature into pipe
+   mHashpipe.push_front( strnhash( buf, bufLen));
+   mHashpipe.pop_back();
+
+	//
+	//     old Hash polynomial: h0 + 3h1 + 5h2 +11h3 +23h4
+	//     (coefficients chosen by requiring superincreasing,
+	//     as well as prime)
+	//
+	FeaturePair feature;
+	for (uint32 j = 1; j < WindowLen; j++) {
+		feature.h1 
+			= mHashpipe[0] * HashCoeff[0] + mHashpipe[j] * HashCoeff[j << 1];
+		feature.h2 
+			= mHashpipe[0] * HashCoeff[1] + mHashpipe[j] * HashCoeff[(j << 1)-1];
+		mStream.mPairs.push_back( feature);
+	}
+	return B_OK;
+}
+
+
+
+/********************************************************************************\
+	BmSpamFilter::OsbfClassifier::FeatureLearner
+\********************************************************************************/
+// #pragma mark --- FeatureLearner ---
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	
+\*------------------------------------------------------------------------------*/
+BmSpamFilter::OsbfClassifier
+::FeatureLearner::FeatureLearner( DataTable* table, bool revert)
+	:	mTable( table)
+	,	mHash( table->hash)
+	,	mHeader( &table->header)
+	,	mRevert( revert)
+	,	mGroomed( false)
+	,	mStatus( B_OK)
+{
+}
+
 /*------------------------------------------------------------------------------*\
 	()
 		-	
@@ -415,113 +474,101 @@ BmSpamFilter::OsbfClassifier
 		-	
 \*------------------------------------------------------------------------------*/
 status_t BmSpamFilter::OsbfClassifier
-::FeatureLearner::operator()( char* buf, uint32 bufLen)
+::FeatureLearner::AddFeature( const FeaturePair& feature)
 {
-	if (!buf || !bufLen || !mHeader->buckets) {
+	if (!mHash || !mHeader->buckets) {
 		mStatus = B_BAD_VALUE;
 		return mStatus;
 	}
 
-	BM_LOG3( BM_LogFilter, BmString("learning feature: ") << BmString( buf, bufLen));
-
-   // Shift hash value of feature into pipe
-   mHashpipe.push_front( strnhash( buf, bufLen));
-   mHashpipe.pop_back();
-
 	int sense = mRevert ? -1 : 1;
 
 	unsigned long hindex;
-	unsigned long h1, h2;
+	unsigned long h1 = feature.h1;
+	unsigned long h2 = feature.h2;
 	unsigned long incrs;
 	
+	hindex = h1 % mHeader->buckets;
+	
 	//
-	//     old Hash polynomial: h0 + 3h1 + 5h2 +11h3 +23h4
-	//     (coefficients chosen by requiring superincreasing,
-	//     as well as prime)
+	//  we now look at both the primary (h1) and 
+	//  crosscut (h2) indexes to see if we've got
+	//  the right bucket or if we need to look further
 	//
-	for (uint32 j = 1; j < WindowLen; j++) {
-		h1 = mHashpipe[0] * HashCoeff[0] + mHashpipe[j] * HashCoeff[j << 1];
-		h2 = mHashpipe[0] * HashCoeff[1] + mHashpipe[j] * HashCoeff[(j << 1)-1];
-		
-		hindex = h1 % mHeader->buckets;
-		
-		//
-		//  we now look at both the primary (h1) and 
-		//  crosscut (h2) indexes to see if we've got
-		//  the right bucket or if we need to look further
+	incrs = 0;
+	while (mHash[hindex].InChain() && !mHash[hindex].HashCompare(h1, h2))
+	{
+		incrs++;
+		// 
+		//        If microgrooming is enabled, and we've found a 
+		//        chain that's too long, we groom it down.
 		//
-		incrs = 0;
-		while (mHash[hindex].InChain() && !mHash[hindex].HashCompare(h1, h2))
-		{
-			incrs++;
-			// 
-			//        If microgrooming is enabled, and we've found a 
-			//        chain that's too long, we groom it down.
+		if (DoMicrogroom && (incrs > MicrogroomChainLength)) {
+			//     set the random number generator up...
+			//     note that this is repeatable for a
+			//     particular test set, yet dynamic.  That
+			//     way, we don't always autogroom away the
+			//     same feature; we depend on the previous
+			//     feature's key.
+			srand ((unsigned int) h2);
 			//
-			if (DoMicrogroom && (incrs > MicrogroomChainLength)) {
-				//     set the random number generator up...
-				//     note that this is repeatable for a
-				//     particular test set, yet dynamic.  That
-				//     way, we don't always autogroom away the
-				//     same feature; we depend on the previous
-				//     feature's key.
-				srand ((unsigned int) h2);
-				//
-				//  and do the groom.
-				// second argument is not necessary any more... fix it!
-				Microgroom (mHash, mHeader, hindex);
-				// since things may have moved after a
-				// microgroom, restart our search
-				hindex = h1 % mHeader->buckets;
-				incrs = 0;
-				continue;
-			};
-
-			//       check to see if we've incremented ourself all the
-			//       way around the .css file.   If so, we're full, and
-			//       can hold no more features (this is unrecoverable)
-			if (incrs > mHeader->buckets - 3) {
-				BM_LOGERR("Your program is stuffing too many "
+			//  and do the groom.
+			// second argument is not necessary any more... fix it!
+			Microgroom (mTable, hindex);
+			mGroomed = true;
+			// since things may have moved after a
+			// microgroom, restart our search
+			hindex = h1 % mHeader->buckets;
+			incrs = 0;
+			continue;
+		};
+
+		//       check to see if we've incremented ourself all the
+		//       way around the .css file.   If so, we're full, and
+		//       can hold no more features (this is unrecoverable)
+		if (incrs > mHeader->buckets - 3) {
+			BM_LOGERR("Your program is stuffing too many "
                       "features into this data-file.   "
                       "Adding any more features is "
                       "impossible in this file."
                       "You are advised to build a larger "
                       "data file and merge your data into "
                       "it.");
-				mStatus = B_ERROR;
-				return mStatus;
-			}
-			hindex++;
-			if (hindex >= mHeader->buckets)
-			   hindex = 0;
-		};
+			mStatus = B_ERROR;
+			return mStatus;
+		}
+		hindex++;
+		if (hindex >= mHeader->buckets)
+		   hindex = 0;
+	};
 
-      if (mHash[hindex].GetValue() == 0)
-			BM_LOG3( BM_LogFilter, 
-						BmString("New feature at ") << hindex);
-		else
-			BM_LOG3( BM_LogFilter, 
-						BmString("Old feature at ") << hindex);
+	if (mHash[hindex].GetValue() == 0)
+		BM_LOG3( BM_LogFilter, 
+					BmString("New feature at ") << hindex);
+	else
+		BM_LOG3( BM_LogFilter, 
+					BmString("Old feature at ") << hindex);
 
-		//    always rewrite hash and key, as they may be incorrect
-		//    (on a reused bucket) or zero (on a fresh one)
-		//
-		mHash[hindex].SetHash(h1);
-		mHash[hindex].SetKey(h2);
-		
-		//       watch out - sense may be both + or -, so check before 
-		//       adding it...
-		//
-		if (!mHash[hindex].IsLocked()) {
-		   if (sense > 0 
-		   && mHash[hindex].GetValue() + sense >=	FeatureBucketValueMax - 1)
-		      mHash[hindex].SetValue( FeatureBucketValueMax - 1);
-		   else if (sense < 0 && mHash[hindex].GetValue() <= (uint32)-sense)
-		      mHash[hindex].SetValue(0);
-		   else
-		      mHash[hindex].SetValue(mHash[hindex].GetValue() + sense);
-		   mHash[hindex].Lock();	// avoid learning this feature more than once
-		}
+	//    always rewrite hash and key, as they may be incorrect
+	//    (on a reused bucket) or zero (on a fresh one)
+	//
+	mHash[hindex].SetHash(h1);
+	mHash[hindex].SetKey(h2);
+	mTable->MarkDirty(hindex);
+	
+	//       watch out - sense may be both + or -, so check before 
+	//       adding it...
+	//
+	if (!mHash[hindex].IsLocked()) {
+	   if (sense > 0 
+	   && mHash[hindex].GetValue() + sense >=	FeatureBucketValueMax - 1)
+	      mHash[hindex].SetValue( FeatureBucketValueMax - 1);
+	   else if (sense < 0 && mHash[hindex].GetValue() <= (uint32)-sense)
+	      mHash[hindex].SetValue(0);
+	   else
+	      mHash[hindex].SetValue(mHash[hindex].GetValue() + sense);
+	   mHash[hindex].Lock();	// avoid learning this feature more than once
+	   mLockedBuckets.push_back(hindex);
 	}
 	return B_OK;
 }
@@ -533,9 +580,19 @@ status_t BmSpamFilter::OsbfClassifier
 void BmSpamFilter::OsbfClassifier
 ::FeatureLearner::Finalize()
 {
-   // unlock features locked during learning
-   for (uint32 i=0; i<mHeader->buckets; i++)
-     mHash[i].Unlock();
+   // unlock features locked during learning (if a microgroom has moved
+   // buckets around, we can't trust the remembered indices anymore):
+   if (mGroomed) {
+	   for (uint32 i=0; i<mHeader->buckets; i++) {
+	     if (mHash[i].IsLocked()) {
+	       mHash[i].Unlock();
+	       mTable->MarkDirty(i);
+	     }
+	   }
+   } else {
+	   for (uint32 i=0; i<mLockedBuckets.size(); i++)
+	     mHash[mLockedBuckets[i]].Unlock();
+   }
 
 	if (mRevert) {
 		// we had to unlearn a feature, meaning that we did make a mistake:
@@ -547,6 +604,7 @@ void BmSpamFilter::OsbfClassifier
 			mHeader->learnings >>= 1;
 			for (uint32 i = 0; i < mHeader->buckets; i++)
 				mHash[i].SetValue(mHash[i].GetRawValue() >> 1);
+			mTable->MarkAllDirty();
 			BM_LOG( BM_LogFilter, 
 						"You have managed to LEARN so many documents that"
 						" you have forced rescaling of the entire database."
@@ -584,10 +642,6 @@ BmSpamFilter::OsbfClassifier
 	mHeader[0] = tofuHeader;
 	mHeader[1] = spamHeader;
 
-   //  init the hashpipe with 0xDEADBEEF 
-   for (uint32 h = 0; h < WindowLen; h++)
-      mHashpipe.push_back( 0xDEADBEEF);
-      
 	// init basic arrays
 	for (uint32 i = 0; i < MaxHash; i++) {
 		mLearnings[i] = mHeader[i]->learnings;
@@ -638,322 +692,310 @@ BmSpamFilter::OsbfClassifier
 		-	
 \*------------------------------------------------------------------------------*/
 status_t BmSpamFilter::OsbfClassifier
-::FeatureClassifier::operator()( char* buf, uint32 bufLen)
+::FeatureClassifier::AddFeature( const FeaturePair& feature, uint32 distance)
 {
-	if (!buf || !bufLen || !mHeader[0]->buckets || !mHeader[1]->buckets) {
+	if (!mHash[0] || !mHash[1] || !mHeader[0]->buckets || !mHeader[1]->buckets) {
 		mStatus = B_BAD_VALUE;
 		return mStatus;
 	}
 
-	BM_LOG3( BM_LogFilter, BmString("classifying feature: ") << BmString( buf, bufLen));
-
-   // Shift hash value of feature into pipe
-   mHashpipe.push_front( strnhash( buf, bufLen));
-   mHashpipe.pop_back();
-
-	uint32 j, k;
+	uint32 k;
 	unsigned long hindex;
-	unsigned long h1, h2;
+	unsigned long h1 = feature.h1;
+	unsigned long h2 = feature.h2;
 	// remember indexes of classes with min and max local probabilities
 	uint32 i_min_p, i_max_p;
 	// remember min and max local probabilities of a feature
 	double min_local_p, max_local_p;
 	double htf;
 
+	hindex = h1;
+	
+	//
+	//    Note - a strict interpretation of Bayesian
+	//    chain probabilities should use 0 as the initial
+	//    state.  However, because we rapidly run out of
+	//    significant digits, we use a much less strong
+	//    initial state.   Note also that any nonzero
+	//    positive value prevents divide-by-zero
+	//
+	//       Zero out "Hits This Feature"
+	htf = 0;
+	mTotalFeatures++;
+	//
+	//    calculate the precursors to the local probabilities;
+	//    these are the hits[k] array, and the htf total.
 	//
-	for (j = 1; j < WindowLen; j++) {
-		h1 = mHashpipe[0] * HashCoeff[0] + mHashpipe[j] * HashCoeff[j << 1];
-		h2 = mHashpipe[0] * HashCoeff[1] + mHashpipe[j] * HashCoeff[(j << 1)-1];
+	min_local_p = 1.0;
+	max_local_p = 0;
+	i_min_p = i_max_p = 0;
+	bool already_seen = false;
+	for (k = 0; k < MaxHash; k++) {
+		uint32 lh, lh0;
+		double p_feat = 0;
 		
-		hindex = h1;
+		lh = hindex % mHashLen[k];
+		lh0 = lh;
+		mHits[k] = 0;
 		
-		//
-		//    Note - a strict interpretation of Bayesian
-		//    chain probabilities should use 0 as the initial
-		//    state.  However, because we rapidly run out of
-		//    significant digits, we use a much less strong
-		//    initial state.   Note also that any nonzero
-		//    positive value prevents divide-by-zero
-		//
-		//       Zero out "Hits This Feature"
-		htf = 0;
-		mTotalFeatures++;
-		//
-		//    calculate the precursors to the local probabilities;
-		//    these are the hits[k] array, and the htf total.
-		//
-		min_local_p = 1.0;
-		max_local_p = 0;
-		i_min_p = i_max_p = 0;
-		bool already_seen = false;
-		for (k = 0; k < MaxHash; k++) {
-			uint32 lh, lh0;
-			double p_feat = 0;
-			
-			lh = hindex % mHashLen[k];
-			lh0 = lh;
-			mHits[k] = 0;
-			
-			// look for feature hashes h1 and h2
-			while (mHash[k][lh].InChain() && !mHash[k][lh].HashCompare(h1,h2))
-			{
-				lh++;
-				if (lh >= mHashLen[k])
-					lh = 0;
-				if (lh == lh0)
-					break;	// wraparound
-			};
+		// look for feature hashes h1 and h2
+		while (mHash[k][lh].InChain() && !mHash[k][lh].HashCompare(h1,h2))
+		{
+			lh++;
+			if (lh >= mHashLen[k])
+				lh = 0;
+			if (lh == lh0)
+				break;	// wraparound
+		};
 	
-			// if the feature wasn't found in the class, the index lh
-			// points to the first empty bucket after the chain and its
-			// value is 0.
-			
-			if (mSeenFeatures[k][lh] == 0) {
-				// only not previously seen features are considered
-				mUniqueFeatures[k] += 1;	// count unique features used
-				if (mHash[k][lh].GetValue() != 0) {
-					mHits[k] = mHash[k][lh].GetValue();
-					mTotalHits[k] += mHits[k];	// remember totalhits
-					htf += mHits[k];	// and hits-this-feature
-					p_feat = (double)mHits[k] / (double)mLearnings[k];
-					// find class with minimum P(F)
-					if (p_feat <= min_local_p) {
-					    i_min_p = k;
-					    min_local_p = p_feat;
-					}
-					// find class with maximum P(F)
-					if (p_feat >= max_local_p) {
-					    i_max_p = k;
-					    max_local_p = p_feat;
-					}
-					// mark the feature as seen
-					mSeenFeatures[k][lh] = 1;
-				} else {
-					// a feature that wasn't found can't be marked as already
-					// seen in the doc because the index lh doesn't refer to it,
-					// but to the first empty bucket after the chain, which
-					// is common to all not-found features in the same chain.
-					// This is not a problem though, because if the feature is
-					// found in another class, it'll be marked as seen on that
-					// class, which is enough to mark it as seen. If it's not
-					// found in any class, it will have zero count on all classes
-					// and will be ignored as well. So, only found features
-					// are marked as seen.
-					i_min_p = k;
-					min_local_p = p_feat;
-					// for statistics only (for now...)
-					mMissedFeatures[k] += 1;
+		// if the feature wasn't found in the class, the index lh
+		// points to the first empty bucket after the chain and its
+		// value is 0.
+		
+		if (mSeenFeatures[k][lh] == 0) {
+			// only not previously seen features are considered
+			mUniqueFeatures[k] += 1;	// count unique features used
+			if (mHash[k][lh].GetValue() != 0) {
+				mHits[k] = mHash[k][lh].GetValue();
+				mTotalHits[k] += mHits[k];	// remember totalhits
+				htf += mHits[k];	// and hits-this-feature
+				p_feat = (double)mHits[k] / (double)mLearnings[k];
+				// find class with minimum P(F)
+				if (p_feat <= min_local_p) {
+				    i_min_p = k;
+				    min_local_p = p_feat;
+				}
+				// find class with maximum P(F)
+				if (p_feat >= max_local_p) {
+				    i_max_p = k;
+				    max_local_p = p_feat;
 				}
+				// mark the feature as seen
+				mSeenFeatures[k][lh] = 1;
 			} else {
-				// ignore already seen features
-				min_local_p = max_local_p = 0;
-				already_seen = true;
-				if (Asymmetric)
-					break;
+				// a feature that wasn't found can't be marked as already
+				// seen in the doc because the index lh doesn't refer to it,
+				// but to the first empty bucket after the chain, which
+				// is common to all not-found features in the same chain.
+				// This is not a problem though, because if the feature is
+				// found in another class, it'll be marked as seen on that
+				// class, which is enough to mark it as seen. If it's not
+				// found in any class, it will have zero count on all classes
+				// and will be ignored as well. So, only found features
+				// are marked as seen.
+				i_min_p = k;
+				min_local_p = p_feat;
+				// for statistics only (for now...)
+				mMissedFeatures[k] += 1;
 			}
+		} else {
+			// ignore already seen features
+			min_local_p = max_local_p = 0;
+			already_seen = true;
+			if (Asymmetric)
+				break;
 		}
+	}
 	
-		//=======================================================
-		// Update the probabilities using Bayes:
-		//
-		//                      P(F|S) P(S)
-		//     P(S|F) = -------------------------------
-		//               P(F|S) P(S) +  P(F|NS) P(NS)
-		//
-		// S = class spam; NS = class nonspam; F = feature
-		//
-		// Here we adopt a different method for estimating
-		// P(F|S). Instead of estimating P(F|S) as (hits[S][F] /
-		// (hits[S][F] + hits[NS][F])), like in the original
-		// code, we use (hits[S][F] / learnings[S]) which is the
-		// ratio between the number of messages of the class S
-		// where the feature F was observed during learnings and
-		// the total number of learnings of that class. Both
-		// values are kept in the respective .css file, the
-		// number of learnings in the header and the number of
-		// occurrences of the feature F as the value of its
-		// feature bucket.
-		//
-		// It's worth noting another important difference here:
-		// as we want to estimate the *number of messages* of a
-		// given class where a certain feature F occurs, we
-		// count only the first ocurrence of each feature in a
-		// message (repetitions are ignored), both when learning
-		// and when classifying.
-		// 
-		// Advantages of this method, compared to the original:
-		//
-		// - First of all, and the most important: accuracy is
-		// really much better, at about the same speed! With
-		// this higher accuracy, it's also possible to increase
-		// the speed, at the cost of a low decrease in accuracy,
-		// using smaller .css files;
-		//
-		// - It is not affected by different sized classes
-		// because the numerator and the denominator belong to
-		// the same class;
-		//
-		// - It allows a simple and fast pruning method that
-		// seems to introduce little noise: just zero features
-		// with lower count in a overflowed chain, zeroing first
-		// those in their right places, to increase the chances
-		// of deleting older ones.
-		//
-		// Disadvantages:
-		//
-		// - It breaks compatibility with previous css file
-		// format because of different header structure and
-		// meaning of the counts.
-		//
-		// Confidence factors
-		//
-		// The motivation for confidence factors is to reduce
-		// the noise introduced by features with small counts
-		// and/or low significance. This is an attempt to mimic
-		// what we do when inspecting a message to tell if it is
-		// spam or not. We intuitively consider only a few
-		// tokens, those which carry strong indications,
-		// according to what we've learned and remember, and
-		// discard the ones that may occur (approximately)
-		// equally in both classes.
-		//
-		// Once P(Feature|Class) is estimated as above, the
-		// calculated value is adjusted using the following
-		// formula:
-		//
-		//  CP(Feature|Class) = 0.5 + 
-		//             CF(Feature) * (P(Feature|Class) - 0.5)
-		//
-		// Where CF(Feature) is the confidence factor and
-		// CP(Feature|Class) is the adjusted estimate for the
-		// probability.
-		//
-		// CF(Feature) is calculated taking into account the
-		// weight, the max and the min frequency of the feature
-		// over the classes, using the empirical formula:
-		//
-		//     (((Hmax - Hmin)^2 + Hmax*Hmin - K1/SH) / SH^2) ^ K2
-		// CF(Feature) = ------------------------------------------
-		//                    1 +  K3 / (SH * Weight)
-		//
-		// Hmax  - Number of documents with the feature "F" on
-		// the class with max local probability;
-		// Hmin  - Number of documents with the feature "F" on
-		// the class with min local probability;
-		// SH - Sum of Hmax and Hmin
-		// K1, K2, K3 - Empirical constants
-		//
-		// OBS: - Hmax and Hmin are normalized to the max number
-		//  of learnings of the 2 classes involved.
-		//  - Besides modulating the estimated P(Feature|Class),
-		//  reducing the noise, 0 <= CF < 1 is also used to
-		//  restrict the probability range, avoiding the
-		//  certainty falsely implied by a 0 count for a given
-		//  class.
-		//
-		// -- Fidelis Assis
-		//=========================================================
-		
-		// ignore less significant features (confidence factor = 0)
-		if (already_seen || (max_local_p - min_local_p) < 0.02)
-			continue;
-		// testing speed-up...
-		if (min_local_p > 0 && max_local_p / min_local_p < MinPmaxPminRatio)
-			continue;
-		
-		// code under testing....
-		// calculate confidence_factor
-		//
-		double hits_max_p, hits_min_p, sum_hits, diff_hits;
-		double K1, K2, K3;
-		double confidence_factor;
-		
-		hits_min_p = mHits[i_min_p];
-		hits_max_p = mHits[i_max_p];
-		
-		// normalize hits to max learnings
-		if (mLearnings[i_min_p] < mLearnings[i_max_p])
-			hits_min_p *= (double)mLearnings[i_max_p] / (double)mLearnings[i_min_p];
-		else
-			hits_max_p *= (double)mLearnings[i_min_p] / (double)mLearnings[i_max_p];
-		
-		sum_hits = hits_max_p + hits_min_p;
-		diff_hits = hits_max_p - hits_min_p;
-		if (diff_hits < 0)
-			diff_hits = -diff_hits;
-		
-		// constants used in the CF formula above
-		// K1 = 0.25; K2 = 10; K3 = 8;
-		K1 = 0.25;
-		K2 = 10;
-		K3 = 8;
-		
-		// calculate confidence factor (CF)
-		if (!ApplyVoodoo)
-			confidence_factor = 1;
-		else
-			confidence_factor =
-				pow ((diff_hits * diff_hits + hits_max_p * hits_min_p -
-						K1 / sum_hits) / (sum_hits * sum_hits),
-						K2) / (1.0 + K3 / (sum_hits * FeatureWeight[j]));
-		
-		BM_LOG3( BM_LogFilter,
-					BmString("CF:") << confidence_factor 
-						<< " max_hits:" << hits_max_p
-						<<" min_hits:" << hits_min_p
-						<< " weight:"<< FeatureWeight[j]);
+	//=======================================================
+	// Update the probabilities using Bayes:
+	//
+	//                      P(F|S) P(S)
+	//     P(S|F) = -------------------------------
+	//               P(F|S) P(S) +  P(F|NS) P(NS)
+	//
+	// S = class spam; NS = class nonspam; F = feature
+	//
+	// Here we adopt a different method for estimating
+	// P(F|S). Instead of estimating P(F|S) as (hits[S][F] /
+	// (hits[S][F] + hits[NS][F])), like in the original
+	// code, we use (hits[S][F] / learnings[S]) which is the
+	// ratio between the number of messages of the class S
+	// where the feature F was observed during learnings and
+	// the total number of learnings of that class. Both
+	// values are kept in the respective .css file, the
+	// number of learnings in the header and the number of
+	// occurrences of the feature F as the value of its
+	// feature bucket.
+	//
+	// It's worth noting another important difference here:
+	// as we want to estimate the *number of messages* of a
+	// given class where a certain feature F occurs, we
+	// count only the first ocurrence of each feature in a
+	// message (repetitions are ignored), both when learning
+	// and when classifying.
+	// 
+	// Advantages of this method, compared to the original:
+	//
+	// - First of all, and the most important: accuracy is
+	// really much better, at about the same speed! With
+	// this higher accuracy, it's also possible to increase
+	// the speed, at the cost of a low decrease in accuracy,
+	// using smaller .css files;
+	//
+	// - It is not affected by different sized classes
+	// because the numerator and the denominator belong to
+	// the same class;
+	//
+	// - It allows a simple and fast pruning method that
+	// seems to introduce little noise: just zero features
+	// with lower count in a overflowed chain, zeroing first
+	// those in their right places, to increase the chances
+	// of deleting older ones.
+	//
+	// Disadvantages:
+	//
+	// - It breaks compatibility with previous css file
+	// format because of different header structure and
+	// meaning of the counts.
+	//
+	// Confidence factors
+	//
+	// The motivation for confidence factors is to reduce
+	// the noise introduced by features with small counts
+	// and/or low significance. This is an attempt to mimic
+	// what we do when inspecting a message to tell if it is
+	// spam or not. We intuitively consider only a few
+	// tokens, those which carry strong indications,
+	// according to what we've learned and remember, and
+	// discard the ones that may occur (approximately)
+	// equally in both classes.
+	//
+	// Once P(Feature|Class) is estimated as above, the
+	// calculated value is adjusted using the following
+	// formula:
+	//
+	//  CP(Feature|Class) = 0.5 + 
+	//             CF(Feature) * (P(Feature|Class) - 0.5)
+	//
+	// Where CF(Feature) is the confidence factor and
+	// CP(Feature|Class) is the adjusted estimate for the
+	// probability.
+	//
+	// CF(Feature) is calculated taking into account the
+	// weight, the max and the min frequency of the feature
+	// over the classes, using the empirical formula:
+	//
+	//     (((Hmax - Hmin)^2 + Hmax*Hmin - K1/SH) / SH^2) ^ K2
+	// CF(Feature) = ------------------------------------------
+	//                    1 +  K3 / (SH * Weight)
+	//
+	// Hmax  - Number of documents with the feature "F" on
+	// the class with max local probability;
+	// Hmin  - Number of documents with the feature "F" on
+	// the class with min local probability;
+	// SH - Sum of Hmax and Hmin
+	// K1, K2, K3 - Empirical constants
+	//
+	// OBS: - Hmax and Hmin are normalized to the max number
+	//  of learnings of the 2 classes involved.
+	//  - Besides modulating the estimated P(Feature|Class),
+	//  reducing the noise, 0 <= CF < 1 is also used to
+	//  restrict the probability range, avoiding the
+	//  certainty falsely implied by a 0 count for a given
+	//  class.
+	//
+	// -- Fidelis Assis
+	//=========================================================
 	
-		// calculate the numerators  - P(F|C) * P(C)
-		// and the denominator (sum of numerators)
-		double bayes_denominator = 0.0;
-		for (k = 0; k < MaxHash; k++) {
-			// P(C) = learnings[k] / total_learnings
-			// P(F|C) = hits[k]/learnings[k], adjusted with confidence factors
-			// 
-			// the ratio between unique and total features improves final
-			// accuracy, reduces the reinforcement threshold to around 10
-			// and reduces the number of reinforcements required to get
-			// final accuracy.
-			// [zooey]: the above is correct for the SA-corpus, but
-			//          with my own corpus, the exact opposite is true >:o/
-			//				As I care less about the SA-corpus, the ratio is deactivated:
-			mPltc[k] = (double) mLearnings[k] / mTotalLearnings *
-									(0.5 + confidence_factor *
-//								   ((double) mUniqueFeatures[k] / (double)mTotalFeatures) *
-									((double)mHits[k] / (double)mLearnings[k] - 0.5));
-			
-			BM_LOG3( BM_LogFilter, 
-						BmString("CF:") << confidence_factor 
-							<< " totalhits[k]:" << mTotalHits[k]
-							<< " missedfeatures[k]:" << mMissedFeatures[k]
-							<< " uniquefeatures[k]:" << mUniqueFeatures[k]
-							<< " totalfeatures:" << mTotalFeatures
-							<< " weight:" << FeatureWeight[j]);
+	// ignore less significant features (confidence factor = 0)
+	if (already_seen || (max_local_p - min_local_p) < 0.02)
+		return B_OK;
+	// testing speed-up...
+	if (min_local_p > 0 && max_local_p / min_local_p < MinPmaxPminRatio)
+		return B_OK;
 	
-			bayes_denominator += mPltc[k];
-		}
+	// code under testing....
+	// calculate confidence_factor
+	//
+	double hits_max_p, hits_min_p, sum_hits, diff_hits;
+	double K1, K2, K3;
+	double confidence_factor;
 	
-		double renorm = 0.0;
-		// divide by Bayes' denominator
-		for (k = 0; k < MaxHash; k++) {
-
-			//   now calculate the updated per class probabilities
-			mPtc[k] = mPtc[k] * mPltc[k] / bayes_denominator;
-			
-			//   if we have underflow (any probability == 0.0 ) then
-			//   bump the probability back up to 10^-308, or
-			//   whatever a small multiple of the minimum double
-			//   precision value is on the current platform.
-			if (mPtc[k] < 10 * DBL_MIN)
-				mPtc[k] = 10 * DBL_MIN;
-			renorm += mPtc[k];
-		}
+	hits_min_p = mHits[i_min_p];
+	hits_max_p = mHits[i_max_p];
+	
+	// normalize hits to max learnings
+	if (mLearnings[i_min_p] < mLearnings[i_max_p])
+		hits_min_p *= (double)mLearnings[i_max_p] / (double)mLearnings[i_min_p];
+	else
+		hits_max_p *= (double)mLearnings[i_min_p] / (double)mLearnings[i_max_p];
+	
+	sum_hits = hits_max_p + hits_min_p;
+	diff_hits = hits_max_p - hits_min_p;
+	if (diff_hits < 0)
+		diff_hits = -diff_hits;
 	
-		// renormalize probabilities
-		for (k = 0; k < MaxHash; k++)
-			mPtc[k] = mPtc[k] / renorm;
+	// constants used in the CF formula above
+	// K1 = 0.25; K2 = 10; K3 = 8;
+	K1 = 0.25;
+	K2 = 10;
+	K3 = 8;
 	
+	// calculate confidence factor (CF)
+	if (!ApplyVoodoo)
+		confidence_factor = 1;
+	else
+		confidence_factor =
+			pow ((diff_hits * diff_hits + hits_max_p * hits_min_p -
+					K1 / sum_hits) / (sum_hits * sum_hits),
+					K2) / (1.0 + K3 / (sum_hits * FeatureWeight[distance]));
+	
+	BM_LOG3( BM_LogFilter,
+				BmString("CF:") << confidence_factor 
+					<< " max_hits:" << hits_max_p
+					<<" min_hits:" << hits_min_p
+					<< " weight:"<< FeatureWeight[distance]);
+	
+	// calculate the numerators  - P(F|C) * P(C)
+	// and the denominator (sum of numerators)
+	double bayes_denominator = 0.0;
+	for (k = 0; k < MaxHash; k++) {
+		// P(C) = learnings[k] / total_learnings
+		// P(F|C) = hits[k]/learnings[k], adjusted with confidence factors
+		// 
+		// the ratio between unique and total features improves final
+		// accuracy, reduces the reinforcement threshold to around 10
+		// and reduces the number of reinforcements required to get
+		// final accuracy.
+		// [zooey]: the above is correct for the SA-corpus, but
+		//          with my own corpus, the exact opposite is true >:o/
+		//				As I care less about the SA-corpus, the ratio is deactivated:
+		mPltc[k] = (double) mLearnings[k] / mTotalLearnings *
+								(0.5 + confidence_factor *
+//								   ((double) mUniqueFeatures[k] / (double)mTotalFeatures) *
+								((double)mHits[k] / (double)mLearnings[k] - 0.5));
+		
+		BM_LOG3( BM_LogFilter, 
+					BmString("CF:") << confidence_factor 
+						<< " totalhits[k]:" << mTotalHits[k]
+						<< " missedfeatures[k]:" << mMissedFeatures[k]
+						<< " uniquefeatures[k]:" << mUniqueFeatures[k]
+						<< " totalfeatures:" << mTotalFeatures
+						<< " weight:" << FeatureWeight[distance]);
+	
+		bayes_denominator += mPltc[k];
+	}
+	
+	double renorm = 0.0;
+	// divide by Bayes' denominator
+	for (k = 0; k < MaxHash; k++) {
+
+		//   now calculate the updated per class probabilities
+		mPtc[k] = mPtc[k] * mPltc[k] / bayes_denominator;
+		
+		//   if we have underflow (any probability == 0.0 ) then
+		//   bump the probability back up to 10^-308, or
+		//   whatever a small multiple of the minimum double
+		//   precision value is on the current platform.
+		if (mPtc[k] < 10 * DBL_MIN)
+			mPtc[k] = 10 * DBL_MIN;
+		renorm += mPtc[k];
 	}
+	
+	// renormalize probabilities
+	for (k = 0; k < MaxHash; k++)
+		mPtc[k] = mPtc[k] / renorm;
 
 	return B_OK;
 }
@@ -1060,18 +1102,152 @@ const uint32 BmSpamFilter::OsbfClassifier
 const uint32 BmSpamFilter::OsbfClassifier
 ::LockedMask = 0x80000000LU;
 
-const BMessage* BmSpamFilter::OsbfClassifier::mJobSpecs = NULL;
+
+const uint32 BmSpamFilter::OsbfClassifier
+::BucketsPerPage = B_PAGE_SIZE / sizeof(FeatureBucket);
+
+/*------------------------------------------------------------------------------*\
+	DataTable()
+		-	
+\*------------------------------------------------------------------------------*/
+BmSpamFilter::OsbfClassifier::DataTable::DataTable()
+	:	hash(NULL)
+	,	mapping(NULL)
+	,	mappingSize(0)
+	,	needToStore(false)
+	,	newClassifications(0)
+{
+	memset(&header, 0, sizeof(header));
+}
+
+/*------------------------------------------------------------------------------*\
+	MarkDirty()
+		-	marks the pages containing the given range of buckets as modified
+		-	the range may wrap around the end of the table
+\*------------------------------------------------------------------------------*/
+void BmSpamFilter::OsbfClassifier::DataTable::MarkDirty( uint32 index, 
+																			uint32 count)
+{
+	if (mapping || !count || !header.buckets)
+		return;							// the VM keeps track of mapped pages
+	if (count > header.buckets)
+		count = header.buckets;
+	index %= header.buckets;
+	uint32 last = index + count - 1;
+	if (last >= header.buckets) {
+		MarkDirty( 0, last - header.buckets + 1);
+		last = header.buckets - 1;
+	}
+	for (uint32 p = index / BucketsPerPage; p <= last / BucketsPerPage; ++p)
+		dirtyPages[p] = 1;
+}
+
+/*------------------------------------------------------------------------------*\
+	MarkAllDirty()
+		-	
+\*------------------------------------------------------------------------------*/
+void BmSpamFilter::OsbfClassifier::DataTable::MarkAllDirty()
+{
+	dirtyPages.assign( dirtyPages.size(), 1);
+}
+
+/*------------------------------------------------------------------------------*\
+	Release()
+		-	frees the buckets (without storing them)
+\*------------------------------------------------------------------------------*/
+void BmSpamFilter::OsbfClassifier::DataTable::Release()
+{
+#ifdef __HAIKU__
+	if (mapping)
+		munmap( mapping, mappingSize);
+	else
+#endif
+		delete [] hash;
+	hash = NULL;
+	mapping = NULL;
+	mappingSize = 0;
+	dirtyPages.clear();
+	newClassifications = 0;
+}
+
+/*------------------------------------------------------------------------------*\
+	FoldNewClassifications()
+		-	adds the classifications counted since the last call to the header
+\*------------------------------------------------------------------------------*/
+void BmSpamFilter::OsbfClassifier::DataTable::FoldNewClassifications()
+{
+	int32 count = atomic_and( &newClassifications, 0);
+	if (count) {
+		header.classifications += count;
+		needToStore = true;
+	}
+}
+
+const int32 BmSpamFilter::OsbfClassifier::TableLock
+::MaxReaders = 64;
+
+/*------------------------------------------------------------------------------*\
+	TableLock()
+		-	readers take one unit of the semaphore, writers take all of them
+\*------------------------------------------------------------------------------*/
+BmSpamFilter::OsbfClassifier::TableLock::TableLock( const char* name)
+	:	mSem( create_sem( MaxReaders, name))
+{
+}
+
+/*------------------------------------------------------------------------------*\
+	~TableLock()
+		-	
+\*------------------------------------------------------------------------------*/
+BmSpamFilter::OsbfClassifier::TableLock::~TableLock()
+{
+	delete_sem( mSem);
+}
+
+/*------------------------------------------------------------------------------*\
+	ReadLock()
+		-	
+\*------------------------------------------------------------------------------*/
+bool BmSpamFilter::OsbfClassifier::TableLock::ReadLock()
+{
+	return acquire_sem( mSem) == B_OK;
+}
+
+/*------------------------------------------------------------------------------*\
+	ReadUnlock()
+		-	
+\*------------------------------------------------------------------------------*/
+void BmSpamFilter::OsbfClassifier::TableLock::ReadUnlock()
+{
+	release_sem( mSem);
+}
+
+/*------------------------------------------------------------------------------*\
+	WriteLock()
+		-	waits until all readers are gone (readers arriving later queue up 
+			behind the writer, so it can't starve)
+\*------------------------------------------------------------------------------*/
+bool BmSpamFilter::OsbfClassifier::TableLock::WriteLock()
+{
+	return acquire_sem_etc( mSem, MaxReaders, 0, 0) == B_OK;
+}
+
+/*------------------------------------------------------------------------------*\
+	WriteUnlock()
+		-	
+\*------------------------------------------------------------------------------*/
+void BmSpamFilter::OsbfClassifier::TableLock::WriteUnlock()
+{
+	release_sem_etc( mSem, MaxReaders, 0);
+}
 
 /*------------------------------------------------------------------------------*\
 	OsbfClassifier()
 		-	
 \*------------------------------------------------------------------------------*/
 BmSpamFilter::OsbfClassifier::OsbfClassifier()
-	:	mSpamHash(NULL)
-	,	mTofuHash(NULL)
-	,	mNeedToStoreSpam(false)
-	,	mNeedToStoreTofu(false)
-	,	mLock("SpamClassifierLock", true)
+	:	mTableLock("SpamClassifierLock")
+	,	mLastErrLock("SpamClassifierErrLock")
 {
 }
 
@@ -1082,8 +1258,8 @@ BmSpamFilter::OsbfClassifier::OsbfClassifier()
 BmSpamFilter::OsbfClassifier::~OsbfClassifier()
 {
 	Store();
-	delete [] mTofuHash;
-	delete [] mSpamHash;
+	mTofu.Release();
+	mSpam.Release();
 }
 
 /*------------------------------------------------------------------------------*\
@@ -1092,15 +1268,15 @@ BmSpamFilter::OsbfClassifier::~OsbfClassifier()
 \*------------------------------------------------------------------------------*/
 void BmSpamFilter::OsbfClassifier::Initialize()
 {
-	if (!mSpamHash) {
+	if (!mSpam.hash) {
 		BmString spamFilename 
 			= BmString( BeamRoster->SettingsPath()) << "/Spam.data";
-		ReadDataFile( spamFilename, mSpamHeader, mSpamHash);
+		ReadDataFile( spamFilename, mSpam);
 	}
-	if (!mTofuHash) {
+	if (!mTofu.hash) {
 		BmString tofuFilename 
 			= BmString( BeamRoster->SettingsPath()) << "/Tofu.data";
-		ReadDataFile( tofuFilename, mTofuHeader, mTofuHash);
+		ReadDataFile( tofuFilename, mTofu);
 	}
 }
 
@@ -1110,15 +1286,17 @@ void BmSpamFilter::OsbfClassifier::Initialize()
 \*------------------------------------------------------------------------------*/
 void BmSpamFilter::OsbfClassifier::Store()
 {
-	if (mSpamHash && mNeedToStoreSpam) {
+	mSpam.FoldNewClassifications();
+	mTofu.FoldNewClassifications();
+	if (mSpam.hash && mSpam.needToStore) {
 		BmString spamFilename 
 			= BmString( BeamRoster->SettingsPath()) << "/Spam.data";
-		WriteDataFile( spamFilename, mSpamHeader, mSpamHash);
+		WriteDataFile( spamFilename, mSpam);
 	}
-	if (mTofuHash && mNeedToStoreTofu) {
+	if (mTofu.hash && mTofu.needToStore) {
 		BmString tofuFilename 
 			= BmString( BeamRoster->SettingsPath()) << "/Tofu.data";
-		WriteDataFile( tofuFilename, mTofuHeader, mTofuHash);
+		WriteDataFile( tofuFilename, mTofu);
 	}
 }
 
@@ -1126,18 +1304,22 @@ void BmSpamFilter::OsbfClassifier::Store()
 	LearnAsSpam()
 		-	
 \*------------------------------------------------------------------------------*/
-bool BmSpamFilter::OsbfClassifier::LearnAsSpam(BmMsgContext* msgContext)
+bool BmSpamFilter::OsbfClassifier::LearnAsSpam(BmMsgContext* msgContext,
+																const BMessage* jobSpecs)
 {
 	if (msgContext->mail->IsMarkedAsSpam()
 	&& !msgContext->GetBool("ForceLearning"))
 		return false;							// learning once is enough
+	FeatureStream features;
+	if (!GetFeatures(msgContext, jobSpecs, features))
+		return false;
 	if (msgContext->mail->IsMarkedAsTofu()) {
 		// unlearn this mail as tofu, since it's not:
-		if (!Learn(msgContext, false, true))
+		if (!Learn(features, false, true))
 			return false;
 	}
 	// learn this mail as spam:
-	bool ok = Learn(msgContext, true, false);
+	bool ok = Learn(features, true, false);
 	if (ok) {
 		msgContext->SetBool("IsSpam", true);
 		msgContext->SetBool("IsTofu", false);
@@ -1150,18 +1332,22 @@ bool BmSpamFilter::OsbfClassifier::LearnAsSpam(BmMsgContext* msgContext)
 	LearnAsTofu()
 		-	
 \*------------------------------------------------------------------------------*/
-bool BmSpamFilter::OsbfClassifier::LearnAsTofu( BmMsgContext* msgContext)
+bool BmSpamFilter::OsbfClassifier::LearnAsTofu( BmMsgContext* msgContext,
+																const BMessage* jobSpecs)
 {
 	if (msgContext->mail->IsMarkedAsTofu()
 	&& !msgContext->GetBool("ForceLearning"))
 		return false;							// learning once is enough
+	FeatureStream features;
+	if (!GetFeatures(msgContext, jobSpecs, features))
+		return false;
 	if (msgContext->mail->IsMarkedAsSpam()) {
 		// unlearn this mail as spam, since it's not:
-		if (!Learn(msgContext, true, true))
+		if (!Learn(features, true, true))
 			return false;
 	}
 	// learn this mail as tofu:
-	bool ok = Learn(msgContext, false, false);
+	bool ok = Learn(features, false, false);
 	if (ok) {
 		msgContext->SetBool("IsSpam", false);
 		msgContext->SetBool("IsTofu", true);
@@ -1170,34 +1356,116 @@ bool BmSpamFilter::OsbfClassifier::LearnAsTofu( BmMsgContext* msgContext)
 	return ok;
 }
 
+/*------------------------------------------------------------------------------*\
+	GetFeatures()
+		-	fetches the feature-stream of the given mail, which is only collected
+			from the mailtext if it neither has been collected for this 
+			msg-context before (a classification followed by a learning) nor
+			has been stored in an attribute of the mail-file
+		-	freshly collected features are written to that attribute if the
+			job asks for it ("PersistFeatures"), such that repeated training
+			sessions don't have to look at the mailtext again
+		-	an attribute that has been written for a different mailtext, with
+			other options or by an older tokenizer is removed
+		-	whether the attribute belongs to the current mailtext is decided
+			by the metadata of the mail-file, the mailtext itself is only
+			looked at if the features have to be collected
+\*------------------------------------------------------------------------------*/
+bool BmSpamFilter::OsbfClassifier
+::GetFeatures( BmMsgContext* msgContext, const BMessage* jobSpecs,
+				  FeatureStream& features)
+{
+	static const char* const FeaturesField = "SpamFeatures";
+
+	// a mail without a file (one that is being received) has no stamp, 
+	// its features are only kept in the msg-context:
+	BNode mailNode;
+	struct stat st;
+	uint32 mailStamp = 0;
+	BmMailRef* ref = msgContext->mail->MailRef();
+	if (ref && mailNode.SetTo( ref->EntryRefPtr()) == B_OK
+	&& mailNode.GetStat( &st) == B_OK)
+		mailStamp = FeatureStream::MailStampFor( st);
+	else
+		mailNode.Unset();
+	features = FeatureStream( FeatureStream::OptionsFor( jobSpecs), mailStamp);
+	const void* data;
+	ssize_t size;
+	if (msgContext->GetData( FeaturesField, &data, &size)
+	&& features.Unflatten( data, size))
+		return true;
+
+	vector<char> flattened;
+	if (mailNode.InitCheck() == B_OK) {
+		attr_info attrInfo;
+		if (mailNode.GetAttrInfo( BM_MAIL_ATTR_SPAM_FEATURES, &attrInfo) == B_OK
+		&& attrInfo.type == B_RAW_TYPE && attrInfo.size > 0) {
+			size = (ssize_t)attrInfo.size;
+			flattened.resize( size);
+			if (mailNode.ReadAttr( BM_MAIL_ATTR_SPAM_FEATURES, B_RAW_TYPE, 0, 
+										  &flattened[0], size) == size
+			&& features.Unflatten( &flattened[0], size)) {
+				msgContext->SetData( FeaturesField, &flattened[0], size);
+				return true;
+			}
+			// stale, we get rid of it:
+			mailNode.RemoveAttr( BM_MAIL_ATTR_SPAM_FEATURES);
+		}
+	}
+
+	if (!CollectFeatures( msgContext, jobSpecs, features))
+		return false;
+	features.Flatten( flattened);
+	msgContext->SetData( FeaturesField, &flattened[0], flattened.size());
+	if (jobSpecs && jobSpecs->FindBool( "PersistFeatures")
+	&& mailNode.InitCheck() == B_OK)
+		mailNode.WriteAttr( BM_MAIL_ATTR_SPAM_FEATURES, B_RAW_TYPE, 0, 
+								  &flattened[0], flattened.size());
+	return true;
+}
+
+/*------------------------------------------------------------------------------*\
+	CollectFeatures()
+		-	extracts the features from the mailtext.
+		-	this is where most of the time is spent, so it is done without
+			touching (and therefore without locking) the feature-tables
+\*------------------------------------------------------------------------------*/
+bool BmSpamFilter::OsbfClassifier
+::CollectFeatures( BmMsgContext* msgContext, const BMessage* jobSpecs,
+					  FeatureStream& features)
+{
+	BmStringIBuf text;
+	SpamRelevantMailtextSelector selector(msgContext->mail, jobSpecs);
+	selector(text);
+	FeatureFilter filter( &text);
+	BmMemBufConsumer consumer( 4096);
+	FeatureCollector collector( features);
+	consumer.Consume(&filter, &collector);
+
+	return collector.mStatus == B_OK;
+}
+
 /*------------------------------------------------------------------------------*\
 	Learn()
 		-	
 \*------------------------------------------------------------------------------*/
-bool BmSpamFilter::OsbfClassifier::Learn( BmMsgContext* msgContext, 
+bool BmSpamFilter::OsbfClassifier::Learn( const FeatureStream& features,
 														bool learnAsSpam, bool revert)
 {
-	// set lock to serialize OSBF-calls:
-	BAutolock lock( &mLock);
+	// learning modifies the tables, so we need exclusive access:
+	TableLock::WriteLocker lock( mTableLock);
 	if (!lock.IsLocked()) {
-		mLastErr = "Unable to get SPAM-lock";
+		SetLastErr( "Unable to get SPAM-lock");
 		return false;
 	}
 	
-	Header* header = learnAsSpam ? &mSpamHeader : &mTofuHeader;
-	FeatureBucket* hash = learnAsSpam ? mSpamHash : mTofuHash;
-	if (learnAsSpam)
-		mNeedToStoreSpam = true;
-	else
-		mNeedToStoreTofu = true;
+	DataTable* table = learnAsSpam ? &mSpam : &mTofu;
+	table->needToStore = true;
 	
-	BmStringIBuf text;
-	SpamRelevantMailtextSelector selector(msgContext->mail);
-	selector(text);
-	FeatureFilter filter( &text);
-	BmMemBufConsumer consumer( 4096);
-	FeatureLearner learner( hash, header, revert);
-	consumer.Consume(&filter, &learner);
+	FeatureLearner learner( table, revert);
+	const vector<FeaturePair>& pairs = features.mPairs;
+	for (uint32 i = 0; i < pairs.size() && learner.mStatus == B_OK; ++i)
+		learner.AddFeature( pairs[i]);
 
 	if (learner.mStatus == B_OK) {
 		learner.Finalize();
@@ -1209,32 +1477,28 @@ bool BmSpamFilter::OsbfClassifier::Learn( BmMsgContext* msgContext,
 	Classify()
 		-	
 \*------------------------------------------------------------------------------*/
-bool BmSpamFilter::OsbfClassifier::Classify( BmMsgContext* msgContext)
+bool BmSpamFilter::OsbfClassifier::Classify( BmMsgContext* msgContext,
+															const BMessage* jobSpecs)
 {
-	// set lock to serialize OSBF-calls:
-	BAutolock lock( &mLock);
-	if (!lock.IsLocked()) {
-		mLastErr = "Unable to get SPAM-lock";
-		return false;
-	}
-
 	if (!msgContext || !msgContext->mail) {
-		mLastErr = "Illegal msg-context!";
+		SetLastErr( "Illegal msg-context!");
 		return false;
 	}
 	
+	FeatureStream features;
 	double overallPr;
-	bool status = DoActualClassification(msgContext, overallPr);
+	bool status = GetFeatures(msgContext, jobSpecs, features)
+						&& DoActualClassification(features, overallPr);
 	if (status) {
 		int32 ThresholdForSpam = 0;
 		int32 ThresholdForTofu = 0;
 		int32 UnsureForSpam = 0;
 		int32 UnsureForTofu = 0;
-		if (mJobSpecs) {
-			mJobSpecs->FindInt32("ThresholdForSpam", &ThresholdForSpam);
-			mJobSpecs->FindInt32("ThresholdForTofu", &ThresholdForTofu);
-			mJobSpecs->FindInt32("UnsureForSpam", &UnsureForSpam);
-			mJobSpecs->FindInt32("UnsureForTofu", &UnsureForTofu);
+		if (jobSpecs) {
+			jobSpecs->FindInt32("ThresholdForSpam", &ThresholdForSpam);
+			jobSpecs->FindInt32("ThresholdForTofu", &ThresholdForTofu);
+			jobSpecs->FindInt32("UnsureForSpam", &UnsureForSpam);
+			jobSpecs->FindInt32("UnsureForTofu", &UnsureForTofu);
 		}
 		bool isSpam = (overallPr < 0);
 		bool reinforced = false;
@@ -1242,20 +1506,21 @@ bool BmSpamFilter::OsbfClassifier::Classify( BmMsgContext* msgContext)
 			// the classifier isn't sure, so we we either reinforce or leave unsure:
 			if (fabs(overallPr) > (isSpam ? UnsureForSpam : UnsureForTofu)) {
 				// reinforce by explicitly learning it:
-				Learn(msgContext, isSpam, false);
+				Learn(features, isSpam, false);
 				reinforced = true;
 			}
 		}
 		msgContext->SetBool("IsReinforced", reinforced);
 		msgContext->SetBool("IsTofu", overallPr >= UnsureForTofu);
 		msgContext->SetBool("IsSpam", overallPr < -1*UnsureForTofu);
-		if (overallPr >= UnsureForTofu) {
-			mTofuHeader.classifications++;
-			mNeedToStoreTofu = true;
-		}
-		if (overallPr < -1*UnsureForTofu) {
-			mSpamHeader.classifications++;
-			mNeedToStoreSpam = true;
+		if (overallPr >= UnsureForTofu || overallPr < -1*UnsureForTofu) {
+			// counting doesn't touch the buckets, so other classifications
+			// may go on meanwhile:
+			TableLock::ReadLocker lock( mTableLock);
+			if (overallPr >= UnsureForTofu)
+				atomic_add( &mTofu.newClassifications, 1);
+			if (overallPr < -1*UnsureForTofu)
+				atomic_add( &mSpam.newClassifications, 1);
 		}
 		msgContext->SetDouble("OverallPr", overallPr);
 		// overallPr is an open range (spam)[-min..+max](tofu), but the 
@@ -1283,16 +1548,23 @@ bool BmSpamFilter::OsbfClassifier::Classify( BmMsgContext* msgContext)
 		-	
 \*------------------------------------------------------------------------------*/
 bool BmSpamFilter::OsbfClassifier
-::DoActualClassification( BmMsgContext* msgContext, double& overallPr)
+::DoActualClassification( const FeatureStream& features, 
+								  double& overallPr)
 {
-	BmStringIBuf text;
-	SpamRelevantMailtextSelector selector(msgContext->mail);
-	selector(text);
-	FeatureFilter filter( &text);
-	BmMemBufConsumer consumer( 4096);
-	FeatureClassifier classifier( mSpamHash, &mSpamHeader, 
-											mTofuHash, &mTofuHeader);
-	consumer.Consume(&filter, &classifier);
+	// classifications only read the tables, so they can run concurrently:
+	TableLock::ReadLocker lock( mTableLock);
+	if (!lock.IsLocked()) {
+		SetLastErr( "Unable to get SPAM-lock");
+		return false;
+	}
+
+	FeatureClassifier classifier( mSpam.hash, &mSpam.header, 
+											mTofu.hash, &mTofu.header);
+	// every word yields WindowLen-1 pairs, one for each distance to the 
+	// words preceding it:
+	const vector<FeaturePair>& pairs = features.mPairs;
+	for (uint32 i = 0; i < pairs.size() && classifier.mStatus == B_OK; ++i)
+		classifier.AddFeature( pairs[i], 1 + i % (WindowLen-1));
 	
 	if (classifier.mStatus == B_OK)
 		classifier.Finalize();
@@ -1308,16 +1580,14 @@ bool BmSpamFilter::OsbfClassifier
 bool BmSpamFilter::OsbfClassifier::Reset( BmMsgContext* msgContext)
 {
 	BM_LOG( BM_LogFilter, "Spam-Addon: resetting datafiles");
-	// set lock to serialize OSBF-calls:
-	BAutolock lock( &mLock);
+	// set lock to get exclusive access to the tables:
+	TableLock::WriteLocker lock( mTableLock);
 	if (!lock.IsLocked()) {
-		mLastErr = "Unable to get SPAM-lock";
+		SetLastErr( "Unable to get SPAM-lock");
 		return false;
 	}
-	delete [] mTofuHash;
-	mTofuHash = NULL;
-	delete [] mSpamHash;
-	mSpamHash = NULL;
+	mTofu.Release();
+	mSpam.Release();
 
 	BEntry entry;
 	BmString spamFilename 
@@ -1341,16 +1611,14 @@ bool BmSpamFilter::OsbfClassifier::Reset( BmMsgContext* msgContext)
 bool BmSpamFilter::OsbfClassifier::Reload( BmMsgContext* msgContext)
 {
 	BM_LOG( BM_LogFilter, "Spam-Addon: reloading datafiles");
-	// set lock to serialize OSBF-calls:
-	BAutolock lock( &mLock);
+	// set lock to get exclusive access to the tables:
+	TableLock::WriteLocker lock( mTableLock);
 	if (!lock.IsLocked()) {
-		mLastErr = "Unable to get SPAM-lock";
+		SetLastErr( "Unable to get SPAM-lock");
 		return false;
 	}
-	delete [] mTofuHash;
-	mTofuHash = NULL;
-	delete [] mSpamHash;
-	mSpamHash = NULL;
+	mTofu.Release();
+	mSpam.Release();
 
 	Initialize();
 
@@ -1364,21 +1632,23 @@ bool BmSpamFilter::OsbfClassifier::Reload( BmMsgContext* msgContext)
 bool BmSpamFilter::OsbfClassifier::ResetStatistics( BmMsgContext* msgContext)
 {
 	BM_LOG( BM_LogFilter, "Spam-Addon: resetting statistics");
-	// set lock to serialize OSBF-calls:
-	BAutolock lock( &mLock);
+	// set lock to get exclusive access to the tables:
+	TableLock::WriteLocker lock( mTableLock);
 	if (!lock.IsLocked()) {
-		mLastErr = "Unable to get SPAM-lock";
+		SetLastErr( "Unable to get SPAM-lock");
 		return false;
 	}
 
-	mSpamHeader.learnings = 0;
-	mSpamHeader.classifications = 0;
-	mSpamHeader.mistakes = 0;
-	mNeedToStoreSpam = true;
-	mTofuHeader.learnings = 0;
-	mTofuHeader.classifications = 0;
-	mTofuHeader.mistakes = 0;
-	mNeedToStoreTofu = true;
+	mSpam.FoldNewClassifications();
+	mTofu.FoldNewClassifications();
+	mSpam.header.learnings = 0;
+	mSpam.header.classifications = 0;
+	mSpam.header.mistakes = 0;
+	mSpam.needToStore = true;
+	mTofu.header.learnings = 0;
+	mTofu.header.classifications = 0;
+	mTofu.header.mistakes = 0;
+	mTofu.needToStore = true;
 	
 	return true;
 }
@@ -1390,15 +1660,14 @@ bool BmSpamFilter::OsbfClassifier::ResetStatistics( BmMsgContext* msgContext)
 bool BmSpamFilter::OsbfClassifier::GetStatistics( BmMsgContext* msgContext)
 {
 	BM_LOG( BM_LogFilter, "Spam-Addon: getting statistics");
-	// set lock to serialize OSBF-calls:
-	BAutolock lock( &mLock);
+	TableLock::ReadLocker lock( mTableLock);
 	if (!lock.IsLocked()) {
-		mLastErr = "Unable to get SPAM-lock";
+		SetLastErr( "Unable to get SPAM-lock");
 		return false;
 	}
 	
 	if (!msgContext) {
-		mLastErr = "Illegal msg-context!";
+		SetLastErr( "Illegal msg-context!");
 		return false;
 	}
 	
@@ -1410,11 +1679,11 @@ bool BmSpamFilter::OsbfClassifier::GetStatistics( BmMsgContext* msgContext)
 	uint32 numChains = 0;
 	uint32 sum = 0;
 	uint32 maxValue = 0;
-	for (uint32 i = 0; i < mSpamHeader.buckets; i++) {
-		sum += mSpamHash[i].GetValue();
-		if (mSpamHash[i].GetValue() != 0) {
-			if (mSpamHash[i].GetValue() > maxValue)
-				maxValue = mSpamHash[i].GetValue();
+	for (uint32 i = 0; i < mSpam.header.buckets; i++) {
+		sum += mSpam.hash[i].GetValue();
+		if (mSpam.hash[i].GetValue() != 0) {
+			if (mSpam.hash[i].GetValue() > maxValue)
+				maxValue = mSpam.hash[i].GetValue();
 			usedBuckets++;
 			curChain++;
       } else {
@@ -1427,11 +1696,12 @@ bool BmSpamFilter::OsbfClassifier::GetStatistics( BmMsgContext* msgContext)
 			}
 		}
 	}
-	msgContext->SetInt32("SpamBuckets", mSpamHeader.buckets);
+	msgContext->SetInt32("SpamBuckets", mSpam.header.buckets);
 	msgContext->SetInt32("SpamBucketsUsed", usedBuckets);
-	msgContext->SetInt32("SpamLearnings", mSpamHeader.learnings);
-	msgContext->SetInt32("SpamClassifications", mSpamHeader.classifications);
-	msgContext->SetInt32("SpamMistakes", mSpamHeader.mistakes);
+	msgContext->SetInt32("SpamLearnings", mSpam.header.learnings);
+	msgContext->SetInt32("SpamClassifications", mSpam.header.classifications
+									+ atomic_add( &mSpam.newClassifications, 0));
+	msgContext->SetInt32("SpamMistakes", mSpam.header.mistakes);
 	msgContext->SetInt32("SpamChains", numChains);
 	msgContext->SetInt32("SpamChainsMaxLength", maxChain);
 	msgContext->SetInt32("SpamChainsAverageLength", 
@@ -1446,11 +1716,11 @@ bool BmSpamFilter::OsbfClassifier::GetStatistics( BmMsgContext* msgContext)
 	numChains = 0;
 	sum = 0;
 	maxValue = 0;
-	for (uint32 i = 0; i < mTofuHeader.buckets; i++) {
-		sum += mTofuHash[i].GetValue();
-		if (mTofuHash[i].GetValue() != 0) {
-			if (mTofuHash[i].GetValue() > maxValue)
-				maxValue = mTofuHash[i].GetValue();
+	for (uint32 i = 0; i < mTofu.header.buckets; i++) {
+		sum += mTofu.hash[i].GetValue();
+		if (mTofu.hash[i].GetValue() != 0) {
+			if (mTofu.hash[i].GetValue() > maxValue)
+				maxValue = mTofu.hash[i].GetValue();
 			usedBuckets++;
 			curChain++;
       } else {
@@ -1463,11 +1733,12 @@ bool BmSpamFilter::OsbfClassifier::GetStatistics( BmMsgContext* msgContext)
 			}
 		}
 	}
-	msgContext->SetInt32("TofuBuckets", mTofuHeader.buckets);
+	msgContext->SetInt32("TofuBuckets", mTofu.header.buckets);
 	msgContext->SetInt32("TofuBucketsUsed", usedBuckets);
-	msgContext->SetInt32("TofuLearnings", mTofuHeader.learnings);
-	msgContext->SetInt32("TofuClassifications", mTofuHeader.classifications);
-	msgContext->SetInt32("TofuMistakes", mTofuHeader.mistakes);
+	msgContext->SetInt32("TofuLearnings", mTofu.header.learnings);
+	msgContext->SetInt32("TofuClassifications", mTofu.header.classifications
+									+ atomic_add( &mTofu.newClassifications, 0));
+	msgContext->SetInt32("TofuMistakes", mTofu.header.mistakes);
 	msgContext->SetInt32("TofuChains", numChains);
 	msgContext->SetInt32("TofuChainsMaxLength", maxChain);
 	msgContext->SetInt32("TofuChainsAverageLength", 
@@ -1497,10 +1768,11 @@ bool BmSpamFilter::OsbfClassifier::GetStatistics( BmMsgContext* msgContext)
 //     There are two steps to microgrooming - first, since we know we're
 //     already too full, we execute a 'zero unity bins'.
 //
-void BmSpamFilter::OsbfClassifier::Microgroom ( FeatureBucket* hash,
-																Header* header,
+void BmSpamFilter::OsbfClassifier::Microgroom ( DataTable* table,
 																unsigned long hindex)
 {
+	FeatureBucket* hash = table->hash;
+	Header* header = &table->header;
 	uint32 i, j;
 	uint32 packstart;
 	int32 packlen;
@@ -1554,6 +1826,8 @@ void BmSpamFilter::OsbfClassifier::Microgroom ( FeatureBucket* hash,
 	packlen = i - packstart;
 	if (packlen < 0)
 		packlen += header->buckets;
+	// zeroing and packing only touches buckets of this chain:
+	table->MarkDirty(packstart, packlen);
 	
 	//   This pruning method zeroes buckets with minimum count in the chain.
 	//   It tries first buckets with minimum distance to their right position,
@@ -1693,12 +1967,23 @@ void BmSpamFilter::OsbfClassifier::PackDataSeg( Header* header,
 
 /*------------------------------------------------------------------------------*\
 	ErrorString()
-		-	
+		-	returns (a copy of) the last error, which may be set by any of the
+			threads classifying concurrently
 \*------------------------------------------------------------------------------*/
-const BmString& BmSpamFilter::OsbfClassifier::ErrorString() const {
+BmString BmSpamFilter::OsbfClassifier::ErrorString() const {
+	BAutolock lock( mLastErrLock);
 	return mLastErr;
 }
 
+/*------------------------------------------------------------------------------*\
+	SetLastErr( err)
+		-	
+\*------------------------------------------------------------------------------*/
+void BmSpamFilter::OsbfClassifier::SetLastErr( const char* err) {
+	BAutolock lock( mLastErrLock);
+	mLastErr = err;
+}
+
 /*------------------------------------------------------------------------------*\
 	CreateDataFile()
 		-	
@@ -1740,13 +2025,14 @@ status_t BmSpamFilter::OsbfClassifier::CreateDataFile( const BmString& filename)
 
 /*------------------------------------------------------------------------------*\
 	ReadDataFile()
-		-	
+		-	maps the buckets of the given datafile into memory (or reads them 
+			onto the heap if mapping isn't possible)
 \*------------------------------------------------------------------------------*/
 status_t BmSpamFilter::OsbfClassifier::ReadDataFile( const BmString& filename,
-												 					  Header& header,
-												 					  FeatureBucket*& hash)
+												 					  DataTable& table)
 {
 	BFile file;
+	Header& header = table.header;
 	// try to open data-file...
 	status_t err;
 	BM_LOG( BM_LogFilter, 
@@ -1772,15 +2058,44 @@ status_t BmSpamFilter::OsbfClassifier::ReadDataFile( const BmString& filename,
 		BM_LOGERR( BmString("Wrong version of spam/tofu datafile ") << filename);
 		return B_MISMATCHED_VALUES;
 	}
-	// read hash
-	hash = new FeatureBucket [header.buckets];
 	ssize_t sz = header.buckets * sizeof(FeatureBucket);
-	if ((err = file.Read(hash, sz)) < sz) {
+#ifdef __HAIKU__
+	// map the whole file, such that only the pages actually touched
+	// will be read (and written back):
+	off_t fileSize;
+	size_t mappingSize = sizeof(Header) + sz;
+	if (file.GetSize( &fileSize) == B_OK && fileSize >= (off_t)mappingSize) {
+		int fd = open( filename.String(), O_RDWR);
+		if (fd >= 0) {
+			void* mapping = mmap( NULL, mappingSize, PROT_READ | PROT_WRITE,
+										 MAP_SHARED, fd, 0);
+			close( fd);
+			if (mapping != MAP_FAILED) {
+				table.mapping = mapping;
+				table.mappingSize = mappingSize;
+				table.hash = (FeatureBucket*)((char*)mapping + sizeof(Header));
+				BM_LOG( BM_LogFilter, 
+						  BmString("Spam-Addon: ok, done mapping datafile ") 
+						  	<< filename);
+				return B_OK;
+			}
+		}
+		BM_LOG( BM_LogFilter, 
+				  BmString("Spam-Addon: unable to map datafile ") << filename
+				  	<< ", reading it instead");
+	}
+#endif
+	// read hash
+	table.hash = new FeatureBucket [header.buckets];
+	if ((err = file.Read(table.hash, sz)) < sz) {
 		BM_LOGERR( BmString("Not enough data in datafile ") << filename);
-		delete hash;
-		hash = NULL;
+		delete [] table.hash;
+		table.hash = NULL;
   		return err < 0 ? err : B_IO_ERROR;
 	}
+	table.dirtyPages.assign( (header.buckets + BucketsPerPage - 1) 
+										/ BucketsPerPage, 
+									 0);
 	BM_LOG( BM_LogFilter, 
 			  BmString("Spam-Addon: ok, done reading datafile ") << filename);
 	return B_OK;
@@ -1788,31 +2103,68 @@ status_t BmSpamFilter::OsbfClassifier::ReadDataFile( const BmString& filename,
 
 /*------------------------------------------------------------------------------*\
 	WriteDataFile()
-		-	
+		-	writes the header and all modified pages of buckets back into 
+			the given datafile
 \*------------------------------------------------------------------------------*/
 status_t BmSpamFilter::OsbfClassifier::WriteDataFile( const BmString& filename,
-												 						Header& header,
-												 						FeatureBucket*& hash)
+												 						DataTable& table)
 {
-	BFile file;
-	// try to open data-file...
 	status_t err;
 	BM_LOG( BM_LogFilter, 
 			  BmString("Spam-Addon: trying to write datafile ") << filename);
+#ifdef __HAIKU__
+	if (table.mapping) {
+		// the buckets live in the file already, we just update the header 
+		// and let the VM write back the dirty pages:
+		memcpy( table.mapping, &table.header, sizeof(Header));
+		if (msync( table.mapping, table.mappingSize, MS_SYNC) != 0) {
+			err = errno;
+			BM_LOGERR( BmString("Couldn't sync data to file ") << filename
+							<< " -> " << strerror(err));
+			return err;
+		}
+		table.needToStore = false;
+		BM_LOG( BM_LogFilter, 
+				  BmString("Spam-Addon: ok, done syncing datafile ") << filename);
+		return B_OK;
+	}
+#endif
+	BFile file;
+	// try to open data-file...
 	if ((err = file.SetTo( filename.String(), B_READ_WRITE)) != B_OK)
 		return err;
 
 	// write header
-	if ((err = file.Write(&header, sizeof(header))) < (int32)sizeof(header))
+	if ((err = file.WriteAt(0, &table.header, sizeof(Header))) 
+			< (int32)sizeof(Header))
 		return err < 0 ? err : B_IO_ERROR;
-	// write hash
-	ssize_t sz = header.buckets * sizeof(FeatureBucket);
-	if ((err = file.Write(hash, sz)) < sz) {
-		BM_LOGERR( BmString("Couldn't write data to file ") << filename);
-  		return err < 0 ? err : B_IO_ERROR;
+	// write each run of consecutive dirty pages of the hash
+	uint32 pageCount = table.dirtyPages.size();
+	uint32 pagesWritten = 0;
+	for (uint32 p = 0; p < pageCount; ) {
+		if (!table.dirtyPages[p]) {
+			p++;
+			continue;
+		}
+		uint32 end = p+1;
+		while (end < pageCount && table.dirtyPages[end])
+			end++;
+		uint32 first = p * BucketsPerPage;
+		uint32 last = min_c( end * BucketsPerPage, table.header.buckets);
+		ssize_t sz = (last - first) * sizeof(FeatureBucket);
+		off_t pos = sizeof(Header) + (off_t)first * sizeof(FeatureBucket);
+		if ((err = file.WriteAt(pos, &table.hash[first], sz)) < sz) {
+			BM_LOGERR( BmString("Couldn't write data to file ") << filename);
+	  		return err < 0 ? err : B_IO_ERROR;
+		}
+		pagesWritten += end - p;
+		p = end;
 	}
+	table.dirtyPages.assign( pageCount, 0);
+	table.needToStore = false;
 	BM_LOG( BM_LogFilter, 
-			  BmString("Spam-Addon: ok, done writing datafile ") << filename);
+			  BmString("Spam-Addon: ok, done writing datafile ") << filename
+			  	<< " (" << pagesWritten << " of " << pageCount << " pages)");
 	return B_OK;
 }
 
@@ -1948,7 +2300,6 @@ BmSpamFilter::Execute( BmMsgContext* msgContext, const BMessage* _jobSpecs)
 		jobSpecs = *_jobSpecs;
 		jobSpecifier = jobSpecs.FindString("jobSpecifier");
 	}
-	nClassifier.JobSpecs(&jobSpecs);
 	bool bdummy;
 	if (jobSpecs.FindBool("DeHtml", &bdummy) != B_OK)
 		jobSpecs.AddBool("DeHtml", D.mDeHtml);
@@ -1962,7 +2313,7 @@ BmSpamFilter::Execute( BmMsgContext* msgContext, const BMessage* _jobSpecs)
 			jobSpecs.AddInt32("ThresholdForSpam", D.mSpamThreshold);
 		if (jobSpecs.FindInt32("ThresholdForTofu", &dummy) != B_OK)
 			jobSpecs.AddInt32("ThresholdForTofu", D.mTofuThreshold);
-		result = nClassifier.Classify( msgContext);
+		result = nClassifier.Classify( msgContext, &jobSpecs);
 		if (result) {
 			bool isSpam = msgContext->GetBool("IsSpam");
 			if (isSpam) {
@@ -2014,7 +2365,7 @@ BmSpamFilter::Execute( BmMsgContext* msgContext, const BMessage* _jobSpecs)
 		if (D.mActionFileUnsure && ratioSpam < D.mUnsureThreshold/100.0)
 			// allow re-learning of quarantined spam messages:
 			msgContext->SetBool("ForceLearning", true);
-		result = nClassifier.LearnAsSpam( msgContext);
+		result = nClassifier.LearnAsSpam( msgContext, &jobSpecs);
 		if (result) {
 			if (D.mActionFileLearnedSpam)
 				msgContext->SetString("FolderName", BmMailFolder::SPAM_FOLDER_NAME);
@@ -2023,7 +2374,7 @@ BmSpamFilter::Execute( BmMsgContext* msgContext, const BMessage* _jobSpecs)
 		}
 	} else if (!jobSpecifier.ICompare("LearnAsTofu")) {
 		BM_LOG2( BM_LogFilter, "Spam-Addon: starting LearnAsTofu job...");
-		result = nClassifier.LearnAsTofu( msgContext);
+		result = nClassifier.LearnAsTofu( msgContext, &jobSpecs);
 		if (result && D.mActionFileLearnedTofu) {
 			const BmString& homeFolder = msgContext->mail->DestFolderName();
 			msgContext->SetString("FolderName", homeFolder.String());
@@ -14,12 +14,16 @@
 
 #include <deque>
 using std::deque;
+#include <vector>
+using std::vector;
 
 #include "BmFilterAddon.h"
 #include "BmFilterAddonPrefs.h"
 
 #include "BmMemIO.h"
 
+struct stat;
+
 /*------------------------------------------------------------------------------*\
 	BmSpamFilter 
 		-	implements filtering through SIEVE
@@ -42,26 +46,24 @@ class BmSpamFilter : public BmFilterAddon {
 	\*------------------------------------------------------------------------------*/
 	class OsbfClassifier
 	{
+		friend class SpamTest;
+
 	public:
 		OsbfClassifier();
 		~OsbfClassifier();
 		void Initialize();
-		const BmString& ErrorString() const;
-		bool LearnAsSpam( BmMsgContext* msgContext);
-		bool LearnAsTofu( BmMsgContext* msgContext);
-		bool Classify( BmMsgContext* msgContext);
+		BmString ErrorString() const;
+		bool LearnAsSpam( BmMsgContext* msgContext, const BMessage* jobSpecs);
+		bool LearnAsTofu( BmMsgContext* msgContext, const BMessage* jobSpecs);
+		bool Classify( BmMsgContext* msgContext, const BMessage* jobSpecs);
 		bool Reset( BmMsgContext* msgContext);
 		bool Reload( BmMsgContext* msgContext);
 		bool ResetStatistics( BmMsgContext* msgContext);
 		bool GetStatistics( BmMsgContext* msgContext);
-		void JobSpecs( const BMessage* jobSpecs)
-													{ mJobSpecs = jobSpecs; }
 													
 #ifndef __MWERKS__
 	private:
 #endif
-		static const BMessage* mJobSpecs;
-
 		typedef struct
 		{
 			uint32 GetRawValue() const		{ return value; }
@@ -95,6 +97,75 @@ class BmSpamFilter : public BmFilterAddon {
 			unsigned long classifications;		/* number of classifications */
 			unsigned long mistakes;		/* number of wrong classifications */
 		} Header;
+
+		/*------------------------------------------------------------------------------*\
+			DataTable
+				-	one feature-table (spam or tofu) as it lives in memory.
+				-	if possible, the buckets are mapped from the datafile, 
+					otherwise they are kept on the heap and the modified pages 
+					are tracked, such that only those have to be written back.
+		\*------------------------------------------------------------------------------*/
+		struct DataTable {
+			DataTable();
+			void MarkDirty( uint32 index, uint32 count = 1);
+			void MarkAllDirty();
+			void Release();
+			void FoldNewClassifications();
+
+			Header header;
+			FeatureBucket* hash;
+			void* mapping;
+							// start of file-mapping (NULL if hash is on heap)
+			size_t mappingSize;
+			vector<uint8> dirtyPages;
+							// one flag per page of buckets (heap only)
+			bool needToStore;
+			int32 newClassifications;
+							// classifications not yet counted in header
+							// (incremented atomically under the read-lock)
+		};
+		static const uint32 BucketsPerPage;
+
+		/*------------------------------------------------------------------------------*\
+			TableLock
+				-	a readers/writer-lock protecting the feature-tables:
+					any number of classifications may read the tables 
+					concurrently, while learning needs exclusive access.
+		\*------------------------------------------------------------------------------*/
+		class TableLock {
+		public:
+			TableLock( const char* name);
+			~TableLock();
+			bool ReadLock();
+			void ReadUnlock();
+			bool WriteLock();
+			void WriteUnlock();
+
+			struct ReadLocker {
+				ReadLocker( TableLock& lock)
+													: mLock( lock)
+													, mLocked( lock.ReadLock()) {}
+				~ReadLocker()					{ if (mLocked) mLock.ReadUnlock(); }
+				bool IsLocked() const		{ return mLocked; }
+			private:
+				TableLock& mLock;
+				bool mLocked;
+			};
+			struct WriteLocker {
+				WriteLocker( TableLock& lock)
+													: mLock( lock)
+													, mLocked( lock.WriteLock()) {}
+				~WriteLocker()					{ if (mLocked) mLock.WriteUnlock(); }
+				bool IsLocked() const		{ return mLocked; }
+			private:
+				TableLock& mLock;
+				bool mLocked;
+			};
+
+		private:
+			static const int32 MaxReaders;
+			sem_id mSem;
+		};
 		
 		////////////////////////////////////////////////////////////////////
 		//
@@ -127,8 +198,7 @@ class BmSpamFilter : public BmFilterAddon {
 		static const unsigned long MinPmaxPminRatio;
 	
 	public:
-		static void Microgroom( FeatureBucket* hash, Header* header,
-										unsigned long hindex);
+		static void Microgroom( DataTable* table, unsigned long hindex);
 	private:
 		static void PackData( Header* header, FeatureBucket* hash,
 									 unsigned long packstart, unsigned long packlen);
@@ -146,7 +216,8 @@ class BmSpamFilter : public BmFilterAddon {
 				typedef BmMemFilter inherited;
 			
 			public:
-				HtmlRemover( BmMemIBuf* input, uint32 blockSize=nBlockSize);
+				HtmlRemover( BmMemIBuf* input, bool keepATags, 
+								 uint32 blockSize=nBlockSize);
 			
 			protected:
 				// overrides of BmMailFilter base:
@@ -161,7 +232,7 @@ class BmSpamFilter : public BmFilterAddon {
 			};
 			
 		public:
-			SpamRelevantMailtextSelector(BmMail* mail);
+			SpamRelevantMailtextSelector(BmMail* mail, const BMessage* jobSpecs);
 			void operator() (BmStringIBuf& inBuf);
 		
 		private:
@@ -169,6 +240,8 @@ class BmSpamFilter : public BmFilterAddon {
 			BmBodyPart* FindBodyPartWithHighestSpamRelevance(BmBodyPart* parent);
 			BmRef<BmMail> mMail;
 			BmStringOBuf mDeHtmlBuf;
+			bool mDeHtml;
+			bool mKeepATags;
 		};
 		
 		/*------------------------------------------------------------------------------*\
@@ -189,22 +262,88 @@ class BmSpamFilter : public BmFilterAddon {
 	
 
 
+		/*------------------------------------------------------------------------------*\
+			FeaturePair
+				-	the primary (h1) and crosscut (h2) hash of one sparse bigram,
+					these are what the feature-tables are indexed with
+		\*------------------------------------------------------------------------------*/
+		struct FeaturePair {
+			unsigned long h1;
+			unsigned long h2;
+		};
+
+
+
+		/*------------------------------------------------------------------------------*\
+			FeatureStream
+				-	all the feature-pairs of one mail (WindowLen-1 pairs per word),
+					in the order they have been found
+				-	the pairs depend on the mailtext, on the options used to select
+					it and on the tokenizer, so a stamp of the mail-file, the 
+					options and a format-version are stored along with them
+				-	can be flattened in order to be kept in the msg-context or 
+					in an attribute of the mail
+		\*------------------------------------------------------------------------------*/
+		struct FeatureStream {
+			FeatureStream( uint32 options = 0, uint32 mailStamp = 0);
+
+			void Flatten( vector<char>& data) const;
+			bool Unflatten( const void* data, ssize_t size);
+
+			static uint32 OptionsFor( const BMessage* jobSpecs);
+			static uint32 MailStampFor( const struct stat& st);
+
+			uint32 mOptions;
+			uint32 mMailStamp;
+			vector<FeaturePair> mPairs;
+
+			static const uint32 Magic;
+			static const uint32 FormatVersion;
+							// must be increased whenever FeatureFilter or 
+							// FeatureCollector yield different pairs
+			static const uint32 OptionDeHtml;
+			static const uint32 OptionKeepATags;
+			static const uint32 HeaderWords = 5;
+		};
+
+
+
+		/*------------------------------------------------------------------------------*\
+			FeatureCollector
+				-	collects the feature-pairs of all words found in the mailtext, 
+					such that learning and classifying can work on them without
+					having to look at the mail again
+		\*------------------------------------------------------------------------------*/
+		struct FeatureCollector : public BmMemBufConsumer::Functor {
+			FeatureCollector( FeatureStream& stream);
+
+			status_t operator() (char* buf, uint32 bufLen);
+
+			FeatureStream& mStream;
+			deque<unsigned long> mHashpipe;
+			status_t mStatus;
+		};
+
+
+
 		/*------------------------------------------------------------------------------*\
 			FeatureLearner
 				-	implements the learning of features into the given feature-class
 		\*------------------------------------------------------------------------------*/
-		struct FeatureLearner : public BmMemBufConsumer::Functor {
-			FeatureLearner( FeatureBucket* hash, Header* header, bool revert);
+		struct FeatureLearner {
+			FeatureLearner( DataTable* table, bool revert);
 			~FeatureLearner();
 
-			status_t operator() (char* buf, uint32 bufLen);
+			status_t AddFeature( const FeaturePair& feature);
 
 			void Finalize();
 
+			DataTable* mTable;
 			FeatureBucket* mHash;
 			Header* mHeader;
 			bool mRevert;
-			deque<unsigned long> mHashpipe;
+			vector<uint32> mLockedBuckets;
+			bool mGroomed;
 			status_t mStatus;
 		};
 
@@ -215,12 +354,12 @@ class BmSpamFilter : public BmFilterAddon {
 				-	implements the classifying of features into one of two (or more)
 					feature-classes
 		\*------------------------------------------------------------------------------*/
-		struct FeatureClassifier : public BmMemBufConsumer::Functor {
+		struct FeatureClassifier {
 			FeatureClassifier( FeatureBucket* spamHash, Header* spamHeader,
 									 FeatureBucket* tofuHash, Header* tofuHeader);
 			~FeatureClassifier();
 
-			status_t operator() (char* buf, uint32 bufLen);
+			status_t AddFeature( const FeaturePair& feature, uint32 distance);
 			
 			void Finalize();
 
@@ -232,7 +371,6 @@ class BmSpamFilter : public BmFilterAddon {
 
 			char *mSeenFeatures[MaxHash];
 
-			deque<unsigned long> mHashpipe;
 			status_t mStatus;
 			
 			unsigned long mHits[MaxHash];
@@ -259,23 +397,25 @@ class BmSpamFilter : public BmFilterAddon {
 
 
 
-		bool Learn( BmMsgContext* msgContext, bool learnAsSpam, bool revert);
-		bool DoActualClassification( BmMsgContext* msgContext, double& overallPr);
+		bool GetFeatures( BmMsgContext* msgContext, const BMessage* jobSpecs,
+								FeatureStream& features);
+		bool CollectFeatures( BmMsgContext* msgContext, const BMessage* jobSpecs,
+									 FeatureStream& features);
+		bool Learn( const FeatureStream& features, bool learnAsSpam, 
+						bool revert);
+		bool DoActualClassification( const FeatureStream& features, 
+											  double& overallPr);
 		void Store();
 		status_t CreateDataFile( const BmString& filename);
-		status_t ReadDataFile( const BmString& filename, Header& header,
-									  FeatureBucket*& hash);
-		status_t WriteDataFile( const BmString& filename, Header& header,
-										FeatureBucket*& hash);
+		status_t ReadDataFile( const BmString& filename, DataTable& table);
+		status_t WriteDataFile( const BmString& filename, DataTable& table);
+		void SetLastErr( const char* err);
 		
-		Header mSpamHeader;
-		FeatureBucket* mSpamHash;
-		bool mNeedToStoreSpam;
-		Header mTofuHeader;
-		FeatureBucket* mTofuHash;
-		bool mNeedToStoreTofu;
-		BLocker mLock;
+		DataTable mSpam;
+		DataTable mTofu;
+		TableLock mTableLock;
 		BmString mLastErr;
+		mutable BLocker mLastErrLock;
 	};
 
 public:
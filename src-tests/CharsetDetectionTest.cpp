@@ -0,0 +1,129 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+/*
+ * Beam's test-application is based on the OpenBeOS testing framework
+ * (which in turn is based on cppunit). Big thanks to everyone involved!
+ *
+ */
+
+#include "BmBodyPartList.h"
+#include "BmEncoding.h"
+#include "BmMail.h"
+#include "BmPrefs.h"
+
+#include "CharsetDetectionTest.h"
+#include "TestBeam.h"
+
+using namespace BmEncoding;
+
+// "Privet" (hello) in cyrillic letters, as KOI8-R and as UTF-8:
+static const char* const nKoi8rText = "\xF0\xD2\xC9\xD7\xC5\xD4";
+static const char* const nKoi8rAsUtf8 
+	= "\xD0\x9F\xD1\x80\xD0\xB8\xD0\xB2\xD0\xB5\xD1\x82";
+// "Nihon" (Japan) as Shift_JIS:
+static const char* const nShiftJisText = "\x93\xFA\x96\x7B";
+// "Gruesse" with umlauts as UTF-8:
+static const char* const nUtf8Text = "Gr\xC3\xBC\xC3\x9F" "e";
+
+static BmString nSavedAutoCharsets;
+
+// setUp
+void
+CharsetDetectionTest::setUp()
+{
+	inherited::setUp();
+	nSavedAutoCharsets = ThePrefs->GetString( "AutoCharsetsInbound");
+}
+
+// tearDown
+void
+CharsetDetectionTest::tearDown()
+{
+	ThePrefs->SetString( "AutoCharsetsInbound", nSavedAutoCharsets);
+	inherited::tearDown();
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	the declared charset (the first candidate) must stay first, 
+			whatever the statistics say, only the fallbacks are ordered by 
+			their score
+\*------------------------------------------------------------------------------*/
+void
+CharsetDetectionTest::RankingTest(void)
+{
+	BmCharsetVect candidates;
+	BmCharsetScoreVect ranking;
+
+	NextSubTest();
+	candidates.push_back( "koi8-r");
+	candidates.push_back( "iso-8859-1");
+	candidates.push_back( "windows-1252");
+	candidates.push_back( "utf-8");
+	candidates.push_back( "koi8-r");
+	RankCharsets( nKoi8rText, candidates, ranking);
+	CPPUNIT_ASSERT( ranking.size() == 4);
+	CPPUNIT_ASSERT( ranking[0].charset == "koi8-r");
+	CPPUNIT_ASSERT( ranking[3].charset == "utf-8");
+
+	NextSubTest();
+	candidates[0] = candidates[4] = "shift_jis";
+	RankCharsets( nShiftJisText, candidates, ranking);
+	CPPUNIT_ASSERT( ranking.size() == 4);
+	CPPUNIT_ASSERT( ranking[0].charset == "shift_jis");
+
+	NextSubTest();
+	candidates.clear();
+	candidates.push_back( "big5");
+	candidates.push_back( "iso-8859-1");
+	candidates.push_back( "utf-8");
+	RankCharsets( nUtf8Text, candidates, ranking);
+	CPPUNIT_ASSERT( ranking.size() == 3);
+	CPPUNIT_ASSERT( ranking[0].charset == "big5");
+	CPPUNIT_ASSERT( ranking[1].charset == "utf-8");
+	CPPUNIT_ASSERT( ranking[2].charset == "iso-8859-1");
+
+	NextSubTest();
+	candidates.clear();
+	RankCharsets( nUtf8Text, candidates, ranking);
+	CPPUNIT_ASSERT( ranking.empty());
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	a mail in a correctly declared non-latin charset must be decoded
+			with that charset, even if latin charsets are configured as 
+			fallbacks (which never fail to convert)
+\*------------------------------------------------------------------------------*/
+void
+CharsetDetectionTest::DeclaredCharsetTest(void)
+{
+	ThePrefs->SetString( "AutoCharsetsInbound", 
+								"iso-8859-1,windows-1252,utf-8,default");
+	BmString mailText( "\
+From: sender@test.org\r\n\
+To: you@test.org\r\n\
+Subject: declared charset\r\n\
+MIME-Version: 1.0\r\n\
+Content-Type: text/plain; charset=koi8-r\r\n\
+Content-Transfer-Encoding: 8bit\r\n\
+\r\n\
+");
+	mailText << nKoi8rText << "\r\n";
+
+	NextSubTest();
+	BmRef<BmMail> mail = new BmMail( mailText, "test");
+	BmRef<BmBodyPart> body = mail->Body()->EditableTextBody();
+	CPPUNIT_ASSERT( body.Get() != NULL);
+	BmString decoded = body->DecodedData();
+	decoded.RemoveSet( "\r\n");
+	CPPUNIT_ASSERT( decoded == nKoi8rAsUtf8);
+	CPPUNIT_ASSERT( !body->HadErrorDuringConversion());
+	CPPUNIT_ASSERT( !body->HadParsingErrors());
+	CPPUNIT_ASSERT( !body->SuggestedCharset().ICompare( "koi8-r"));
+}
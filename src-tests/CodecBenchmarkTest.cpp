@@ -0,0 +1,167 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+/*
+ * Beam's test-application is based on the OpenBeOS testing framework
+ * (which in turn is based on cppunit). Big thanks to everyone involved!
+ *
+ */
+
+#include <stdio.h>
+
+#include <OS.h>
+
+#include "BmCodecKernels.h"
+#include "BmEncoding.h"
+#include "BmMemIO.h"
+
+#include "CodecBenchmarkTest.h"
+#include "TestBeam.h"
+
+enum Codec {
+	DECODE_BASE64 = 0,
+	ENCODE_BASE64,
+	DECODE_QP,
+	ENCODE_QP,
+	CODEC_COUNT
+};
+
+static const char* nCodecNames[CODEC_COUNT] = {
+	"base64-decode", "base64-encode", "qp-decode", "qp-encode"
+};
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	runs the given input through the given codec (with whatever kernels
+			are active)
+\*------------------------------------------------------------------------------*/
+static BmString Convert( int codec, const BmString& input)
+{
+	const int32 blockSize = 65536;
+	BmStringIBuf srcBuf( input);
+	BmStringOBuf destBuf( input.Length()*2, 2);
+	BmMemFilter* filter = NULL;
+	switch( codec) {
+		case DECODE_BASE64:
+			filter = new BmBase64Decoder( &srcBuf, blockSize);
+			break;
+		case ENCODE_BASE64:
+			filter = new BmBase64Encoder( &srcBuf, blockSize);
+			break;
+		case DECODE_QP:
+			filter = new BmQuotedPrintableDecoder( &srcBuf, blockSize);
+			break;
+		default:
+			filter = new BmQuotedPrintableEncoder( &srcBuf, blockSize);
+			break;
+	}
+	destBuf.Write( filter, blockSize);
+	delete filter;
+	BmString result;
+	result.Adopt( destBuf.TheString());
+	return result;
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	builds the inputs for all codecs, either from the testdata-files
+			or (if there are none) from some generated text
+\*------------------------------------------------------------------------------*/
+static void BuildInputs( BmString inputs[CODEC_COUNT])
+{
+	if (HaveTestdata) {
+		SlurpFile( "testdata.base64_encoded", inputs[DECODE_BASE64]);
+		SlurpFile( "testdata.base64_decoded", inputs[ENCODE_BASE64]);
+		SlurpFile( "testdata.qp_encoded", inputs[DECODE_QP]);
+		SlurpFile( "testdata.qp_decoded", inputs[ENCODE_QP]);
+		return;
+	}
+	BmString text;
+	for( int32 i=0; i<2000; ++i) {
+		text << "Line " << i << " of some_text with trailing spaces   \n"
+			  << "Gr\xC3\xBC\xC3\x9F""e = \"quoted\" & (more) text, which is "
+			  << "long enough to require a soft linebreak somewhere\n";
+	}
+	inputs[ENCODE_BASE64] = text;
+	inputs[ENCODE_QP] = text;
+	inputs[DECODE_BASE64] = Convert( ENCODE_BASE64, text);
+	inputs[DECODE_QP] = Convert( ENCODE_QP, text);
+}
+
+// setUp
+void
+CodecBenchmarkTest::setUp()
+{
+	inherited::setUp();
+}
+
+// tearDown
+void
+CodecBenchmarkTest::tearDown()
+{
+	BmCodecKernels::Activate( NULL);
+	inherited::tearDown();
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	checks that every kernel-variant supported by this CPU yields the
+			same result as the plain one
+\*------------------------------------------------------------------------------*/
+void
+CodecBenchmarkTest::KernelVariantsTest()
+{
+	BmString inputs[CODEC_COUNT];
+	BuildInputs( inputs);
+	int32 variantCount = BmCodecKernels::CountVariants();
+	CPPUNIT_ASSERT( variantCount > 0);
+	const BmCodecKernels* plain = BmCodecKernels::VariantAt( variantCount-1);
+	CPPUNIT_ASSERT( BmString( plain->name) == "plain");
+	BmCodecKernels::Activate( plain);
+	BmString results[CODEC_COUNT];
+	for( int codec=0; codec<CODEC_COUNT; ++codec)
+		results[codec] = Convert( codec, inputs[codec]);
+	for( int32 v=0; v<variantCount-1; ++v) {
+		BmCodecKernels::Activate( BmCodecKernels::VariantAt( v));
+		for( int codec=0; codec<CODEC_COUNT; ++codec) {
+			NextSubTest();
+			CPPUNIT_ASSERT( Convert( codec, inputs[codec]) == results[codec]);
+		}
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	measures the throughput of every codec with every kernel-variant
+			supported by this CPU (on the large testdata only)
+\*------------------------------------------------------------------------------*/
+void
+CodecBenchmarkTest::ThroughputTest()
+{
+	if (!HaveTestdata)
+		return;
+	Activator activate(LargeDataMode);
+	BmString inputs[CODEC_COUNT];
+	BuildInputs( inputs);
+	const int32 rounds = 10;
+	for( int32 v=0; v<BmCodecKernels::CountVariants(); ++v) {
+		const BmCodecKernels* kernels = BmCodecKernels::VariantAt( v);
+		BmCodecKernels::Activate( kernels);
+		for( int codec=0; codec<CODEC_COUNT; ++codec) {
+			NextSubTest();
+			bigtime_t start = system_time();
+			for( int32 r=0; r<rounds; ++r)
+				Convert( codec, inputs[codec]);
+			bigtime_t duration = std::max( system_time()-start, (bigtime_t)1);
+			double mbPerSec
+				= double(inputs[codec].Length())*rounds/duration;
+			printf( "<%s/%s: %.1f MB/s>", nCodecNames[codec], kernels->name,
+					  mbPerSec);
+			fflush(stdout);
+		}
+	}
+}
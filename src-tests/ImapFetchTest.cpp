@@ -0,0 +1,344 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+/*
+ * Beam's test-application is based on the OpenBeOS testing framework
+ * (which in turn is based on cppunit). Big thanks to everyone involved!
+ *
+ */
+
+#include <Message.h>
+#include <OS.h>
+
+#include "BmImap.h"
+#include "BmMemIO.h"
+
+#include "ImapFetchTest.h"
+#include "TestBeam.h"
+
+static const char* nMail1 = 
+	"From: a@test.org\r\nSubject: one\r\n\r\nfirst body\r\n";
+static const char* nMail2 = 
+	"From: b@test.org\r\nSubject: two\r\n\r\nsecond body,\r\n"
+	"with a line that looks like a status: * 3 FETCH (UID 9 RFC822 {5}\r\n";
+static const char* nMail3 = 
+	"From: c@test.org\r\nSubject: three\r\n\r\nthird body\r\n";
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	builds the answer of a server to "bm7 UID FETCH 11:12,15 rfc822"
+		-	the second message has its UID after the literal, and an 
+			unsolicited flag-update is mixed in
+\*------------------------------------------------------------------------------*/
+static BmString BuildFetchAnswer()
+{
+	BmString answer;
+	answer << "* 1 FETCH (UID 11 RFC822 {" << strlen(nMail1) << "}\r\n"
+			 << nMail1 << ")\r\n"
+			 << "* 2 FETCH (RFC822 {" << strlen(nMail2) << "}\r\n"
+			 << nMail2 << " UID 12)\r\n"
+			 << "* 4 FETCH (FLAGS (\\Seen))\r\n"
+			 << "* 5 FETCH (UID 15 RFC822 {" << strlen(nMail3) << "}\r\n"
+			 << nMail3 << ")\r\n"
+			 << "bm7 OK UID FETCH completed\r\n";
+	return answer;
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	runs the given input through the IMAP status-filter (as BmImap
+			does when receiving an answer) and splits the result
+\*------------------------------------------------------------------------------*/
+static bool ReceiveAndSplit( BmMemIBuf* input, BmString& answerText,
+									  BmImap::FetchedMsgVect& msgs)
+{
+	BMessage infoMsg;
+	infoMsg.AddString( BmImap::IMSG_NEEDED_TAG, "bm7");
+	BmImapStatusFilter filter( input, NULL);
+	filter.SetInfoMsg( &infoMsg);
+	BmStringOBuf answerBuf( 1024, 2.0);
+	answerBuf.Write( &filter, 1500);
+	answerText.Adopt( answerBuf.TheString());
+	CPPUNIT_ASSERT( filter.CheckForPositiveAnswer());
+	return BmImap::SplitFetchAnswer( filter.StatusText(), answerText.Length(), 
+												msgs);
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	checks that the given messages match the three scripted mails
+\*------------------------------------------------------------------------------*/
+static void CheckMsgs( const BmString& answerText, 
+							  const BmImap::FetchedMsgVect& msgs)
+{
+	CPPUNIT_ASSERT( msgs.size() == 3);
+	const char* mails[] = { nMail1, nMail2, nMail3 };
+	for( uint32 i=0; i<3; ++i) {
+		BmString mail( answerText.String()+msgs[i].start, msgs[i].length);
+		CPPUNIT_ASSERT( mail == mails[i]);
+	}
+	CPPUNIT_ASSERT( msgs[0].seqNr == 1 && msgs[0].serverUID == "11");
+	CPPUNIT_ASSERT( msgs[1].seqNr == 2 && msgs[1].serverUID.Length() == 0);
+	CPPUNIT_ASSERT( msgs[2].seqNr == 5 && msgs[2].serverUID == "15");
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	receives the fetch-answer from the given server and checks it
+\*------------------------------------------------------------------------------*/
+static void CheckFetchAnswer( ScriptedServerBuf& server)
+{
+	BmString answerText;
+	BmImap::FetchedMsgVect msgs;
+	CPPUNIT_ASSERT( ReceiveAndSplit( &server, answerText, msgs));
+	CheckMsgs( answerText, msgs);
+}
+
+// setUp
+void
+ImapFetchTest::setUp()
+{
+	inherited::setUp();
+}
+	
+// tearDown
+void
+ImapFetchTest::tearDown()
+{
+	inherited::tearDown();
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	
+\*------------------------------------------------------------------------------*/
+void 
+ImapFetchTest::BatchedFetchTest(void)
+{
+	NextSubTest();
+	BmString script = BuildFetchAnswer();
+	BmStringIBuf input( script);
+	BmString answerText;
+	BmImap::FetchedMsgVect msgs;
+	CPPUNIT_ASSERT( ReceiveAndSplit( &input, answerText, msgs));
+	CheckMsgs( answerText, msgs);
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	the server delivers the answer in tiny chunks with some latency, 
+			such that literals and status-lines are split across reads
+\*------------------------------------------------------------------------------*/
+void 
+ImapFetchTest::SlowServerTest(void)
+{
+	BmString script = BuildFetchAnswer();
+	uint32 chunkSizes[] = { 1, 7, 64 };
+	RunScriptedServer( *this, script, chunkSizes, 
+							 sizeof(chunkSizes)/sizeof(uint32), 100, 
+							 CheckFetchAnswer);
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	an answer whose literals don't add up must be rejected
+\*------------------------------------------------------------------------------*/
+void 
+ImapFetchTest::BrokenAnswerTest(void)
+{
+	NextSubTest();
+	BmImap::FetchedMsgVect msgs;
+	BmString statusText( "* 1 FETCH (UID 11 RFC822 {10}\n"
+								"* 2 FETCH (UID 12 RFC822 {20}\n");
+	CPPUNIT_ASSERT( !BmImap::SplitFetchAnswer( statusText, 25, msgs));
+	CPPUNIT_ASSERT( !BmImap::SplitFetchAnswer( statusText, 35, msgs));
+	CPPUNIT_ASSERT( BmImap::SplitFetchAnswer( statusText, 30, msgs));
+	CPPUNIT_ASSERT( msgs.size() == 2 && msgs[1].start == 10);
+
+	NextSubTest();
+	CPPUNIT_ASSERT( BmImap::SplitFetchAnswer( "", 0, msgs));
+	CPPUNIT_ASSERT( msgs.empty());
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	parses the answers to SELECT and to a FETCH of uid, size and flags,
+			as required for an incremental check
+\*------------------------------------------------------------------------------*/
+void 
+ImapFetchTest::MailboxStatusTest(void)
+{
+	NextSubTest();
+	BmImap::MailboxStatus status;
+	CPPUNIT_ASSERT( BmImap::ParseMailboxStatus( 
+		"* 172 EXISTS\r\n"
+		"* 1 RECENT\r\n"
+		"* OK [UIDVALIDITY 3857529045] UIDs valid\r\n"
+		"* OK [UIDNEXT 4392] Predicted next UID\r\n"
+		"* OK [HIGHESTMODSEQ 90060115205545359] Highest\r\n"
+		"bm3 OK [READ-WRITE] SELECT completed\r\n", status));
+	CPPUNIT_ASSERT( status.exists == 172);
+	CPPUNIT_ASSERT( status.uidValidity == 3857529045UL);
+	CPPUNIT_ASSERT( status.uidNext == 4392);
+	CPPUNIT_ASSERT( status.highestModSeq == 90060115205545359ULL);
+
+	NextSubTest();
+	CPPUNIT_ASSERT( BmImap::ParseMailboxStatus( 
+		"* 0 EXISTS\r\n"
+		"* OK [UIDVALIDITY 17] UIDs valid\r\n"
+		"* OK [NOMODSEQ] Sorry, no modseqs\r\n"
+		"bm3 OK SELECT completed\r\n", status));
+	CPPUNIT_ASSERT( status.exists == 0 && status.uidValidity == 17);
+	CPPUNIT_ASSERT( status.uidNext == 0 && status.highestModSeq == 0);
+	CPPUNIT_ASSERT( !BmImap::ParseMailboxStatus( 
+		"bm3 OK SELECT completed\r\n", status));
+
+	NextSubTest();
+	BmImap::MsgInfoVect infos;
+	CPPUNIT_ASSERT( BmImap::ParseMsgInfos( 
+		"* 7 FETCH (UID 4390 RFC822.SIZE 1200 FLAGS (\\Seen) MODSEQ (12))\r\n"
+		"* 3 FETCH (FLAGS (\\Answered) MODSEQ (13))\r\n"
+		"* 8 FETCH (MODSEQ (14) FLAGS () RFC822.SIZE 55 UID 4391)\r\n"
+		"bm4 OK UID FETCH completed\r\n", infos));
+	CPPUNIT_ASSERT( infos.size() == 2);
+	CPPUNIT_ASSERT( infos[0].seqNr == 7 && infos[0].uid == 4390);
+	CPPUNIT_ASSERT( infos[0].size == 1200 && infos[0].flags != 0);
+	CPPUNIT_ASSERT( infos[1].seqNr == 8 && infos[1].uid == 4391);
+	CPPUNIT_ASSERT( infos[1].size == 55 && infos[1].flags == 0);
+	CPPUNIT_ASSERT( !BmImap::ParseMsgInfos( "* 1 FETCH (UID)\r\n", infos));
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	parses the UID-sets of VANISHED responses and counts the mails
+			reported as expunged
+\*------------------------------------------------------------------------------*/
+void 
+ImapFetchTest::VanishedTest(void)
+{
+	NextSubTest();
+	BmImap::UidRangeVect ranges;
+	CPPUNIT_ASSERT( BmImap::ParseUidSet( "3,9:7,12", ranges));
+	CPPUNIT_ASSERT( ranges.size() == 3);
+	CPPUNIT_ASSERT( ranges[1].first == 7 && ranges[1].last == 9);
+	CPPUNIT_ASSERT( BmImap::ContainsUid( ranges, 8));
+	CPPUNIT_ASSERT( BmImap::ContainsUid( ranges, 12));
+	CPPUNIT_ASSERT( !BmImap::ContainsUid( ranges, 10));
+	CPPUNIT_ASSERT( !BmImap::ParseUidSet( "3:", ranges));
+	CPPUNIT_ASSERT( !BmImap::ParseUidSet( "3;4", ranges));
+
+	NextSubTest();
+	ranges.clear();
+	BmImap::ParseVanished( 
+		"* VANISHED (EARLIER) 41,43:116,118\r\n"
+		"* 1 FETCH (UID 200 RFC822.SIZE 10 FLAGS ())\r\n"
+		"* VANISHED 120\r\n"
+		"bm5 OK UID FETCH completed\r\n", ranges);
+	CPPUNIT_ASSERT( ranges.size() == 4);
+	CPPUNIT_ASSERT( BmImap::ContainsUid( ranges, 100));
+	CPPUNIT_ASSERT( BmImap::ContainsUid( ranges, 120));
+	CPPUNIT_ASSERT( !BmImap::ContainsUid( ranges, 42));
+
+	NextSubTest();
+	CPPUNIT_ASSERT( BmImap::CountExpunged( 
+		"* 3 EXPUNGE\r\n"
+		"* 3 EXPUNGE\r\n"
+		"* 5 EXISTS\r\n"
+		"bm6 OK EXPUNGE completed\r\n") == 2);
+	CPPUNIT_ASSERT( BmImap::CountExpunged( 
+		"* VANISHED 405,407:410\r\n"
+		"bm6 OK EXPUNGE completed\r\n") == 5);
+	CPPUNIT_ASSERT( BmImap::CountExpunged( 
+		"* VANISHED (EARLIER) 1:100\r\n"
+		"bm6 OK EXPUNGE completed\r\n") == 0);
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	decides whether an inbox can be checked incrementally, and how, 
+			and whether the result of an incremental check can be trusted
+\*------------------------------------------------------------------------------*/
+void 
+ImapFetchTest::SyncModeTest(void)
+{
+	BmImap::MailboxStatus status;
+	status.exists = 10;
+	status.uidValidity = 3857529045UL;
+	status.uidNext = 4392;
+	status.highestModSeq = 715;
+	BmImapAccount::SyncState oldState;
+
+	NextSubTest();
+	// nothing known about the last check:
+	CPPUNIT_ASSERT( BmImap::ChooseSyncMode( status, oldState, true) 
+							== BmImap::SYNC_ALL);
+
+	NextSubTest();
+	oldState.uidValidity = status.uidValidity;
+	oldState.uidNext = status.uidNext;
+	oldState.msgCount = status.exists;
+	oldState.highestModSeq = status.highestModSeq;
+	CPPUNIT_ASSERT( BmImap::ChooseSyncMode( status, oldState, true) 
+							== BmImap::SYNC_UNCHANGED);
+	CPPUNIT_ASSERT( BmImap::IncrementalCountMatches( 
+		status, oldState, 0, BmImap::SYNC_UNCHANGED
+	));
+
+	NextSubTest();
+	// the UIDs have been renumbered:
+	status.uidValidity = 17;
+	CPPUNIT_ASSERT( BmImap::ChooseSyncMode( status, oldState, true) 
+							== BmImap::SYNC_ALL);
+	CPPUNIT_ASSERT( BmImap::ChooseSyncMode( status, oldState, false) 
+							== BmImap::SYNC_ALL);
+	// the server doesn't report uidvalidity or uidnext:
+	status.uidValidity = 0;
+	CPPUNIT_ASSERT( BmImap::ChooseSyncMode( status, oldState, true) 
+							== BmImap::SYNC_ALL);
+	status.uidValidity = oldState.uidValidity;
+	status.uidNext = 0;
+	CPPUNIT_ASSERT( BmImap::ChooseSyncMode( status, oldState, true) 
+							== BmImap::SYNC_ALL);
+
+	NextSubTest();
+	// two mails have arrived, one has been removed:
+	status.uidNext = 4394;
+	status.exists = 11;
+	status.highestModSeq = 720;
+	CPPUNIT_ASSERT( BmImap::ChooseSyncMode( status, oldState, true) 
+							== BmImap::SYNC_QRESYNC);
+	CPPUNIT_ASSERT( BmImap::IncrementalCountMatches( 
+		status, oldState, 2, BmImap::SYNC_QRESYNC
+	));
+	// ...but more mails than have been reported as added:
+	CPPUNIT_ASSERT( !BmImap::IncrementalCountMatches( 
+		status, oldState, 0, BmImap::SYNC_QRESYNC
+	));
+
+	NextSubTest();
+	// QRESYNC has not been enabled:
+	CPPUNIT_ASSERT( BmImap::ChooseSyncMode( status, oldState, false) 
+							== BmImap::SYNC_ADDED);
+	// server without CONDSTORE (doesn't report a highestmodseq):
+	status.highestModSeq = 0;
+	CPPUNIT_ASSERT( BmImap::ChooseSyncMode( status, oldState, true) 
+							== BmImap::SYNC_ADDED);
+	// no highestmodseq stored during the last check:
+	status.highestModSeq = 720;
+	oldState.highestModSeq = 0;
+	CPPUNIT_ASSERT( BmImap::ChooseSyncMode( status, oldState, true) 
+							== BmImap::SYNC_ADDED);
+	// without VANISHED, the removed mail can't be found, so all mails have
+	// to be checked:
+	CPPUNIT_ASSERT( !BmImap::IncrementalCountMatches( 
+		status, oldState, 2, BmImap::SYNC_ADDED
+	));
+	status.exists = 12;
+	CPPUNIT_ASSERT( BmImap::IncrementalCountMatches( 
+		status, oldState, 2, BmImap::SYNC_ADDED
+	));
+}
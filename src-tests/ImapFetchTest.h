@@ -0,0 +1,53 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+/*
+ * Beam's test-application is based on the OpenBeOS testing framework
+ * (which in turn is based on cppunit). Big thanks to everyone involved!
+ *
+ */
+
+
+#ifndef _ImapFetchTest_h
+#define _ImapFetchTest_h
+
+#include <cppunit/TestCaller.h>
+#include <cppunit/TestSuite.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <TestCase.h>
+
+class ImapFetchTest : public BTestCase
+{
+	typedef TestCase inherited;
+	CPPUNIT_TEST_SUITE( ImapFetchTest );
+	CPPUNIT_TEST( BatchedFetchTest);
+	CPPUNIT_TEST( SlowServerTest);
+	CPPUNIT_TEST( BrokenAnswerTest);
+	CPPUNIT_TEST( MailboxStatusTest);
+	CPPUNIT_TEST( VanishedTest);
+	CPPUNIT_TEST( SyncModeTest);
+	CPPUNIT_TEST_SUITE_END();
+public:
+	// This function called before *each* test added in Suite()
+	void setUp();
+	
+	// This function called after *each* test added in Suite()
+	void tearDown();
+
+	//------------------------------------------------------------
+	// Test functions
+	//------------------------------------------------------------
+	void BatchedFetchTest();
+	void SlowServerTest();
+	void BrokenAnswerTest();
+	void MailboxStatusTest();
+	void VanishedTest();
+	void SyncModeTest();
+};
+
+
+#endif
@@ -0,0 +1,349 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+/*
+ * Beam's test-application is based on the OpenBeOS testing framework
+ * (which in turn is based on cppunit). Big thanks to everyone involved!
+ *
+ */
+
+#include <Message.h>
+
+#include "BmImap.h"
+#include "BmLogHandler.h"
+#include "BmMemIO.h"
+#include "BmNetJobModel.h"
+
+#include "ImapIdleTest.h"
+#include "TestBeam.h"
+
+/*------------------------------------------------------------------------------*\
+	ImapStandIn
+		-	a network-job that receives the lines sent during IDLE from the 
+			given buffer instead of an IMAP-server
+\*------------------------------------------------------------------------------*/
+class ImapStandIn : public NetJobStandIn {
+	typedef NetJobStandIn inherited;
+public:
+	ImapStandIn( BmMemIBuf* server)
+		:	inherited( "ImapStandIn", BM_LogRecv,
+						  new BmImapStatusFilter( NULL, this), server, true)
+													{ }
+	void ReceiveLine() {
+		BMessage infoMsg;
+		infoMsg.AddString( BmImap::IMSG_NEEDED_TAG, "bm5");
+		infoMsg.AddBool( BmImap::IMSG_SINGLE_LINE, true);
+		GetAnswer( 4096, false, false, &infoMsg);
+	}
+	bool HasPendingLines() const			{ return HasBufferedInput(); }
+};
+
+/*------------------------------------------------------------------------------*\
+	the lines a server sends while idling (after "bm5 IDLE" and "DONE"), 
+	with the event and the number of mails we expect to result from each
+\*------------------------------------------------------------------------------*/
+struct ScriptedLine {
+	const char* wire;
+	BmImap::IdleEvent event;
+	uint32 msgCount;
+};
+
+static ScriptedLine nLines[] = {
+	{ "* 4 EXISTS\r\n", BmImap::IDLE_NEW_MAIL, 4 },
+	{ "* 1 RECENT\r\n", BmImap::IDLE_NOTHING, 4 },
+	{ "* 2 EXPUNGE\r\n", BmImap::IDLE_NOTHING, 3 },
+	{ "* 4 EXISTS\r\n", BmImap::IDLE_NEW_MAIL, 4 },
+	{ "* VANISHED 17:18\r\n", BmImap::IDLE_NOTHING, 2 },
+	{ "* 2 EXISTS\r\n", BmImap::IDLE_NOTHING, 2 },
+};
+static const uint32 nLineCount = sizeof(nLines)/sizeof(ScriptedLine);
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	builds the script of a server that idles, sends the scripted lines,
+			terminates the IDLE-command and then goes away
+\*------------------------------------------------------------------------------*/
+static BmString BuildIdleScript()
+{
+	BmString script( "+ idling\r\n");
+	for( uint32 i=0; i<nLineCount; ++i)
+		script << nLines[i].wire;
+	script << "bm5 OK IDLE terminated\r\n"
+			 << "* BYE server shutting down\r\n";
+	return script;
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	receives the scripted lines one by one and checks each of them
+\*------------------------------------------------------------------------------*/
+static void CheckIdleLines( ScriptedServerBuf& server)
+{
+	ImapStandIn imap( &server);
+	imap.ReceiveLine();
+	CPPUNIT_ASSERT( imap.StatusText() == "+ idling\n");
+	if (server.ChunkSize() >= 512)
+		CPPUNIT_ASSERT( imap.HasPendingLines());
+	uint32 msgCount = 3;
+	for( uint32 i=0; i<nLineCount; ++i) {
+		imap.ReceiveLine();
+		CPPUNIT_ASSERT( imap.BottomStatusText().Length() == 0);
+		CPPUNIT_ASSERT( BmImap::HandleIdleResponse( imap.StatusText(), msgCount)
+							 == nLines[i].event);
+		CPPUNIT_ASSERT( msgCount == nLines[i].msgCount);
+	}
+	imap.ReceiveLine();
+	CPPUNIT_ASSERT( imap.StatusText().Length() == 0);
+	CPPUNIT_ASSERT( imap.BottomStatusText() == "bm5 OK IDLE terminated\n");
+	imap.ReceiveLine();
+	CPPUNIT_ASSERT( BmImap::HandleIdleResponse( imap.StatusText(), msgCount)
+						 == BmImap::IDLE_BYE);
+	CPPUNIT_ASSERT( !imap.HasPendingLines());
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	runs the scripted session through an idle-tracker, just like
+			StateIdle() does (but with a simulated clock, advancing by a 
+			tenth of a second per line)
+\*------------------------------------------------------------------------------*/
+static void CheckIdleSession( ScriptedServerBuf& server)
+{
+	const bigtime_t tick = 100*1000;
+	const bigtime_t settleTime = BmImap::IdleTracker::SettleTime;
+	ImapStandIn imap( &server);
+	BmImap::IdleTracker tracker( 3, BmImap::IdleRenewalTime( 10));
+	bigtime_t now = 0;
+	tracker.IdleSent( now);
+	CPPUNIT_ASSERT( !tracker.IsIdling());
+	for( uint32 i=0; i<=nLineCount; ++i) {
+		CPPUNIT_ASSERT( !tracker.NeedsRenewal( now));
+		imap.ReceiveLine();
+		CPPUNIT_ASSERT( !tracker.HandleLine( imap.StatusText(), 
+														 imap.BottomStatusText(), now));
+		CPPUNIT_ASSERT( tracker.IsIdling());
+		if (i > 0)
+			CPPUNIT_ASSERT( tracker.MsgCount() == nLines[i-1].msgCount);
+		CPPUNIT_ASSERT( !tracker.ShouldTriggerCheck( now));
+		now += tick;
+	}
+	// both new-mail events lie within one settle-time, so they lead to a 
+	// single check, which is due one settle-time after the first event:
+	CPPUNIT_ASSERT( !tracker.ShouldTriggerCheck( tick + settleTime - 1));
+	CPPUNIT_ASSERT( tracker.ShouldTriggerCheck( tick + settleTime));
+	CPPUNIT_ASSERT( !tracker.ShouldTriggerCheck( now + 10*settleTime));
+	// the server terminates the IDLE-command by itself:
+	imap.ReceiveLine();
+	CPPUNIT_ASSERT( tracker.HandleLine( imap.StatusText(), 
+													imap.BottomStatusText(), now));
+	CPPUNIT_ASSERT( !tracker.IsIdling());
+	// IDLE is sent again, but the server says goodbye:
+	tracker.IdleSent( now);
+	imap.ReceiveLine();
+	bool caught = false;
+	try {
+		tracker.HandleLine( imap.StatusText(), imap.BottomStatusText(), now);
+	} catch( BM_network_error&) {
+		caught = true;
+	}
+	CPPUNIT_ASSERT( caught);
+}
+
+// setUp
+void
+ImapIdleTest::setUp()
+{
+	inherited::setUp();
+}
+
+// tearDown
+void
+ImapIdleTest::tearDown()
+{
+	inherited::tearDown();
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	the lines sent during IDLE must be received one by one, no matter
+			how they are spread across the reads, and whatever follows a line
+			must be kept for the next one
+\*------------------------------------------------------------------------------*/
+void
+ImapIdleTest::IdleLinesTest(void)
+{
+	uint32 chunkSizes[] = { 1, 7, 512 };
+	RunScriptedServer( *this, BuildIdleScript(), chunkSizes, 
+							 sizeof(chunkSizes)/sizeof(uint32), 0, CheckIdleLines);
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	the answer to DONE may contain several untagged lines, which must 
+			be evaluated in order
+\*------------------------------------------------------------------------------*/
+void
+ImapIdleTest::IdleResponseTest(void)
+{
+	NextSubTest();
+	uint32 msgCount = 4;
+	CPPUNIT_ASSERT( BmImap::HandleIdleResponse( "* 3 EXPUNGE\n* 5 EXISTS\n",
+															  msgCount)
+						 == BmImap::IDLE_NEW_MAIL);
+	CPPUNIT_ASSERT( msgCount == 5);
+
+	NextSubTest();
+	CPPUNIT_ASSERT( BmImap::HandleIdleResponse( "* 5 EXISTS\n* 1 EXPUNGE\n",
+															  msgCount)
+						 == BmImap::IDLE_NOTHING);
+	CPPUNIT_ASSERT( msgCount == 4);
+
+	NextSubTest();
+	msgCount = 1;
+	CPPUNIT_ASSERT( BmImap::HandleIdleResponse( "* VANISHED 3:7\n", msgCount)
+						 == BmImap::IDLE_NOTHING);
+	CPPUNIT_ASSERT( msgCount == 0);
+	CPPUNIT_ASSERT( BmImap::HandleIdleResponse( "* OK still here\n", msgCount)
+						 == BmImap::IDLE_NOTHING);
+	CPPUNIT_ASSERT( msgCount == 0);
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	drives the decisions of StateIdle() through a scripted session: 
+			IDLE is accepted, new mails lead to a single (delayed) check, the
+			server may terminate IDLE by itself and may end the session
+\*------------------------------------------------------------------------------*/
+void
+ImapIdleTest::IdleSessionTest(void)
+{
+	uint32 chunkSizes[] = { 1, 7, 512 };
+	RunScriptedServer( *this, BuildIdleScript(), chunkSizes, 
+							 sizeof(chunkSizes)/sizeof(uint32), 0, CheckIdleSession);
+
+	NextSubTest();
+	// a server that refuses to IDLE:
+	BmString script( "bm5 BAD unknown command\r\n");
+	BmStringIBuf server( script);
+	ImapStandIn imap( &server);
+	BmImap::IdleTracker tracker( 0, BmImap::IdleRenewalTime( 10));
+	tracker.IdleSent( 0);
+	imap.ReceiveLine();
+	bool caught = false;
+	try {
+		tracker.HandleLine( imap.StatusText(), imap.BottomStatusText(), 0);
+	} catch( BM_network_error&) {
+		caught = true;
+	}
+	CPPUNIT_ASSERT( caught);
+
+	NextSubTest();
+	// new mails announced in the answer to DONE trigger a check, too:
+	BmImap::IdleTracker doneTracker( 2, BmImap::IdleRenewalTime( 10));
+	doneTracker.IdleSent( 0);
+	doneTracker.HandleDoneAnswer( "* 1 EXPUNGE\n* 3 EXISTS\n", 0);
+	CPPUNIT_ASSERT( doneTracker.MsgCount() == 3);
+	CPPUNIT_ASSERT( !doneTracker.IsIdling());
+	CPPUNIT_ASSERT( !doneTracker.ShouldTriggerCheck( 0));
+	CPPUNIT_ASSERT( doneTracker.ShouldTriggerCheck( 
+		BmImap::IdleTracker::SettleTime
+	));
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	IDLE must be renewed before the server may drop the connection 
+			(after 30 minutes, RFC 2177), whatever has been configured
+\*------------------------------------------------------------------------------*/
+void
+ImapIdleTest::IdleRenewalTest(void)
+{
+	const bigtime_t minute = 60*1000*1000LL;
+
+	NextSubTest();
+	CPPUNIT_ASSERT( BmImap::IdleRenewalTime( 10) == 10*minute);
+	CPPUNIT_ASSERT( BmImap::IdleRenewalTime( 0) == minute);
+	CPPUNIT_ASSERT( BmImap::IdleRenewalTime( -5) == minute);
+	CPPUNIT_ASSERT( BmImap::IdleRenewalTime( 29) == 29*minute);
+	CPPUNIT_ASSERT( BmImap::IdleRenewalTime( 30) == 29*minute);
+	CPPUNIT_ASSERT( BmImap::IdleRenewalTime( 1000) == 29*minute);
+
+	NextSubTest();
+	BmImap::IdleTracker tracker( 0, BmImap::IdleRenewalTime( 1000));
+	bigtime_t start = 5*minute;
+	tracker.IdleSent( start);
+	CPPUNIT_ASSERT( !tracker.NeedsRenewal( start));
+	CPPUNIT_ASSERT( !tracker.NeedsRenewal( start + 29*minute - 1));
+	CPPUNIT_ASSERT( tracker.NeedsRenewal( start + 29*minute));
+	// renewing starts another period:
+	tracker.IdleSent( start + 29*minute);
+	CPPUNIT_ASSERT( !tracker.NeedsRenewal( start + 30*minute));
+	CPPUNIT_ASSERT( tracker.NeedsRenewal( start + 58*minute));
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	the delay before reconnecting an interrupted IDLE-session doubles
+			with each failed attempt (but is capped) and is reset as soon as 
+			a connection has been fine
+\*------------------------------------------------------------------------------*/
+void
+ImapIdleTest::ReconnectBackoffTest(void)
+{
+	const bigtime_t second = 1000*1000LL;
+
+	NextSubTest();
+	bigtime_t delay = BmImap::NextReconnectDelay( 0);
+	CPPUNIT_ASSERT( delay == 10*second);
+	bigtime_t expected[] = { 20, 40, 80, 160, 320, 600, 600 };
+	for( uint32 i=0; i<sizeof(expected)/sizeof(bigtime_t); ++i) {
+		delay = BmImap::NextReconnectDelay( delay);
+		CPPUNIT_ASSERT( delay == expected[i]*second);
+	}
+
+	NextSubTest();
+	CPPUNIT_ASSERT( BmImap::NextReconnectDelay( 0) == 10*second);
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	when the IDLE-session (re-)connects, it triggers a check if mails
+			may have arrived since the last complete check (as they won't be
+			announced during IDLE)
+\*------------------------------------------------------------------------------*/
+void
+ImapIdleTest::TriggerAutoCheckTest(void)
+{
+	BmImap::MailboxStatus status;
+	status.exists = 5;
+	status.uidValidity = 1234;
+	status.uidNext = 42;
+	status.highestModSeq = 0;
+	BmImapAccount::SyncState syncState;
+
+	NextSubTest();
+	// nothing known about the inbox:
+	CPPUNIT_ASSERT( BmImap::InboxChangedSince( status, syncState));
+
+	NextSubTest();
+	syncState.uidValidity = 1234;
+	syncState.uidNext = 42;
+	syncState.msgCount = 5;
+	CPPUNIT_ASSERT( !BmImap::InboxChangedSince( status, syncState));
+	// expunged mails alone don't require a check:
+	status.exists = 3;
+	CPPUNIT_ASSERT( !BmImap::InboxChangedSince( status, syncState));
+
+	NextSubTest();
+	status.uidNext = 43;
+	CPPUNIT_ASSERT( BmImap::InboxChangedSince( status, syncState));
+
+	NextSubTest();
+	status.uidNext = 42;
+	status.uidValidity = 4321;
+	CPPUNIT_ASSERT( BmImap::InboxChangedSince( status, syncState));
+}
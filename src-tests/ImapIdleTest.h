@@ -0,0 +1,53 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+/*
+ * Beam's test-application is based on the OpenBeOS testing framework
+ * (which in turn is based on cppunit). Big thanks to everyone involved!
+ *
+ */
+
+
+#ifndef _ImapIdleTest_h
+#define _ImapIdleTest_h
+
+#include <cppunit/TestCaller.h>
+#include <cppunit/TestSuite.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <TestCase.h>
+
+class ImapIdleTest : public BTestCase
+{
+	typedef TestCase inherited;
+	CPPUNIT_TEST_SUITE( ImapIdleTest );
+	CPPUNIT_TEST( IdleLinesTest);
+	CPPUNIT_TEST( IdleResponseTest);
+	CPPUNIT_TEST( IdleSessionTest);
+	CPPUNIT_TEST( IdleRenewalTest);
+	CPPUNIT_TEST( ReconnectBackoffTest);
+	CPPUNIT_TEST( TriggerAutoCheckTest);
+	CPPUNIT_TEST_SUITE_END();
+public:
+	// This function called before *each* test added in Suite()
+	void setUp();
+	
+	// This function called after *each* test added in Suite()
+	void tearDown();
+
+	//------------------------------------------------------------
+	// Test functions
+	//------------------------------------------------------------
+	void IdleLinesTest();
+	void IdleResponseTest();
+	void IdleSessionTest();
+	void IdleRenewalTest();
+	void ReconnectBackoffTest();
+	void TriggerAutoCheckTest();
+};
+
+
+#endif
@@ -0,0 +1,116 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+/*
+ * Beam's test-application is based on the OpenBeOS testing framework
+ * (which in turn is based on cppunit). Big thanks to everyone involved!
+ *
+ */
+
+#include "BmDataModel.h"
+
+#include "ListModelBatchTest.h"
+#include "TestBeam.h"
+
+/*------------------------------------------------------------------------------*\
+	TestItem
+		-	the most simple listmodel-item
+\*------------------------------------------------------------------------------*/
+class TestItem : public BmListModelItem {
+public:
+	TestItem( const BmString& key)
+		:	BmListModelItem( key, NULL, NULL)			{}
+	int16 ArchiveVersion() const			{ return 1; }
+};
+
+// setUp
+void
+ListModelBatchTest::setUp()
+{
+	inherited::setUp();
+}
+
+// tearDown
+void
+ListModelBatchTest::tearDown()
+{
+	inherited::tearDown();
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	successive updates of an item are merged, anything else is kept
+			in order
+\*------------------------------------------------------------------------------*/
+void
+ListModelBatchTest::MergeTest(void)
+{
+	BmRef<BmListModelItem> itemA = new TestItem( "a");
+	BmRef<BmListModelItem> itemB = new TestItem( "b");
+	BmRef<BmListModelBatch> batch = new BmListModelBatch( "test");
+
+	NextSubTest();
+	CPPUNIT_ASSERT( batch->AddChange( BmListModelBatch::ITEM_ADDED, 
+												 itemA.Get()));
+	CPPUNIT_ASSERT( batch->AddChange( BmListModelBatch::ITEM_UPDATED, 
+												 itemA.Get(), UPD_EXPANDER));
+	CPPUNIT_ASSERT( batch->AddChange( BmListModelBatch::ITEM_UPDATED, 
+												 itemB.Get(), UPD_EXPANDER));
+	CPPUNIT_ASSERT( batch->AddChange( BmListModelBatch::ITEM_UPDATED, 
+												 itemA.Get(), UPD_KEY));
+	const BmListModelBatch::BmChangeVect& changes = batch->Changes();
+	CPPUNIT_ASSERT( changes.size() == 3);
+	CPPUNIT_ASSERT( changes[0].type == BmListModelBatch::ITEM_ADDED);
+	CPPUNIT_ASSERT( changes[1].item == itemA);
+	CPPUNIT_ASSERT( changes[1].flags == (UPD_EXPANDER | UPD_KEY));
+	CPPUNIT_ASSERT( changes[2].item == itemB);
+	CPPUNIT_ASSERT( changes[2].flags == UPD_EXPANDER);
+
+	NextSubTest();
+	// a rename is never merged:
+	batch->AddChange( BmListModelBatch::ITEM_UPDATED, itemB.Get(), UPD_KEY, 
+							"c");
+	batch->AddChange( BmListModelBatch::ITEM_UPDATED, itemB.Get(), 
+							UPD_EXPANDER);
+	CPPUNIT_ASSERT( changes.size() == 5);
+	CPPUNIT_ASSERT( changes[3].oldKey == "c");
+	CPPUNIT_ASSERT( changes[4].flags == UPD_EXPANDER);
+
+	NextSubTest();
+	// updates following a removal must not be merged into earlier ones:
+	batch->AddChange( BmListModelBatch::ITEM_REMOVED, itemA.Get());
+	batch->AddChange( BmListModelBatch::ITEM_ADDED, itemA.Get());
+	batch->AddChange( BmListModelBatch::ITEM_UPDATED, itemA.Get(), UPD_KEY);
+	CPPUNIT_ASSERT( changes.size() == 8);
+	CPPUNIT_ASSERT( changes[1].flags == (UPD_EXPANDER | UPD_KEY));
+	CPPUNIT_ASSERT( changes[7].type == BmListModelBatch::ITEM_UPDATED);
+	CPPUNIT_ASSERT( batch->AddedCount() == 2);
+	CPPUNIT_ASSERT( batch->RemovedCount() == 1);
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	a closed batch doesn't accept any more changes
+\*------------------------------------------------------------------------------*/
+void
+ListModelBatchTest::CloseTest(void)
+{
+	BmRef<BmListModelItem> item = new TestItem( "a");
+	BmRef<BmListModelBatch> batch = new BmListModelBatch( "test");
+
+	NextSubTest();
+	CPPUNIT_ASSERT( batch->AddChange( BmListModelBatch::ITEM_UPDATED, 
+												 item.Get(), UPD_KEY));
+	batch->Close();
+	CPPUNIT_ASSERT( !batch->AddChange( BmListModelBatch::ITEM_UPDATED, 
+												  item.Get(), UPD_EXPANDER));
+	CPPUNIT_ASSERT( !batch->AddChange( BmListModelBatch::ITEM_REMOVED, 
+												  item.Get()));
+	CPPUNIT_ASSERT( batch->Changes().size() == 1);
+	CPPUNIT_ASSERT( batch->Changes()[0].flags == UPD_KEY);
+	CPPUNIT_ASSERT( batch->RemovedCount() == 0);
+}
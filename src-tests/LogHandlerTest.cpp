@@ -0,0 +1,263 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+/*
+ * Beam's test-application is based on the OpenBeOS testing framework
+ * (which in turn is based on cppunit). Big thanks to everyone involved!
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <Entry.h>
+#include <FindDirectory.h>
+#include <OS.h>
+#include <Path.h>
+
+#include "BmEncoding.h"
+#include "BmLogHandler.h"
+#include "BmMemIO.h"
+#include "BmStorageUtil.h"
+
+#include "LogHandlerTest.h"
+#include "TestBeam.h"
+
+static const char* const nLogName = "LogHandlerTest";
+static const int32 nMessageCount = 5000;
+static const int32 nWriterCount = 4;
+static const int32 nDisabledCallCount = 1000000;
+
+static int32 nBuiltMessages;
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	returns the path of the test-logfile
+\*------------------------------------------------------------------------------*/
+static BmString LogfilePath()
+{
+	BPath logPath;
+	find_directory( B_SYSTEM_LOG_DIRECTORY, &logPath, true);
+	return BmString( logPath.Path()) << "/beam_test/" << nLogName << ".log";
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	closes the test-logfile (which writes all pending entries) and
+			returns its contents
+\*------------------------------------------------------------------------------*/
+static BmString FinishAndFetchLog()
+{
+	BM_LOG_FINISH( nLogName);
+	BmString contents;
+	CPPUNIT_ASSERT( FetchFile( LogfilePath(), contents));
+	return contents;
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	logs numbered messages as fast as possible
+\*------------------------------------------------------------------------------*/
+static int32 WriterThread( void* data)
+{
+	int32 writer = (int32)data;
+	for( int32 i=0; i<nMessageCount; ++i)
+		BmLogHandler::Log( nLogName, BmString("writer ") << writer << ": " << i);
+	return 0;
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	counts the entries of the writer-threads found in the given 
+			log-contents (checking that the entries of each thread have kept 
+			their order) and the entries that have been dropped
+\*------------------------------------------------------------------------------*/
+static void CountWriterEntries( const BmString& contents, int32& seenCount,
+										  int32& droppedCount)
+{
+	int32 lastSeen[nWriterCount];
+	seenCount = 0;
+	droppedCount = 0;
+	for( int32 i=0; i<nWriterCount; ++i)
+		lastSeen[i] = -1;
+	const char* line = contents.String();
+	while( line && *line) {
+		const char* text = strstr( line, ">: ");
+		CPPUNIT_ASSERT( text != NULL);
+		int32 writer, num, dropped;
+		if (sscanf( text+3, "writer %ld: %ld", &writer, &num) == 2) {
+			CPPUNIT_ASSERT( writer >= 0 && writer < nWriterCount);
+			CPPUNIT_ASSERT( num > lastSeen[writer]);
+			lastSeen[writer] = num;
+			seenCount++;
+		} else if (sscanf( text+3, "%ld log-entries have been dropped",
+								 &dropped) == 1)
+			droppedCount += dropped;
+		line = strchr( line, '\n');
+		if (line)
+			line++;
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	builds a log-message (and counts that it has been built)
+\*------------------------------------------------------------------------------*/
+static BmString CountedMessage( int32 i)
+{
+	nBuiltMessages++;
+	return BmString("message ") << i;
+}
+
+// setUp
+void
+LogHandlerTest::setUp()
+{
+	inherited::setUp();
+	BEntry( LogfilePath().String()).Remove();
+}
+
+// tearDown
+void
+LogHandlerTest::tearDown()
+{
+	inherited::tearDown();
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	checks the formatting of multiline entries
+\*------------------------------------------------------------------------------*/
+void
+LogHandlerTest::FormatTest(void)
+{
+	NextSubTest();
+	BmLogHandler::Log( nLogName, "first\r\nsecond\n\nthird");
+	BmString contents = FinishAndFetchLog();
+	int32 pos = contents.FindFirst( ">: ");
+	CPPUNIT_ASSERT( pos > 0);
+	BmString indent;
+	indent.SetTo( ' ', 34);
+	CPPUNIT_ASSERT( BmString( contents.String()+pos+3)
+							== BmString("first<CR>\n") << indent << "second\n"
+									<< indent << "third\n");
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	several threads log concurrently, every entry must be written
+			(or counted as dropped) and the entries of each thread must keep
+			their order
+\*------------------------------------------------------------------------------*/
+void
+LogHandlerTest::ConcurrentWriteTest(void)
+{
+	NextSubTest();
+	thread_id writers[nWriterCount];
+	bigtime_t start = system_time();
+	for( int32 i=0; i<nWriterCount; ++i) {
+		writers[i] = spawn_thread( WriterThread, "log-writer",
+											B_NORMAL_PRIORITY, (void*)i);
+		CPPUNIT_ASSERT( writers[i] >= 0);
+		resume_thread( writers[i]);
+	}
+	for( int32 i=0; i<nWriterCount; ++i) {
+		status_t exitVal;
+		wait_for_thread( writers[i], &exitVal);
+	}
+	bigtime_t duration = system_time()-start;
+	BmString contents = FinishAndFetchLog();
+
+	int32 seenCount, droppedCount;
+	CountWriterEntries( contents, seenCount, droppedCount);
+	printf( "<%ld entries in %Ld us, %ld dropped>",
+			  nWriterCount*nMessageCount, duration, droppedCount);
+	fflush(stdout);
+	CPPUNIT_ASSERT( seenCount + droppedCount == nWriterCount*nMessageCount);
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	the logfile is closed over and over again while several threads 
+			are logging to it (finding it without locking), no entry may get
+			lost in the process
+\*------------------------------------------------------------------------------*/
+void
+LogHandlerTest::CloseWhileWritingTest(void)
+{
+	NextSubTest();
+	// the logfile must not be shrunk when it is reopened:
+	int32 maxFileSize = TheLogHandler->MaxFileSize();
+	TheLogHandler->LogLevels( TheLogHandler->LogLevels(), 
+									  TheLogHandler->MinFileSize(), 64*1024*1024);
+	thread_id writers[nWriterCount];
+	for( int32 i=0; i<nWriterCount; ++i) {
+		writers[i] = spawn_thread( WriterThread, "log-writer",
+											B_NORMAL_PRIORITY, (void*)i);
+		CPPUNIT_ASSERT( writers[i] >= 0);
+		resume_thread( writers[i]);
+	}
+	for( int32 i=0; i<50; ++i) {
+		snooze( 1000);
+		BM_LOG_FINISH( nLogName);
+	}
+	for( int32 i=0; i<nWriterCount; ++i) {
+		status_t exitVal;
+		wait_for_thread( writers[i], &exitVal);
+	}
+	BmString contents = FinishAndFetchLog();
+
+	int32 seenCount, droppedCount;
+	CountWriterEntries( contents, seenCount, droppedCount);
+	TheLogHandler->LogLevels( TheLogHandler->LogLevels(), 
+									  TheLogHandler->MinFileSize(), maxFileSize);
+	CPPUNIT_ASSERT( seenCount + droppedCount == nWriterCount*nMessageCount);
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	measures the overhead of log-statements whose loglevel is disabled,
+			on their own and within the base64-decoder (which contains two
+			of them per call of Filter())
+		-	the messages of disabled log-statements must never be built
+\*------------------------------------------------------------------------------*/
+void
+LogHandlerTest::DisabledLogOverheadTest(void)
+{
+	NextSubTest();
+	uint32 logLevels = TheLogHandler->LogLevels();
+	TheLogHandler->LogLevels( logLevels & ~BM_LOGLVL3(BM_LogMailParse),
+									  TheLogHandler->MinFileSize(),
+									  TheLogHandler->MaxFileSize());
+	nBuiltMessages = 0;
+	bigtime_t start = system_time();
+	for( int32 i=0; i<nDisabledCallCount; ++i)
+		BM_LOG3( BM_LogMailParse, CountedMessage( i));
+	bigtime_t duration = system_time()-start;
+	printf( "<disabled BM_LOG3: %.2f ns per call>", 
+			  1000.0*duration/nDisabledCallCount);
+
+	NextSubTest();
+	BmString input;
+	for( int32 i=0; i<nDisabledCallCount/100; ++i)
+		input << "YWJj";
+	const int32 blockSize = 4;
+	BmStringIBuf srcBuf( input);
+	BmStringOBuf destBuf( input.Length());
+	BmBase64Decoder decoder( &srcBuf, blockSize);
+	start = system_time();
+	destBuf.Write( &decoder, blockSize);
+	duration = system_time()-start;
+	printf( "<base64-decoder: %.2f ns per call of Filter()>", 
+			  1000.0*duration/(input.Length()/blockSize));
+	fflush(stdout);
+
+	TheLogHandler->LogLevels( logLevels, TheLogHandler->MinFileSize(),
+									  TheLogHandler->MaxFileSize());
+	CPPUNIT_ASSERT( nBuiltMessages == 0);
+	CPPUNIT_ASSERT( destBuf.TheString().Length() == input.Length()/4*3);
+}
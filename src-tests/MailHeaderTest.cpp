@@ -0,0 +1,282 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+/*
+ * Beam's test-application is based on the OpenBeOS testing framework
+ * (which in turn is based on cppunit). Big thanks to everyone involved!
+ *
+ */
+
+#include <string.h>
+
+#include "BmBodyPartList.h"
+#include "BmFilterAddon.h"
+#include "BmMail.h"
+#include "BmMailHeader.h"
+
+#include "MailHeaderTest.h"
+#include "TestBeam.h"
+
+static BmString nHeaderText("\
+Date: Mon, 25 Feb 2003 08:51:06 -0500\r\n\
+Received: through2\r\n\
+Received: through1\r\n\
+From: Some Sender <sender@test.org>\r\n\
+To: you@test.org\r\n\
+Subject: A simple testmail\r\n\
+X-Spam-Status: No\r\n\
+x-spam-level: ***\r\n\
+\r\n\
+");
+
+// setUp
+void
+MailHeaderTest::setUp()
+{
+	inherited::setUp();
+}
+
+// tearDown
+void
+MailHeaderTest::tearDown()
+{
+	inherited::tearDown();
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	looks up known and unknown fields with differing case
+\*------------------------------------------------------------------------------*/
+void
+MailHeaderTest::FieldLookupTest(void)
+{
+	BmRef<BmMailHeader> header
+		= new BmMailHeader( BmStringView( nHeaderText), NULL);
+
+	NextSubTest();
+	CPPUNIT_ASSERT( header->GetFieldVal( "Subject") == "A simple testmail");
+	CPPUNIT_ASSERT( header->GetFieldVal( "SUBJECT") == "A simple testmail");
+	CPPUNIT_ASSERT( header->CountFieldVals( "received") == 2);
+	CPPUNIT_ASSERT( header->GetFieldVal( "Received", 1) == "through1");
+	CPPUNIT_ASSERT( header->GetFieldVal( "Received", 2) == "");
+	CPPUNIT_ASSERT( header->GetFieldVal( "from") == "Some Sender <sender@test.org>");
+
+	NextSubTest();
+	CPPUNIT_ASSERT( header->GetFieldVal( "X-Spam-Status") == "No");
+	CPPUNIT_ASSERT( header->GetFieldVal( "x-SPAM-status") == "No");
+	CPPUNIT_ASSERT( header->GetFieldVal( "X-Spam-Level") == "***");
+	CPPUNIT_ASSERT( header->CountFieldVals( "X-Spam") == 0);
+	CPPUNIT_ASSERT( header->IsFieldEmpty( "X-Unknown"));
+
+	NextSubTest();
+	header->AddFieldVal( "x-spam-status", "Yes");
+	CPPUNIT_ASSERT( header->CountFieldVals( "X-Spam-Status") == 2);
+	header->RemoveField( "X-SPAM-STATUS");
+	CPPUNIT_ASSERT( header->CountFieldVals( "X-Spam-Status") == 0);
+	CPPUNIT_ASSERT( header->GetFieldVal( "X-Spam-Level") == "***");
+	header->RemoveField( "subject");
+	CPPUNIT_ASSERT( header->IsFieldEmpty( "Subject"));
+	header->SetFieldVal( "SUBJECT", "Another one");
+	CPPUNIT_ASSERT( header->GetFieldVal( "Subject") == "Another one");
+
+	NextSubTest();
+	vector<BmString> names;
+	header->GetAllFieldNames( names);
+	CPPUNIT_ASSERT( names.size() == 6);
+	CPPUNIT_ASSERT( names[0] == "Date");
+	CPPUNIT_ASSERT( names[4] == "To");
+	CPPUNIT_ASSERT( names[5] == "X-Spam-Level");
+
+	NextSubTest();
+	// enough unknown fields to make the hash-index grow several times:
+	for( int i=0; i<40; ++i)
+		header->AddFieldVal( BmString("X-Field-") << i, BmString() << i);
+	for( int i=0; i<40; ++i) {
+		CPPUNIT_ASSERT( 
+			header->GetFieldVal( BmString("x-field-") << i) == BmString() << i
+		);
+	}
+	header->RemoveField( "X-Field-7");
+	CPPUNIT_ASSERT( header->IsFieldEmpty( "X-Field-7"));
+	CPPUNIT_ASSERT( header->GetFieldVal( "X-Field-8") == "8");
+	CPPUNIT_ASSERT( header->GetFieldVal( "X-Field-39") == "39");
+	CPPUNIT_ASSERT( header->GetFieldVal( "X-Spam-Level") == "***");
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	checks the properties of some fields
+\*------------------------------------------------------------------------------*/
+void
+MailHeaderTest::FieldPropertiesTest(void)
+{
+	NextSubTest();
+	CPPUNIT_ASSERT( BmMailHeader::IsAddressField( "resent-from"));
+	CPPUNIT_ASSERT( BmMailHeader::IsAddressField( "List-ID"));
+	CPPUNIT_ASSERT( !BmMailHeader::IsAddressField( "Subject"));
+	CPPUNIT_ASSERT( !BmMailHeader::IsAddressField( "X-From"));
+
+	NextSubTest();
+	CPPUNIT_ASSERT( BmMailHeader::IsIdentificationField( "message-id"));
+	CPPUNIT_ASSERT( !BmMailHeader::IsIdentificationField( "Resent-Message-Id"));
+
+	NextSubTest();
+	CPPUNIT_ASSERT( !BmMailHeader::IsEncodingOkForField( "Content-Whatever"));
+	CPPUNIT_ASSERT( !BmMailHeader::IsEncodingOkForField( "RESENT-DATE"));
+	CPPUNIT_ASSERT( BmMailHeader::IsEncodingOkForField( "Subject"));
+	CPPUNIT_ASSERT( BmMailHeader::IsEncodingOkForField( "X-Whatever"));
+
+	NextSubTest();
+	CPPUNIT_ASSERT( !BmMailHeader::IsStrippingOkForField( "x-whatever"));
+	CPPUNIT_ASSERT( !BmMailHeader::IsStrippingOkForField( "Subject"));
+	CPPUNIT_ASSERT( BmMailHeader::IsStrippingOkForField( "To"));
+	CPPUNIT_ASSERT( BmMailHeader::IsStrippingOkForField( "Whatever"));
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	all message-contexts of a mail share the same header-infos, which
+			are rebuilt once the header changes
+		-	contexts keep using their (old) infos even if the header changes
+			or goes away
+\*------------------------------------------------------------------------------*/
+void
+MailHeaderTest::SharedHeaderInfosTest(void)
+{
+	BmRef<BmMailHeader> header
+		= new BmMailHeader( BmStringView( nHeaderText), NULL);
+
+	NextSubTest();
+	BmMsgContext* context1 = new BmMsgContext;
+	BmMsgContext* context2 = new BmMsgContext;
+	header->GetAllFieldValues( *context1);
+	header->GetAllFieldValues( *context2);
+	CPPUNIT_ASSERT( context1->headerInfos != NULL);
+	CPPUNIT_ASSERT( context1->headerInfos == context2->headerInfos);
+	CPPUNIT_ASSERT( context1->headerInfoCount == 7);
+	delete context1;
+	const BmHeaderInfo* info = context2->FindHeaderInfo( "RECEIVED");
+	CPPUNIT_ASSERT( info != NULL);
+	CPPUNIT_ASSERT( strcmp( info->values[0], "through2") == 0);
+	CPPUNIT_ASSERT( strcmp( info->values[1], "through1") == 0);
+	CPPUNIT_ASSERT( info->values[2] == NULL);
+
+	NextSubTest();
+	// changing the header must not pull the infos from under a context
+	// that still uses them:
+	header->AddFieldVal( "Received", "through0");
+	header->SetFieldVal( "Subject", "Changed");
+	info = context2->FindHeaderInfo( "Received");
+	CPPUNIT_ASSERT( info != NULL);
+	CPPUNIT_ASSERT( strcmp( info->values[1], "through1") == 0);
+	CPPUNIT_ASSERT( info->values[2] == NULL);
+	info = context2->FindHeaderInfo( "Subject");
+	CPPUNIT_ASSERT( info != NULL);
+	CPPUNIT_ASSERT( strcmp( info->values[0], "A simple testmail") == 0);
+
+	NextSubTest();
+	BmMsgContext context;
+	header->GetAllFieldValues( context);
+	CPPUNIT_ASSERT( context.headerInfos != context2->headerInfos);
+	info = context.FindHeaderInfo( "Received");
+	CPPUNIT_ASSERT( info != NULL);
+	CPPUNIT_ASSERT( strcmp( info->values[2], "through0") == 0);
+	delete context2;
+	header = NULL;
+	// the context still holds its own reference:
+	info = context.FindHeaderInfo( "Subject");
+	CPPUNIT_ASSERT( info != NULL);
+	CPPUNIT_ASSERT( strcmp( info->values[0], "Changed") == 0);
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	parses the value and parameters of content-fields (Content-Type,
+			Content-Disposition), including quoted, RFC 2231-encoded and
+			broken parameters
+\*------------------------------------------------------------------------------*/
+void
+MailHeaderTest::ContentFieldTest(void)
+{
+	NextSubTest();
+	BmContentField plain( "Text/Plain; Charset=US-ASCII;format=flowed");
+	CPPUNIT_ASSERT( plain.InitCheck() == B_OK);
+	CPPUNIT_ASSERT( plain.Value() == "text/plain");
+	CPPUNIT_ASSERT( plain.Param( "charset") == "US-ASCII");
+	CPPUNIT_ASSERT( plain.Param( "CHARSET") == "US-ASCII");
+	CPPUNIT_ASSERT( plain.Param( "format") == "flowed");
+	CPPUNIT_ASSERT( plain.Param( "delsp") == "");
+
+	NextSubTest();
+	// quoted parameters (with separators inside the quotes), whitespace 
+	// around '=' and missing semicolons:
+	BmContentField quoted( 
+		"multipart/mixed; boundary=\"=_a;b c_=\" ;\r\n\tname = \"my file.txt\""
+		" x-unix-mode=0644"
+	);
+	CPPUNIT_ASSERT( quoted.Value() == "multipart/mixed");
+	CPPUNIT_ASSERT( quoted.Param( "boundary") == "=_a;b c_=");
+	CPPUNIT_ASSERT( quoted.Param( "name") == "my file.txt");
+	CPPUNIT_ASSERT( quoted.Param( "x-unix-mode") == "0644");
+	CPPUNIT_ASSERT( quoted.Param( "mode") == "");
+
+	NextSubTest();
+	// charset-parameters are kept as they are (the body-part decides how to 
+	// interpret them):
+	BmContentField charset( "text/html; charset=\"utf-8\"");
+	CPPUNIT_ASSERT( charset.Param( "charset") == "utf-8");
+	charset.SetTo( "text/plain; charset=unknown-8bit");
+	CPPUNIT_ASSERT( charset.Param( "charset") == "unknown-8bit");
+
+	NextSubTest();
+	// RFC 2231: continuations, possibly out of order...
+	BmContentField continued( 
+		"attachment; filename*1=\"part.pdf\"; filename*0=\"a long \"; "
+		"size=42"
+	);
+	CPPUNIT_ASSERT( continued.Value() == "attachment");
+	CPPUNIT_ASSERT( continued.Param( "filename") == "a long part.pdf");
+	CPPUNIT_ASSERT( continued.Param( "size") == "42");
+	CPPUNIT_ASSERT( continued.Param( "0") == "");
+	CPPUNIT_ASSERT( continued.Param( "1") == "");
+	// ...with charset and %-encoding...
+	BmContentField extended( 
+		"attachment; filename*=iso-8859-1'de'Gr%FC%DFe%20%2x.txt"
+	);
+	CPPUNIT_ASSERT( extended.Param( "filename") == "Gr\xC3\xBC\xC3\x9F" "e %2x.txt");
+	// ...and both combined (the extended value wins over a plain one):
+	BmContentField combined( 
+		"attachment; filename=\"fallback.txt\";\r\n"
+		" filename*0*=utf-8''%E2%82%AC%20; filename*1=\"and more\";\r\n"
+		" filename*2*=%21"
+	);
+	CPPUNIT_ASSERT( combined.Param( "filename") == "\xE2\x82\xAC and more!");
+
+	NextSubTest();
+	// empty and broken parameters are skipped (up to the next ';'):
+	BmContentField broken( 
+		"text/plain; =oops; charset=; \"junk\"=1; name=\"\"; *=2;"
+		" format = ; delsp=yes; ;; name*x=3; level=\"unterminated"
+	);
+	CPPUNIT_ASSERT( broken.InitCheck() == B_OK);
+	CPPUNIT_ASSERT( broken.Value() == "text/plain");
+	CPPUNIT_ASSERT( broken.Param( "charset") == "");
+	CPPUNIT_ASSERT( broken.Param( "junk") == "");
+	CPPUNIT_ASSERT( broken.Param( "name") == "");
+	CPPUNIT_ASSERT( broken.Param( "x") == "");
+	CPPUNIT_ASSERT( broken.Param( "format") == "");
+	CPPUNIT_ASSERT( broken.Param( "delsp") == "yes");
+	CPPUNIT_ASSERT( broken.Param( "level") == "unterminated");
+
+	NextSubTest();
+	// a field without a value is rejected:
+	BmContentField empty( "  ; charset=utf-8");
+	CPPUNIT_ASSERT( empty.InitCheck() != B_OK);
+	BmContentField nothing( "");
+	CPPUNIT_ASSERT( nothing.InitCheck() != B_OK);
+	CPPUNIT_ASSERT( nothing.Param( "charset") == "");
+}
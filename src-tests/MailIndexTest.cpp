@@ -0,0 +1,336 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+/*
+ * Beam's test-application is based on the OpenBeOS testing framework
+ * (which in turn is based on cppunit). Big thanks to everyone involved!
+ *
+ */
+
+#include <algorithm>
+#include <string.h>
+
+#include <Entry.h>
+#include <File.h>
+
+#include "BmBodyPartList.h"
+#include "BmMail.h"
+#include "BmMailIndex.h"
+#include "BmMailRef.h"
+#include "BmPrefs.h"
+
+#include "MailIndexTest.h"
+#include "TestBeam.h"
+
+static const char* const nIndexedMailPath = "/tmp/beam_mailindex_testmail";
+static const char* const nLazyMailPath = "/tmp/beam_mailindex_lazymail";
+static const char* const nBrokenMailPath = "/tmp/beam_mailindex_brokenmail";
+
+static int32 nSavedLazyLoadThreshold;
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	returns a multipart mail with a short text-part and the given number
+			of larger body-parts
+\*------------------------------------------------------------------------------*/
+static BmString MultipartMail( int32 largeBodyCount, int32 lineCount)
+{
+	const char* lb = "\r\n";
+	BmString text;
+	text << "From: sender@test.org" << lb
+		  << "To: you@test.org" << lb
+		  << "Subject: large body-parts" << lb
+		  << "MIME-Version: 1.0" << lb
+		  << "Content-Type: multipart/mixed; boundary=\"outer\"" << lb
+		  << lb
+		  << "preamble" << lb
+		  << "--outer" << lb
+		  << "Content-Type: text/plain" << lb
+		  << lb
+		  << "some text" << lb;
+	for( int32 b=0; b<largeBodyCount; ++b) {
+		text << "--outer" << lb
+			  << "Content-Type: application/octet-stream" << lb
+			  << lb;
+		for( int32 l=0; l<lineCount; ++l)
+			text << "line " << l << " of large body-part " << b << lb;
+	}
+	text << "--outer--" << lb;
+	return text;
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	writes the given mail into the test-file and indexes it in blocks of
+			the given size
+		-	returns the mailtext put together again from the skeleton and the
+			elided body-parts
+\*------------------------------------------------------------------------------*/
+static BmString IndexMail( const BmString& mailText, int32 maxInlineLength,
+									int32 blockSize, BmString& skeleton,
+									BmElidedBodyVect& elidedBodies,
+									bool* isAmbiguous = NULL)
+{
+	BFile file( nIndexedMailPath, B_READ_WRITE | B_CREATE_FILE | B_ERASE_FILE);
+	file.Write( mailText.String(), mailText.Length());
+
+	BmStringOBuf skeletonBuf( 1024);
+	BmMailIndexer indexer( skeletonBuf, elidedBodies, maxInlineLength);
+	vector<char> block( blockSize);
+	for( int32 pos=0; pos<mailText.Length(); pos+=blockSize) {
+		int32 len = MIN( blockSize, mailText.Length()-pos);
+		// the indexer may modify the block (just like a block read from file):
+		memcpy( &block[0], mailText.String()+pos, len);
+		indexer.Add( &block[0], len);
+	}
+	indexer.Finish();
+	skeleton = skeletonBuf.TheString();
+	if (isAmbiguous)
+		*isAmbiguous = indexer.IsAmbiguous();
+
+	BmStringOBuf text( 2*mailText.Length()+1);
+	int32 pos = 0;
+	for( uint32 i=0; i<elidedBodies.size(); ++i) {
+		const BmElidedBody& body = elidedBodies[i];
+		text.Write( skeleton.String()+pos, body.startInText-pos);
+		BmMailFileIBuf bodyText( &file, body.startInFile, body.lengthInFile,
+										 100);
+		text.Write( &bodyText);
+		pos = body.startInText;
+	}
+	text.Write( skeleton.String()+pos, skeleton.Length()-pos);
+	CPPUNIT_ASSERT( (uint32)indexer.TextLength() == text.CurrPos());
+	return text.TheString();
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	writes the given mail into a file and loads it from there
+\*------------------------------------------------------------------------------*/
+static BmRef<BmMail> LoadMail( const char* path, const BmString& mailText)
+{
+	BFile file( path, B_READ_WRITE | B_CREATE_FILE | B_ERASE_FILE);
+	file.Write( mailText.String(), mailText.Length());
+	entry_ref eref;
+	if (get_ref_for_path( path, &eref) != B_OK)
+		return NULL;
+	BmRef<BmMailRef> ref = BmMailRef::CreateInstance( eref);
+	if (!ref)
+		return NULL;
+	BmRef<BmMail> mail = BmMail::CreateInstance( ref.Get());
+	mail->StartJobInThisThread();
+	return mail;
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	returns the decoded data of all body-parts of the given mail (sorted,
+			since the order of the body-parts depends on their keys)
+\*------------------------------------------------------------------------------*/
+static vector<BmString> DecodedBodies( BmMail* mail)
+{
+	struct DecodedDataCollector : public BmListModelItem::Collector {
+		virtual bool operator() (BmListModelItem* listItem)
+		{
+			BmBodyPart* bodyPart = dynamic_cast<BmBodyPart*>( listItem);
+			if (bodyPart && !bodyPart->IsMultiPart())
+				decodedData.push_back( bodyPart->DecodedData());
+			return true;
+		}
+		vector<BmString> decodedData;
+	};
+	DecodedDataCollector collector;
+	mail->Body()->ForEachItem( collector);
+	std::sort( collector.decodedData.begin(), collector.decodedData.end());
+	return collector.decodedData;
+}
+
+// setUp
+void
+MailIndexTest::setUp()
+{
+	inherited::setUp();
+	nSavedLazyLoadThreshold = ThePrefs->GetInt( "LazyLoadThreshold");
+	ThePrefs->SetInt( "LazyLoadThreshold", 1024);
+}
+
+// tearDown
+void
+MailIndexTest::tearDown()
+{
+	ThePrefs->SetInt( "LazyLoadThreshold", nSavedLazyLoadThreshold);
+	inherited::tearDown();
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	only the large body-part is left out of the skeleton, and the mail
+			can be put together again from the skeleton and the index
+\*------------------------------------------------------------------------------*/
+void
+MailIndexTest::SkeletonTest(void)
+{
+	BmString mailText = MultipartMail( 1, 100);
+	BmString skeleton;
+	BmElidedBodyVect elidedBodies;
+
+	NextSubTest();
+	BmString text = IndexMail( mailText, 64, 7, skeleton, elidedBodies);
+	CPPUNIT_ASSERT( text == mailText);
+	CPPUNIT_ASSERT( elidedBodies.size() == 1);
+	CPPUNIT_ASSERT( skeleton.FindFirst( "some text") != B_ERROR);
+	CPPUNIT_ASSERT( skeleton.FindFirst( "line 0 ") == B_ERROR);
+
+	NextSubTest();
+	const BmElidedBody& body = elidedBodies[0];
+	CPPUNIT_ASSERT( body.startInFile == mailText.FindFirst( "line 0 "));
+	CPPUNIT_ASSERT( body.startInText == skeleton.FindFirst( "\r\n--outer--"));
+	// the linebreak in front of the boundary doesn't belong to the body-part:
+	CPPUNIT_ASSERT( body.startInFile+body.lengthInFile
+							== mailText.FindFirst( "\r\n--outer--"));
+	CPPUNIT_ASSERT( body.length == body.lengthInFile);
+
+	NextSubTest();
+	elidedBodies.clear();
+	text = IndexMail( mailText, 1000000, 4096, skeleton, elidedBodies);
+	CPPUNIT_ASSERT( elidedBodies.empty());
+	CPPUNIT_ASSERT( skeleton == mailText);
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	a mail with LF-linebreaks is normalized while being indexed, the
+			body-parts of a nested multipart are found, too
+\*------------------------------------------------------------------------------*/
+void
+MailIndexTest::LinebreakTest(void)
+{
+	BmString mailText( "\
+From: sender@test.org\n\
+Subject: nested multiparts\n\
+Content-Type: multipart/mixed; boundary=\"outer\"\n\
+\n\
+--outer\n\
+Content-Type: multipart/alternative; boundary=\"inner\"\n\
+\n\
+--inner\n\
+Content-Type: text/plain\n\
+\n\
+");
+	for( int32 l=0; l<100; ++l)
+		mailText << "line " << l << " of the text\n";
+	mailText << "--inner--\n--outer\nContent-Type: image/png\n\n";
+	for( int32 l=0; l<100; ++l)
+		mailText << "line " << l << " of the image\n";
+	mailText << "--outer--\n";
+
+	BmString skeleton;
+	BmElidedBodyVect elidedBodies;
+	NextSubTest();
+	BmString text = IndexMail( mailText, 64, 3, skeleton, elidedBodies);
+	BmString normalizedText;
+	normalizedText.ConvertLinebreaksToCRLF( &mailText);
+	CPPUNIT_ASSERT( text == normalizedText);
+	CPPUNIT_ASSERT( elidedBodies.size() == 2);
+	CPPUNIT_ASSERT( skeleton.FindFirst( "\r\n--inner--\r\n") != B_ERROR);
+	CPPUNIT_ASSERT( skeleton.FindFirst( "line ") == B_ERROR);
+
+	NextSubTest();
+	// each LF has become a CRLF, which isn't the case within the file:
+	const BmElidedBody& body = elidedBodies[1];
+	CPPUNIT_ASSERT( body.startInFile == mailText.FindFirst( "line 0 of the image"));
+	CPPUNIT_ASSERT( body.length == body.lengthInFile+99);
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	a line that is longer than nMaxLineLength is passed on in pieces,
+			a boundary within it (even across two pieces) makes the index
+			ambiguous
+\*------------------------------------------------------------------------------*/
+void
+MailIndexTest::LongLineTest(void)
+{
+	BmString longLine;
+	longLine.SetTo( 'x', 20000);
+	BmString mailText = MultipartMail( 0, 0);
+	int32 pos = mailText.FindFirst( "--outer--");
+	BmString start( mailText.String(), pos);
+	BmString end( mailText.String()+pos);
+	start << "--outer\r\nContent-Type: application/octet-stream\r\n\r\n";
+
+	BmString skeleton;
+	BmElidedBodyVect elidedBodies;
+	bool isAmbiguous;
+	NextSubTest();
+	mailText = start;
+	mailText << longLine << "\r\n" << end;
+	BmString text = IndexMail( mailText, 64, 5, skeleton, elidedBodies,
+										&isAmbiguous);
+	CPPUNIT_ASSERT( text == mailText);
+	CPPUNIT_ASSERT( elidedBodies.size() == 1);
+	CPPUNIT_ASSERT( elidedBodies[0].length == longLine.Length());
+	CPPUNIT_ASSERT( !isAmbiguous);
+
+	NextSubTest();
+	longLine.Insert( "--outer", 10001);
+	mailText = start;
+	mailText << longLine << "\r\n" << end;
+	elidedBodies.clear();
+	text = IndexMail( mailText, 64, 5, skeleton, elidedBodies, &isAmbiguous);
+	CPPUNIT_ASSERT( text == mailText);
+	CPPUNIT_ASSERT( isAmbiguous);
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	a mail that is loaded lazily must look just like the same mail
+			when loaded completely
+\*------------------------------------------------------------------------------*/
+void
+MailIndexTest::LazyMailTest(void)
+{
+	BmString mailText = MultipartMail( 2, 1000);
+	BmRef<BmMail> eagerMail = new BmMail( mailText, "test");
+
+	NextSubTest();
+	BmRef<BmMail> lazyMail = LoadMail( nLazyMailPath, mailText);
+	CPPUNIT_ASSERT( lazyMail && lazyMail->InitCheck() == B_OK);
+	CPPUNIT_ASSERT( lazyMail->SkeletonText().Length() < 1024);
+	CPPUNIT_ASSERT( lazyMail->RawTextLength() == mailText.Length());
+	CPPUNIT_ASSERT( lazyMail->HeaderText() == eagerMail->HeaderText());
+
+	NextSubTest();
+	vector<BmString> lazyBodies = DecodedBodies( lazyMail.Get());
+	vector<BmString> eagerBodies = DecodedBodies( eagerMail.Get());
+	CPPUNIT_ASSERT( lazyBodies.size() == 3);
+	CPPUNIT_ASSERT( lazyBodies == eagerBodies);
+
+	NextSubTest();
+	CPPUNIT_ASSERT( lazyMail->RawText() == eagerMail->RawText());
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	a mail whose large body-part contains its boundary can't be trusted
+			to be parsed like its skeleton, so it is loaded completely
+\*------------------------------------------------------------------------------*/
+void
+MailIndexTest::BrokenMultipartTest(void)
+{
+	BmString mailText = MultipartMail( 2, 1000);
+	mailText.Insert( "this isn't a --outer boundary\r\n",
+						  mailText.FindFirst( "line 500 "));
+	BmRef<BmMail> eagerMail = new BmMail( mailText, "test");
+
+	NextSubTest();
+	BmRef<BmMail> lazyMail = LoadMail( nBrokenMailPath, mailText);
+	CPPUNIT_ASSERT( lazyMail && lazyMail->InitCheck() == B_OK);
+	CPPUNIT_ASSERT( lazyMail->SkeletonText() == mailText);
+	CPPUNIT_ASSERT( DecodedBodies( lazyMail.Get())
+							== DecodedBodies( eagerMail.Get()));
+}
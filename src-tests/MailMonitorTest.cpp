@@ -47,6 +47,8 @@ X-Empty: \r\n\
 blah (just to have a body)\
 ");
 
+static const int32 nStressMailCount = 10000;
+
 static BmRef<BmMailFolder> inFolder;
 static BmRef<BmMailRefList> inList;
 static BmRef<BmMailRefList> refList;
@@ -315,6 +317,18 @@ MailMonitorTest::suite() {
 	caller->addThread("t4", &MailMonitorTest::RefListStorageTest);
 	suite->addTest(caller);
 
+	// measures how many events the mail-monitor handles per second:
+	suite->addTest(new CppUnit::TestCaller<MailMonitorTest>(
+		"MailMonitorTest::EventThroughputTest", 
+		&MailMonitorTest::EventThroughputTest
+	));
+
+	// a mail created and moved away by the mail-mover within one batch:
+	suite->addTest(new CppUnit::TestCaller<MailMonitorTest>(
+		"MailMonitorTest::BatchedCreateAndMoveTest", 
+		&MailMonitorTest::BatchedCreateAndMoveTest
+	));
+
 	return suite;
 }
 
@@ -760,3 +774,183 @@ MailMonitorTest::RefListStorageTest(void)
 			CPPUNIT_ASSERT(refListSyncer->CheckStoredRefList());
 	}
 }
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	moves lots of mails into the in-folder (and removes them again) 
+			in one burst and measures how long it takes the mail-monitor to
+			catch up
+		-	mails that are created, moved and removed in one burst must not
+			leave any traces
+\*------------------------------------------------------------------------------*/
+void 
+MailMonitorTest::EventThroughputTest(void)
+{
+	const char* stressPath = "stress_mails";
+	system( "rm -rf stress_mails");
+	CPPUNIT_ASSERT( create_directory( stressPath, 0755) == B_OK);
+	BDirectory stressDir( stressPath);
+	BDirectory mailDir( &inFolder->NodeRef());
+	BmMail mail( mailText, "");
+	for( int32 i=0; i<nStressMailCount; ++i)
+		mail.StoreIntoFile( &stressDir, BmString("stress_") << i, 
+								  BM_MAIL_STATUS_READ, system_time());
+	SyncWithMailMonitor();
+	int32 initialCount = (int32)inList->size();
+
+	// burst of arrivals:
+	NextSubTest();
+	BEntry entry;
+	bigtime_t start = system_time();
+	for( int32 i=0; i<nStressMailCount; ++i) {
+		BmString name = BmString("stress_") << i;
+		CPPUNIT_ASSERT( stressDir.FindEntry( name.String(), &entry) == B_OK);
+		CPPUNIT_ASSERT( entry.MoveTo( &mailDir) == B_OK);
+	}
+	bigtime_t deadline = system_time() + 60*1000*1000;
+	while( (int32)inList->size() < initialCount+nStressMailCount
+	&& system_time() < deadline)
+		snooze( 1000);
+	bigtime_t duration = system_time()-start;
+	SyncWithMailMonitor();
+	CPPUNIT_ASSERT( (int32)inList->size() == initialCount+nStressMailCount);
+	printf( "<%ld arrivals in %Ld us: %.0f events/s>", nStressMailCount, 
+			  duration, 1000000.0*nStressMailCount/duration);
+	fflush(stdout);
+
+	// burst of removals:
+	NextSubTest();
+	start = system_time();
+	for( int32 i=0; i<nStressMailCount; ++i) {
+		BmString name = BmString("stress_") << i;
+		CPPUNIT_ASSERT( mailDir.FindEntry( name.String(), &entry) == B_OK);
+		CPPUNIT_ASSERT( entry.Remove() == B_OK);
+	}
+	deadline = system_time() + 60*1000*1000;
+	while( (int32)inList->size() > initialCount && system_time() < deadline)
+		snooze( 1000);
+	duration = system_time()-start;
+	SyncWithMailMonitor();
+	CPPUNIT_ASSERT( (int32)inList->size() == initialCount);
+	printf( "<%ld removals in %Ld us: %.0f events/s>", nStressMailCount, 
+			  duration, 1000000.0*nStressMailCount/duration);
+	fflush(stdout);
+
+	// create+move+remove chains, which should cancel each other out:
+	NextSubTest();
+	BNode node;
+	node.SetTo( "mail/folder1");
+	node_ref nref;
+	node.GetNodeRef( &nref);
+	BmRef<BmMailFolder> folder1 = 
+		dynamic_cast< BmMailFolder*>( 
+			TheMailFolderList->FindItemByKey( BM_REFKEY(nref)).Get()
+		);
+	CPPUNIT_ASSERT( folder1 != NULL);
+	BmRef<BmMailRefList> folder1List( folder1->MailRefList());
+	CPPUNIT_ASSERT( folder1List != NULL);
+	folder1List->NeedControllersToContinue( false);
+	folder1List->StartJobInThisThread();
+	int32 folder1Count = (int32)folder1List->size();
+	BDirectory folder1Dir( &folder1->NodeRef());
+	for( int32 i=0; i<nStressMailCount/10; ++i) {
+		BmString name = BmString("chain_") << i;
+		mail.StoreIntoFile( &mailDir, name, BM_MAIL_STATUS_READ, system_time());
+		CPPUNIT_ASSERT( mailDir.FindEntry( name.String(), &entry) == B_OK);
+		CPPUNIT_ASSERT( entry.MoveTo( &folder1Dir) == B_OK);
+		CPPUNIT_ASSERT( entry.Remove() == B_OK);
+	}
+	snooze( 500*1000);
+	SyncWithMailMonitor();
+	CPPUNIT_ASSERT( (int32)inList->size() == initialCount);
+	CPPUNIT_ASSERT( (int32)folder1List->size() == folder1Count);
+
+	system( "rm -rf stress_mails");
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	creates a mail and moves it into another folder (announcing the
+			move the way the mail-mover does) while the mail-monitor is busy,
+			such that both events end up in the same batch
+		-	the pending addition of the mail to its original folder must be 
+			dropped together with the move-event
+\*------------------------------------------------------------------------------*/
+void 
+MailMonitorTest::BatchedCreateAndMoveTest(void)
+{
+	const int32 burstCount = nStressMailCount/10;
+	const char* stressPath = "stress_mails";
+	system( "rm -rf stress_mails");
+	CPPUNIT_ASSERT( create_directory( stressPath, 0755) == B_OK);
+	BDirectory stressDir( stressPath);
+	BDirectory mailDir( &inFolder->NodeRef());
+	BmMail mail( mailText, "");
+	for( int32 i=0; i<burstCount; ++i)
+		mail.StoreIntoFile( &stressDir, BmString("stress_") << i, 
+								  BM_MAIL_STATUS_READ, system_time());
+	BNode node;
+	node_ref nref;
+	node.SetTo( "mail/folder1");
+	node.GetNodeRef( &nref);
+	BmRef<BmMailFolder> folder1 = 
+		dynamic_cast< BmMailFolder*>( 
+			TheMailFolderList->FindItemByKey( BM_REFKEY(nref)).Get()
+		);
+	CPPUNIT_ASSERT( folder1 != NULL);
+	BmRef<BmMailRefList> folder1List( folder1->MailRefList());
+	CPPUNIT_ASSERT( folder1List != NULL);
+	folder1List->NeedControllersToContinue( false);
+	folder1List->StartJobInThisThread();
+	BDirectory folder1Dir( &folder1->NodeRef());
+	SyncWithMailMonitor();
+	int32 initialCount = (int32)inList->size();
+	int32 folder1Count = (int32)folder1List->size();
+
+	NextSubTest();
+	// keep the mail-monitor busy with a burst of arrivals...
+	BEntry entry;
+	for( int32 i=0; i<burstCount; ++i) {
+		BmString name = BmString("stress_") << i;
+		CPPUNIT_ASSERT( stressDir.FindEntry( name.String(), &entry) == B_OK);
+		CPPUNIT_ASSERT( entry.MoveTo( &mailDir) == B_OK);
+	}
+	// ...create a new mail behind it...
+	mail.StoreIntoFile( &mailDir, "batched_mail", BM_MAIL_STATUS_READ, 
+							  system_time());
+	CPPUNIT_ASSERT( mailDir.FindEntry( "batched_mail", &entry) == B_OK);
+	CPPUNIT_ASSERT( entry.GetNodeRef( &nref) == B_OK);
+	// ...and move it away just like the mail-mover would do:
+	BmExpectedMoveMap expectedMoves;
+	expectedMoves[BM_REFKEY( nref)] = 2;
+	TheMailMonitor->ExpectMoves( expectedMoves);
+	CPPUNIT_ASSERT( entry.MoveTo( &folder1Dir) == B_OK);
+	BmMailRefSpecVect specs( 1);
+	CPPUNIT_ASSERT( entry.GetRef( &specs[0].eref) == B_OK);
+	CPPUNIT_ASSERT( entry.GetStat( &specs[0].st) == B_OK);
+	vector<node_ref> nrefs( 1, nref);
+	inFolder->RemoveMailRefs( nrefs);
+	folder1->AddMailRefs( specs);
+	snooze( 500*1000);
+	SyncWithMailMonitor();
+	CPPUNIT_ASSERT( inList->FindItemByKey( BM_REFKEY(nref)) == NULL);
+	CPPUNIT_ASSERT( folder1List->FindItemByKey( BM_REFKEY(nref)) != NULL);
+	CPPUNIT_ASSERT( (int32)inList->size() == initialCount+burstCount);
+	CPPUNIT_ASSERT( (int32)folder1List->size() == folder1Count+1);
+
+	// clean up:
+	NextSubTest();
+	for( int32 i=0; i<burstCount; ++i) {
+		BmString name = BmString("stress_") << i;
+		CPPUNIT_ASSERT( mailDir.FindEntry( name.String(), &entry) == B_OK);
+		CPPUNIT_ASSERT( entry.Remove() == B_OK);
+	}
+	CPPUNIT_ASSERT( folder1Dir.FindEntry( "batched_mail", &entry) == B_OK);
+	CPPUNIT_ASSERT( entry.Remove() == B_OK);
+	snooze( 500*1000);
+	SyncWithMailMonitor();
+	CPPUNIT_ASSERT( (int32)inList->size() == initialCount);
+	CPPUNIT_ASSERT( (int32)folder1List->size() == folder1Count);
+
+	system( "rm -rf stress_mails");
+}
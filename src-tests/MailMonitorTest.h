@@ -50,6 +50,8 @@ public:
 	void RefListAdder();
 	void RefListRemover();
 	void RefListStorageTest();
+	void EventThroughputTest();
+	void BatchedCreateAndMoveTest();
 private:
 	void SyncWithMailMonitor();
 };
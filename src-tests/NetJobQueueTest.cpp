@@ -0,0 +1,147 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+/*
+ * Beam's test-application is based on the OpenBeOS testing framework
+ * (which in turn is based on cppunit). Big thanks to everyone involved!
+ *
+ */
+
+#include <Message.h>
+
+#include "BmJobModel.h"
+#include "BmJobStatusWin.h"
+#include "BmRecvAccount.h"
+#include "BmUtil.h"
+
+#include "NetJobQueueTest.h"
+#include "TestBeam.h"
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	creates a job-message for the account with the given name
+\*------------------------------------------------------------------------------*/
+static BMessage* JobMsg( const char* name, bool isAutoCheck = false)
+{
+	BMessage* msg = new BMessage( 'test');
+	msg->AddString( BmJobModel::MSG_JOB_NAME, name);
+	if (isAutoCheck)
+		msg->AddBool( BmRecvAccountList::MSG_AUTOCHECK, true);
+	return msg;
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	takes the next startable job from the queue and returns its name
+			(or an empty string if no job may be started)
+\*------------------------------------------------------------------------------*/
+static BmString TakeNext( BmNetJobQueue& queue)
+{
+	BMessage* msg = queue.TakeNextStartable();
+	if (!msg)
+		return "";
+	BmString name = FindMsgString( msg, BmJobModel::MSG_JOB_NAME);
+	delete msg;
+	return name;
+}
+
+// setUp
+void
+NetJobQueueTest::setUp()
+{
+	inherited::setUp();
+}
+
+// tearDown
+void
+NetJobQueueTest::tearDown()
+{
+	inherited::tearDown();
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	checks that the limits for all jobs and for jobs per server are
+			obeyed and that ended jobs free their slot
+\*------------------------------------------------------------------------------*/
+void
+NetJobQueueTest::LimitsTest(void)
+{
+	BmNetJobQueue queue;
+	queue.SetLimits( 3, 2);
+	CPPUNIT_ASSERT( queue.Add( JobMsg( "a1"), "server-a"));
+	CPPUNIT_ASSERT( queue.Add( JobMsg( "a2"), "server-a"));
+	CPPUNIT_ASSERT( queue.Add( JobMsg( "a3"), "server-a"));
+	CPPUNIT_ASSERT( queue.Add( JobMsg( "b1"), "server-b"));
+	CPPUNIT_ASSERT( queue.Add( JobMsg( "c1"), "server-c"));
+
+	NextSubTest();
+	CPPUNIT_ASSERT( TakeNext( queue) == "a1");
+	CPPUNIT_ASSERT( TakeNext( queue) == "a2");
+	CPPUNIT_ASSERT( TakeNext( queue) == "b1");
+	CPPUNIT_ASSERT( TakeNext( queue) == "");
+	CPPUNIT_ASSERT( queue.RunningCount() == 3);
+
+	NextSubTest();
+	queue.JobHasEnded( "b1");
+	CPPUNIT_ASSERT( TakeNext( queue) == "c1");
+	CPPUNIT_ASSERT( TakeNext( queue) == "");
+	queue.JobHasEnded( "c1");
+	CPPUNIT_ASSERT( TakeNext( queue) == "");
+	queue.JobHasEnded( "a1");
+	CPPUNIT_ASSERT( TakeNext( queue) == "a3");
+	CPPUNIT_ASSERT( queue.IsEmpty());
+
+	NextSubTest();
+	queue.SetLimits( 0, 0);
+	CPPUNIT_ASSERT( queue.Add( JobMsg( "a4"), "server-a"));
+	CPPUNIT_ASSERT( queue.Add( JobMsg( "a5"), "server-a"));
+	CPPUNIT_ASSERT( TakeNext( queue) == "a4");
+	CPPUNIT_ASSERT( TakeNext( queue) == "a5");
+	CPPUNIT_ASSERT( queue.RunningCount() == 4);
+
+	NextSubTest();
+	// a job that is running must not be started a second time:
+	CPPUNIT_ASSERT( queue.Add( JobMsg( "a4"), "server-a"));
+	CPPUNIT_ASSERT( TakeNext( queue) == "");
+	queue.JobHasEnded( "a4");
+	CPPUNIT_ASSERT( TakeNext( queue) == "a4");
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	checks that user-requested jobs overtake automatic checks and that
+			waiting jobs are not queued twice
+\*------------------------------------------------------------------------------*/
+void
+NetJobQueueTest::PriorityTest(void)
+{
+	BmNetJobQueue queue;
+	queue.SetLimits( 1, 1);
+	CPPUNIT_ASSERT( queue.Add( JobMsg( "auto1", true), "server-a"));
+	CPPUNIT_ASSERT( queue.Add( JobMsg( "auto2", true), "server-b"));
+	CPPUNIT_ASSERT( queue.Add( JobMsg( "user1"), "server-c"));
+
+	NextSubTest();
+	BMessage* dupMsg = JobMsg( "auto2", true);
+	CPPUNIT_ASSERT( !queue.Add( dupMsg, "server-b"));
+	delete dupMsg;
+	dupMsg = JobMsg( "user1");
+	CPPUNIT_ASSERT( !queue.Add( dupMsg, "server-c"));
+	delete dupMsg;
+	// a user-request replaces the waiting automatic check:
+	CPPUNIT_ASSERT( queue.Add( JobMsg( "auto2"), "server-b"));
+
+	NextSubTest();
+	CPPUNIT_ASSERT( TakeNext( queue) == "user1");
+	queue.JobHasEnded( "user1");
+	CPPUNIT_ASSERT( TakeNext( queue) == "auto2");
+	queue.JobHasEnded( "auto2");
+	CPPUNIT_ASSERT( TakeNext( queue) == "auto1");
+	queue.JobHasEnded( "auto1");
+	CPPUNIT_ASSERT( queue.IsEmpty());
+}
@@ -0,0 +1,159 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+/*
+ * Beam's test-application is based on the OpenBeOS testing framework
+ * (which in turn is based on cppunit). Big thanks to everyone involved!
+ *
+ */
+
+#include <OS.h>
+
+#include "BmLogHandler.h"
+#include "BmMemIO.h"
+#include "BmNetJobModel.h"
+#include "BmPopper.h"
+
+#include "PopPipelineTest.h"
+#include "TestBeam.h"
+
+/*------------------------------------------------------------------------------*\
+	PopStandIn
+		-	a network-job that receives its answers from the given buffer
+			instead of a POP3-server
+\*------------------------------------------------------------------------------*/
+class PopStandIn : public NetJobStandIn {
+	typedef NetJobStandIn inherited;
+public:
+	PopStandIn( BmMemIBuf* server, bool pipelining)
+		:	inherited( "PopStandIn", BM_LogRecv,
+						  new BmPopStatusFilter( NULL, this), server, pipelining)
+													{ }
+	void Receive( bool multiLine)			{ GetAnswer( 4096, multiLine); }
+	bool IsPositive() 						{ return StatusText().ByteAt(0) == '+'; }
+};
+
+/*------------------------------------------------------------------------------*\
+	the answers of a POP3-server to the pipelined commands
+	"STAT UIDL LIST", "RETR 1 RETR 2 RETR 3" and "DELE 1 DELE 3"
+\*------------------------------------------------------------------------------*/
+struct ScriptedAnswer {
+	bool multiLine;
+	const char* wire;
+	const char* status;
+	const char* data;
+};
+
+static ScriptedAnswer nAnswers[] = {
+	{ false, "+OK 3 95\r\n", "+OK 3 95", "" },
+	{ true,	"+OK\r\n1 uid-a\r\n2 uid-b\r\n3 uid-c\r\n.\r\n",
+				"+OK", "1 uid-a\r\n2 uid-b\r\n3 uid-c\r\n" },
+	{ true,	"+OK\r\n1 40\r\n2 30\r\n3 25\r\n.\r\n",
+				"+OK", "1 40\r\n2 30\r\n3 25\r\n" },
+	{ true,	"+OK 40 octets\r\nSubject: one\r\n\r\n..dotted\r\n.\r\n",
+				"+OK 40 octets", "Subject: one\r\n\r\n.dotted\r\n" },
+	{ true,	"-ERR message 2 is locked\r\n",
+				"-ERR message 2 is locked", "" },
+	{ true,	"+OK 25 octets\r\nSubject: three\r\n\r\nbody\r\n.\r\n",
+				"+OK 25 octets", "Subject: three\r\n\r\nbody\r\n" },
+	{ false, "+OK message 1 deleted\r\n", "+OK message 1 deleted", "" },
+	{ false, "-ERR message 3 already deleted\r\n",
+				"-ERR message 3 already deleted", "" },
+};
+static const uint32 nAnswerCount = sizeof(nAnswers)/sizeof(ScriptedAnswer);
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	reads all scripted answers through the given stand-in and checks
+			that none of them gets lost or mixed up with its neighbours
+\*------------------------------------------------------------------------------*/
+static void CheckAnswers( PopStandIn& popper)
+{
+	for( uint32 i=0; i<nAnswerCount; ++i) {
+		popper.Receive( nAnswers[i].multiLine);
+		CPPUNIT_ASSERT( popper.StatusText() == nAnswers[i].status);
+		CPPUNIT_ASSERT( popper.AnswerText() == nAnswers[i].data);
+		CPPUNIT_ASSERT( popper.IsPositive() == (nAnswers[i].status[0] == '+'));
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	checks the answers sent by the given server (with pipelining)
+\*------------------------------------------------------------------------------*/
+static void CheckPipelinedAnswers( ScriptedServerBuf& server)
+{
+	PopStandIn popper( &server, true);
+	CheckAnswers( popper);
+}
+
+// setUp
+void
+PopPipelineTest::setUp()
+{
+	inherited::setUp();
+}
+
+// tearDown
+void
+PopPipelineTest::tearDown()
+{
+	inherited::tearDown();
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	the server sends all answers in one go
+\*------------------------------------------------------------------------------*/
+void
+PopPipelineTest::PipelinedAnswersTest(void)
+{
+	NextSubTest();
+	BmString script;
+	for( uint32 i=0; i<nAnswerCount; ++i)
+		script << nAnswers[i].wire;
+	BmStringIBuf server( script);
+	PopStandIn popper( &server, true);
+	CheckAnswers( popper);
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	the server delivers the answers in chunks with some latency, such
+			that answers (and their terminating dots) are split across reads
+\*------------------------------------------------------------------------------*/
+void
+PopPipelineTest::SlowServerTest(void)
+{
+	BmString script;
+	for( uint32 i=0; i<nAnswerCount; ++i)
+		script << nAnswers[i].wire;
+	uint32 chunkSizes[] = { 1, 3, 7, 64 };
+	RunScriptedServer( *this, script, chunkSizes, 
+							 sizeof(chunkSizes)/sizeof(uint32), 100, 
+							 CheckPipelinedAnswers);
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	without pipelining, every answer arrives on its own and whatever
+			trails an answer is dropped (as has always been the case)
+\*------------------------------------------------------------------------------*/
+void
+PopPipelineTest::SequentialFallbackTest(void)
+{
+	NextSubTest();
+	PopStandIn popper( NULL, false);
+	for( uint32 i=0; i<nAnswerCount; ++i) {
+		BmString wire = BmString( nAnswers[i].wire) << "\r\n-ERR junk\r\n";
+		BmStringIBuf server( wire);
+		popper.SetServer( &server);
+		popper.Receive( nAnswers[i].multiLine);
+		CPPUNIT_ASSERT( popper.StatusText() == nAnswers[i].status);
+		CPPUNIT_ASSERT( popper.AnswerText() == nAnswers[i].data);
+	}
+}
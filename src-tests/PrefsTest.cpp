@@ -0,0 +1,170 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+/*
+ * Beam's test-application is based on the OpenBeOS testing framework
+ * (which in turn is based on cppunit). Big thanks to everyone involved!
+ *
+ */
+
+#include <stdio.h>
+
+#include <OS.h>
+
+#include "BmPrefs.h"
+
+#include "PrefsTest.h"
+#include "TestBeam.h"
+
+static const char* const nIntName = "PrefsTest_Int";
+static const char* const nStringName = "PrefsTest_String";
+static const int32 nWriteCount = 200;
+static const int32 nReaderCount = 4;
+
+static volatile int32 nStopReaders;
+static int32 nBadReads;
+static int32 nReads;
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	keeps reading the test-values (via a cached handle and directly)
+			until told to stop, counting all values that were never written
+\*------------------------------------------------------------------------------*/
+static int32 ReaderThread( void*)
+{
+	BmCachedIntPref intPref( nIntName, 0);
+	BmCachedStringPref stringPref( nStringName, "");
+	int32 reads = 0;
+	while( !nStopReaders) {
+		int32 val = intPref.Value();
+		if (val < 0 || val > nWriteCount)
+			atomic_add( &nBadReads, 1);
+		val = ThePrefs->GetInt( nIntName, 0);
+		if (val < 0 || val > nWriteCount)
+			atomic_add( &nBadReads, 1);
+		const BmString& str = stringPref.Value();
+		if (str.Length() && str.ByteAt(0) != 'v')
+			atomic_add( &nBadReads, 1);
+		reads += 3;
+	}
+	atomic_add( &nReads, reads);
+	return 0;
+}
+
+// setUp
+void
+PrefsTest::setUp()
+{
+	inherited::setUp();
+}
+
+// tearDown
+void
+PrefsTest::tearDown()
+{
+	inherited::tearDown();
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	cached handles pick up every change of their value
+\*------------------------------------------------------------------------------*/
+void
+PrefsTest::CachedValueTest(void)
+{
+	NextSubTest();
+	BmCachedIntPref intPref( nIntName, 42);
+	BmCachedStringPref stringPref( nStringName, "default");
+	CPPUNIT_ASSERT( intPref.Value() == ThePrefs->GetInt( nIntName, 42));
+	CPPUNIT_ASSERT( stringPref.Value() 
+							== ThePrefs->GetString( nStringName, "default"));
+
+	NextSubTest();
+	int32 generation = ThePrefs->Generation();
+	ThePrefs->SetInt( nIntName, 1);
+	CPPUNIT_ASSERT( ThePrefs->Generation() != generation);
+	CPPUNIT_ASSERT( intPref.Value() == 1);
+	CPPUNIT_ASSERT( intPref.Value() == 1);
+	ThePrefs->SetInt( nIntName, 2);
+	CPPUNIT_ASSERT( intPref.Value() == 2);
+	CPPUNIT_ASSERT( ThePrefs->GetInt( nIntName) == 2);
+
+	NextSubTest();
+	ThePrefs->SetString( nStringName, "value");
+	CPPUNIT_ASSERT( stringPref.Value() == "value");
+	CPPUNIT_ASSERT( ThePrefs->GetString( nStringName) == "value");
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	several threads read the prefs while they are being changed, none
+			of them may ever see a value that hasn't been written
+\*------------------------------------------------------------------------------*/
+void
+PrefsTest::ConcurrentReadTest(void)
+{
+	NextSubTest();
+	ThePrefs->SetInt( nIntName, 0);
+	ThePrefs->SetString( nStringName, "v0");
+	nStopReaders = 0;
+	nBadReads = 0;
+	nReads = 0;
+	thread_id readers[nReaderCount];
+	for( int32 i=0; i<nReaderCount; ++i) {
+		readers[i] = spawn_thread( ReaderThread, "prefs-reader", 
+											B_NORMAL_PRIORITY, NULL);
+		CPPUNIT_ASSERT( readers[i] >= 0);
+		resume_thread( readers[i]);
+	}
+	bigtime_t start = system_time();
+	for( int32 i=1; i<=nWriteCount; ++i) {
+		ThePrefs->SetInt( nIntName, i);
+		ThePrefs->SetString( nStringName, BmString("v") << i);
+		snooze( 500);
+	}
+	nStopReaders = 1;
+	for( int32 i=0; i<nReaderCount; ++i) {
+		status_t exitVal;
+		wait_for_thread( readers[i], &exitVal);
+	}
+	bigtime_t duration = system_time()-start;
+	printf( "<%ld reads in %Ld us>", nReads, duration);
+	fflush(stdout);
+	CPPUNIT_ASSERT( nBadReads == 0);
+	CPPUNIT_ASSERT( ThePrefs->GetInt( nIntName) == nWriteCount);
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	replaced snapshots are kept for as long as a reader may use them 
+			and are deleted as soon as no reader is active
+\*------------------------------------------------------------------------------*/
+void
+PrefsTest::SnapshotReclaimTest(void)
+{
+	NextSubTest();
+	ThePrefs->SetInt( nIntName, 1);
+	CPPUNIT_ASSERT( ThePrefs->RetiredSnapshotCount() == 0);
+
+	NextSubTest();
+	{
+		BmPrefsReader reader( ThePrefs);
+		ThePrefs->SetInt( nIntName, 2);
+		ThePrefs->SetInt( nIntName, 3);
+		CPPUNIT_ASSERT( ThePrefs->RetiredSnapshotCount() == 2);
+		// the pinned snapshot is still intact:
+		int32 val;
+		CPPUNIT_ASSERT( reader->FindInt( nIntName, val) && val == 1);
+		CPPUNIT_ASSERT( ThePrefs->GetInt( nIntName) == 3);
+	}
+
+	NextSubTest();
+	// once the reader is gone, the next change cleans up:
+	ThePrefs->SetInt( nIntName, 4);
+	CPPUNIT_ASSERT( ThePrefs->RetiredSnapshotCount() == 0);
+	CPPUNIT_ASSERT( ThePrefs->GetInt( nIntName) == 4);
+}
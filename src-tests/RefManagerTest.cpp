@@ -0,0 +1,128 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+/*
+ * Beam's test-application is based on the OpenBeOS testing framework
+ * (which in turn is based on cppunit). Big thanks to everyone involved!
+ *
+ */
+
+#include <stdio.h>
+
+#include <Entry.h>
+#include <File.h>
+
+#include "RefManagerTest.h"
+#include <ThreadedTestCaller.h>
+#include <cppunit/Test.h>
+#include <cppunit/TestCaller.h>
+#include <cppunit/TestSuite.h>
+
+static const char* const testMailPath = "/tmp/beam_refmanager_testmail";
+
+static const int32 nCopiesPerThread = 1000000;
+
+static BmString mailText("\
+From: them\r\n\
+To: you@test.org\r\n\
+Subject: A simple testmail for ref-counting\r\n\
+\r\n\
+blah (just to have a body)\
+");
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	
+\*------------------------------------------------------------------------------*/
+static BmRef<BmMailRef> CreateTestMailRef()
+{
+	BFile file( testMailPath, B_READ_WRITE | B_CREATE_FILE | B_ERASE_FILE);
+	file.Write( mailText.String(), mailText.Length());
+	entry_ref eref;
+	if (get_ref_for_path( testMailPath, &eref) != B_OK)
+		return NULL;
+	return BmMailRef::CreateInstance( eref);
+}
+
+RefManagerTest::RefManagerTest(string name)
+	: BThreadedTestCase(name)
+	, mMailRef( CreateTestMailRef())
+{
+}
+
+CppUnit::Test*
+RefManagerTest::suite() {
+	CppUnit::TestSuite *suite = new CppUnit::TestSuite("RefManagerSuite");
+	BThreadedTestCaller<RefManagerTest> *caller;
+	RefManagerTest *test;
+	
+	// simple test for ref-counting:
+	suite->addTest(new CppUnit::TestCaller<RefManagerTest>(
+		"RefManagerTest::BasicRefCountTest", 
+		&RefManagerTest::BasicRefCountTest
+	));
+
+	// massively parallel copying of refs (doubles as a benchmark):
+	test = new RefManagerTest;
+	caller = new BThreadedTestCaller<RefManagerTest>(
+		"RefManagerTest::MassiveRefCopyTest", test
+	);
+	caller->addThread("t1", &RefManagerTest::MassiveRefCopyTest);
+	caller->addThread("t2", &RefManagerTest::MassiveRefCopyTest);
+	caller->addThread("t3", &RefManagerTest::MassiveRefCopyTest);
+	caller->addThread("t4", &RefManagerTest::MassiveRefCopyTest);
+	caller->addThread("t5", &RefManagerTest::MassiveRefCopyTest);
+	caller->addThread("t6", &RefManagerTest::MassiveRefCopyTest);
+	caller->addThread("t7", &RefManagerTest::MassiveRefCopyTest);
+	caller->addThread("t8", &RefManagerTest::MassiveRefCopyTest);
+	suite->addTest(caller);
+	
+	return suite;
+}
+
+void
+RefManagerTest::BasicRefCountTest() {
+	NextSubTest();
+	CPPUNIT_ASSERT( mMailRef);
+	BmString key = mMailRef->Key();
+	{
+		BmRef<BmMailRef> copy( mMailRef);
+		NextSubTest();
+		CPPUNIT_ASSERT( copy == mMailRef);
+		BmRef<BmMailRef> copy2;
+		copy2 = copy;
+		NextSubTest();
+		CPPUNIT_ASSERT( copy2 == mMailRef);
+	}
+	// the object must still be found via the object-list:
+	NextSubTest();
+	BAutolock lock( BmRefObj::GlobalLocker());
+	CPPUNIT_ASSERT( 
+		BmRefObj::FetchObject( typeid(BmMailRef).name(), key) 
+			== mMailRef.Get()
+	);
+}	
+
+void
+RefManagerTest::MassiveRefCopyTest() {
+	NextSubTest();
+	CPPUNIT_ASSERT( mMailRef);
+	bigtime_t start = system_time();
+	for( int32 i=0; i<nCopiesPerThread; ++i) {
+		BmRef<BmMailRef> copy( mMailRef);
+		BmRef<BmMailRef> copy2;
+		copy2 = copy;
+	}
+	bigtime_t duration = system_time() - start;
+	printf( "<%ld ref-copies in %Ld us (%.0f copies/s)>", 
+			  2*nCopiesPerThread, duration, 
+			  duration ? 2.0*nCopiesPerThread*1000000/duration : 0.0);
+	fflush(stdout);
+	// the object must have survived all this:
+	NextSubTest();
+	CPPUNIT_ASSERT( mMailRef->InitCheck() == B_OK);
+}	
@@ -0,0 +1,37 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+/*
+ * Beam's test-application is based on the OpenBeOS testing framework
+ * (which in turn is based on cppunit). Big thanks to everyone involved!
+ *
+ */
+
+
+#ifndef _RefManagerTest_h
+#define _RefManagerTest_h
+
+
+#include <ThreadedTestCase.h>
+
+#include "BmMailRef.h"
+
+class RefManagerTest : public BThreadedTestCase {
+public:
+	RefManagerTest(string name = "");
+
+	static CppUnit::Test* suite();
+	
+	void BasicRefCountTest();
+
+	void MassiveRefCopyTest();
+
+protected:
+	BmRef<BmMailRef> mMailRef;
+};
+
+#endif
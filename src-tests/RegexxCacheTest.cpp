@@ -0,0 +1,173 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+/*
+ * Beam's test-application is based on the OpenBeOS testing framework
+ * (which in turn is based on cppunit). Big thanks to everyone involved!
+ *
+ */
+
+#include <stdio.h>
+
+#include <OS.h>
+
+#include "regexx.hh"
+using namespace regexx;
+
+#include "BmMailHeader.h"
+
+#include "RegexxCacheTest.h"
+#include "TestBeam.h"
+
+static const int32 nHeaderCount = 200;
+static const int32 nRounds = 10;
+
+// setUp
+void
+RegexxCacheTest::setUp()
+{
+	inherited::setUp();
+	mOldCapacity = RegexxCache::Capacity();
+}
+	
+// tearDown
+void
+RegexxCacheTest::tearDown()
+{
+	RegexxCache::SetCapacity( mOldCapacity);
+	inherited::tearDown();
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	generates a corpus of somewhat realistic (and folded) mail-headers
+\*------------------------------------------------------------------------------*/
+static void BuildHeaderCorpus( vector<BmString>& corpus)
+{
+	for( int32 i=0; i<nHeaderCount; ++i) {
+		BmString header;
+		header << "Return-Path: <sender" << i << "@example.org>\r\n"
+				 << "Received: from mail" << i%7 << ".example.org "
+				 << "(mail" << i%7 << ".example.org [10.0.0." << i%250 << "])\r\n"
+				 << "\tby mx.test.org with ESMTP id " << 4711+i << "\r\n"
+				 << "\tfor <you@test.org>; Mon, 3 Apr 2006 12:00:00 +0200\r\n"
+				 << "Message-ID: <" << 100000+i << ".sender@example.org>\r\n"
+				 << "From: Sender " << i << " <sender" << i << "@example.org>\r\n"
+				 << "To: you@test.org,\r\n"
+				 << "  them@test.org\r\n"
+				 << "Subject: =?iso-8859-1?q?Test_mail_number_" << i 
+				 << "_with_=E4_umlaut?=\r\n"
+				 << "Date: Mon, 3 Apr 2006 12:00:" << i%60 << " +0200\r\n"
+				 << "MIME-Version: 1.0\r\n"
+				 << "Content-Type: text/plain;\r\n"
+				 << "\tcharset=\"iso-8859-1\"\r\n"
+				 << "Content-Transfer-Encoding: 8bit\r\n"
+				 << "\r\n";
+		corpus.push_back( header);
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	
+\*------------------------------------------------------------------------------*/
+static bigtime_t ParseHeaderCorpus( const vector<BmString>& corpus)
+{
+	bigtime_t start = system_time();
+	for( int32 r=0; r<nRounds; ++r) {
+		for( uint32 i=0; i<corpus.size(); ++i) {
+			BmRef<BmMailHeader> header( new BmMailHeader( corpus[i], NULL));
+		}
+	}
+	return system_time() - start;
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	
+\*------------------------------------------------------------------------------*/
+void 
+RegexxCacheTest::BasicCacheTest(void)
+{
+	RegexxCache::SetCapacity( 16);
+	RegexxCache::ResetCounters();
+
+	NextSubTest();
+	Regexx rx;
+	CPPUNIT_ASSERT( rx.exec( "some text", "t(e)xt") == 1);
+	CPPUNIT_ASSERT( RegexxCache::Misses() == 1);
+	CPPUNIT_ASSERT( RegexxCache::Hits() == 0);
+
+	// the same expression with the same flags must come from the cache:
+	NextSubTest();
+	Regexx rx2;
+	CPPUNIT_ASSERT( rx2.exec( "other text", "t(e)xt") == 1);
+	CPPUNIT_ASSERT( rx2.match[0].atom[0] == "e");
+	CPPUNIT_ASSERT( RegexxCache::Misses() == 1);
+	CPPUNIT_ASSERT( RegexxCache::Hits() == 1);
+
+	// different flags mean a different compiled expression:
+	NextSubTest();
+	CPPUNIT_ASSERT( Regexx( "SOME TEXT", "t(e)xt", Regexx::nocase) == 1);
+	CPPUNIT_ASSERT( Regexx( "SOME TEXT", "t(e)xt", Regexx::study) == 0);
+	CPPUNIT_ASSERT( RegexxCache::Misses() == 3);
+
+	// evicted expressions must stay usable by those still holding them:
+	NextSubTest();
+	RegexxCache::SetCapacity( 0);
+	CPPUNIT_ASSERT( rx.exec() == 1);
+	CPPUNIT_ASSERT( rx2.exec() == 1);
+
+	// without a cache, every expression is compiled:
+	NextSubTest();
+	RegexxCache::ResetCounters();
+	CPPUNIT_ASSERT( Regexx( "some text", "t(e)xt") == 1);
+	CPPUNIT_ASSERT( Regexx( "some text", "t(e)xt") == 1);
+	CPPUNIT_ASSERT( RegexxCache::Misses() == 2);
+	CPPUNIT_ASSERT( RegexxCache::Hits() == 0);
+
+	// compile errors must be reported as before:
+	NextSubTest();
+	RegexxCache::SetCapacity( 16);
+	bool gotException = false;
+	try {
+		Regexx( "some text", "t(e");
+	} catch( Regexx::CompileException&) {
+		gotException = true;
+	}
+	CPPUNIT_ASSERT( gotException);
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	
+\*------------------------------------------------------------------------------*/
+void 
+RegexxCacheTest::HeaderParsingBenchmark(void)
+{
+	vector<BmString> corpus;
+	BuildHeaderCorpus( corpus);
+
+	NextSubTest();
+	RegexxCache::SetCapacity( 0);
+	RegexxCache::ResetCounters();
+	bigtime_t uncached = ParseHeaderCorpus( corpus);
+	uint32 uncachedMisses = RegexxCache::Misses();
+	CPPUNIT_ASSERT( RegexxCache::Hits() == 0);
+
+	NextSubTest();
+	RegexxCache::SetCapacity( mOldCapacity ? mOldCapacity : 128);
+	RegexxCache::ResetCounters();
+	bigtime_t cached = ParseHeaderCorpus( corpus);
+	CPPUNIT_ASSERT( RegexxCache::Hits() > RegexxCache::Misses());
+
+	printf( "<%ld headers: %Ld us without cache (%lu compiles), "
+			  "%Ld us with cache (%lu hits, %lu misses)>", 
+			  nHeaderCount*nRounds, uncached, uncachedMisses,
+			  cached, RegexxCache::Hits(), RegexxCache::Misses());
+	fflush(stdout);
+}
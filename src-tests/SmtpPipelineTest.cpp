@@ -0,0 +1,134 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+/*
+ * Beam's test-application is based on the OpenBeOS testing framework
+ * (which in turn is based on cppunit). Big thanks to everyone involved!
+ *
+ */
+
+#include <OS.h>
+
+#include "BmLogHandler.h"
+#include "BmMemIO.h"
+#include "BmNetJobModel.h"
+#include "BmSmtp.h"
+
+#include "SmtpPipelineTest.h"
+#include "TestBeam.h"
+
+/*------------------------------------------------------------------------------*\
+	SmtpSink
+		-	a network-job that receives its replies from the given buffer
+			instead of an SMTP-server
+\*------------------------------------------------------------------------------*/
+class SmtpSink : public NetJobStandIn {
+	typedef NetJobStandIn inherited;
+public:
+	SmtpSink( BmMemIBuf* server)
+		:	inherited( "SmtpSink", BM_LogSmtp, new BmSmtpStatusFilter( NULL),
+						  server, true)
+													{ }
+	void Receive()								{ GetAnswer(); }
+};
+
+/*------------------------------------------------------------------------------*\
+	the replies of an SMTP-server to a pipelined envelope (MAIL and three
+	RCPTs, the second of which is refused with a multiline reply) followed
+	by two BDAT-chunks
+\*------------------------------------------------------------------------------*/
+static const char* nReplies[] = {
+	"250 2.1.0 Ok",
+	"250 2.1.5 Ok",
+	"550-5.1.1 <b@test.org>: Recipient address rejected:\n"
+		"550 5.1.1 User unknown in local recipient table",
+	"250 2.1.5 Ok",
+	"250 2.0.0 1048576 octets received",
+	"250 2.0.0 Ok: queued as 4711",
+};
+static const uint32 nReplyCount = sizeof(nReplies)/sizeof(const char*);
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	builds the script that is sent by the server (with CRLFs)
+\*------------------------------------------------------------------------------*/
+static BmString BuildScript()
+{
+	BmString script;
+	for( uint32 i=0; i<nReplyCount; ++i)
+		script << nReplies[i] << "\n";
+	script.ReplaceAll( "\n", "\r\n");
+	return script;
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	reads all scripted replies through the given sink and checks that
+			each one is matched to its own command
+\*------------------------------------------------------------------------------*/
+static void CheckReplies( SmtpSink& sink)
+{
+	for( uint32 i=0; i<nReplyCount; ++i) {
+		sink.Receive();
+		BmString status = sink.StatusText();
+		status.RemoveAll( "\r");
+		CPPUNIT_ASSERT( status == nReplies[i]);
+	}
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	checks the replies sent by the given server
+\*------------------------------------------------------------------------------*/
+static void CheckServerReplies( ScriptedServerBuf& server)
+{
+	SmtpSink sink( &server);
+	CheckReplies( sink);
+}
+
+// setUp
+void
+SmtpPipelineTest::setUp()
+{
+	inherited::setUp();
+}
+
+// tearDown
+void
+SmtpPipelineTest::tearDown()
+{
+	inherited::tearDown();
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	the server sends all replies in one go
+\*------------------------------------------------------------------------------*/
+void
+SmtpPipelineTest::PipelinedRepliesTest(void)
+{
+	NextSubTest();
+	BmString script = BuildScript();
+	BmStringIBuf server( script);
+	SmtpSink sink( &server);
+	CheckReplies( sink);
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	the server delivers the replies in chunks with some latency, such
+			that reply-codes and multiline replies are split across reads
+\*------------------------------------------------------------------------------*/
+void
+SmtpPipelineTest::SlowServerTest(void)
+{
+	BmString script = BuildScript();
+	uint32 chunkSizes[] = { 1, 2, 5, 64 };
+	RunScriptedServer( *this, script, chunkSizes, 
+							 sizeof(chunkSizes)/sizeof(uint32), 100, 
+							 CheckServerReplies);
+}
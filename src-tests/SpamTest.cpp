@@ -0,0 +1,179 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+/*
+ * Beam's test-application is based on the OpenBeOS testing framework
+ * (which in turn is based on cppunit). Big thanks to everyone involved!
+ *
+ */
+
+#include <string.h>
+#include <sys/stat.h>
+
+#include <Message.h>
+
+#include "SpamTest.h"
+#include "TestBeam.h"
+
+static const uint32 nMailStamp = 0x5ca1ab1e;
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	creates a feature-stream with the given number of pairs
+\*------------------------------------------------------------------------------*/
+SpamTest::FeatureStream
+SpamTest::MakeStream( uint32 options, uint32 pairCount)
+{
+	FeatureStream stream( options, nMailStamp);
+	for( uint32 i=0; i<pairCount; ++i) {
+		FeaturePair pair = { 1000+i, 2000+i };
+		stream.mPairs.push_back( pair);
+	}
+	return stream;
+}
+
+// setUp
+void
+SpamTest::setUp()
+{
+	inherited::setUp();
+}
+
+// tearDown
+void
+SpamTest::tearDown()
+{
+	inherited::tearDown();
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	flattens feature-streams and reads them back
+\*------------------------------------------------------------------------------*/
+void
+SpamTest::FeatureStreamTest(void)
+{
+	NextSubTest();
+	BMessage jobSpecs;
+	CPPUNIT_ASSERT( FeatureStream::OptionsFor( NULL) == 0);
+	CPPUNIT_ASSERT( FeatureStream::OptionsFor( &jobSpecs) == 0);
+	jobSpecs.AddBool( "DeHtml", true);
+	jobSpecs.AddBool( "KeepATags", false);
+	CPPUNIT_ASSERT( FeatureStream::OptionsFor( &jobSpecs) 
+							== FeatureStream::OptionDeHtml);
+	jobSpecs.ReplaceBool( "KeepATags", true);
+	uint32 options = FeatureStream::OptionsFor( &jobSpecs);
+	CPPUNIT_ASSERT( options 
+		== (FeatureStream::OptionDeHtml | FeatureStream::OptionKeepATags));
+
+	NextSubTest();
+	FeatureStream stream = MakeStream( options, 100);
+	vector<char> data;
+	stream.Flatten( data);
+	CPPUNIT_ASSERT( data.size() == FeatureStream::HeaderWords*sizeof(uint32)
+												+ 100*sizeof(FeaturePair));
+	FeatureStream readStream( options, nMailStamp);
+	CPPUNIT_ASSERT( readStream.Unflatten( &data[0], data.size()));
+	CPPUNIT_ASSERT( readStream.mPairs.size() == 100);
+	for( uint32 i=0; i<100; ++i) {
+		CPPUNIT_ASSERT( readStream.mPairs[i].h1 == stream.mPairs[i].h1);
+		CPPUNIT_ASSERT( readStream.mPairs[i].h2 == stream.mPairs[i].h2);
+	}
+
+	NextSubTest();
+	FeatureStream emptyStream = MakeStream( 0, 0);
+	emptyStream.Flatten( data);
+	CPPUNIT_ASSERT( data.size() == FeatureStream::HeaderWords*sizeof(uint32));
+	FeatureStream readEmptyStream( 0, nMailStamp);
+	CPPUNIT_ASSERT( readEmptyStream.Unflatten( &data[0], data.size()));
+	CPPUNIT_ASSERT( readEmptyStream.mPairs.empty());
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	flattened feature-streams must not be accepted for other options,
+			another mailtext, by another tokenizer or if they are damaged
+\*------------------------------------------------------------------------------*/
+void
+SpamTest::FeatureStreamMismatchTest(void)
+{
+	vector<char> data;
+	MakeStream( FeatureStream::OptionDeHtml, 10).Flatten( data);
+
+	NextSubTest();
+	FeatureStream otherOptions( 0, nMailStamp);
+	CPPUNIT_ASSERT( !otherOptions.Unflatten( &data[0], data.size()));
+	CPPUNIT_ASSERT( otherOptions.mPairs.empty());
+	FeatureStream moreOptions( 
+		FeatureStream::OptionDeHtml | FeatureStream::OptionKeepATags, 
+		nMailStamp
+	);
+	CPPUNIT_ASSERT( !moreOptions.Unflatten( &data[0], data.size()));
+
+	NextSubTest();
+	FeatureStream otherMail( FeatureStream::OptionDeHtml, nMailStamp+1);
+	CPPUNIT_ASSERT( !otherMail.Unflatten( &data[0], data.size()));
+
+	NextSubTest();
+	FeatureStream stream( FeatureStream::OptionDeHtml, nMailStamp);
+	vector<char> oldData( data);
+	uint32 version = FeatureStream::FormatVersion-1;
+	memcpy( &oldData[sizeof(uint32)], &version, sizeof(uint32));
+	CPPUNIT_ASSERT( !stream.Unflatten( &oldData[0], oldData.size()));
+	// the format of version 1 had a header of three words only:
+	uint32 oldHeader[3] = { 
+		FeatureStream::Magic, sizeof(FeaturePair), FeatureStream::OptionDeHtml 
+	};
+	memcpy( &oldData[0], oldHeader, sizeof(oldHeader));
+	CPPUNIT_ASSERT( !stream.Unflatten( &oldData[0], oldData.size()));
+
+	NextSubTest();
+	CPPUNIT_ASSERT( !stream.Unflatten( NULL, data.size()));
+	CPPUNIT_ASSERT( !stream.Unflatten( &data[0], 3));
+	CPPUNIT_ASSERT( !stream.Unflatten( &data[0], data.size()-1));
+	vector<char> badMagic( data);
+	badMagic[0] ^= 0xff;
+	CPPUNIT_ASSERT( !stream.Unflatten( &badMagic[0], badMagic.size()));
+	CPPUNIT_ASSERT( stream.mPairs.empty());
+
+	NextSubTest();
+	CPPUNIT_ASSERT( stream.Unflatten( &data[0], data.size()));
+	CPPUNIT_ASSERT( stream.mPairs.size() == 10);
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	the mail-stamp must change whenever any of the metadata it is 
+			built from changes, since stored features are matched by it
+\*------------------------------------------------------------------------------*/
+void
+SpamTest::MailStampTest(void)
+{
+	NextSubTest();
+	struct stat st;
+	memset( &st, 0, sizeof(st));
+	st.st_dev = 3;
+	st.st_ino = 4711;
+	st.st_size = 12345;
+	st.st_mtime = 1100000000;
+	uint32 stamp = FeatureStream::MailStampFor( st);
+	CPPUNIT_ASSERT( FeatureStream::MailStampFor( st) == stamp);
+
+	NextSubTest();
+	struct stat other = st;
+	other.st_dev++;
+	CPPUNIT_ASSERT( FeatureStream::MailStampFor( other) != stamp);
+	other = st;
+	other.st_ino++;
+	CPPUNIT_ASSERT( FeatureStream::MailStampFor( other) != stamp);
+	other = st;
+	other.st_size++;
+	CPPUNIT_ASSERT( FeatureStream::MailStampFor( other) != stamp);
+	other = st;
+	other.st_mtime++;
+	CPPUNIT_ASSERT( FeatureStream::MailStampFor( other) != stamp);
+}
@@ -0,0 +1,55 @@
+/*
+ * Copyright 2002-2006, project beam (http://sourceforge.net/projects/beam).
+ * All rights reserved. Distributed under the terms of the GNU GPL v2.
+ *
+ * Authors:
+ *		Oliver Tappe <beam@hirschkaefer.de>
+ */
+/*
+ * Beam's test-application is based on the OpenBeOS testing framework
+ * (which in turn is based on cppunit). Big thanks to everyone involved!
+ *
+ */
+
+
+#ifndef _SpamTest_h
+#define _SpamTest_h
+
+#include <cppunit/TestCaller.h>
+#include <cppunit/TestSuite.h>
+#include <cppunit/extensions/HelperMacros.h>
+#include <TestCase.h>
+
+#include "BmSpamFilter.h"
+
+class SpamTest : public BTestCase
+{
+	typedef TestCase inherited;
+	CPPUNIT_TEST_SUITE( SpamTest );
+	CPPUNIT_TEST( FeatureStreamTest);
+	CPPUNIT_TEST( FeatureStreamMismatchTest);
+	CPPUNIT_TEST( MailStampTest);
+	CPPUNIT_TEST_SUITE_END();
+public:
+	// This function called before *each* test added in Suite()
+	void setUp();
+	
+	// This function called after *each* test added in Suite()
+	void tearDown();
+
+	//------------------------------------------------------------
+	// Test functions
+	//------------------------------------------------------------
+	void FeatureStreamTest();
+	void FeatureStreamMismatchTest();
+	void MailStampTest();
+
+private:
+	typedef BmSpamFilter::OsbfClassifier::FeatureStream FeatureStream;
+	typedef BmSpamFilter::OsbfClassifier::FeaturePair FeaturePair;
+
+	static FeatureStream MakeStream( uint32 options, uint32 pairCount);
+};
+
+
+#endif
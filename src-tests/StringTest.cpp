@@ -11,24 +11,65 @@
  *
  */
 
+#include <stdio.h>
+
+#include <OS.h>
 #include <UTF8.h>
 
 #include "StringTest.h"
 #include "TestBeam.h"
 
+#include "BmMail.h"
+#include "BmMailHeader.h"
 #include "BmString.h"
 
+static BmString nHeaderText("\
+Date: Mon, 25 Feb 2003 08:51:06 -0500\r\n\
+Received: from mail.test.org by mx.test.org with SMTP id 4711\r\n\
+From: Some Sender <sender@test.org>\r\n\
+To: you@test.org\r\n\
+Cc: cc1@test.org, the_cc2 <cc2@test.org>\r\n\
+Sender: <list@test.org>\r\n\
+Subject: A simple testmail\r\n\
+Message-Id: <4711@test.org>\r\n\
+X-Priority: 3\r\n\
+\r\n\
+blah (just to have a body)\
+");
+
+static vint32 nHeapAllocations = 0;
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	counts the heap-buffers allocated for string-data
+\*------------------------------------------------------------------------------*/
+static void CountHeapAllocation()
+{
+	atomic_add( &nHeapAllocations, 1);
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	returns the number of heap-buffers allocated for string-data so far
+\*------------------------------------------------------------------------------*/
+static int32 HeapAllocations()
+{
+	return nHeapAllocations;
+}
+
 // setUp
 void
 StringTest::setUp()
 {
 	inherited::setUp();
+	BmString::SetHeapAllocHook( CountHeapAllocation);
 }
 	
 // tearDown
 void
 StringTest::tearDown()
 {
+	BmString::SetHeapAllocHook( NULL);
 	inherited::tearDown();
 }
 
@@ -166,3 +207,140 @@ StringTest::StringBeamExtensionsTest(void)
 	trim.Trim( false, false);
 	CPPUNIT_ASSERT( strcmp( trim.String(), "          x x x         ") == 0);
 }
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	checks strings around the limit of the inline storage, such that
+			they move between inline storage and heap
+\*------------------------------------------------------------------------------*/
+void 
+StringTest::ShortStringTest(void)
+{
+	NextSubTest();
+	BmString str;
+	CPPUNIT_ASSERT( str.Length() == 0 && *str.String() == 0);
+	int32 allocs = HeapAllocations();
+	str = "short";
+	str << " and" << 'x';
+	CPPUNIT_ASSERT( str == "short andx");
+	CPPUNIT_ASSERT( HeapAllocations() == allocs);
+
+	NextSubTest();
+	BmString expected;
+	for( int32 i=0; i<40; ++i) {
+		str << char('a'+i%26);
+		expected << char('a'+i%26);
+		CPPUNIT_ASSERT( str.Length() == 10+i+1);
+		CPPUNIT_ASSERT( strcmp( str.String()+10, expected.String()) == 0);
+	}
+
+	NextSubTest();
+	for( int32 len=str.Length(); len>=0; --len) {
+		str.Truncate( len);
+		CPPUNIT_ASSERT( str.Length() == len);
+		CPPUNIT_ASSERT( str.String()[len] == 0);
+	}
+	CPPUNIT_ASSERT( str == "");
+
+	NextSubTest();
+	str = "0123456789";
+	str.Prepend( "0123456789");
+	CPPUNIT_ASSERT( str == "01234567890123456789");
+	str.RemoveAll( "9");
+	CPPUNIT_ASSERT( str == "012345678012345678");
+	str.ReplaceAll( "0", "000");
+	CPPUNIT_ASSERT( str == "0001234567800012345678");
+	str.ReplaceAll( "000", "");
+	CPPUNIT_ASSERT( str == "1234567812345678");
+
+	NextSubTest();
+	char* buf = str.LockBuffer( 100);
+	strcpy( buf, "tiny");
+	str.UnlockBuffer();
+	CPPUNIT_ASSERT( str == "tiny" && str.Length() == 4);
+	BmString copy( str);
+	copy << str << str << str << str << str;
+	CPPUNIT_ASSERT( copy == "tinytinytinytinytinytiny");
+	CPPUNIT_ASSERT( str == "tiny");
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	checks that adopting (and moving) takes over the data, for short
+			and long strings alike
+\*------------------------------------------------------------------------------*/
+void 
+StringTest::MoveTest(void)
+{
+	NextSubTest();
+	BmString shortStr( "short");
+	BmString longStr( "a string which is too long to be stored inline");
+	BmString target;
+	target.Adopt( shortStr);
+	CPPUNIT_ASSERT( target == "short" && shortStr.Length() == 0);
+	int32 allocs = HeapAllocations();
+	const char* longData = longStr.String();
+	target.Adopt( longStr);
+	CPPUNIT_ASSERT( target.String() == longData && longStr.Length() == 0);
+	CPPUNIT_ASSERT( HeapAllocations() == allocs);
+
+	NextSubTest();
+	target.Adopt( target);
+	CPPUNIT_ASSERT( target.String() == longData);
+	BmString partial( "a string which is too long as well");
+	target.Adopt( partial, 8);
+	CPPUNIT_ASSERT( target == "a string" && partial.Length() == 0);
+
+#if __cplusplus >= 201103L
+	NextSubTest();
+	BmString moved( static_cast<BmString&&>( target));
+	CPPUNIT_ASSERT( moved == "a string" && target.Length() == 0);
+	target = static_cast<BmString&&>( moved);
+	CPPUNIT_ASSERT( target == "a string" && moved.Length() == 0);
+	longStr = "a string which is too long to be stored inline";
+	longData = longStr.String();
+	allocs = HeapAllocations();
+	moved = static_cast<BmString&&>( longStr);
+	CPPUNIT_ASSERT( moved.String() == longData && longStr.Length() == 0);
+	CPPUNIT_ASSERT( HeapAllocations() == allocs);
+#endif
+}
+
+/*------------------------------------------------------------------------------*\
+	()
+		-	counts the string-allocations required for parsing a mail-header
+			and for looking up some of its fields
+		-	lookups of short fields must not allocate at all
+\*------------------------------------------------------------------------------*/
+void 
+StringTest::HeaderParsingAllocationsTest(void)
+{
+	NextSubTest();
+	const int32 rounds = 1000;
+	BmString account( "testacc@test.org");
+	BmRef<BmMail> mail = new BmMail( nHeaderText, account);
+	int32 allocs = HeapAllocations();
+	bigtime_t start = system_time();
+	for( int32 i=0; i<rounds; ++i)
+		mail->SetTo( nHeaderText, account);
+	bigtime_t duration = system_time()-start;
+	printf( "<parsing: %.1f allocations and %Ld us per header>",
+			  double(HeapAllocations()-allocs)/rounds,
+			  duration/rounds);
+
+	NextSubTest();
+	allocs = HeapAllocations();
+	start = system_time();
+	for( int32 i=0; i<rounds; ++i) {
+		CPPUNIT_ASSERT( mail->GetFieldVal( BM_FIELD_SUBJECT) 
+								== "A simple testmail");
+		CPPUNIT_ASSERT( mail->GetFieldVal( BM_FIELD_X_PRIORITY) == "3");
+		CPPUNIT_ASSERT( mail->Header()->DetermineSender() == "list@test.org");
+	}
+	duration = system_time()-start;
+	printf( "<lookups: %.1f allocations and %Ld us per round>",
+			  double(HeapAllocations()-allocs)/rounds,
+			  duration/rounds);
+	fflush(stdout);
+	CPPUNIT_ASSERT( HeapAllocations() == allocs);
+}
@@ -38,16 +38,31 @@ using namespace regexx;
 #include "Base64EncoderTest.h"
 #include "BinaryDecoderTest.h"
 #include "BinaryEncoderTest.h"
+#include "CharsetDetectionTest.h"
+#include "CodecBenchmarkTest.h"
 #include "EncodedWordEncoderTest.h"
 #include "FoldedLineEncoderTest.h"
+#include "ImapFetchTest.h"
+#include "ImapIdleTest.h"
 #include "LinebreakDecoderTest.h"
 #include "LinebreakEncoderTest.h"
+#include "ListModelBatchTest.h"
+#include "LogHandlerTest.h"
+#include "MailHeaderTest.h"
+#include "MailIndexTest.h"
 #include "MailMonitorTest.h"
 #include "MemIoTest.h"
 #include "MultiLockerTest.h"
+#include "NetJobQueueTest.h"
+#include "PopPipelineTest.h"
+#include "PrefsTest.h"
 #include "QuotedPrintableDecoderTest.h"
 #include "QuotedPrintableEncoderTest.h"
+#include "RefManagerTest.h"
+#include "RegexxCacheTest.h"
 #include "SieveTest.h"
+#include "SmtpPipelineTest.h"
+#include "SpamTest.h"
 #include "StringTest.h"
 #include "Utf8DecoderTest.h"
 #include "Utf8EncoderTest.h"
@@ -92,6 +107,26 @@ void SlurpFile( const char* filename, BmString& str) {
 		);
 }
 
+/*------------------------------------------------------------------------------*\
+	()
+		-	
+\*------------------------------------------------------------------------------*/
+void RunScriptedServer( BTestCase& test, const BmString& script, 
+								const uint32* chunkSizes, uint32 chunkCount, 
+								bigtime_t latency, ScriptedServerCheck check) {
+	for( uint32 c=0; c<chunkCount; ++c) {
+		test.NextSubTest();
+		ScriptedServerBuf server( script, chunkSizes[c], latency);
+		bigtime_t start = system_time();
+		check( server);
+		if (latency) {
+			printf( "<chunks of %lu bytes: %lu reads in %Ld us>", 
+					  chunkSizes[c], server.ReadCount(), system_time()-start);
+			fflush(stdout);
+		}
+	}
+}
+
 /*------------------------------------------------------------------------------*\
 	()
 		-	
@@ -100,10 +135,18 @@ BTestSuite* CreateBmBaseTestSuite() {
 	BTestSuite *suite = new BTestSuite("BmBase");
 
 	// ##### Add test suites here #####
+	suite->addTest("BmBase::ListModelBatch", 
+						ListModelBatchTest::suite());
+	suite->addTest("BmBase::LogHandler", 
+						LogHandlerTest::suite());
 	suite->addTest("BmBase::MemIo", 
 						MemIoTest::suite());
 //	suite->addTest("BmBase::MultiLocker", 
 //						MultiLockerTest::suite());
+	suite->addTest("BmBase::Prefs", 
+						PrefsTest::suite());
+	suite->addTest("BmBase::RefManager", 
+						RefManagerTest::suite());
 	suite->addTest("BmBase::String", 
 						StringTest::suite());
 	return suite;
@@ -138,10 +181,18 @@ BTestSuite* CreateMailParserTestSuite() {
 						BinaryDecoderTest::suite());
 	suite->addTest("Encoding::BinaryEncoder", 
 						BinaryEncoderTest::suite());
+	suite->addTest("Encoding::CharsetDetection", 
+						CharsetDetectionTest::suite());
+	suite->addTest("Encoding::CodecBenchmark", 
+						CodecBenchmarkTest::suite());
 	suite->addTest("Encoding::EncodedWordEncoder", 
 						EncodedWordEncoderTest::suite());
 	suite->addTest("Encoding::FoldedLineEncoder", 
 						FoldedLineEncoderTest::suite());
+	suite->addTest("MailParser::MailHeader", 
+						MailHeaderTest::suite());
+	suite->addTest("MailParser::MailIndex", 
+						MailIndexTest::suite());
 	suite->addTest("Encoding::LinebreakDecoder", 
 						LinebreakDecoderTest::suite());
 	suite->addTest("Encoding::LinebreakEncoder", 
@@ -150,6 +201,8 @@ BTestSuite* CreateMailParserTestSuite() {
 						QuotedPrintableDecoderTest::suite());
 	suite->addTest("Encoding::QuotedPrintableEncoder", 
 						QuotedPrintableEncoderTest::suite());
+	suite->addTest("Regexx::RegexxCache", 
+						RegexxCacheTest::suite());
 	suite->addTest("Encoding::Utf8Decoder", 
 						Utf8DecoderTest::suite());
 	suite->addTest("Encoding::Utf8Encoder", 
@@ -157,6 +210,27 @@ BTestSuite* CreateMailParserTestSuite() {
 	return suite;
 }
 
+/*------------------------------------------------------------------------------*\
+	()
+		-	
+\*------------------------------------------------------------------------------*/
+BTestSuite* CreateProtocolsTestSuite() {
+	BTestSuite *suite = new BTestSuite("Protocols");
+
+	// ##### Add test suites here #####
+	suite->addTest("Protocols::ImapFetch", 
+						ImapFetchTest::suite());
+	suite->addTest("Protocols::ImapIdle", 
+						ImapIdleTest::suite());
+	suite->addTest("Protocols::NetJobQueue", 
+						NetJobQueueTest::suite());
+	suite->addTest("Protocols::PopPipeline", 
+						PopPipelineTest::suite());
+	suite->addTest("Protocols::SmtpPipeline", 
+						SmtpPipelineTest::suite());
+	return suite;
+}
+
 /*------------------------------------------------------------------------------*\
 	()
 		-	
@@ -167,6 +241,8 @@ BTestSuite* CreateFilterAddonsTestSuite() {
 	// ##### Add test suites here #####
 	suite->addTest("FilterAddons::Sieve", 
 						SieveTest::suite());
+	suite->addTest("FilterAddons::Spam", 
+						SpamTest::suite());
 	return suite;
 }
 
@@ -228,6 +304,7 @@ int32 StartTests( void* args) {
 		if (HaveTestdata)
 			shell.AddSuite( CreateMailTrackerTestSuite() );
 		shell.AddSuite( CreateMailParserTestSuite() );
+		shell.AddSuite( CreateProtocolsTestSuite() );
 		shell.AddSuite( CreateFilterAddonsTestSuite() );
 	
 		BTestShell::SetGlobalShell(&shell);
@@ -15,6 +15,12 @@
 #ifndef _TestBeam_h
 #define _TestBeam_h
 
+#include <OS.h>
+
+#include <TestCase.h>
+
+#include "BmMemIO.h"
+#include "BmNetJobModel.h"
 #include "BmString.h"
 
 void SlurpFile( const char* filename, BmString& str);
@@ -31,4 +37,77 @@ struct Activator {
 	bool& flag;
 };
 
+/*------------------------------------------------------------------------------*\
+	ScriptedServerBuf
+		-	plays the part of a server: delivers the given answer in small 
+			chunks, each of which is delayed by the given latency
+\*------------------------------------------------------------------------------*/
+class ScriptedServerBuf : public BmMemIBuf {
+public:
+	ScriptedServerBuf( const BmString& script, uint32 chunkSize, 
+							 bigtime_t latency)
+		:	mScript( script)
+		,	mPos( 0)
+		,	mChunkSize( chunkSize)
+		,	mLatency( latency)
+		,	mReadCount( 0)							{}
+	uint32 Read( char* data, uint32 reqLen) {
+		uint32 len = std::min( std::min( reqLen, mChunkSize), 
+									  uint32(mScript.Length()) - mPos);
+		if (mLatency)
+			snooze( mLatency);
+		memcpy( data, mScript.String()+mPos, len);
+		mPos += len;
+		mReadCount++;
+		return len;
+	}
+	bool IsAtEnd()								{ return mPos >= (uint32)mScript.Length(); }
+	uint32 ReadCount() const				{ return mReadCount; }
+	uint32 ChunkSize() const				{ return mChunkSize; }
+private:
+	BmString mScript;
+	uint32 mPos;
+	uint32 mChunkSize;
+	bigtime_t mLatency;
+	uint32 mReadCount;
+};
+
+/*------------------------------------------------------------------------------*\
+	RunScriptedServer()
+		-	lets the given check talk to a scripted server once for each of the
+			given chunk-sizes (as a subtest of its own)
+		-	if a latency is given, the number of reads and the time taken are
+			printed for each chunk-size
+\*------------------------------------------------------------------------------*/
+typedef void (*ScriptedServerCheck)( ScriptedServerBuf& server);
+void RunScriptedServer( BTestCase& test, const BmString& script, 
+								const uint32* chunkSizes, uint32 chunkCount, 
+								bigtime_t latency, ScriptedServerCheck check);
+
+/*------------------------------------------------------------------------------*\
+	NetJobStandIn
+		-	a network-job that receives its answers from the given buffer 
+			instead of a server
+		-	the protocol-specific stand-ins only add a way to receive answers
+\*------------------------------------------------------------------------------*/
+class NetJobStandIn : public BmNetJobModel {
+	typedef BmNetJobModel inherited;
+public:
+	NetJobStandIn( const char* name, uint32 logType, 
+						BmStatusFilter* statusFilter, BmMemIBuf* server, 
+						bool pipelining)
+		:	inherited( name, logType, statusFilter)
+	{
+		mIncomingLogger->Reset( server);
+		mPipelining = pipelining;
+	}
+	void SetServer( BmMemIBuf* server)	{ mIncomingLogger->Reset( server); }
+
+	void UpdateProgress( uint32)			{ }
+	bool StartJob()							{ return true; }
+protected:
+	void ExtractBase64( const BmString&, BmString&)
+													{ }
+};
+
 #endif
@@ -49,6 +49,7 @@ static int32 PerfCount = -1;
 
 static bool DeHtml = false;
 static bool KeepATags = false;
+static bool CacheFeatures = false;
 
 static void Out(const char* format, ...)
 {
@@ -257,7 +258,7 @@ void SpamOMeter( const char* pathfileName, ResInfo& ri)
 			Out("### couldn't read! ###\n");
 			continue;
 		}
-		Out("%ld...", mail->RawText().Length());
+		Out("%ld...", mail->RawTextLength());
 		BmMsgContext result;
 		// Learning as Tofu/Spam actually skips the learning if a mail has
 		// already been marked as such. However, we are simulating a fresh
@@ -386,6 +387,8 @@ main( int argc, char** argv)
 			DeHtml = true;
 		else if (!strcmp(argv[as], "--keep-atags"))
 			KeepATags = true;
+		else if (!strcmp(argv[as], "--cache-features"))
+			CacheFeatures = true;
 		else if (!strcmp(argv[as], "--do-training"))
 			TrainingMode = true;
 		else 
@@ -395,6 +398,9 @@ main( int argc, char** argv)
 	if (argc<=as && !TrainingMode) {
 		fprintf(stderr, "usage:\n\t%s [options] path-files\n", argv[0]);
 		fprintf(stderr, "where options can be any combination of:\n"
+				  "\t[--cache-features]\n"
+				  "\t\tstore the features of each mail in an attribute, such that\n"
+				  "\t\tthey don't have to be extracted again in the next run\n"
 				  "\t[--dehtml]\n"
 				  "\t\tremove html-tags from mails before classifying\n"
 				  "\t[--do-training]\n"
@@ -436,6 +442,11 @@ main( int argc, char** argv)
 		LearnAsSpamJob.AddBool("KeepATags", true);
 		LearnAsTofuJob.AddBool("KeepATags", true);
 	}
+	if (CacheFeatures) {
+		ClassifyJob.AddBool("PersistFeatures", true);
+		LearnAsSpamJob.AddBool("PersistFeatures", true);
+		LearnAsTofuJob.AddBool("PersistFeatures", true);
+	}
 	ClassifyJob.AddInt32("ThresholdForSpam", ThresholdForSpam);
 	ClassifyJob.AddInt32("ThresholdForTofu", ThresholdForTofu);
 	ClassifyJob.AddInt32("UnsureForSpam", UnsureForSpam);